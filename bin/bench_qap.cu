@@ -3,6 +3,8 @@
 #include <random>
 
 #include "argparse/argparse.hpp"
+#include "stencil/dim3.hpp"
+#include "stencil/numeric.hpp"
 #include "stencil/qap.hpp"
 
 struct Mats {
@@ -67,7 +69,7 @@ Mat2D<double> blkdiag(int size,    // matrix size
   while (r < size) {
 
     int blkSize = blkSizeDist(re);
-    blkSize = min(blkSize, size - r);
+    blkSize = std::min(blkSize, size - r);
 
     // fill the block
     for (int i = r; i < r + blkSize; ++i) {
@@ -109,11 +111,69 @@ Mats make_blkdiag(int s) {
   };
 }
 
-void bench(const std::string &name, MatFunc func) {
+/* s GPUs running a periodic 3D stencil, in groups of 4 with fast links
+ */
+Mats make_stencil(int s) {
+  Mat2D<double> w(s, s, 0);
+  Mat2D<double> d(s, s);
+
+  // split s into a 3D grid of subdomains
+  Dim3 dim(1, 1, 1);
+  for (int64_t f : prime_factors(s)) {
+    if (dim.x <= dim.y && dim.x <= dim.z) {
+      dim.x *= f;
+    } else if (dim.y <= dim.z) {
+      dim.y *= f;
+    } else {
+      dim.z *= f;
+    }
+  }
+
+  for (int i = 0; i < s; ++i) {
+    Dim3 src(i % dim.x, (i / dim.x) % dim.y, i / (dim.x * dim.y));
+    for (int dz = -1; dz <= 1; ++dz) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          Dim3 dir(dx, dy, dz);
+          if (dir == Dim3(0, 0, 0)) {
+            continue;
+          }
+          Dim3 dst = (src + dir).wrap(dim);
+          const int j = dst.x + dst.y * dim.x + dst.z * dim.y * dim.x;
+          // faces, edges, and corners of a 512^3 subdomain with radius 2
+          const int nz = (dx != 0) + (dy != 0) + (dz != 0);
+          w.at(i, j) += 1 == nz ? 512 * 512 * 2 : (2 == nz ? 512 * 2 * 2 : 2 * 2 * 2);
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < s; ++i) {
+    for (int j = 0; j < s; ++j) {
+      if (i == j) {
+        d.at(i, j) = 0;
+      } else if (i / 4 == j / 4) {
+        d.at(i, j) = 1.0 / 75;
+      } else {
+        d.at(i, j) = 1.0 / 25;
+      }
+    }
+  }
+
+  return Mats{
+      .w = w,
+      .d = d,
+  };
+}
+
+void bench(const std::string &name, MatFunc func, int maxExact, double timeLimit, const qap::TabuOptions &tabuOpts) {
   int nIters = 20;
 
+  qap::SolveOptions opts;
+  opts.timeLimit = timeLimit;
+
   std::cout << name << "\n";
-  std::cout << "size CRAFT(s) cost exact(s) cost\n";
+  std::cout << "size CRAFT(s) cost tabu(s) cost exact(s) cost nodes pruned(%) best(s) optimal\n";
   for (int s = 2; s < 40; ++s) {
 
     Mats wd = func(s);
@@ -136,23 +196,21 @@ void bench(const std::string &name, MatFunc func) {
 
     std::cout << elapsed.count() / nIters << " " << cost;
 
-    // benchmark exact solution
-    if (s < 9) {
-      start = std::chrono::system_clock::now();
-
-      for (int i = 0; i < nIters; ++i) {
-        auto f = qap::solve(w, d, &cost);
-      }
+    // benchmark tabu search
+    start = std::chrono::system_clock::now();
+    qap::solve_tabu(w, d, &cost, tabuOpts);
+    elapsed = std::chrono::system_clock::now() - start;
+    std::cout << " " << elapsed.count() << " " << cost;
 
-      elapsed =
-          std::chrono::system_clock::now() - start;
+    // benchmark exact solution
+    if (s <= maxExact) {
+      qap::SolveStats stats;
+      auto f = qap::solve(w, d, &cost, opts, &stats);
 
-      std::cout << " " << elapsed.count() / nIters << " " << cost;
+      std::cout << " " << stats.elapsed << " " << cost << " " << stats.nodes << " " << 100 * stats.prune_ratio()
+                << " " << stats.timeToBest << " " << stats.optimal;
     } else {
-      std::cout << " "
-                << "-"
-                << " "
-                << "-";
+      std::cout << " - - - - - -";
     }
 
     std::cout << "\n";
@@ -160,12 +218,28 @@ void bench(const std::string &name, MatFunc func) {
 }
 
 int main(int argc, char **argv) {
-  (void) argc;
-  (void) argv;
 
-  bench("blkdiag", make_blkdiag);
-  bench("random", make_random);
-  bench("matched", make_matched);
+  argparse::Parser p("benchmark QAP solvers");
+  int maxExact = 16;
+  double timeLimit = 10;
+  p.add_option(maxExact, "--max-exact")->help("largest problem for the exact solver");
+  p.add_option(timeLimit, "--time-limit")->help("exact solver time limit (s)");
+  qap::TabuOptions tabuOpts;
+  p.add_option(tabuOpts.starts, "--starts")->help("tabu search starts");
+  p.add_option(tabuOpts.threads, "--threads")->help("tabu search threads (0 for all)");
+  if (!p.parse(argc, argv)) {
+    std::cout << p.help();
+    exit(EXIT_FAILURE);
+  }
+  if (p.need_help()) {
+    std::cout << p.help();
+    exit(EXIT_SUCCESS);
+  }
+
+  bench("stencil", make_stencil, maxExact, timeLimit, tabuOpts);
+  bench("blkdiag", make_blkdiag, maxExact, timeLimit, tabuOpts);
+  bench("random", make_random, maxExact, timeLimit, tabuOpts);
+  bench("matched", make_matched, maxExact, timeLimit, tabuOpts);
 
   return 0;
 }
@@ -21,8 +21,10 @@ int main(int argc, char **argv) {
   MPI_Comm_size(MPI_COMM_WORLD, &size);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-  int devCount;
-  CUDA_RUNTIME(cudaGetDeviceCount(&devCount));
+  int devCount = 0;
+  if (cudaSuccess != cudaGetDeviceCount(&devCount)) {
+    devCount = 0; // CPU-only node
+  }
 
   int numSubdoms;
   int numNodes;
@@ -54,6 +56,7 @@ int main(int argc, char **argv) {
 
   int nIters = 30;
   bool useNaivePlacement = false;
+  bool useHost = false;
   bool useKernel = false;
   bool usePeer = false;
   bool useColoPmu = false; // pack/memcpy/unpack
@@ -62,6 +65,7 @@ int main(int argc, char **argv) {
   bool useColoM3 = false;  // memcpy3d
   bool useColoD = false;   // domainkernel
   bool useStaged = false;
+  bool useAggregate = false;
 
   argparse::Parser p;
   p.no_unrecognized();
@@ -79,6 +83,8 @@ int main(int argc, char **argv) {
   p.add_flag(useNaivePlacement, "--naive");
   p.add_option(prefix, "--prefix");
   p.add_flag(useStaged, "--staged");
+  p.add_flag(useHost, "--host")->help("domains in host memory, exchange with MPI");
+  p.add_flag(useAggregate, "--aggregate")->help("one MPI message per pair of ranks");
   if (!p.parse(argc, argv)) {
     std::cout << p.help() << "\n";
     exit(EXIT_FAILURE);
@@ -109,6 +115,9 @@ int main(int argc, char **argv) {
   if (useKernel) {
     methods |= Method::CudaKernel;
   }
+  if (useHost) {
+    methods = Method::HostMpi;
+  }
   if (methods == Method::None) {
     methods = Method::Default;
   }
@@ -137,6 +146,7 @@ int main(int argc, char **argv) {
     dd.set_methods(methods);
     dd.set_radius(radius);
     dd.set_output_prefix(prefix);
+    dd.set_aggregate(useAggregate);
     if (useNaivePlacement) {
       dd.set_placement(PlacementStrategy::Trivial);
     } else {
@@ -53,13 +53,16 @@ __global__ void stencil_kernel(Accessor<float> dst, const Accessor<float> src,
     for (int y = myReg.lo.y + blockIdx.y * blockDim.y + threadIdx.y; y < myReg.hi.y; y += gridDim.y * blockDim.y) {
       for (int x = myReg.lo.x + blockIdx.x * blockDim.x + threadIdx.x; x < myReg.hi.x; x += gridDim.x * blockDim.x) {
         Dim3 o(x, y, z);
+        // with deep halos, points in the halo are computed too
+        Dim3 w = o;
+        w = w.wrap(cReg.hi);
 
         /* a sphere 1/10 of the CR in radius and x = 1/3 of the way over is set hot
            a similar sphere of cold is at x = 2/3
         */
-        if (dist(o, hotCenter) <= sphereRadius) {
+        if (dist(w, hotCenter) <= sphereRadius) {
           dst[o] = HOT_TEMP;
-        } else if (dist(o, coldCenter) <= sphereRadius) {
+        } else if (dist(w, coldCenter) <= sphereRadius) {
           dst[o] = COLD_TEMP;
         } else {
           float px = src[o + Dim3(1, 0, 0)];
@@ -90,8 +93,11 @@ int main(int argc, char **argv) {
   bool useColo = false;
   bool useMemcpyPeer = false;
   bool useKernel = false;
+  bool autotune = false;
 
   bool trivial = false;
+  bool exhaustive = false;
+  bool hilbert = false;
   bool noOverlap = false;
   bool paraview = false;
 
@@ -103,6 +109,7 @@ int main(int argc, char **argv) {
 
   int iters = 5;
   int checkpointPeriod = -1;
+  int haloDepth = 1;
 
   argparse::Parser parser("a cwpearson/argparse-powered CLI app");
   // clang-format off
@@ -110,12 +117,16 @@ int main(int argc, char **argv) {
   parser.add_flag(useColo, "--colo")->help("Enable ColocatedHaloSender/Recver");
   parser.add_flag(useMemcpyPeer, "--peer")->help("Enable PeerAccessSender");
   parser.add_flag(useKernel, "--kernel")->help("Enable PeerCopySender");
+  parser.add_flag(autotune, "--autotune")->help("Time the enabled methods and use the fastest for each message");
   parser.add_flag(trivial, "--trivial")->help("Skip node-aware placement");
+  parser.add_flag(exhaustive, "--exhaustive")->help("Search all decompositions for the least halo traffic");
+  parser.add_flag(hilbert, "--hilbert")->help("Place along a Hilbert curve");
   parser.add_flag(noOverlap, "--no-overlap")->help("Don't overlap communication and computation");
   parser.add_option(prefix, "--prefix")->help("prefix for paraview files");
   parser.add_flag(paraview, "--paraview")->help("dump paraview files");
   parser.add_option(iters, "--iters", "-n")->help("number of iterations");
   parser.add_option(checkpointPeriod, "--period", "-q")->help("iterations between checkpoints");
+  parser.add_option(haloDepth, "--halo-depth")->help("exchange every N iterations, with N-deep halos");
   parser.add_positional(x)->required();
   parser.add_positional(y)->required();
   parser.add_positional(z)->required();
@@ -227,10 +238,14 @@ int main(int argc, char **argv) {
   PlacementStrategy strategy = PlacementStrategy::NodeAware;
   if (trivial) {
     strategy = PlacementStrategy::Trivial;
+  } else if (exhaustive) {
+    strategy = PlacementStrategy::Exhaustive;
+  } else if (hilbert) {
+    strategy = PlacementStrategy::Hilbert;
   }
 
   bool overlap = true;
-  if (noOverlap) {
+  if (noOverlap || haloDepth > 1) { // deep halos compute into the halo instead of overlapping
     overlap = false;
   }
 
@@ -252,7 +267,9 @@ int main(int argc, char **argv) {
     DistributedDomain dd(x, y, z);
 
     dd.set_methods(methods);
+    dd.set_autotune(autotune);
     dd.set_radius(radius);
+    dd.set_halo_depth(haloDepth);
     dd.set_placement(strategy);
 
     auto dh = dd.add_data<float>("d");
@@ -319,7 +336,9 @@ int main(int argc, char **argv) {
       // exchange halos: update ghost elements with current values from neighbors
       // if (0 == rank)
       //   std::cerr << rank << ": exchange\n";
-      dd.exchange();
+      if (dd.exchange_due()) {
+        dd.exchange();
+      }
 
       if (overlap) {
         // operate on exterior now that ghost values are right
@@ -341,10 +360,11 @@ int main(int argc, char **argv) {
           }
         }
       } else {
-        // launch operations on compute region now that ghost values are right
+        // launch operations on compute region (and any deep halo) now that ghost values are right
+        const std::vector<Rect3> stepRegions = dd.get_step_regions();
         for (size_t di = 0; di < dd.domains().size(); ++di) {
           auto &d = dd.domains()[di];
-          const Rect3 mr = d.get_compute_region();
+          const Rect3 mr = stepRegions[di];
           const Accessor<float> src = d.get_curr_accessor<float>(dh);
           const Accessor<float> dst = d.get_next_accessor<float>(dh);
           nvtxRangePush("launch (whole)");
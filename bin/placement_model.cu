@@ -0,0 +1,248 @@
+/* Model the placement and communication plan of a DistributedDomain on a machine described in a file, without running
+   on that machine. See Machine (stencil/machine.hpp) for the file format.
+
+   Prints the rank-to-rank bytes of one halo exchange, the bytes carried by each method, and the links that carry the
+   most bytes for their bandwidth.
+*/
+
+#include "stencil/exchange_plan.hpp"
+#include "stencil/logging.hpp"
+#include "stencil/machine.hpp"
+#include "stencil/mat2d.hpp"
+#include "stencil/mpi.hpp"
+#include "stencil/partition.hpp"
+#include "stencil/placement_intranoderandom.hpp"
+#include "stencil/placement_sfc.hpp"
+
+#include "argparse/argparse.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+/* bytes sent over a link, and its bandwidth
+ */
+struct Link {
+  uint64_t bytes;
+  double bandwidth;
+  Link() : bytes(0), bandwidth(1) {}
+  double time() const { return double(bytes) / bandwidth; }
+};
+
+int main(int argc, char **argv) {
+
+  bool useStaged = false;
+  bool useColo = false;
+  bool useMemcpyPeer = false;
+  bool useKernel = false;
+
+  bool trivial = false;
+  bool random = false;
+  bool exhaustive = false;
+  bool hilbert = false;
+  bool morton = false;
+  bool open = false;
+
+  std::string machineFile;
+  size_t x = 512;
+  size_t y = 512;
+  size_t z = 512;
+  int radius = 1;
+  int bytesPerCell = 4;
+  int top = 5;
+
+  argparse::Parser parser("model placement and communication on a described machine");
+  // clang-format off
+  parser.add_flag(useStaged, "--staged")->help("Enable RemoteSender/Recver");
+  parser.add_flag(useColo, "--colo")->help("Enable ColocatedHaloSender/Recver");
+  parser.add_flag(useMemcpyPeer, "--peer")->help("Enable PeerAccessSender");
+  parser.add_flag(useKernel, "--kernel")->help("Enable PeerCopySender");
+  parser.add_flag(trivial, "--trivial")->help("Skip node-aware placement");
+  parser.add_flag(random, "--random")->help("Random placement within each node");
+  parser.add_flag(exhaustive, "--exhaustive")->help("Search all decompositions for the least halo traffic");
+  parser.add_flag(hilbert, "--hilbert")->help("Place along a Hilbert curve");
+  parser.add_flag(morton, "--morton")->help("Place along a Morton curve");
+  parser.add_flag(open, "--open")->help("Open boundaries instead of periodic");
+  parser.add_option(radius, "--radius", "-r")->help("stencil radius");
+  parser.add_option(bytesPerCell, "--bytes", "-b")->help("bytes per grid point across all quantities");
+  parser.add_option(top, "--top")->help("number of busiest links to print");
+  parser.add_positional(machineFile)->required();
+  parser.add_positional(x)->required();
+  parser.add_positional(y)->required();
+  parser.add_positional(z)->required();
+  // clang-format on
+
+  if (!parser.parse(argc, argv)) {
+    std::cerr << parser.help() << "\n";
+    exit(EXIT_FAILURE);
+  }
+
+  if (parser.need_help()) {
+    std::cerr << parser.help() << "\n";
+    return 0;
+  }
+
+  // for logging, and the collectives in the placements are skipped
+  MPI_Init(&argc, &argv);
+
+  const Machine machine = Machine::from_file(machineFile);
+  const JobLayout job = JobLayout::from_machine(machine);
+  const Dim3 size(x, y, z);
+  const Radius rad = Radius::constant(radius);
+
+  Method methods = Method::None;
+  if (useStaged) {
+    methods |= Method::CudaMpi;
+  }
+  if (useColo) {
+    methods |= Method::ColoPackMemcpyUnpack;
+  }
+  if (useMemcpyPeer) {
+    methods |= Method::CudaMemcpyPeer;
+  }
+  if (useKernel) {
+    methods |= Method::CudaKernel;
+  }
+  if (Method::None == methods) {
+    methods = Method::Default;
+  }
+
+  const Topology::Boundary boundary = open ? Topology::Boundary::OPEN : Topology::Boundary::PERIODIC;
+
+  CommModel model;
+  model.bytesPerCell = bytesPerCell;
+  std::fill(model.boundary, model.boundary + 3, boundary);
+
+  std::unique_ptr<Placement> placement;
+  if (trivial) {
+    placement.reset(new Trivial(size, job, rad));
+  } else if (random) {
+    placement.reset(new IntraNodeRandom(size, job, rad));
+  } else if (hilbert) {
+    placement.reset(new SpaceFillingCurve(size, job, SpaceFillingCurve::Curve::Hilbert, rad));
+  } else if (morton) {
+    placement.reset(new SpaceFillingCurve(size, job, SpaceFillingCurve::Curve::Morton, rad));
+  } else if (exhaustive) {
+    // inter-node links are several times slower than intra-node links, like DistributedDomain
+    PartitionCost cost = partition_cost::halo_bytes(rad, bytesPerCell, 4);
+    placement.reset(new NodeAware(size, job, rad, machine.network(), cost, model));
+  } else {
+    placement.reset(new NodeAware(size, job, rad, machine.network(), nullptr, model));
+  }
+
+  const Dim3 dim = placement->dim();
+  std::cout << "placement: " << dim << " subdomains\n";
+  for (int64_t iz = 0; iz < dim.z; ++iz) {
+    for (int64_t iy = 0; iy < dim.y; ++iy) {
+      for (int64_t ix = 0; ix < dim.x; ++ix) {
+        const Dim3 idx(ix, iy, iz);
+        const int rank = placement->get_rank(idx);
+        std::cout << "  " << idx << " size=" << placement->subdomain_size(idx) << " rank=" << rank
+                  << " node=" << machine.hostname(machine.node_of_rank(rank)) << " cuda=" << placement->get_cuda(idx)
+                  << "\n";
+      }
+    }
+  }
+
+  // the first GPU of each node, to find the distance between nodes
+  std::vector<int> nodeGpu(machine.num_nodes(), -1);
+  for (int gpu = machine.num_gpus() - 1; gpu >= 0; --gpu) {
+    nodeGpu[machine.node_of_gpu(gpu)] = gpu;
+  }
+
+  const int numRanks = machine.num_ranks();
+  Mat2D<uint64_t> rankBytes(numRanks, numRanks, 0);
+  std::map<std::string, uint64_t> methodBytes;
+  // (node, src cuda, dst cuda) for links in a node, and (src node, dst node, -1) between nodes
+  std::map<std::tuple<int, int, int>, Link> links;
+
+  const Topology topology(dim, boundary);
+  for (int rank = 0; rank < numRanks; ++rank) {
+    const int node = machine.node_of_rank(rank);
+    const ExchangePlan plan = plan_exchange(
+        *placement, topology, rad, methods, rank, machine.cuda_ids(rank).size(),
+        [&](int src, int dst) { return machine.cuda_peer(src, dst); },
+        [&](int other) { return machine.node_of_rank(other) == node; });
+
+    auto add = [&](const std::string &method, const Message &msg, const Dim3 &dstIdx) {
+      const uint64_t bytes = uint64_t(bytesPerCell) * msg.ext().flatten();
+      const int srcDev = placement->get_cuda(placement->get_idx(rank, msg.srcGPU_));
+      const int dstRank = placement->get_rank(dstIdx);
+      const int dstDev = placement->get_cuda(dstIdx);
+      const int dstNode = machine.node_of_rank(dstRank);
+      rankBytes.at(rank, dstRank) += bytes;
+      methodBytes[method] += bytes;
+      if (dstNode == node) {
+        Link &link = links[std::make_tuple(node, srcDev, dstDev)];
+        link.bytes += bytes;
+        link.bandwidth = machine.cuda_bandwidth(srcDev, dstDev);
+      } else {
+        Link &link = links[std::make_tuple(node, dstNode, -1)];
+        link.bytes += bytes;
+        link.bandwidth = machine.gpu_distance(nodeGpu[node], nodeGpu[dstNode]).bandwidth;
+      }
+    };
+
+    for (const Message &msg : plan.peerAccessOutbox) {
+      add("kernel", msg, placement->get_idx(rank, msg.dstGPU_));
+    }
+    for (const auto &v : plan.peerCopyOutboxes) {
+      for (const auto &msgs : v) {
+        for (const Message &msg : msgs) {
+          add("peer", msg, placement->get_idx(rank, msg.dstGPU_));
+        }
+      }
+    }
+    for (const auto &box : plan.coloOutboxes) {
+      for (const auto &kv : box) {
+        for (const Message &msg : kv.second) {
+          add("colo", msg, kv.first);
+        }
+      }
+    }
+    for (const auto &box : plan.remoteOutboxes) {
+      for (const auto &kv : box) {
+        for (const Message &msg : kv.second) {
+          add("mpi", msg, kv.first);
+        }
+      }
+    }
+  }
+
+  std::cout << "rank bytes (row sends to column):\n";
+  for (int64_t r = 0; r < numRanks; ++r) {
+    for (int64_t c = 0; c < numRanks; ++c) {
+      std::cout << " " << rankBytes.at(r, c);
+    }
+    std::cout << "\n";
+  }
+
+  std::cout << "method bytes:\n";
+  for (const auto &kv : methodBytes) {
+    std::cout << "  " << kv.first << ": " << kv.second << "\n";
+  }
+
+  // the link with the largest bytes / bandwidth bounds the exchange time
+  typedef std::pair<std::tuple<int, int, int>, Link> LinkEntry;
+  std::vector<LinkEntry> sorted(links.begin(), links.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const LinkEntry &a, const LinkEntry &b) { return a.second.time() > b.second.time(); });
+  std::cout << "busiest links (bytes / bandwidth):\n";
+  for (size_t i = 0; i < sorted.size() && int(i) < top; ++i) {
+    const auto &key = sorted[i].first;
+    const Link &link = sorted[i].second;
+    if (-1 == std::get<2>(key)) {
+      std::cout << "  " << machine.hostname(std::get<0>(key)) << " -> " << machine.hostname(std::get<1>(key));
+    } else {
+      std::cout << "  " << machine.hostname(std::get<0>(key)) << " cuda " << std::get<1>(key) << " -> "
+                << std::get<2>(key);
+    }
+    std::cout << ": " << link.bytes << " B / " << link.bandwidth << " = " << link.time() << "\n";
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "stencil/dim3.hpp"
+#include "stencil/logging.hpp"
+
+/* How to fill the halo on a face of the domain where there is no neighbor (an OPEN axis, see Topology).
+   The boundary point is the last interior point before the face.
+*/
+struct BoundaryCondition {
+  enum class Type {
+    NONE,          // leave the halo alone
+    DIRICHLET,     // halo = value
+    NEUMANN,       // halo = boundary point + value * (distance from the boundary point), value is the outward gradient
+    SYMMETRIC,     // halo = the interior point mirrored about the boundary point
+    ANTISYMMETRIC, // halo = -(the interior point mirrored about the boundary point)
+    FUNCTION       // halo = fn(global position of the halo point)
+  };
+
+  Type type;
+  double value;
+  std::function<double(const Dim3 &)> fn;
+
+  BoundaryCondition() : type(Type::NONE), value(0) {}
+
+  static BoundaryCondition dirichlet(double value) { return BoundaryCondition(Type::DIRICHLET, value); }
+  static BoundaryCondition neumann(double gradient) { return BoundaryCondition(Type::NEUMANN, gradient); }
+  static BoundaryCondition symmetric() { return BoundaryCondition(Type::SYMMETRIC, 0); }
+  static BoundaryCondition antisymmetric() { return BoundaryCondition(Type::ANTISYMMETRIC, 0); }
+  static BoundaryCondition function(const std::function<double(const Dim3 &)> &fn) {
+    BoundaryCondition ret(Type::FUNCTION, 0);
+    ret.fn = fn;
+    return ret;
+  }
+
+  /* interior points beyond the boundary point needed to fill a halo of `radius`
+   */
+  int64_t interior_needed(int64_t radius) const noexcept {
+    return (Type::SYMMETRIC == type || Type::ANTISYMMETRIC == type) ? radius : 0;
+  }
+
+private:
+  BoundaryCondition(Type t, double v) : type(t), value(v) {}
+};
+
+/* Fill the halo on one face of `buf`, an x-fastest region of extent `ext` whose first point is at global position
+   `origin`. Along `axis`, the region is the halo of `radius` points on the `side` (-1 or 1) face and the interior points
+   next to it. Layers are filled a row of x at a time, so the inner loop is contiguous except for faces normal to x.
+*/
+template <typename T>
+void fill_boundary(T *buf, const Dim3 &ext, int axis, int side, int64_t radius, const Dim3 &origin,
+                   const BoundaryCondition &bc) {
+  assert(axis >= 0 && axis < 3);
+  assert(1 == side || -1 == side);
+  Dim3 e = ext;
+  const int64_t n = e[axis];
+  const int64_t b = side < 0 ? radius : n - radius - 1; // boundary point
+  if (b < 0 || b >= n || n - radius - 1 < bc.interior_needed(radius)) {
+    LOG_FATAL("fill_boundary: " << n - radius << " interior points along axis " << axis << " can't fill a halo of "
+                                << radius);
+  }
+
+  // distance between neighboring points along `axis`
+  const int64_t stride = 0 == axis ? 1 : (1 == axis ? e.x : e.x * e.y);
+  // a row is contiguous along x, except for faces normal to x where each point is its own row
+  const int64_t rowLen = 0 == axis ? 1 : e.x;
+  const int64_t rowStride = 1 == axis ? e.x * e.y : e.x;
+  const int64_t numRows = e.flatten() / n / rowLen;
+
+  for (int64_t k = 1; k <= radius; ++k) {
+    const int64_t h = b + side * k; // halo layer
+    const int64_t m = b - side * k; // mirror layer
+    for (int64_t row = 0; row < numRows; ++row) {
+      T *dst = buf + row * rowStride + h * stride;
+      const T *src = buf + row * rowStride + m * stride;
+      const T *bnd = buf + row * rowStride + b * stride;
+      switch (bc.type) {
+      case BoundaryCondition::Type::NONE:
+        break;
+      case BoundaryCondition::Type::DIRICHLET: {
+        const T v = T(bc.value);
+        for (int64_t i = 0; i < rowLen; ++i) {
+          dst[i] = v;
+        }
+        break;
+      }
+      case BoundaryCondition::Type::NEUMANN: {
+        const T dv = T(bc.value * k);
+        for (int64_t i = 0; i < rowLen; ++i) {
+          dst[i] = bnd[i] + dv;
+        }
+        break;
+      }
+      case BoundaryCondition::Type::SYMMETRIC: {
+        for (int64_t i = 0; i < rowLen; ++i) {
+          dst[i] = src[i];
+        }
+        break;
+      }
+      case BoundaryCondition::Type::ANTISYMMETRIC: {
+        for (int64_t i = 0; i < rowLen; ++i) {
+          dst[i] = -src[i];
+        }
+        break;
+      }
+      case BoundaryCondition::Type::FUNCTION: {
+        for (int64_t i = 0; i < rowLen; ++i) {
+          const int64_t off = (dst + i) - buf;
+          const Dim3 p(off % e.x, (off / e.x) % e.y, off / (e.x * e.y));
+          dst[i] = T(bc.fn(origin + p));
+        }
+        break;
+      }
+      }
+    }
+  }
+}
+
+/* fill_boundary() for a quantity of some type, chosen when the condition is set
+ */
+typedef std::function<void(void *buf, const Dim3 &ext, int axis, int side, int64_t radius, const Dim3 &origin)>
+    BoundaryFill;
+
+template <typename T> BoundaryFill make_boundary_fill(const BoundaryCondition &bc) {
+  return [bc](void *buf, const Dim3 &ext, int axis, int side, int64_t radius, const Dim3 &origin) {
+    fill_boundary(static_cast<T *>(buf), ext, axis, side, radius, origin, bc);
+  };
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Settings for compressing inter-rank halo messages, from DistributedDomain::set_compression()
+ */
+struct CompressConfig {
+  bool enable;
+  int threads;          // most threads compressing one message
+  double linkBandwidth; // bytes / second between ranks, to decide whether compressing pays off
+};
+
+namespace compress {
+
+/* LZ77 byte compression in the style of LZ4: each sequence is a token (literal length, match length), the literals,
+   and a 2-byte offset back to the match. Returns the compressed size, or 0 if it does not fit in `dstCap` bytes
+*/
+size_t lz_compress(void *dst, size_t dstCap, const void *src, size_t n);
+
+/* decompress `srcSize` bytes from lz_compress() into exactly `n` bytes at `dst`. false if `src` is malformed
+ */
+bool lz_decompress(void *dst, size_t n, const void *src, size_t srcSize);
+
+/* dst[i] = a[i] ^ b[i] for `n` bytes. `dst` may be `a` or `b`
+ */
+void xor_bytes(void *dst, const void *a, const void *b, size_t n);
+
+} // namespace compress
+
+/*! Lossless codec for one stream of halo messages (the messages one sender sends to one recver).
+
+    A message is XORed with the same message from the previous exchange, so the bits of a smooth field that did not
+    change become zero bytes, and then split into chunks that are LZ-compressed on separate threads.
+    Both ends keep the previous message of each quantity set, so every message must go through the codec, compressed
+    or not.
+
+    The sender times each compression, and sends raw messages when
+      2 * encode time + compressed bytes / linkBandwidth >= raw bytes / linkBandwidth
+    (counting decoding as no slower than encoding), except for the first message of each quantity set, which has no
+    previous one. While raw, it compresses every kProbeInterval-th message again to see if the data has become more
+    compressible.
+
+    frame: uint32 kind, uint32 numChunks, uint32 chunk bytes * numChunks, chunks
+*/
+class HaloCodec {
+public:
+  enum class Kind : uint32_t { Raw = 0, Delta = 1 };
+
+  static constexpr size_t kMaxChunks = 64;
+  static constexpr size_t kMinChunk = 64 * 1024; // bytes per thread before another one is used
+  static constexpr uint64_t kProbeInterval = 64;
+
+private:
+  int threads_;
+  double linkBandwidth_;
+
+  // prev_[set] = the last message of quantity set `set`, all zeros before the first
+  std::vector<std::vector<unsigned char>> prev_;
+  std::vector<unsigned char> delta_;
+
+  bool compress_;   // compressing this stream pays off
+  uint64_t numRaw_; // raw messages since the last compressed one
+  double ratio_;    // raw / wire bytes of the last compressed message
+
+  std::vector<unsigned char> &prev(size_t set, size_t n);
+
+public:
+  HaloCodec(const CompressConfig &config);
+
+  /* most bytes in the frame of a message of `n` bytes
+   */
+  static size_t max_frame_size(size_t n);
+
+  /* encode the `n`-byte message `src` of quantity set `set` into the frame `dst` (max_frame_size(n) bytes).
+     Returns the frame size
+  */
+  size_t encode(void *dst, const void *src, size_t n, size_t set);
+
+  /* decode the frame `src` into the `n`-byte message `dst` of quantity set `set`
+   */
+  void decode(void *dst, size_t n, const void *src, size_t set);
+
+  // whether the next message will be compressed
+  bool compressing() const noexcept { return compress_ || numRaw_ >= kProbeInterval; }
+
+  // raw / wire bytes of the last compressed message (0 before the first)
+  double ratio() const noexcept { return ratio_; }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "stencil/dim3.hpp"
+#include "stencil/method.hpp"
+#include "stencil/partition.hpp"
+#include "stencil/radius.hpp"
+#include "stencil/topology.hpp"
+#include "stencil/tx_common.hpp"
+
+/* The messages planned for one rank
+ */
+struct ExchangePlan {
+  // same-GPU exchanges
+  std::vector<Message> peerAccessOutbox;
+  // peerCopyOutboxes[di][dj] = peer copy from di to dj
+  std::vector<std::vector<std::vector<Message>>> peerCopyOutboxes;
+  // coloOutboxes[di][dstIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> coloOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> coloInboxes;
+  // remoteOutboxes[di][dstIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> remoteOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> remoteInboxes;
+
+  /* empty boxes for `n` domains */
+  void resize(size_t n) {
+    peerCopyOutboxes.resize(n);
+    for (auto &v : peerCopyOutboxes) {
+      v.resize(n);
+    }
+    coloOutboxes.resize(n);
+    coloInboxes.resize(n);
+    remoteOutboxes.resize(n);
+    remoteInboxes.resize(n);
+  }
+};
+
+/* Plan the messages to and from the `numDomains` subdomains of `rank` in `placement`.
+   Each message uses the first of `methods` that can carry it: same device, peer copy, colocated, then MPI.
+   `peer(src, dst)` is whether CUDA devices in a node can access each other, and `colocated(r)` is whether rank `r` is
+   in the same node as `rank`.
+
+   With `axis` of 0, 1, or 2, only the two face messages along that axis are planned, sized to also carry the halos
+   of the earlier axes: one round of a phased exchange (see LocalDomain::set_phased()). -1 plans every direction.
+
+   If given, `messageMethods(dstIdx, dir)` replaces `methods` for the message sent in `dir` to the subdomain at
+   `dstIdx`, e.g. as chosen by autotuning (see DistributedDomain::set_autotune()). It must give the same answer on
+   the sending and receiving rank.
+
+   Does not communicate, so the plans for every rank of a modeled machine can be made in one process.
+*/
+ExchangePlan plan_exchange(Placement &placement, const Topology &topology, const Radius &radius, Method methods,
+                           int rank, size_t numDomains, const std::function<bool(int, int)> &peer,
+                           const std::function<bool(int)> &colocated, int axis = -1,
+                           const std::function<Method(const Dim3 &dstIdx, const Dim3 &dir)> &messageMethods = nullptr);
+
+/* Whether a phased exchange (one round per axis, see plan_exchange()) should beat sending to all 26 neighbors
+   directly, for subdomains of `sz`. Edge and corner messages smaller than `latencyBytes` (about latency times
+   bandwidth) cost mostly latency, so folding them into the face messages saves more than the extra rounds cost.
+*/
+bool prefer_phased(const Dim3 &sz, const Radius &radius, size_t bytesPerCell, size_t latencyBytes);
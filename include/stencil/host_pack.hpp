@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cassert>
+#include <cstring>
+
+#include <cuda_runtime.h> // cudaPitchedPtr
+
+#include "stencil/dim3.hpp"
+#include "stencil/wire_format.hpp"
+
+/* Host versions of grid_pack() and grid_unpack(), for LocalDomains in host memory.
+   A row of x is contiguous in both the allocation and the buffer, so each row is one memcpy.
+*/
+
+/* pack the region at `srcPos` of extent `srcExtent` (in elements) of `src` into `dst`
+ */
+inline void host_pack(void *dst, const cudaPitchedPtr &src, const Dim3 &srcPos, const Dim3 &srcExtent,
+                      const size_t elemSize) {
+  assert(src.pitch > 0);
+  const char *sp = static_cast<const char *>(src.ptr);
+  char *dp = static_cast<char *>(dst);
+  const size_t rowBytes = srcExtent.x * elemSize;
+  for (int64_t zo = 0; zo < srcExtent.z; ++zo) {
+    const int64_t zi = zo + srcPos.z;
+    for (int64_t yo = 0; yo < srcExtent.y; ++yo) {
+      const int64_t yi = yo + srcPos.y;
+      const size_t bi = zi * src.ysize * src.pitch + yi * src.pitch + srcPos.x * elemSize;
+      std::memcpy(dp, sp + bi, rowBytes);
+      dp += rowBytes;
+    }
+  }
+}
+
+/* unpack `src` into the region at `dstPos` of extent `dstExtent` (in elements) of `dst`
+ */
+inline void host_unpack(cudaPitchedPtr dst, const void *src, const Dim3 &dstPos, const Dim3 &dstExtent,
+                        const size_t elemSize) {
+  assert(dst.pitch > 0);
+  char *dp = static_cast<char *>(dst.ptr);
+  const char *sp = static_cast<const char *>(src);
+  const size_t rowBytes = dstExtent.x * elemSize;
+  for (int64_t zo = 0; zo < dstExtent.z; ++zo) {
+    const int64_t zi = zo + dstPos.z;
+    for (int64_t yo = 0; yo < dstExtent.y; ++yo) {
+      const int64_t yi = yo + dstPos.y;
+      const size_t bi = zi * dst.ysize * dst.pitch + yi * dst.pitch + dstPos.x * elemSize;
+      std::memcpy(dp + bi, sp, rowBytes);
+      sp += rowBytes;
+    }
+  }
+}
+
+/* host_pack(), with each element encoded as `wire` (see WireFormat). `dst` holds wire.wire_size(elemSize) bytes per
+   element
+*/
+inline void host_pack_wire(void *dst, const cudaPitchedPtr &src, const Dim3 &srcPos, const Dim3 &srcExtent,
+                           const size_t elemSize, const WireFormat &wire) {
+  if (WireFormat::Kind::Native == wire.kind) {
+    host_pack(dst, src, srcPos, srcExtent, elemSize);
+    return;
+  }
+  assert(src.pitch > 0);
+  const char *sp = static_cast<const char *>(src.ptr);
+  char *dp = static_cast<char *>(dst);
+  const size_t wireSize = wire.wire_size(elemSize);
+  for (int64_t zo = 0; zo < srcExtent.z; ++zo) {
+    const int64_t zi = zo + srcPos.z;
+    for (int64_t yo = 0; yo < srcExtent.y; ++yo) {
+      const int64_t yi = yo + srcPos.y;
+      const char *row = sp + zi * src.ysize * src.pitch + yi * src.pitch + srcPos.x * elemSize;
+      for (int64_t x = 0; x < srcExtent.x; ++x) {
+        wire.encode(dp, row + x * elemSize, elemSize);
+        dp += wireSize;
+      }
+    }
+  }
+}
+
+/* host_unpack() from a buffer packed by host_pack_wire()
+ */
+inline void host_unpack_wire(cudaPitchedPtr dst, const void *src, const Dim3 &dstPos, const Dim3 &dstExtent,
+                             const size_t elemSize, const WireFormat &wire) {
+  if (WireFormat::Kind::Native == wire.kind) {
+    host_unpack(dst, src, dstPos, dstExtent, elemSize);
+    return;
+  }
+  assert(dst.pitch > 0);
+  char *dp = static_cast<char *>(dst.ptr);
+  const char *sp = static_cast<const char *>(src);
+  const size_t wireSize = wire.wire_size(elemSize);
+  for (int64_t zo = 0; zo < dstExtent.z; ++zo) {
+    const int64_t zi = zo + dstPos.z;
+    for (int64_t yo = 0; yo < dstExtent.y; ++yo) {
+      const int64_t yi = yo + dstPos.y;
+      char *row = dp + zi * dst.ysize * dst.pitch + yi * dst.pitch + dstPos.x * elemSize;
+      for (int64_t x = 0; x < dstExtent.x; ++x) {
+        wire.decode(row + x * elemSize, sp, elemSize);
+        sp += wireSize;
+      }
+    }
+  }
+}
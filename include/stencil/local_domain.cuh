@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdlib>
 #include <iostream>
 #include <thread>
 #include <vector>
@@ -7,11 +8,13 @@
 #include "stencil/accessor.hpp"
 #include "stencil/cuda_runtime.hpp"
 #include "stencil/dim3.hpp"
+#include "stencil/host_pack.hpp"
 #include "stencil/logging.hpp"
 #include "stencil/pack_kernel.cuh"
 #include "stencil/pitched_ptr.hpp"
 #include "stencil/radius.hpp"
 #include "stencil/rect3.hpp"
+#include "stencil/wire_format.hpp"
 
 class DistributedDomain;
 
@@ -46,25 +49,50 @@ private:
   //!< radius of stencils that will be applied
   Radius radius_;
 
+  /* halos are exchanged one axis at a time (see DistributedDomain::set_exchange_rounds()), so each face halo also
+     covers the halos of the earlier axes, which carry the edges and corners along
+  */
+  bool phased_;
+
   //!< backing info for the actual data I have
   // host versions
   std::vector<cudaPitchedPtr> currDataPtrs_;
   std::vector<cudaPitchedPtr> nextDataPtrs_;
   std::vector<size_t> dataElemSize_;
   std::vector<std::string> dataName_;
+  // encoding of each quantity in remote messages
+  std::vector<WireFormat> wireFormats_;
   /* device versions of the pointers (the pointers already point to device data)
    used in the packers
    */
   cudaPitchedPtr *devCurrDataPtrs_, *devNextDataPtrs_;
   size_t *devDataElemSize_;
+  WireFormat *devWireFormats_;
+
+  /* quantitySets_[s] = the quantities in quantity set s, which can be exchanged on their own.
+     Set 0 is every quantity, filled in by realize()
+  */
+  std::vector<std::vector<int64_t>> quantitySets_;
+  // device versions of quantitySets_, used in the packers
+  std::vector<int64_t *> devQuantitySets_;
+  // the quantity set that packers and unpackers use
+  size_t activeQuantitySet_;
 
   int dev_; // CUDA device
 
+  /* data is in host memory instead of on dev_.
+     The "device" versions of the pointers are host arrays, and dev_ only identifies the domain to the Placement
+  */
+  bool host_;
+
+  // free all allocations
+  void release();
+
 public:
-  LocalDomain(Dim3 sz, Dim3 origin, int dev);
+  LocalDomain(Dim3 sz, Dim3 origin, int dev, bool host = false);
   ~LocalDomain();
 
-  /* set the CUDA device for this LocalDomain
+  /* set the CUDA device for this LocalDomain. Nothing to do for a domain in host memory
    */
   void set_device(CudaErrorsFatal fatal = CudaErrorsFatal::YES);
 
@@ -85,6 +113,7 @@ public:
   int64_t add_data(size_t n, const std::string &name = "") {
     dataName_.push_back(name);
     dataElemSize_.push_back(n);
+    wireFormats_.push_back(WireFormat::native());
     currDataPtrs_.push_back({});
     nextDataPtrs_.push_back({});
     return int64_t(dataElemSize_.size()) - 1;
@@ -94,6 +123,35 @@ public:
     return DataHandle<T>(add_data(sizeof(T)), name);
   }
 
+  /*! Add a set of quantities that can be exchanged without the others. Call before realize()
+
+  \returns The index of the set. Set 0 is every quantity
+  */
+  size_t add_quantity_set(const std::vector<int64_t> &quantities) {
+    quantitySets_.push_back(quantities);
+    return quantitySets_.size() - 1;
+  }
+
+  size_t num_quantity_sets() const noexcept { return quantitySets_.size(); }
+
+  const std::vector<int64_t> &quantity_set(size_t set) const {
+    assert(set < quantitySets_.size());
+    return quantitySets_[set];
+  }
+
+  const int64_t *dev_quantity_set(size_t set) const {
+    assert(set < devQuantitySets_.size());
+    return devQuantitySets_[set];
+  }
+
+  /* choose the quantity set that packers and unpackers use
+   */
+  void set_active_quantity_set(size_t set) {
+    assert(set < quantitySets_.size());
+    activeQuantitySet_ = set;
+  }
+  size_t active_quantity_set() const noexcept { return activeQuantitySet_; }
+
   /*! \brief set the radius. Should only be called by DistributedDomain
   TODO friend class
    */
@@ -105,6 +163,20 @@ public:
 
   const Radius &radius() const noexcept { return radius_; }
 
+  /* \brief exchange face halos one axis at a time. Should only be called by DistributedDomain
+   */
+  void set_phased(bool phased) noexcept { phased_ = phased; }
+  bool phased() const noexcept { return phased_; }
+
+  /* the axis of a face direction, or -1 for an edge or corner
+   */
+  static int face_axis(const Dim3 &dir) noexcept {
+    if (1 != std::abs(dir.x) + std::abs(dir.y) + std::abs(dir.z)) {
+      return -1;
+    }
+    return dir.x ? 0 : (dir.y ? 1 : 2);
+  }
+
   /*! \brief retrieve a pointer to current domain values (to read in stencil)
    */
   template <typename T> PitchedPtr<T> get_curr(const DataHandle<T> handle) const {
@@ -134,6 +206,21 @@ public:
   const std::vector<size_t> &elem_sizes() const { return dataElemSize_; }
   const size_t *dev_elem_sizes() const { return devDataElemSize_; }
 
+  /* set the encoding of quantity `idx` in remote messages. Call before realize()
+   */
+  void set_wire_format(const size_t idx, const WireFormat &wire) {
+    assert(idx < wireFormats_.size());
+    wireFormats_[idx] = wire;
+  }
+  const WireFormat &wire_format(const size_t idx) const {
+    assert(idx < wireFormats_.size());
+    return wireFormats_[idx];
+  }
+  const WireFormat *dev_wire_formats() const { return devWireFormats_; }
+
+  // bytes of one element of quantity `idx` in remote messages
+  size_t wire_elem_size(const size_t idx) const { return wire_format(idx).wire_size(elem_size(idx)); }
+
   cudaPitchedPtr curr_data(size_t idx) const {
     assert(idx < currDataPtrs_.size());
     return currDataPtrs_[idx];
@@ -193,8 +280,10 @@ public:
   // return the position of the halo relative to get_data() on the `dir` side of the
   // LocalDomain (e.g., dir [1,0,0] returns the position of the region on the +x side)
   // dir = [0,0,0] returns the entire region (without the halo), ignoring the `halo` argument
-  // sz is the size of the allocated data, and radius is the stencil radius
-  static Dim3 halo_pos(const Dim3 &dir, const Dim3 &sz, const Radius &radius, const bool halo) noexcept;
+  // sz is the size of the allocated data, and radius is the stencil radius.
+  // With `phased`, a face halo also covers the halos of the earlier axes (see phased_)
+  static Dim3 halo_pos(const Dim3 &dir, const Dim3 &sz, const Radius &radius, const bool halo,
+                       const bool phased = false) noexcept;
 
   // return the position of the halo relative to get_data() on the `dir` side of the
   // LocalDomain (e.g., dir [1,0,0] returns the position of the region on the +x side)
@@ -207,9 +296,9 @@ public:
   Rect3 halo_coords(const Dim3 &dir, const bool halo) const;
 
   /* get the point-size of the halo region on side `dir`, with a compute region of size `sz` and a kernel radius
-  `radius`. dir=[0,0,0] returns sz
+  `radius`. dir=[0,0,0] returns sz. With `phased`, a face halo also covers the halos of the earlier axes
   */
-  static Dim3 halo_extent(const Dim3 &dir, const Dim3 &sz, const Radius &radius) {
+  static Dim3 halo_extent(const Dim3 &dir, const Dim3 &sz, const Radius &radius, const bool phased = false) {
     assert(dir.x >= -1 && dir.x <= 1);
     assert(dir.y >= -1 && dir.y <= 1);
     assert(dir.z >= -1 && dir.z <= 1);
@@ -218,17 +307,30 @@ public:
     ret.x = (0 == dir.x) ? sz.x : radius.x(dir.x);
     ret.y = (0 == dir.y) ? sz.y : radius.y(dir.y);
     ret.z = (0 == dir.z) ? sz.z : radius.z(dir.z);
+
+    const int axis = phased ? face_axis(dir) : -1;
+    if (axis > 0) {
+      ret.x += radius.x(-1) + radius.x(1);
+    }
+    if (axis > 1) {
+      ret.y += radius.y(-1) + radius.y(1);
+    }
     return ret;
   }
 
   // return the extent of the halo in direction `dir`
-  Dim3 halo_extent(const Dim3 &dir) const noexcept { return halo_extent(dir, sz_, radius_); }
+  Dim3 halo_extent(const Dim3 &dir) const noexcept { return halo_extent(dir, sz_, radius_, phased_); }
 
   // return the number of bytes of the halo in direction `dir`
   int64_t halo_bytes(const Dim3 &dir, const int64_t idx) const noexcept {
     return dataElemSize_[idx] * halo_extent(dir).flatten();
   }
 
+  // return the number of bytes of the halo in direction `dir` in a remote message (see set_wire_format())
+  int64_t wire_bytes(const Dim3 &dir, const int64_t idx) const noexcept {
+    return wire_elem_size(idx) * halo_extent(dir).flatten();
+  }
+
   // return the 3d size of the compute domain, in terms of elements
   Dim3 size() const noexcept { return sz_; }
 
@@ -241,6 +343,9 @@ public:
   // the GPU this domain is on
   int gpu() const { return dev_; }
 
+  // true if the data is in host memory
+  bool is_host() const noexcept { return host_; }
+
   /* Swap current and next pointers
    */
   void swap() noexcept;
@@ -251,6 +356,12 @@ public:
                                             const size_t qi // quantity index
                                             ) const;
 
+  /* copy `buf` from the host into the logical region
+   */
+  void region_from_host(const Dim3 &pos, const Dim3 &ext,
+                        const size_t qi, // quantity index
+                        const std::vector<unsigned char> &buf);
+
   /*! Copy the compute region to the host
    */
   std::vector<unsigned char> interior_to_host(const size_t qi // quantity index
@@ -273,4 +384,8 @@ public:
   }
 
   void realize();
+
+  /* Change the size and origin of the compute region. Frees all data, so call realize() again afterwards
+   */
+  void resize(const Dim3 &sz, const Dim3 &origin);
 };
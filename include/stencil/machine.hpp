@@ -6,12 +6,17 @@
 
 #include "stencil/cuda_runtime.hpp"
 #include "stencil/logging.hpp"
+#include "stencil/mat2d.hpp"
+#include "stencil/network.hpp"
 
 #include <nvml.h>
 
 #include <cstring>
+#include <istream>
 #include <ostream>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 struct UUID {
@@ -20,7 +25,7 @@ struct UUID {
   UUID(const char bytes[16]) { std::memcpy(bytes_, bytes, 16); }
   /* copy up to 16 bytes to form a UUID
    */
-  UUID(const void *bytes, size_t n) {
+  UUID(const void *bytes, size_t n) : bytes_{} {
     if (n > 16) {
       n = 16;
     }
@@ -102,6 +107,27 @@ private:
 
     gpus are indexed 0..<N
 
+   A Machine can also be read from a description file, to model placement and communication for a machine we are not
+   running on. One entry per line:
+
+     node <hostname> <gpus> [ranks]      a node with <gpus> GPUs and [ranks] MPI ranks (default one per GPU)
+     gpu-bandwidth <i> <j> <bandwidth>   bandwidth between CUDA devices i and j in every node
+     no-peer <i> <j>                     CUDA devices i and j in every node can't access each other
+     inter-node-bandwidth <bandwidth>    bandwidth between GPUs in different nodes
+     host <hostname> <switch> [bandwidth]
+     link <switch> <switch> [bandwidth]  the network connecting the nodes (see stencil/network.hpp)
+
+   Bandwidths are relative, on the scale of gpu_topo::bandwidth (NVLink is 1, and the same device is 10).
+   GPU pairs default to 1, and inter-node bandwidth defaults to 0.1.
+   Devices are given to the ranks in a node like DistributedDomain does: round-robin, or shared if there are more ranks
+   than devices. Everything after `#` is a comment.
+
+   Two nodes with 8 GPUs and 2 ranks each, where devices 0 and 4 only connect through the host:
+
+     node dgx0 8 2
+     node dgx1 8 2
+     no-peer 0 4
+     gpu-bandwidth 0 4 0.2
 */
 class Machine {
 public:
@@ -115,6 +141,14 @@ private:
   std::vector<int> nodeOfRank_;        // node of each rank
   std::vector<GPU> gpus_;              // all GPUs in the machine
 
+  // only for machines read from a description
+  std::vector<int> cudaOfGpu_;                // CUDA device of each GPU within its node
+  std::vector<std::vector<int>> rankCudaIds_; // CUDA devices used by each rank
+  Mat2D<double> cudaBandwidth_;               // bandwidth between CUDA devices in a node
+  std::set<std::pair<int, int>> noPeer_;      // CUDA devices in a node that can't access each other
+  double interNodeBandwidth_;
+  Network network_;
+
 public:
 #if STENCIL_USE_MPI == 1
   /* build a model of a machine visible to `comm`
@@ -126,15 +160,43 @@ public:
    */
   static Machine build();
 
-  /* return the distance between two GPUs in the machine
+  /* read a machine description from a file. Fatal if the file can't be read or has an error
+   */
+  static Machine from_file(const std::string &path);
+
+  /* read a machine description from a stream. Fatal if the stream has an error
+   */
+  static Machine parse(std::istream &is);
+
+  Machine() : interNodeBandwidth_(0.1) {}
+
+  /* return the distance between two GPUs in the machine.
+     Bandwidth is relative (see above), and latency is the number of network hops between the GPUs' nodes
    */
   Distance gpu_distance(const unsigned srcId, const unsigned dstId) const;
 
   int node_of_gpu(GPU::index_t i) const noexcept { return nodeOfRank_[gpus_[i].ranks()[0]]; }
 
   int num_nodes() const noexcept { return hostnames_.size(); }
+  const std::string &hostname(const int node) const noexcept { return hostnames_[node]; }
   int num_ranks() const noexcept { return nodeOfRank_.size(); }
   int num_gpus() const noexcept { return gpus_.size(); }
   int node_of_rank(const int rank) const noexcept { return nodeOfRank_[rank]; }
   const GPU &gpu(const GPU::index_t i) const noexcept { return gpus_[i]; }
+
+  /* The CUDA devices each rank uses. Only for machines read from a description
+   */
+  const std::vector<int> &cuda_ids(const int rank) const noexcept { return rankCudaIds_[rank]; }
+
+  /* bandwidth between CUDA devices `src` and `dst` in a node, like gpu_topo::bandwidth()
+   */
+  double cuda_bandwidth(const int src, const int dst) const;
+
+  /* whether CUDA devices `src` and `dst` in a node can access each other, like gpu_topo::peer()
+   */
+  bool cuda_peer(const int src, const int dst) const { return 0 == noPeer_.count(std::make_pair(src, dst)); }
+
+  /* the network connecting the nodes (empty if not described)
+   */
+  const Network &network() const noexcept { return network_; }
 };
\ No newline at end of file
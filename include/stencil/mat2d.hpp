@@ -155,6 +155,7 @@ public:
 
   inline const Shape &shape() const noexcept { return shape_; }
   inline uint64_t size() const noexcept { return shape_.flatten(); }
+  inline bool empty() const noexcept { return 0 == size(); }
 
   bool operator==(const Mat2D &rhs) const noexcept {
     if (shape_ != rhs.shape_) {
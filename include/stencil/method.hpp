@@ -12,6 +12,7 @@ enum class Method : int {
   ColoDomainKernel = 32,
   CudaMemcpyPeer = 64,
   CudaKernel = 128,
+  HostMpi = 256, // domains in host memory, all exchanges over MPI. Exclusive of the others
   Default = CudaMpi + ColoPackMemcpyUnpack + CudaMemcpyPeer + CudaKernel
 };
 
@@ -69,6 +70,10 @@ inline std::string to_string(const Method &m) {
     ret += ret.empty() ? "" : sep;
     ret += "kernel";
   }
+  if (m && Method::HostMpi) {
+    ret += ret.empty() ? "" : sep;
+    ret += "host";
+  }
 
   return ret;
 }
\ No newline at end of file
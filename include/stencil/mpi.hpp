@@ -46,6 +46,20 @@ inline int tag_ub(MPI_Comm comm) {
 #endif
 }
 
+/* free a persistent request from MPI_Send_init / MPI_Recv_init. A no-op for MPI_REQUEST_NULL, or after MPI_Finalize
+   (when the request is already gone)
+ */
+inline void request_free(MPI_Request &req) {
+#if STENCIL_USE_MPI == 1
+  int finalized;
+  MPI_Finalized(&finalized);
+  if (!finalized && MPI_REQUEST_NULL != req) {
+    MPI_Request_free(&req);
+  }
+#endif
+  req = MPI_REQUEST_NULL;
+}
+
 inline int world_rank() { return comm_rank(MPI_COMM_WORLD); }
 
 inline int world_size() { return comm_size(MPI_COMM_WORLD); }
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "stencil/mat2d.hpp"
+
+/* A model of the network connecting the hosts of a job.
+
+   Read from a text file with one entry per line:
+
+     host <hostname> <switch> [bandwidth]   a host attached to a switch
+     link <switch> <switch> [bandwidth]     a link between two switches
+
+   Links are bidirectional. Bandwidth is relative and defaults to 1.
+   A host may be listed more than once if it is attached to several switches.
+   Everything after `#` is a comment.
+
+   A fat tree lists each host under its leaf switch, then a link from every leaf to every spine.
+   A dragonfly lists each host under its router, all-to-all links within each group, and the global links between
+   groups.
+
+   The distance between two hosts is the cheapest path, where each link costs 1 / bandwidth.
+   With default bandwidths, that is the number of hops.
+*/
+class Network {
+public:
+  /* the path between two hosts */
+  struct Route {
+    double distance;
+    int hops;
+  };
+
+private:
+  std::map<std::string, size_t> vertices_; // vertex of each host or switch name
+  std::vector<std::string> names_;         // name of each vertex
+  std::vector<bool> isHost_;               // whether each vertex is a host
+
+  // adj_[v] = (u, 1/bandwidth) for each link out of v
+  std::vector<std::vector<std::pair<size_t, double>>> adj_;
+
+  size_t add_vertex(const std::string &name, bool host);
+  void add_link(size_t a, size_t b, double bandwidth);
+
+  // vertex of a host, or -1
+  int64_t host_vertex(const std::string &name) const;
+
+  // route from vertex `src` to all vertices
+  std::vector<Route> routes(size_t src) const;
+
+public:
+  /* read a network from a file. Fatal if the file can't be read or has an error
+   */
+  static Network from_file(const std::string &path);
+
+  /* read a network from a stream. Fatal if the stream has an error
+   */
+  static Network parse(std::istream &is);
+
+  /* true if `name` is a host in the network.
+     If `name` is not found, the name before the first '.' is tried too, so fully-qualified domain names match short
+     names in the file and vice versa
+  */
+  bool has_host(const std::string &name) const { return host_vertex(name) >= 0; }
+
+  /* names of all hosts in the network */
+  std::vector<std::string> hosts() const;
+
+  /* route between hosts `src` and `dst`. Infinite distance if there is no route
+   */
+  Route route(const std::string &src, const std::string &dst) const;
+
+  /* distance between each pair of `hosts`
+   */
+  Mat2D<double> distance(const std::vector<std::string> &hosts) const;
+};
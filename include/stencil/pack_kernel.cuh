@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stencil/dim3.hpp"
+#include "stencil/wire_format.hpp"
 
 /* used in a variety of places, so we'll leave it as inlineable for now
  */
@@ -14,4 +15,12 @@ __device__ void grid_unpack(cudaPitchedPtr dst, const void *__restrict__ src, co
                             const size_t elemSize);
 
 __global__ void unpack_kernel(cudaPitchedPtr dst, const void *src, const Dim3 dstPos, const Dim3 dstExtent,
-                              const size_t elemSize);
\ No newline at end of file
+                              const size_t elemSize);
+
+/* grid_pack() and grid_unpack(), with each element encoded as `wire` in the packed buffer (see WireFormat)
+ */
+__device__ void grid_pack_wire(void *__restrict__ dst, const cudaPitchedPtr src, const Dim3 srcPos,
+                               const Dim3 srcExtent, const size_t elemSize, const WireFormat wire);
+
+__device__ void grid_unpack_wire(cudaPitchedPtr dst, const void *__restrict__ src, const Dim3 dstPos,
+                                 const Dim3 dstExtent, const size_t elemSize, const WireFormat wire);
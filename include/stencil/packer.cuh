@@ -16,8 +16,9 @@ public:
   // pack
   virtual void pack() = 0;
 
-  // number of bytes
+  // number of bytes for the domain's active quantity set, and for quantity set `set`
   virtual int64_t size() = 0;
+  virtual int64_t size(size_t set) = 0;
   virtual void *data() = 0;
 
   virtual ~Packer() {}
@@ -31,28 +32,36 @@ public:
   virtual void unpack() = 0;
 
   virtual int64_t size() = 0;
+  virtual int64_t size(size_t set) = 0;
   virtual void *data() = 0;
 
   virtual ~Unpacker() {}
 };
 
+/* Packers and unpackers plan every quantity set of the domain (see LocalDomain::add_quantity_set()) in prepare(), and
+   pack or unpack the domain's active one. The buffer is sized for set 0, which is every quantity.
+
+   With `wire`, each quantity is packed in its LocalDomain::wire_format(), for MPI messages between ranks. Both ends of
+   a message must agree.
+*/
 class DevicePacker : public Packer {
 private:
   LocalDomain *domain_;
 
   std::vector<Message> dirs_;
-  int64_t size_;
+  std::vector<int64_t> sizes_; // sizes_[s] = bytes for quantity set s
+  bool wire_;                  // pack in the wire formats
 
   char *devBuf_;
 
-  cudaStream_t stream_; // an unowned stream
-  cudaGraph_t graph_;
-  cudaGraphExec_t instance_;
+  cudaStream_t stream_;                    // an unowned stream
+  std::vector<cudaGraph_t> graphs_;        // one per quantity set
+  std::vector<cudaGraphExec_t> instances_; // one per quantity set
 
-  void launch_pack_kernels();
+  void launch_pack_kernels(size_t set);
 
 public:
-  DevicePacker(cudaStream_t stream);
+  DevicePacker(cudaStream_t stream, bool wire = false);
 
   ~DevicePacker(); 
 
@@ -60,7 +69,8 @@ public:
 
   virtual void pack() override;
 
-  virtual int64_t size() { return size_; }
+  virtual int64_t size() override { return sizes_[domain_->active_quantity_set()]; }
+  virtual int64_t size(size_t set) override { return sizes_[set]; }
 
   virtual void *data() { return devBuf_; }
 };
@@ -70,25 +80,79 @@ private:
   LocalDomain *domain_;
 
   std::vector<Message> dirs_;
-  int64_t size_;
+  std::vector<int64_t> sizes_; // sizes_[s] = bytes for quantity set s
+  bool wire_;                  // pack in the wire formats
 
   char *devBuf_;
 
   cudaStream_t stream_;
-  cudaGraph_t graph_;
-  cudaGraphExec_t instance_;
+  std::vector<cudaGraph_t> graphs_;        // one per quantity set
+  std::vector<cudaGraphExec_t> instances_; // one per quantity set
 
-  void launch_unpack_kernels();
+  void launch_unpack_kernels(size_t set);
 
 public:
-  DeviceUnpacker(cudaStream_t stream);
+  DeviceUnpacker(cudaStream_t stream, bool wire = false);
   ~DeviceUnpacker();
 
   virtual void prepare(LocalDomain *domain, const std::vector<Message> &messages) override;
 
   virtual void unpack() override;
 
-  virtual int64_t size() override { return size_; }
+  virtual int64_t size() override { return sizes_[domain_->active_quantity_set()]; }
+  virtual int64_t size(size_t set) override { return sizes_[set]; }
 
   virtual void *data() override { return devBuf_; }
 };
+
+/* Pack a LocalDomain in host memory into a host buffer, with the same layout as DevicePacker
+ */
+class HostPacker : public Packer {
+private:
+  LocalDomain *domain_;
+
+  std::vector<Message> dirs_;
+  std::vector<int64_t> sizes_; // sizes_[s] = bytes for quantity set s
+  bool wire_;                  // pack in the wire formats
+
+  char *buf_;
+
+public:
+  HostPacker(bool wire = false);
+  ~HostPacker();
+
+  virtual void prepare(LocalDomain *domain, const std::vector<Message> &messages) override;
+
+  virtual void pack() override;
+
+  virtual int64_t size() override { return sizes_[domain_->active_quantity_set()]; }
+  virtual int64_t size(size_t set) override { return sizes_[set]; }
+
+  virtual void *data() override { return buf_; }
+};
+
+/* Unpack a host buffer from a HostPacker into a LocalDomain in host memory
+ */
+class HostUnpacker : public Unpacker {
+private:
+  LocalDomain *domain_;
+
+  std::vector<Message> dirs_;
+  std::vector<int64_t> sizes_; // sizes_[s] = bytes for quantity set s
+  bool wire_;                  // pack in the wire formats
+
+  char *buf_;
+
+public:
+  HostUnpacker(bool wire = false);
+  ~HostUnpacker();
+
+  virtual void prepare(LocalDomain *domain, const std::vector<Message> &messages) override;
+
+  virtual void unpack() override;
+
+  virtual int64_t size() override { return sizes_[domain_->active_quantity_set()]; }
+  virtual int64_t size(size_t set) override { return sizes_[set]; }
+
+  virtual void *data() override { return buf_; }
+};
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <numeric>
 #include <sstream>
+#include <string>
+#include <tuple>
 #include <vector>
 
 #include "dim3.hpp"
@@ -13,19 +19,172 @@
 #include "mat2d.hpp"
 #include "mpi_topology.hpp"
 #include "stencil/logging.hpp"
+#include "stencil/machine.hpp"
+#include "stencil/network.hpp"
 #include "stencil/numeric.hpp"
 #include "stencil/qap.hpp"
 #include "stencil/radius.hpp"
+#include "stencil/topology.hpp"
+
+/* Split `n` cells into `weights.size()` slabs with widths proportional to `weights`, by largest remainder.
+   Equal weights give each slab n / weights.size(), and the first n % weights.size() slabs one extra.
+   Every slab gets at least `minWidth` cells, taken from the widest slabs, so a slab is never thinner than the halo it
+   fills in its neighbors. Fatal if `n` is too small for that.
+*/
+inline std::vector<int64_t> split_weighted(const int64_t n, const std::vector<double> &weights,
+                                           const int64_t minWidth = 1) {
+  assert(!weights.empty());
+  assert(minWidth >= 1);
+  if (n < minWidth * int64_t(weights.size())) {
+    LOG_FATAL("can't split " << n << " cells into " << weights.size() << " slabs at least " << minWidth
+                             << " wide (the halo radius)");
+  }
+  double total = 0;
+  for (double w : weights) {
+    if (!(w > 0) || !std::isfinite(w)) {
+      LOG_FATAL("partition weights must be positive, got " << w);
+    }
+    total += w;
+  }
+
+  std::vector<int64_t> ret(weights.size());
+  std::vector<double> frac(weights.size());
+  int64_t left = n;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    const double quota = double(n) * weights[i] / total;
+    ret[i] = int64_t(quota);
+    frac[i] = quota - double(ret[i]);
+    left -= ret[i];
+  }
+
+  // hand out the remaining cells, largest fractional part first, lowest index on ties
+  std::vector<size_t> order(weights.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return frac[a] > frac[b]; });
+  for (size_t i = 0; left > 0; i = (i + 1) % order.size(), --left) {
+    ++ret[order[i]];
+  }
+
+  // don't leave any slab thinner than minWidth. The widest slab is wider than minWidth while any is thinner
+  for (auto &e : ret) {
+    while (e < minWidth) {
+      ++e;
+      --*std::max_element(ret.begin(), ret.end());
+    }
+  }
+  return ret;
+}
+
+/* The narrowest a subdomain may be along each axis: as wide as the deepest halo it fills along that axis in any of
+   its neighbors (faces, edges, and corners), and at least one cell. A thinner subdomain would send part of its own
+   halo as its neighbor's.
+*/
+inline Dim3 min_extent(const Radius &radius) {
+  Dim3 ret(1, 1, 1);
+  for (int dz = -1; dz <= 1; ++dz) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      for (int dx = -1; dx <= 1; ++dx) {
+        const int64_t r = radius.dir(dx, dy, dz);
+        if (dx) {
+          ret.x = std::max(ret.x, r);
+        }
+        if (dy) {
+          ret.y = std::max(ret.y, r);
+        }
+        if (dz) {
+          ret.z = std::max(ret.z, r);
+        }
+      }
+    }
+  }
+  return ret;
+}
+
+/* Sum `weights` (x-fastest over `dim`) over each plane normal to x, y, and z
+ */
+inline void weight_marginals(const std::vector<double> &weights, const Dim3 &dim, std::vector<double> &x,
+                             std::vector<double> &y, std::vector<double> &z) {
+  assert(weights.size() == dim.flatten());
+  x = std::vector<double>(dim.x, 0);
+  y = std::vector<double>(dim.y, 0);
+  z = std::vector<double>(dim.z, 0);
+  for (int64_t k = 0; k < dim.z; ++k) {
+    for (int64_t j = 0; j < dim.y; ++j) {
+      for (int64_t i = 0; i < dim.x; ++i) {
+        const double w = weights[i + j * dim.x + k * dim.y * dim.x];
+        x[i] += w;
+        y[j] += w;
+        z[k] += w;
+      }
+    }
+  }
+}
+
+/* The slabs of a rectilinear partition with uneven widths along each axis.
+   Subdomains are still a 3D grid, so neighbors share whole faces.
+*/
+class AxisCuts {
+private:
+  // x_[i] is where the i-th slab in x starts, and x_.back() is the size in x
+  std::vector<int64_t> x_, y_, z_;
+
+  static std::vector<int64_t> prefix(const std::vector<int64_t> &widths) {
+    std::vector<int64_t> ret(1, 0);
+    for (int64_t w : widths) {
+      ret.push_back(ret.back() + w);
+    }
+    return ret;
+  }
+
+public:
+  AxisCuts() {}
+
+  /* from the width of each slab along x, y, and z
+   */
+  AxisCuts(const std::vector<int64_t> &x, const std::vector<int64_t> &y, const std::vector<int64_t> &z)
+      : x_(prefix(x)), y_(prefix(y)), z_(prefix(z)) {}
+
+  bool empty() const noexcept { return x_.empty(); }
+
+  Dim3 size(const Dim3 &idx) const {
+    assert(idx.x + 1 < int64_t(x_.size()));
+    assert(idx.y + 1 < int64_t(y_.size()));
+    assert(idx.z + 1 < int64_t(z_.size()));
+    return Dim3(x_[idx.x + 1] - x_[idx.x], y_[idx.y + 1] - y_[idx.y], z_[idx.z + 1] - z_[idx.z]);
+  }
+
+  Dim3 origin(const Dim3 &idx) const {
+    assert(idx.x < int64_t(x_.size()));
+    assert(idx.y < int64_t(y_.size()));
+    assert(idx.z < int64_t(z_.size()));
+    return Dim3(x_[idx.x], y_[idx.y], z_[idx.z]);
+  }
+};
+
+/* Cut `size` into a `dim` grid of slabs, where each slab is as wide as the total of `weights` (x-fastest over `dim`)
+   in that slab. The sizes are exact when the weights vary along one axis at a time, and approximate otherwise.
+   No slab is narrower than `minSize` (see min_extent()).
+*/
+inline AxisCuts weighted_cuts(const Dim3 &size, const Dim3 &dim, const std::vector<double> &weights,
+                              const Dim3 &minSize = Dim3(1, 1, 1)) {
+  std::vector<double> x, y, z;
+  weight_marginals(weights, dim, x, y, z);
+  return AxisCuts(split_weighted(size.x, x, minSize.x), split_weighted(size.y, y, minSize.y),
+                  split_weighted(size.z, z, minSize.z));
+}
 
 class RankPartition {
 
 private:
-  Dim3 dim_;  // the number of subdomains
-  Dim3 size_; // the size of each subdomain
-  Dim3 rem_;  // input size % dim_
+  Dim3 dim_;     // the number of subdomains
+  Dim3 size_;    // the size of each subdomain
+  Dim3 rem_;     // input size % dim_
+  Dim3 domSize_; // input size
+
+  AxisCuts cuts_; // uneven subdomain sizes, if weighted
 
 public:
-  RankPartition(const Dim3 &size, const int64_t n) : dim_(1, 1, 1), size_(size) {
+  RankPartition(const Dim3 &size, const int64_t n) : dim_(1, 1, 1), size_(size), domSize_(size) {
 
     // split repeatedly by the prime factors of n
     std::vector<int64_t> factors = prime_factors(n);
@@ -52,8 +211,27 @@ public:
 
   virtual Dim3 dim() const { return dim_; }
 
+  /* Size subdomains in proportion to `weights`, the relative throughput of each subdomain (x-fastest over dim()).
+     See weighted_cuts(): exact when the weights vary along one axis at a time (e.g. a heavy rank holds a slab of
+     subdomains), and approximate otherwise. No subdomain is narrower than `minSize` (see min_extent()).
+  */
+  void set_weights(const std::vector<double> &weights, const Dim3 &minSize = Dim3(1, 1, 1)) {
+    if (weights.size() != dim_.flatten()) {
+      LOG_FATAL("RankPartition: expected " << dim_.flatten() << " weights, got " << weights.size());
+    }
+    cuts_ = weighted_cuts(domSize_, dim_, weights, minSize);
+  }
+
+  /* set the subdomain boundaries directly
+   */
+  void set_cuts(const AxisCuts &cuts) { cuts_ = cuts; }
+
   virtual Dim3 subdomain_size(const Dim3 &idx) const {
 
+    if (!cuts_.empty()) {
+      return cuts_.size(idx);
+    }
+
     Dim3 ret = size_;
 
     if (rem_.x != 0 && idx.x >= rem_.x) {
@@ -70,6 +248,10 @@ public:
   }
 
   Dim3 subdomain_origin(const Dim3 &idx) const noexcept {
+    if (!cuts_.empty()) {
+      return cuts_.origin(idx);
+    }
+
     Dim3 ret = size_ * idx;
 
     if (rem_.x != 0 && idx.x >= rem_.x) {
@@ -123,8 +305,24 @@ private:
   Dim3 sysDim_;  // dimension of the system
   Dim3 nodeDim_; // dimension of a node
 
-  Dim3 size_; // approximate subdomain size
-  Dim3 rem_;  // input size % sysDim_ * nodeDim_
+  Dim3 size_;    // approximate subdomain size
+  Dim3 rem_;     // input size % sysDim_ * nodeDim_
+  Dim3 domSize_; // input size
+
+  AxisCuts cuts_; // uneven subdomain sizes, if weighted
+
+  /* split `n` among `sys` slabs, and then each of those among `node` slabs at least `minWidth` wide
+   */
+  static std::vector<int64_t> split_two_level(const int64_t n, const std::vector<double> &sys,
+                                              const std::vector<double> &node, const int64_t minWidth) {
+    std::vector<int64_t> ret;
+    for (int64_t w : split_weighted(n, sys, minWidth * int64_t(node.size()))) {
+      for (int64_t e : split_weighted(w, node, minWidth)) {
+        ret.push_back(e);
+      }
+    }
+    return ret;
+  }
 
   /* linearize an index `idx` in a space `dim` */
   static int64_t linearize(const Dim3 idx, const Dim3 dim) {
@@ -155,7 +353,7 @@ private:
 
 public:
   NodePartition(const Dim3 &size, const Radius radius, const int64_t nodes, const int64_t gpus)
-      : sysDim_(1, 1, 1), nodeDim_(1, 1, 1), size_(size) {
+      : sysDim_(1, 1, 1), nodeDim_(1, 1, 1), size_(size), domSize_(size) {
 
     // split among nodes
     std::vector<int64_t> factors = prime_factors(nodes);
@@ -210,6 +408,17 @@ public:
     rem_ = size % (sysDim_ * nodeDim_);
   }
 
+  /* split `size` into exactly `sysDim` blocks of `nodeDim` subdomains each
+   */
+  NodePartition(const Dim3 &size, const Dim3 &sysDim, const Dim3 &nodeDim)
+      : sysDim_(sysDim), nodeDim_(nodeDim), size_(size), domSize_(size) {
+    const Dim3 dim = sysDim_ * nodeDim_;
+    size_.x = div_ceil(size.x, dim.x);
+    size_.y = div_ceil(size.y, dim.y);
+    size_.z = div_ceil(size.z, dim.z);
+    rem_ = size % dim;
+  }
+
   NodePartition() : NodePartition(Dim3(0, 0, 0), Radius::constant(0), 0, 0) {}
 
   Dim3 sys_dim() const noexcept { return sysDim_; }
@@ -218,8 +427,34 @@ public:
 
   Dim3 dim() const noexcept { return sys_dim() * node_dim(); }
 
+  /* Size subdomains in proportion to the relative throughput of each block of the system-level partition
+     (`sysWeights`, x-fastest over sys_dim()) and of each position within a node (`nodeWeights`, x-fastest over
+     node_dim()). As in RankPartition::set_weights, each axis is cut by the total weight in each slab, and no subdomain
+     is narrower than `minSize`.
+  */
+  void set_weights(const std::vector<double> &sysWeights, const std::vector<double> &nodeWeights,
+                   const Dim3 &minSize = Dim3(1, 1, 1)) {
+    if (sysWeights.size() != sysDim_.flatten() || nodeWeights.size() != nodeDim_.flatten()) {
+      LOG_FATAL("NodePartition: expected " << sysDim_.flatten() << "+" << nodeDim_.flatten() << " weights, got "
+                                           << sysWeights.size() << "+" << nodeWeights.size());
+    }
+    std::vector<double> sx, sy, sz, nx, ny, nz;
+    weight_marginals(sysWeights, sysDim_, sx, sy, sz);
+    weight_marginals(nodeWeights, nodeDim_, nx, ny, nz);
+    cuts_ = AxisCuts(split_two_level(domSize_.x, sx, nx, minSize.x), split_two_level(domSize_.y, sy, ny, minSize.y),
+                     split_two_level(domSize_.z, sz, nz, minSize.z));
+  }
+
+  /* set the subdomain boundaries directly
+   */
+  void set_cuts(const AxisCuts &cuts) { cuts_ = cuts; }
+
   Dim3 subdomain_size(const Dim3 &idx) const {
 
+    if (!cuts_.empty()) {
+      return cuts_.size(idx);
+    }
+
     Dim3 ret = size_;
 
     if (rem_.x != 0 && idx.x >= rem_.x) {
@@ -236,6 +471,10 @@ public:
   }
 
   Dim3 subdomain_origin(const Dim3 &idx) const noexcept {
+    if (!cuts_.empty()) {
+      return cuts_.origin(idx);
+    }
+
     Dim3 ret = size_ * idx;
 
     if (rem_.x != 0 && idx.x >= rem_.x) {
@@ -255,10 +494,310 @@ public:
   Dim3 node_idx(int64_t i) const noexcept { return dimensionize(i, node_dim()); }
 };
 
+/* A score for a partition (lower is better), used to choose among decompositions
+ */
+typedef std::function<double(const NodePartition &)> PartitionCost;
+
+namespace partition_cost {
+
+/* Bytes sent in one halo exchange by all subdomains, with `bytesPerCell` bytes across all quantities.
+   Halos sent to a different node count `interNode` times.
+*/
+inline PartitionCost halo_bytes(const Radius &radius, const double bytesPerCell, const double interNode = 1) {
+  return [=](const NodePartition &p) {
+    // subdomains in a row along an axis only differ in their size, and whether their -1 or +1 neighbor is on another
+    // node. Count each kind along each axis
+    struct Kind {
+      int64_t size;
+      bool crossNeg;
+      bool crossPos;
+      bool operator<(const Kind &rhs) const {
+        return std::tie(size, crossNeg, crossPos) < std::tie(rhs.size, rhs.crossNeg, rhs.crossPos);
+      }
+    };
+    std::map<Kind, int64_t> kinds[3];
+    Dim3 dim = p.dim();
+    Dim3 nodeDim = p.node_dim();
+    for (size_t a = 0; a < 3; ++a) {
+      for (int64_t i = 0; i < dim[a]; ++i) {
+        Dim3 idx(0, 0, 0);
+        idx[a] = i;
+        Kind k;
+        k.size = p.subdomain_size(idx)[a];
+        k.crossNeg = i / nodeDim[a] != ((i + dim[a] - 1) % dim[a]) / nodeDim[a];
+        k.crossPos = i / nodeDim[a] != ((i + 1) % dim[a]) / nodeDim[a];
+        ++kinds[a][k];
+      }
+    }
+
+    double ret = 0;
+    for (const auto &kx : kinds[0]) {
+      for (const auto &ky : kinds[1]) {
+        for (const auto &kz : kinds[2]) {
+          const double count = double(kx.second * ky.second * kz.second);
+          const Dim3 sz(kx.first.size, ky.first.size, kz.first.size);
+          for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+              for (int dx = -1; dx <= 1; ++dx) {
+                const Dim3 dir(dx, dy, dz);
+                if (Dim3(0, 0, 0) == dir) {
+                  continue;
+                }
+                const bool cross = (dx < 0 && kx.first.crossNeg) || (dx > 0 && kx.first.crossPos) ||
+                                   (dy < 0 && ky.first.crossNeg) || (dy > 0 && ky.first.crossPos) ||
+                                   (dz < 0 && kz.first.crossNeg) || (dz > 0 && kz.first.crossPos);
+                const double bytes = LocalDomain::halo_extent(dir, sz, radius).flatten() * bytesPerCell;
+                ret += count * bytes * (cross ? interNode : 1);
+              }
+            }
+          }
+        }
+      }
+    }
+    return ret;
+  };
+}
+
+/* Volume of the largest subdomain
+ */
+inline PartitionCost max_volume() {
+  return [](const NodePartition &p) { return double(p.subdomain_size(Dim3(0, 0, 0)).flatten()); };
+}
+
+/* Number of unit-stride rows (along x) in all subdomains. Fewer rows are longer, which is better for coalescing and
+   packing
+*/
+inline PartitionCost x_rows() {
+  return [](const NodePartition &p) {
+    const Dim3 sz = p.subdomain_size(Dim3(0, 0, 0));
+    return double(p.dim().flatten() * sz.y * sz.z);
+  };
+}
+
+/* sum of weighted costs, e.g. sum({{1, halo_bytes(r, 8)}, {0.1, max_volume()}})
+ */
+inline PartitionCost sum(const std::vector<std::pair<double, PartitionCost>> &terms) {
+  return [=](const NodePartition &p) {
+    double ret = 0;
+    for (const auto &t : terms) {
+      ret += t.first * t.second(p);
+    }
+    return ret;
+  };
+}
+
+} // namespace partition_cost
+
+/* every (x,y,z) with x*y*z == n, in increasing x then y
+ */
+inline std::vector<Dim3> factorizations(const int64_t n) {
+  std::vector<Dim3> ret;
+  for (int64_t x = 1; x <= n; ++x) {
+    if (n % x) {
+      continue;
+    }
+    for (int64_t y = 1; y <= n / x; ++y) {
+      if ((n / x) % y) {
+        continue;
+      }
+      ret.push_back(Dim3(x, y, n / x / y));
+    }
+  }
+  return ret;
+}
+
+/* The partition of `size` among `nodes` nodes of `gpus` GPUs that minimizes `cost`, trying every factorization of
+   `nodes` and `gpus`. Ties go to the first in the order of factorizations()
+*/
+inline NodePartition exhaustive_partition(const Dim3 &size, const int64_t nodes, const int64_t gpus,
+                                          const PartitionCost &cost, double *costp = nullptr) {
+  NodePartition best;
+  double bestCost = std::numeric_limits<double>::infinity();
+  bool found = false;
+  for (const Dim3 &sysDim : factorizations(nodes)) {
+    for (const Dim3 &nodeDim : factorizations(gpus)) {
+      // don't leave any subdomain empty
+      const Dim3 dim = sysDim * nodeDim;
+      if (dim.x > size.x || dim.y > size.y || dim.z > size.z) {
+        continue;
+      }
+      NodePartition p(size, sysDim, nodeDim);
+      const double c = cost(p);
+      if (!found || c < bestCost) {
+        best = p;
+        bestCost = c;
+        found = true;
+      }
+    }
+  }
+  if (!found) {
+    LOG_FATAL("no partition of " << size << " into " << nodes << "x" << gpus << " subdomains");
+  }
+  if (costp) {
+    *costp = bestCost;
+  }
+  return best;
+}
+
 enum class PlacementStrategy {
   NodeAware,
   Trivial,
-  IntraNodeRandom // grouped by node, but randomly within nodes
+  IntraNodeRandom, // grouped by node, but randomly within nodes
+  Exhaustive,      // NodeAware, with the decomposition that minimizes a PartitionCost
+  Hilbert,         // consecutive runs of a Hilbert curve through the subdomains to each node and rank
+  Morton           // like Hilbert, with a Morton (Z-order) curve
+};
+
+inline std::string to_string(const PlacementStrategy &s) {
+  switch (s) {
+  case PlacementStrategy::NodeAware:
+    return "NodeAware";
+  case PlacementStrategy::Trivial:
+    return "Trivial";
+  case PlacementStrategy::IntraNodeRandom:
+    return "IntraNodeRandom";
+  case PlacementStrategy::Exhaustive:
+    return "Exhaustive";
+  case PlacementStrategy::Hilbert:
+    return "Hilbert";
+  case PlacementStrategy::Morton:
+    return "Morton";
+  }
+  return "unknown";
+}
+
+/* The ranks of a job and the CUDA devices they contribute, which is everything a Placement needs to know about the
+   machine.
+   Built from the running job with gather(), or from a machine description with from_machine() to model a placement
+   without running on the machine.
+*/
+struct JobLayout {
+  std::vector<std::string> rankNames;       // hostname of each rank
+  std::vector<std::vector<int>> cudaIds;    // CUDA devices each rank contributes
+  std::vector<std::vector<double>> weights; // relative throughput of each of those devices
+  std::function<double(int, int)> bandwidth; // bandwidth between CUDA devices in a node, like gpu_topo::bandwidth
+  std::function<bool(int, int)> peer;        // peer access between CUDA devices in a node, like gpu_topo::peer
+
+  // set by calibrate(), where `bandwidth` is then in bytes / second
+  std::function<double(int, int)> latency; // seconds between CUDA devices in a node
+  Mat2D<double> nodeBandwidth;             // bytes / second between nodes, numbered like node_ranks()
+  Mat2D<double> nodeLatency;               // seconds between nodes
+
+  int num_ranks() const noexcept { return rankNames.size(); }
+
+  /* true if the devices do not all have the same weight
+   */
+  bool weighted() const {
+    for (const auto &ws : weights) {
+      for (double w : ws) {
+        if (w != weights[0][0]) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /* the ranks in each node. nodes are numbered in order of their first rank
+   */
+  std::vector<std::vector<int>> node_ranks() const {
+    std::map<std::string, size_t> nodeNumbers;
+    std::vector<std::vector<int>> ret;
+    for (int rank = 0; rank < num_ranks(); ++rank) {
+      auto p = nodeNumbers.emplace(rankNames[rank], ret.size());
+      if (p.second) {
+        ret.push_back({});
+      }
+      ret[p.first->second].push_back(rank);
+    }
+    return ret;
+  }
+
+  /* the hostname of each node, numbered like node_ranks()
+   */
+  std::vector<std::string> node_names() const {
+    std::vector<std::string> ret;
+    for (const auto &ranks : node_ranks()) {
+      ret.push_back(rankNames[ranks[0]]);
+    }
+    return ret;
+  }
+
+  /* Collective. Every rank contributes the CUDA devices `rankCudaIds` and their throughput `rankWeights` (empty for
+     equal). Every rank gets the whole layout.
+  */
+  static JobLayout gather(const std::vector<int> &rankCudaIds, const std::vector<double> &rankWeights = {}) {
+    if (!rankWeights.empty() && rankWeights.size() != rankCudaIds.size()) {
+      LOG_FATAL("JobLayout: " << rankWeights.size() << " weights for " << rankCudaIds.size() << " devices");
+    }
+    const int size = mpi::world_size();
+    JobLayout job;
+
+    // get the name of each rank
+    char name[MPI_MAX_PROCESSOR_NAME] = {0};
+    int nameLen;
+    MPI_Get_processor_name(name, &nameLen);
+    std::vector<char> allNames(MPI_MAX_PROCESSOR_NAME * size);
+    MPI_Allgather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, allNames.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR,
+                  MPI_COMM_WORLD);
+    for (int rank = 0; rank < size; ++rank) {
+      job.rankNames.push_back(std::string(allNames.data() + rank * MPI_MAX_PROCESSOR_NAME));
+    }
+
+    // the CUDA ids and weights contributed from each rank
+    const int count = rankCudaIds.size();
+    std::vector<int> counts(size);
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    std::vector<int> offs;
+    int total = 0;
+    for (int c : counts) {
+      offs.push_back(total);
+      total += c;
+    }
+
+    std::vector<int> cudaIds(total);
+    MPI_Allgatherv(rankCudaIds.data(), count, MPI_INT, cudaIds.data(), counts.data(), offs.data(), MPI_INT,
+                   MPI_COMM_WORLD);
+    std::vector<double> weights = rankWeights;
+    if (weights.empty()) {
+      weights.resize(count, 1);
+    }
+    std::vector<double> allWeights(total);
+    MPI_Allgatherv(weights.data(), count, MPI_DOUBLE, allWeights.data(), counts.data(), offs.data(), MPI_DOUBLE,
+                   MPI_COMM_WORLD);
+
+    for (int rank = 0; rank < size; ++rank) {
+      job.cudaIds.push_back(
+          std::vector<int>(cudaIds.begin() + offs[rank], cudaIds.begin() + offs[rank] + counts[rank]));
+      job.weights.push_back(
+          std::vector<double>(allWeights.begin() + offs[rank], allWeights.begin() + offs[rank] + counts[rank]));
+    }
+
+    job.bandwidth = gpu_topo::bandwidth;
+    job.peer = gpu_topo::peer;
+    return job;
+  }
+
+  /* Collective. Measure the bandwidth and latency between the CUDA devices in each node with cudaMemcpyPeerAsync,
+     and between nodes with MPI in host memory, and use them instead of gpu_topo::bandwidth and the network model.
+     Each pair of devices is averaged over the nodes that have it.
+     Defined in calibration.cu
+  */
+  void calibrate();
+
+  /* the ranks of a machine read from a description, with equal weights
+   */
+  static JobLayout from_machine(const Machine &machine) {
+    JobLayout job;
+    for (int rank = 0; rank < machine.num_ranks(); ++rank) {
+      job.rankNames.push_back(machine.hostname(machine.node_of_rank(rank)));
+      job.cudaIds.push_back(machine.cuda_ids(rank));
+      job.weights.push_back(std::vector<double>(machine.cuda_ids(rank).size(), 1));
+    }
+    job.bandwidth = [machine](int src, int dst) { return machine.cuda_bandwidth(src, dst); };
+    job.peer = [machine](int src, int dst) { return machine.cuda_peer(src, dst); };
+    return job;
+  }
 };
 
 class Placement {
@@ -286,6 +825,9 @@ public:
 
   // upper bound for idx
   virtual Dim3 dim() = 0;
+
+  // move subdomain boundaries, keeping each subdomain on the same rank and device
+  virtual void set_cuts(const AxisCuts &cuts) = 0;
 };
 
 class Trivial : public Placement {
@@ -334,18 +876,39 @@ public:
 
   Dim3 dim() override { return partition_.dim(); }
 
+  void set_cuts(const AxisCuts &cuts) override { partition_.set_cuts(cuts); }
+
   Trivial(const Dim3 &size, // total domain size
           MpiTopology &mpiTopo,
-          const std::vector<int> &rankCudaIds // which CUDA devices the calling
-                                              // rank wants to contribute
+          const std::vector<int> &rankCudaIds,        // which CUDA devices the calling
+                                                      // rank wants to contribute
+          const std::vector<double> &rankWeights = {}, // relative throughput of each of those
+                                                       // devices (empty for equal)
+          const Radius &radius = Radius::constant(0)   // halo radius, the narrowest a weighted subdomain may be
   ) {
+    (void)mpiTopo;
     MPI_Barrier(MPI_COMM_WORLD);
-    // have everyone request one work item per GPU
-    const int workItems = rankCudaIds.size();
-    std::vector<int> workItemCounts(mpiTopo.size());
-    MPI_Allgather(&workItems, 1, MPI_INT, workItemCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    place(size, JobLayout::gather(rankCudaIds, rankWeights), radius);
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
 
-    if (mpiTopo.rank() == 0) {
+  /* Place the ranks of `job` without MPI, e.g. to model a machine description
+   */
+  Trivial(const Dim3 &size, const JobLayout &job, const Radius &radius = Radius::constant(0)) {
+    place(size, job, radius);
+  }
+
+private:
+  void place(const Dim3 &size, const JobLayout &job, const Radius &radius) {
+    const bool root = 0 == mpi::world_rank();
+
+    // one work item per GPU
+    std::vector<int> workItemCounts;
+    for (const auto &ids : job.cudaIds) {
+      workItemCounts.push_back(ids.size());
+    }
+
+    if (root) {
       std::cerr << "Trivial: workItemCounts:";
       for (auto &e : workItemCounts) {
         std::cerr << " " << e;
@@ -355,7 +918,7 @@ public:
 
     const int numSubdomains = std::accumulate(workItemCounts.begin(), workItemCounts.end(), 0);
 
-    if (mpiTopo.rank() == 0) {
+    if (root) {
       std::cerr << "Trivial: numSubdomains=" << numSubdomains << "\n";
     }
 
@@ -363,17 +926,22 @@ public:
 
     // determine which rank each subdomain will be assigned to
     // determine what the subdomain id within each rank each subdomain is
+    // and which CUDA id and throughput each subdomain will be assigned
     std::vector<int> rankAssignments;
     std::vector<int> rankIds;
+    std::vector<int> cudaAssignments;
+    std::vector<double> weightAssignments;
     for (size_t rank = 0; rank < workItemCounts.size(); ++rank) {
       for (int i = 0; i < workItemCounts[rank]; ++i) {
         rankAssignments.push_back(rank);
         rankIds.push_back(int(i));
+        cudaAssignments.push_back(job.cudaIds[rank][i]);
+        weightAssignments.push_back(job.weights[rank][i]);
       }
     }
     assert(rankAssignments.size() == numSubdomains);
     assert(rankIds.size() == numSubdomains);
-    if (mpiTopo.rank() == 0) {
+    if (root) {
       std::cerr << "Trivial: rankAssignments:";
       for (auto &e : rankAssignments) {
         std::cerr << " " << e;
@@ -385,22 +953,7 @@ public:
         std::cerr << " " << e;
       }
       std::cerr << "\n";
-    }
 
-    // figure out the cuda IDs contributed from each rank
-    std::vector<int> offs;
-    int val = 0;
-    for (const auto &e : workItemCounts) {
-      offs.push_back(val);
-      val += e;
-    }
-
-    // determine which CUDA id each subdomain will be assigned to
-    std::vector<int> cudaAssignments(numSubdomains);
-    MPI_Allgatherv(rankCudaIds.data(), rankCudaIds.size(), MPI_INT, cudaAssignments.data(), workItemCounts.data(),
-                   offs.data(), MPI_INT, MPI_COMM_WORLD);
-
-    if (0 == mpiTopo.rank()) {
       std::cerr << "Trivial: cudaAssignments:";
       for (auto &e : cudaAssignments) {
         std::cerr << " " << e;
@@ -408,6 +961,11 @@ public:
       std::cerr << "\n";
     }
 
+    // size subdomains by the throughput of the device they are assigned to
+    if (job.weighted()) {
+      partition_.set_weights(weightAssignments, min_extent(radius));
+    }
+
     // fill data
     assert(cudaAssignments.size() == numSubdomains);
     assert(rankIds.size() == numSubdomains);
@@ -419,7 +977,7 @@ public:
       const Dim3 idx = partition_.dimensionize(i);
       const Dim3 sdSize = partition_.subdomain_size(idx);
 
-      if (0 == mpiTopo.rank()) {
+      if (root) {
         std::cerr << idx << "is sd" << id << " on r" << rank << " cuda" << cuda << ")" << sdSize << "\n";
       }
 
@@ -439,8 +997,6 @@ public:
       idx_[rank][id] = idx;
       cuda_[idx] = cuda;
     }
-
-    MPI_Barrier(MPI_COMM_WORLD);
   }
 };
 
@@ -522,21 +1078,129 @@ double match(const Mat2D<double> &x, const Mat2D<double> &y) {
 }
 */
 
+/* How NodeAware weighs communication
+ */
+struct CommModel {
+  double bytesPerCell;           // bytes per grid point across all exchanged quantities
+  bool calibrate;                // measure bandwidth and latency with JobLayout::calibrate()
+  Topology::Boundary boundary[3]; // no halo exchange across the edge of an OPEN axis
+  CommModel()
+      : bytesPerCell(1), calibrate(false),
+        boundary{Topology::Boundary::PERIODIC, Topology::Boundary::PERIODIC, Topology::Boundary::PERIODIC} {}
+};
+
+/* mean of the non-zero entries of `m` (0 if there are none)
+ */
+inline double mean_nonzero(const Mat2D<double> &m) {
+  double sum = 0;
+  int64_t n = 0;
+  for (uint64_t i = 0; i < m.shape().y; ++i) {
+    for (uint64_t j = 0; j < m.shape().x; ++j) {
+      if (0 != m.at(i, j)) {
+        sum += m.at(i, j);
+        ++n;
+      }
+    }
+  }
+  return n ? sum / n : 0;
+}
+
+/* Predicted seconds per byte between each pair for messages of `msgBytes`: 1 / bandwidth + latency / msgBytes.
+   Used as the QAP distance, so the QAP cost is the predicted transfer time.
+   A pair with zero bandwidth (e.g. a node to itself) costs nothing.
+*/
+inline Mat2D<double> transfer_time(const Mat2D<double> &bandwidth, const Mat2D<double> &latency, double msgBytes) {
+  assert(bandwidth.shape() == latency.shape());
+  Mat2D<double> ret(bandwidth.shape(), 0);
+  for (uint64_t i = 0; i < bandwidth.shape().y; ++i) {
+    for (uint64_t j = 0; j < bandwidth.shape().x; ++j) {
+      if (0 != bandwidth.at(i, j)) {
+        ret.at(i, j) = 1.0 / bandwidth.at(i, j) + (msgBytes > 0 ? latency.at(i, j) / msgBytes : 0);
+      }
+    }
+  }
+  return ret;
+}
+
 class NodeAware : public Placement {
 private:
   NodePartition partition_;
 
-  constexpr static double interNodeBandwidth = 15;
-  constexpr static double gpuMemoryBandwidth = 900;
+  // how to weigh the halo exchange
+  CommModel model_;
 
-  /* Return a number proportional to the bytes in a halo exchange, along
+  /* Return the bytes in a halo exchange, along
    * direction `dir` for a domain of size `sz` with radius `radius`
    */
   double comm_cost(Dim3 dir, const Dim3 sz, const Radius radius) {
     assert(dir.all_lt(2));
     assert(dir.all_gt(-2));
     double count = double(LocalDomain::halo_extent(dir, sz, radius).flatten());
-    return count;
+    return count * model_.bytesPerCell;
+  }
+
+  /* Choose which block of the system-level partition each node gets, so that blocks that exchange large halos are
+     close. Distance is the measured transfer time between nodes if `job` was calibrated, or from `network` otherwise.
+     returns the linear sys index for each node
+  */
+  std::vector<int> place_nodes(const JobLayout &job, const Network &network, const std::vector<std::string> &nodeNames,
+                               const Radius &radius) {
+    const int64_t numNodes = nodeNames.size();
+
+    std::vector<int> ret(numNodes);
+    std::iota(ret.begin(), ret.end(), 0);
+
+    if (job.nodeBandwidth.empty()) {
+      for (const std::string &name : nodeNames) {
+        if (!network.has_host(name)) {
+          LOG_WARN("NodeAware: " << name << " is not in the network model, skipping inter-node placement");
+          return ret;
+        }
+      }
+    }
+
+    // halo exchange between blocks of the system-level partition
+    const Dim3 sysDim = partition_.sys_dim();
+    const Dim3 nodeDim = partition_.node_dim();
+    const Topology sysTopology(sysDim, model_.boundary[0], model_.boundary[1], model_.boundary[2]);
+    Mat2D<double> comm(numNodes, numNodes, 0.0);
+    for (int64_t a = 0; a < numNodes; ++a) {
+      const Dim3 aIdx = partition_.sys_idx(a);
+      const Dim3 blkSize = partition_.subdomain_size(aIdx * nodeDim) * nodeDim;
+      for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dx = -1; dx <= 1; ++dx) {
+            const Dim3 dir(dx, dy, dz);
+            if (Dim3(0, 0, 0) == dir) {
+              continue;
+            }
+            const Topology::OptionalNeighbor nbr = sysTopology.get_neighbor(aIdx, dir);
+            if (!nbr.exists) {
+              continue;
+            }
+            const Dim3 bIdx = nbr.index;
+            const int64_t b = bIdx.x + bIdx.y * sysDim.x + bIdx.z * sysDim.y * sysDim.x;
+            if (b != a) {
+              comm[a][b] += comm_cost(dir, blkSize, radius);
+            }
+          }
+        }
+      }
+    }
+
+    Mat2D<double> distance;
+    if (job.nodeBandwidth.empty()) {
+      distance = network.distance(nodeNames);
+    } else {
+      distance = transfer_time(job.nodeBandwidth, job.nodeLatency, mean_nonzero(comm));
+    }
+
+    // f[block] = node
+    std::vector<size_t> f = qap::solve_auto(comm, distance);
+    for (int64_t b = 0; b < numNodes; ++b) {
+      ret[f[b]] = b;
+    }
+    return ret;
   }
 
   // convert idx to rank
@@ -580,100 +1244,103 @@ public:
 
   Dim3 dim() override { return partition_.dim(); }
 
+  void set_cuts(const AxisCuts &cuts) override { partition_.set_cuts(cuts); }
+
   NodeAware(const Dim3 &size, // total domain size
             MpiTopology &mpiTopo, Radius radius,
-            const std::vector<int> &rankCudaIds // which CUDA devices the calling
-                                                // rank wants to contribute
+            const std::vector<int> &rankCudaIds,         // which CUDA devices the calling
+                                                         // rank wants to contribute
+            const std::string &networkFile = "",         // a Network model to place nodes with
+            const std::vector<double> &rankWeights = {}, // relative throughput of each of those
+                                                         // devices (empty for equal)
+            const PartitionCost &cost = nullptr,         // if set, search for the decomposition
+                                                         // that minimizes this
+            const CommModel &model = CommModel()         // how to weigh communication
   ) {
     LOG_DEBUG("NodeAware: entered ctor");
     MPI_Barrier(MPI_COMM_WORLD);
     LOG_DEBUG("NodeAware: after barrier");
 
-    // TODO: actually check that everyone has the same number of GPUs
-    const int gpusPerRank = rankCudaIds.size();
-    const int ranksPerNode = mpiTopo.colocated_size();
-    const int gpusPerNode = gpusPerRank * ranksPerNode;
-    const int numNodes = mpiTopo.size() / mpiTopo.colocated_size();
-    const int numSubdomains = numNodes * gpusPerNode;
-
-    partition_ = NodePartition(size, radius, numNodes, gpusPerNode);
-
-    if (0 == mpi::world_rank()) {
-      LOG_INFO("NodeAware: " << partition_.sys_dim() << "x" << partition_.node_dim());
+    JobLayout job = JobLayout::gather(rankCudaIds, rankWeights);
+    if (model.calibrate) {
+      job.calibrate();
     }
-
-    // get the name of each node
-    char name[MPI_MAX_PROCESSOR_NAME] = {0};
-    int nameLen;
-    MPI_Get_processor_name(name, &nameLen);
-    if (0 == mpiTopo.rank()) {
-      LOG_DEBUG("NodeAware: got name " << name);
+    Network network;
+    if (!networkFile.empty() && 0 == mpiTopo.rank()) {
+      network = Network::from_file(networkFile);
     }
+    place(size, radius, job, network, cost, model, true);
+  }
 
-    // gather the names to root
-    std::vector<char> allNames;
-    if (0 == mpiTopo.rank()) {
-      allNames.resize(MPI_MAX_PROCESSOR_NAME * mpiTopo.size());
-    }
-    MPI_Gather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, allNames.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0,
-               MPI_COMM_WORLD);
-    if (0 == mpiTopo.rank()) {
-      LOG_DEBUG("NodeAware: gathered names to root");
+  /* Place the ranks of `job` without MPI, e.g. to model a machine description.
+     `network` connects the nodes (empty to place nodes in order)
+  */
+  NodeAware(const Dim3 &size, const JobLayout &job, Radius radius, const Network &network = Network(),
+            const PartitionCost &cost = nullptr, const CommModel &model = CommModel()) {
+    if (model.calibrate) {
+      LOG_WARN("NodeAware: can't calibrate without MPI, call JobLayout::calibrate() on the job instead");
     }
+    place(size, radius, job, network, cost, model, false);
+  }
 
-    // get the name for each rank
-    std::vector<std::string> rankNames;
-    if (0 == mpiTopo.rank()) {
-      for (int rank = 0; rank < mpiTopo.size(); ++rank) {
-        std::string _name(allNames.data() + rank * MPI_MAX_PROCESSOR_NAME);
-        rankNames.push_back(_name);
+private:
+  /* If `collective`, rank 0 places and broadcasts the result. Otherwise, place on the calling process.
+   */
+  void place(const Dim3 &size, const Radius &radius, const JobLayout &job, const Network &network,
+             const PartitionCost &cost, const CommModel &model, bool collective) {
+    const bool root = !collective || 0 == mpi::world_rank();
+    model_ = model;
+
+    const int gpusPerRank = job.cudaIds[0].size();
+    for (int rank = 0; rank < job.num_ranks(); ++rank) {
+      if (int(job.cudaIds[rank].size()) != gpusPerRank) {
+        LOG_FATAL("NodeAware: rank " << rank << " has " << job.cudaIds[rank].size() << " GPUs but rank 0 has "
+                                     << gpusPerRank << ". Use PlacementStrategy::Trivial for different GPU counts");
       }
     }
-    if (0 == mpiTopo.rank()) {
-      std::cerr << "DEBUG: NodeAware: built names for each rank\n";
+    // the ranks in each node
+    const std::vector<std::vector<int>> nodeRanks = job.node_ranks();
+    const int numNodes = nodeRanks.size();
+    const int ranksPerNode = job.num_ranks() / numNodes;
+    for (int node = 0; node < numNodes; ++node) {
+      if (int(nodeRanks[node].size()) != ranksPerNode) {
+        LOG_FATAL("NodeAware: node " << node << " has " << nodeRanks[node].size() << " ranks, expected "
+                                     << ranksPerNode);
+      }
     }
+    const int gpusPerNode = gpusPerRank * ranksPerNode;
+    const int numSubdomains = numNodes * gpusPerNode;
 
-    // number each name
-    std::map<std::string, size_t> nodeNumbers;
-    size_t nn = 0;
-    if (0 == mpiTopo.rank()) {
-      for (int rank = 0; rank < mpiTopo.size(); ++rank) {
-        auto p = nodeNumbers.emplace(rankNames[rank], nn);
-        if (p.second) {
-          ++nn;
-        }
+    if (cost) {
+      double c;
+      partition_ = exhaustive_partition(size, numNodes, gpusPerNode, cost, &c);
+      if (root) {
+        LOG_INFO("NodeAware: exhaustive search cost=" << c);
       }
+    } else {
+      partition_ = NodePartition(size, radius, numNodes, gpusPerNode);
     }
-    if (0 == mpiTopo.rank()) {
-      std::cerr << "DEBUG: NodeAware: numbered each name\n";
+
+    if (root) {
+      LOG_INFO("NodeAware: " << partition_.sys_dim() << "x" << partition_.node_dim());
     }
 
-    // store the node number for each rank
-    std::vector<int> rankNode(mpiTopo.size());
-    // a vec of ranks that are in each node
-    std::vector<std::vector<int>> nodeRanks(nodeNumbers.size());
-    if (0 == mpiTopo.rank()) {
-      for (int rank = 0; rank < mpiTopo.size(); ++rank) {
-        int node = nodeNumbers[rankNames[rank]];
-        rankNode[rank] = node;
-        nodeRanks[node].push_back(rank);
+    // the block of the system-level partition for each node
+    std::vector<int> nodeBlock(numNodes);
+    std::iota(nodeBlock.begin(), nodeBlock.end(), 0);
+    if (root && (!network.hosts().empty() || !job.nodeBandwidth.empty())) {
+      const std::vector<std::string> nodeNames = job.node_names();
+      nodeBlock = place_nodes(job, network, nodeNames, radius);
+      for (int node = 0; node < numNodes; ++node) {
+        LOG_INFO("NodeAware: node " << node << " (" << nodeNames[node]
+                                    << ") sys_idx=" << partition_.sys_idx(nodeBlock[node]));
       }
     }
-    if (0 == mpiTopo.rank()) {
-      std::cerr << "DEBUG: NodeAware: build ranks in each node\n";
-    }
-
-    // gather up all CUDA ids that all ranks are contributing
-    std::vector<int> globalCudaIds(numSubdomains);
-    MPI_Allgather(rankCudaIds.data(), rankCudaIds.size(), MPI_INT, globalCudaIds.data(), rankCudaIds.size(), MPI_INT,
-                  mpiTopo.comm());
 
-    if (0 == mpiTopo.rank()) {
-      std::cerr << "globalCudaIds:";
-      for (auto &e : globalCudaIds)
-        std::cerr << " " << e;
-      std::cerr << "\n";
-    }
+    const bool weighted = job.weighted();
+    // weights of each block of the system-level partition, and each position within a node
+    std::vector<double> sysWeights(partition_.sys_dim().flatten(), 0);
+    std::vector<double> nodeWeights(partition_.node_dim().flatten(), 0);
 
     // OUTPUTS
     // the CUDA device for each subdomain
@@ -683,22 +1350,33 @@ public:
     // subdomain ID for each subdomain
     std::vector<int> idForDomain(numSubdomains);
 
-    if (0 == mpiTopo.rank()) {
+    if (root) {
 
       const Dim3 nodeDim = partition_.node_dim();
       const Dim3 globalDim = nodeDim * partition_.sys_dim();
 
+      // size each node's block by the total throughput of the node
+      if (weighted) {
+        for (int node = 0; node < numNodes; ++node) {
+          for (int rank : nodeRanks[node]) {
+            for (int gi = 0; gi < gpusPerRank; ++gi) {
+              sysWeights[nodeBlock[node]] += job.weights[rank][gi];
+            }
+          }
+        }
+        partition_.set_weights(sysWeights, std::vector<double>(nodeDim.flatten(), 1), min_extent(radius));
+      }
+
       // do placement separately for each node
       for (int node = 0; node < numNodes; ++node) {
 
-        const Dim3 sysIdx = partition_.sys_idx(node);
+        const Dim3 sysIdx = partition_.sys_idx(nodeBlock[node]);
         auto &ranks = nodeRanks[node]; // ranks in this node
         std::cerr << "placement on node " << node << " sys_idx=" << sysIdx << "\n";
         std::cerr << "ranks:";
         for (auto &e : ranks)
           std::cerr << " " << e;
         std::cerr << "\n";
-        assert(ranks.size() == ranksPerNode);
 
         // make a bandwidth matrix for the components in this node
         Mat2D<double> bandwidth(gpusPerNode, gpusPerNode, 0.0);
@@ -711,9 +1389,9 @@ public:
 
                 // recover the cuda device ID for this component
                 // FIXME: if CUDA_VISIBLE_DEVICES is used, all ranks will report GPU 0
-                const int di = globalCudaIds[ranks[ri] * gpusPerRank + gi];
-                const int dj = globalCudaIds[ranks[rj] * gpusPerRank + gj];
-                bandwidth[ci][cj] = gpu_topo::bandwidth(di, dj);
+                const int di = job.cudaIds[ranks[ri]][gi];
+                const int dj = job.cudaIds[ranks[rj]][gj];
+                bandwidth[ci][cj] = job.bandwidth(di, dj);
               }
             }
           }
@@ -728,17 +1406,20 @@ public:
 
             Dim3 dir = dstIdx - srcIdx;
             // periodic boundary
-            if (dir.x != 0 && dir.x == globalDim.x - 1)
+            const bool px = Topology::Boundary::PERIODIC == model_.boundary[0];
+            const bool py = Topology::Boundary::PERIODIC == model_.boundary[1];
+            const bool pz = Topology::Boundary::PERIODIC == model_.boundary[2];
+            if (px && dir.x != 0 && dir.x == globalDim.x - 1)
               dir.x = -1;
-            if (dir.y != 0 && dir.y == globalDim.y - 1)
+            if (py && dir.y != 0 && dir.y == globalDim.y - 1)
               dir.y = -1;
-            if (dir.z != 0 && dir.z == globalDim.z - 1)
+            if (pz && dir.z != 0 && dir.z == globalDim.z - 1)
               dir.z = -1;
-            if (dir.x != 0 && dir.x == 1 - globalDim.x)
+            if (px && dir.x != 0 && dir.x == 1 - globalDim.x)
               dir.x = 1;
-            if (dir.y != 0 && dir.y == 1 - globalDim.y)
+            if (py && dir.y != 0 && dir.y == 1 - globalDim.y)
               dir.y = 1;
-            if (dir.z != 0 && dir.z == 1 - globalDim.z)
+            if (pz && dir.z != 0 && dir.z == 1 - globalDim.z)
               dir.z = 1;
             if (Dim3(0, 0, 0) == dir || dir.any_gt(1) || dir.any_lt(-1)) {
               continue;
@@ -751,9 +1432,23 @@ public:
           }
         }
 
-        // which component each subdomain should be on
-        Mat2D<double> distance = make_reciprocal(bandwidth);
-        std::vector<size_t> components = qap::solve(comm, distance);
+        // which component each subdomain should be on.
+        // If the latency was measured, minimize the predicted transfer time
+        Mat2D<double> distance;
+        if (job.latency) {
+          Mat2D<double> latency(gpusPerNode, gpusPerNode, 0.0);
+          for (int64_t ci = 0; ci < gpusPerNode; ++ci) {
+            for (int64_t cj = 0; cj < gpusPerNode; ++cj) {
+              const int di = job.cudaIds[ranks[ci / gpusPerRank]][ci % gpusPerRank];
+              const int dj = job.cudaIds[ranks[cj / gpusPerRank]][cj % gpusPerRank];
+              latency[ci][cj] = job.latency(di, dj);
+            }
+          }
+          distance = transfer_time(bandwidth, latency, mean_nonzero(comm));
+        } else {
+          distance = make_reciprocal(bandwidth);
+        }
+        std::vector<size_t> components = qap::solve_auto(comm, distance);
 
         std::cerr << "components:";
         for (auto &e : components)
@@ -767,7 +1462,7 @@ public:
           const int ri = component / gpusPerRank;
           const int rank = ranks[ri];
           const int gpuId = component % gpusPerRank;
-          const int cuda = globalCudaIds[rank * gpusPerRank + gpuId];
+          const int cuda = job.cudaIds[rank][gpuId];
 
           // implicitly, the global ID is grouped by node, and subdomain id within that node
           const size_t gi = node * gpusPerNode + id;
@@ -782,15 +1477,27 @@ public:
           rankAssignment[gi] = rank;
           idForDomain[gi] = gpuId;
           cudaAssignment[gi] = cuda;
+          // average device throughput at this position across nodes
+          nodeWeights[id] += job.weights[rank][gpuId] / numNodes;
         }
       }
 
-    } // 0 == rank
+    } // root
 
     // broadcast the data to all ranks
-    MPI_Bcast(rankAssignment.data(), rankAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(idForDomain.data(), idForDomain.size(), MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(cudaAssignment.data(), cudaAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
+    if (collective) {
+      MPI_Bcast(nodeBlock.data(), nodeBlock.size(), MPI_INT, 0, MPI_COMM_WORLD);
+      if (weighted) {
+        MPI_Bcast(sysWeights.data(), sysWeights.size(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        MPI_Bcast(nodeWeights.data(), nodeWeights.size(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+      }
+      MPI_Bcast(rankAssignment.data(), rankAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
+      MPI_Bcast(idForDomain.data(), idForDomain.size(), MPI_INT, 0, MPI_COMM_WORLD);
+      MPI_Bcast(cudaAssignment.data(), cudaAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    if (weighted) {
+      partition_.set_weights(sysWeights, nodeWeights, min_extent(radius));
+    }
 
     // implicitly first M are first node, next M are second node, so not okay to use partition_.idx()
     for (size_t gi = 0; gi < rankAssignment.size(); ++gi) {
@@ -803,7 +1510,7 @@ public:
       const size_t inNodeId = gi % gpusPerNode;
 
       // convert into a full global index
-      Dim3 sysIdx = partition_.sys_idx(node);
+      Dim3 sysIdx = partition_.sys_idx(nodeBlock[node]);
       Dim3 nodeIdx = partition_.node_idx(inNodeId);
       Dim3 idx = sysIdx * partition_.node_dim() + nodeIdx;
 
@@ -812,7 +1519,7 @@ public:
       subdomainId_[idx] = subdomain;
       cuda_[idx] = cuda;
 
-      if (0 == mpiTopo.rank()) {
+      if (root) {
         std::cerr << "idx=" << idx << " size=" << partition_.subdomain_size(idx) << " rank=" << rank << " node=" << node
                   << " inNodeId=" << inNodeId << " sysIdx=" << sysIdx << " nodeIdx=" << nodeIdx
                   << " subdomain=" << subdomain << " cuda=" << cuda << "\n";
@@ -31,6 +31,10 @@ public:
                                                       // rank wants to contribute
   );
 
+  /* Place the ranks of `job` without MPI, e.g. to model a machine description
+   */
+  IntraNodeRandom(const Dim3 &size, const JobLayout &job, Radius radius);
+
   /*! return the compute domain index associated with a particular rank and
       domain ID `domId`.
   */
@@ -59,4 +63,10 @@ public:
 
   Dim3 dim() override { return partition_.dim(); }
 
+  void set_cuts(const AxisCuts &cuts) override { partition_.set_cuts(cuts); }
+
+private:
+  /* If `collective`, rank 0 places and broadcasts the result. Otherwise, place on the calling process.
+   */
+  void place(const Dim3 &size, const Radius &radius, const JobLayout &job, bool collective);
 };
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "stencil/partition.hpp"
+
+#include <cstdint>
+
+namespace sfc {
+
+/* Position of `p` along a Morton (Z-order) curve through a cube of 2^bits per side
+ */
+uint64_t morton(const Dim3 &p, int bits);
+
+/* Position of `p` along a Hilbert curve through a cube of 2^bits per side.
+   Consecutive positions are neighbors in the cube.
+*/
+uint64_t hilbert(const Dim3 &p, int bits);
+
+/* bits per side of the smallest power-of-two cube that contains `dim`
+ */
+int bits_for(const Dim3 &dim);
+
+} // namespace sfc
+
+/* Order the subdomains along a space-filling curve, and give consecutive runs to the devices of each rank, and the
+   ranks of each node. Neighbors mostly end up on the same rank and node without any QAP, and every rank computes the
+   whole placement locally in O(P log P) for P subdomains, so it scales to large jobs.
+*/
+class SpaceFillingCurve : public Placement {
+public:
+  enum class Curve { Hilbert, Morton };
+
+private:
+  RankPartition partition_;
+
+  // rank, subdomain id, and CUDA device of each subdomain, x-fastest over dim()
+  std::vector<int> rank_;
+  std::vector<int> subdomainId_;
+  std::vector<int> cuda_;
+
+  // convert rank and subdomain to idx
+  std::vector<std::vector<Dim3>> idx_;
+
+  size_t linear(const Dim3 &idx) const {
+    const Dim3 dim = partition_.dim();
+    assert(idx.all_lt(dim));
+    return idx.x + idx.y * dim.x + idx.z * dim.y * dim.x;
+  }
+
+public:
+  SpaceFillingCurve(const Dim3 &size, // total domain size
+                    MpiTopology &mpiTopo,
+                    const std::vector<int> &rankCudaIds,         // which CUDA devices the calling
+                                                                 // rank wants to contribute
+                    const std::vector<double> &rankWeights = {}, // relative throughput of each of those
+                                                                 // devices (empty for equal)
+                    Curve curve = Curve::Hilbert,
+                    const Radius &radius = Radius::constant(0)); // halo radius, the narrowest a weighted
+                                                                 // subdomain may be
+
+  /* Place the ranks of `job` without MPI, e.g. to model a machine description
+   */
+  SpaceFillingCurve(const Dim3 &size, const JobLayout &job, Curve curve = Curve::Hilbert,
+                    const Radius &radius = Radius::constant(0));
+
+  Dim3 get_idx(int rank, int domId) override {
+    assert(rank < int(idx_.size()));
+    assert(domId < int(idx_[rank].size()));
+    return idx_[rank][domId];
+  }
+
+  int get_rank(const Dim3 &idx) override { return rank_[linear(idx)]; }
+
+  int get_subdomain_id(const Dim3 &idx) override { return subdomainId_[linear(idx)]; }
+
+  int get_cuda(const Dim3 &idx) override { return cuda_[linear(idx)]; }
+
+  Dim3 subdomain_size(const Dim3 &idx) override { return partition_.subdomain_size(idx); }
+
+  Dim3 subdomain_origin(const Dim3 &idx) override { return partition_.subdomain_origin(idx); }
+
+  Dim3 dim() override { return partition_.dim(); }
+
+  void set_cuts(const AxisCuts &cuts) override { partition_.set_cuts(cuts); }
+
+private:
+  void place(const Dim3 &size, const JobLayout &job, Curve curve, const Radius &radius);
+};
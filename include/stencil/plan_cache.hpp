@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "stencil/dim3.hpp"
+#include "stencil/exchange_plan.hpp"
+#include "stencil/partition.hpp"
+#include "stencil/tx_common.hpp"
+
+/* An on-disk cache of the placement and communication plan computed by DistributedDomain::realize().
+
+   Entries are keyed on a fingerprint of the problem (size, radius, quantities, methods, placement strategy,
+   boundaries, GPU weights, network model) and the machine (hostnames, GPU UUIDs, and the devices each rank uses).
+   The key is part of the file name and the file header, so an entry for a different problem or machine is never
+   loaded, and the expensive placement and planning are done again and the entry rewritten.
+
+   Files:
+     <dir>/stencil_<key>_placement.txt  the partition and the rank, subdomain id, and device of each subdomain
+     <dir>/stencil_<key'>_plan_<rank>.txt  the messages planned by each rank, where key' includes the placement
+     <dir>/stencil_<key'>_autotune.txt  the method chosen for each message by autotuning, if enabled
+*/
+
+/* 64-bit FNV-1a hash
+ */
+class Fnv1a {
+private:
+  uint64_t h_;
+
+public:
+  Fnv1a() : h_(14695981039346656037ull) {}
+
+  Fnv1a &add(const void *data, size_t n) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < n; ++i) {
+      h_ ^= p[i];
+      h_ *= 1099511628211ull;
+    }
+    return *this;
+  }
+
+  template <typename T> Fnv1a &add(const T &t) {
+    static_assert(std::is_arithmetic<T>::value, "Fnv1a::add(T) is for arithmetic types");
+    return add(&t, sizeof(t));
+  }
+
+  Fnv1a &add(const std::string &s) {
+    add(uint64_t(s.size()));
+    return add(s.data(), s.size());
+  }
+
+  Fnv1a &add(const Dim3 &d) { return add(d.x).add(d.y).add(d.z); }
+
+  uint64_t value() const noexcept { return h_; }
+};
+
+/* A placement read from the cache
+ */
+class CachedPlacement : public Placement {
+private:
+  Dim3 dim_;
+  AxisCuts cuts_;
+
+  /* idx_[rank][id] = idx */
+  std::vector<std::vector<Dim3>> idx_;
+  std::map<Dim3, int> rank_;
+  std::map<Dim3, int> subdomain_id_;
+  std::map<Dim3, int> cuda_;
+
+public:
+  /* `ranks`, `ids`, and `cudas` are for each subdomain, x-fastest over `dim`
+   */
+  CachedPlacement(const Dim3 &dim, const AxisCuts &cuts, const std::vector<int> &ranks, const std::vector<int> &ids,
+                  const std::vector<int> &cudas);
+
+  Dim3 get_idx(int rank, int domId) override {
+    assert(rank < int(idx_.size()));
+    assert(domId < int(idx_[rank].size()));
+    return idx_[rank][domId];
+  }
+  int get_rank(const Dim3 &idx) override { return rank_[idx]; }
+  int get_subdomain_id(const Dim3 &idx) override { return subdomain_id_[idx]; }
+  int get_cuda(const Dim3 &idx) override { return cuda_[idx]; }
+  Dim3 subdomain_size(const Dim3 &idx) override { return cuts_.size(idx); }
+  Dim3 subdomain_origin(const Dim3 &idx) override { return cuts_.origin(idx); }
+  Dim3 dim() override { return dim_; }
+  void set_cuts(const AxisCuts &cuts) override { cuts_ = cuts; }
+};
+
+namespace plan_cache {
+
+/* path of the cache file `what` for `key` in `dir`
+ */
+std::string path(const std::string &dir, uint64_t key, const std::string &what);
+
+/* combine `key` with the rank, subdomain id, device, size, and origin of every subdomain in `placement`
+ */
+uint64_t placement_key(uint64_t key, Placement &placement);
+
+/* write `placement` of a domain of `size`.
+   return false (and write nothing) if the subdomains are not a rectilinear grid that covers `size`
+*/
+bool write_placement(std::ostream &os, uint64_t key, const Dim3 &size, Placement &placement);
+
+/* read a placement written by write_placement for a domain of `size` across `worldSize` ranks.
+   return nullptr if the entry has a different key or does not match the domain
+*/
+CachedPlacement *read_placement(std::istream &is, uint64_t key, const Dim3 &size, int worldSize);
+
+void write_plan(std::ostream &os, uint64_t key, const ExchangePlan &plan);
+
+/* read a plan written by write_plan for a rank with `numDomains` domains into `plan`.
+   return false if the entry has a different key or does not match
+*/
+bool read_plan(std::istream &is, uint64_t key, size_t numDomains, ExchangePlan &plan);
+
+/* write the method chosen for each message by autotuning (see DistributedDomain::set_autotune())
+ */
+void write_methods(std::ostream &os, uint64_t key, const std::vector<Method> &methods);
+
+/* read `n` methods written by write_methods into `methods`.
+   return false if the entry has a different key or does not match
+*/
+bool read_methods(std::istream &is, uint64_t key, size_t n, std::vector<Method> &methods);
+
+} // namespace plan_cache
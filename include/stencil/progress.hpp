@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/* A thread that advances communication while the caller computes.
+   Each start() calls `poll` until it returns false (nothing left pending), then the thread sleeps until the next
+   start(). The caller must not touch what `poll` touches between start() and done() / wait().
+*/
+class ProgressThread {
+private:
+  std::function<bool()> poll_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool active_;   // polling, or asked to
+  bool shutdown_; // exit the thread
+
+  std::thread thread_;
+
+  void run();
+
+public:
+  /* `core` >= 0 pins the thread to that core
+   */
+  ProgressThread(const std::function<bool()> &poll, int core = -1);
+  ~ProgressThread();
+
+  ProgressThread(const ProgressThread &) = delete;
+  ProgressThread &operator=(const ProgressThread &) = delete;
+
+  /* start polling
+   */
+  void start();
+
+  /* true if polling has finished since start(). Does not block
+   */
+  bool done();
+
+  /* block until polling has finished
+   */
+  void wait();
+};
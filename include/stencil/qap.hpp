@@ -1,9 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <thread>
 #include <vector>
 
 #include "stencil/mat2d.hpp"
@@ -11,6 +17,26 @@
 
 namespace qap {
 
+/* limits for qap::solve */
+struct SolveOptions {
+  double timeLimit; // give up on proving optimality after this many seconds
+  double gap;       // accept a placement within this fraction of the optimal cost
+  SolveOptions() : timeLimit(10), gap(0) {}
+};
+
+/* what qap::solve did */
+struct SolveStats {
+  uint64_t nodes;    // search nodes bounded
+  uint64_t pruned;   // search nodes discarded by their bound
+  double elapsed;    // seconds spent in the search
+  double timeToBest; // seconds until the returned placement was found
+  bool optimal;      // the search completed, so the placement is optimal (within `gap`)
+  double lowerBound; // no placement costs less than this
+  SolveStats() : nodes(0), pruned(0), elapsed(0), timeToBest(0), optimal(false), lowerBound(0) {}
+
+  double prune_ratio() const { return nodes ? double(pruned) / double(nodes) : 0; }
+};
+
 namespace detail {
 
 inline double cost_product(double we, double de) {
@@ -46,14 +72,474 @@ inline double cost(const Mat2D<double> &w,      // weight
 
   return ret;
 }
-} // namespace detail
 
-inline std::vector<size_t> solve(const Mat2D<double> &w, Mat2D<double> &d, double *costp = nullptr) {
+/* solve a linear assignment problem on a square cost matrix (Hungarian algorithm, O(n^3))
+   row i is assigned to column `col[i]`
+   returns the total cost of the assignment
+*/
+inline double lap(const Mat2D<double> &c, std::vector<size_t> &col) {
+  assert(c.shape().x == c.shape().y);
+  const size_t n = c.shape().x;
+  const double inf = std::numeric_limits<double>::infinity();
+
+  // 1-indexed potentials and column->row matching, 0 is a sentinel
+  std::vector<double> u(n + 1, 0), v(n + 1, 0), minv(n + 1);
+  std::vector<size_t> p(n + 1, 0), way(n + 1, 0);
+  std::vector<char> used(n + 1);
+
+  for (size_t i = 1; i <= n; ++i) {
+    p[0] = i;
+    size_t j0 = 0;
+    std::fill(minv.begin(), minv.end(), inf);
+    std::fill(used.begin(), used.end(), false);
+    do {
+      used[j0] = true;
+      const size_t i0 = p[j0];
+      double delta = inf;
+      size_t j1 = 0;
+      for (size_t j = 1; j <= n; ++j) {
+        if (!used[j]) {
+          const double cur = c.at(i0 - 1, j - 1) - u[i0] - v[j];
+          if (cur < minv[j]) {
+            minv[j] = cur;
+            way[j] = j0;
+          }
+          if (minv[j] < delta) {
+            delta = minv[j];
+            j1 = j;
+          }
+        }
+      }
+      for (size_t j = 0; j <= n; ++j) {
+        if (used[j]) {
+          u[p[j]] += delta;
+          v[j] -= delta;
+        } else {
+          minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    do {
+      const size_t j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0);
+  }
+
+  col.resize(n);
+  double ret = 0;
+  for (size_t j = 1; j <= n; ++j) {
+    col[p[j] - 1] = j - 1;
+    ret += c.at(p[j] - 1, j - 1);
+  }
+  return ret;
+}
+
+/* change in cost(w, d, f) from exchanging f[i] and f[j]
+ */
+inline double swap_delta(const Mat2D<double> &w, const Mat2D<double> &d, const std::vector<size_t> &f, size_t i,
+                         size_t j) {
+  const size_t fi = f[i];
+  const size_t fj = f[j];
+  double ret = 0;
+  for (size_t k = 0; k < f.size(); ++k) {
+    if (k == i || k == j) {
+      continue;
+    }
+    const size_t fk = f[k];
+    ret += cost_product(w.at(i, k), d.at(fj, fk)) - cost_product(w.at(i, k), d.at(fi, fk));
+    ret += cost_product(w.at(j, k), d.at(fi, fk)) - cost_product(w.at(j, k), d.at(fj, fk));
+    ret += cost_product(w.at(k, i), d.at(fk, fj)) - cost_product(w.at(k, i), d.at(fk, fi));
+    ret += cost_product(w.at(k, j), d.at(fk, fi)) - cost_product(w.at(k, j), d.at(fk, fj));
+  }
+  ret += cost_product(w.at(i, i), d.at(fj, fj)) - cost_product(w.at(i, i), d.at(fi, fi));
+  ret += cost_product(w.at(j, j), d.at(fi, fi)) - cost_product(w.at(j, j), d.at(fj, fj));
+  ret += cost_product(w.at(i, j), d.at(fj, fi)) - cost_product(w.at(i, j), d.at(fi, fj));
+  ret += cost_product(w.at(j, i), d.at(fi, fj)) - cost_product(w.at(j, i), d.at(fj, fi));
+  return ret;
+}
+
+/* apply improving exchanges to f until none are left
+ */
+inline void descend(const Mat2D<double> &w, const Mat2D<double> &d, std::vector<size_t> &f, double &fCost) {
+  bool improved;
+  do {
+    improved = false;
+    for (size_t i = 0; i < f.size(); ++i) {
+      for (size_t j = i + 1; j < f.size(); ++j) {
+        if (swap_delta(w, d, f, i, j) < -1e-12 * std::abs(fCost)) {
+          std::swap(f[i], f[j]);
+          fCost = cost(w, d, f);
+          improved = true;
+        }
+      }
+    }
+  } while (improved);
+}
+
+/* Exact branch-and-bound search for qap::solve.
 
-  typedef std::chrono::system_clock Clock;
+   The distance rows and weight rows are first reduced so that each has a zero off the diagonal. This moves part of
+   the quadratic cost into an exact linear term L, which makes the bound much tighter on flat instances.
+
+   Each search node is bounded with the Gilmore-Lawler bound:
+   the cost of the fixed assignments, plus a linear assignment over the unassigned facilities. The cost of facility i
+   at location k is L, plus its interaction with the fixed facilities, plus the minimum scalar product of i's remaining
+   weights with k's remaining distances.
+
+   Locations that can be exchanged without changing d (e.g. GPUs in the same NVLink clique) are only branched on once.
+
+   The search runs in two phases:
+   1) find the optimal cost, assigning the facilities with the most communication first
+   2) find the lexicographically smallest bijection with that cost, which is what an exhaustive search in
+      next_permutation order would return
+*/
+class BranchAndBound {
+  typedef std::chrono::steady_clock Clock;
   typedef std::chrono::duration<double> Duration;
 
-  auto stop = Clock::now() + Duration(10);
+  const Mat2D<double> &w_;
+  const Mat2D<double> &d_;
+  size_t n_;
+  SolveOptions opts_;
+
+  Mat2D<double> wr_;          // reduced weights
+  Mat2D<double> dr_;          // reduced distances (infinities clamped)
+  Mat2D<double> l_;           // linear cost of facility i at location k
+  std::vector<size_t> twin_;  // smallest location interchangeable with each location
+  std::vector<size_t> order_; // order facilities are assigned in
+
+  std::vector<size_t> f_;    // current partial assignment
+  std::vector<char> taken_;  // location is used in f_
+  std::vector<size_t> best_; // incumbent
+  double bestCost_;
+
+  bool lex_;           // phase 2: looking for the first bijection that costs no more than target_
+  double target_;      //
+  bool found_;         //
+  Clock::time_point start_;
+  Clock::time_point stop_;
+  bool timedOut_;
+  double lowerBound_; // smallest bound among subtrees abandoned at the time limit
+
+  double tol() const { return 1e-9 * std::abs(bestCost_); }
+
+  // a subtree with bound lb should be searched
+  bool promising(double lb) const {
+    if (lex_) {
+      return lb <= target_;
+    } else {
+      return lb < bestCost_ - tol() - opts_.gap * std::abs(bestCost_);
+    }
+  }
+
+  void offer(const std::vector<size_t> &f, double fCost) {
+    if (fCost < bestCost_) {
+      best_ = f;
+      bestCost_ = fCost;
+      stats.timeToBest = Duration(Clock::now() - start_).count();
+    }
+  }
+
+  // reduced cost of facility i at location k against the first `depth` assigned facilities
+  double interaction(size_t depth, size_t i, size_t k) const {
+    double e = l_.at(i, k);
+    for (size_t p = 0; p < depth; ++p) {
+      const size_t a = order_[p];
+      e += wr_.at(i, a) * dr_.at(k, f_[a]);
+      e += wr_.at(a, i) * dr_.at(f_[a], k);
+    }
+    return e;
+  }
+
+  /* lower bound on any completion of the first `depth` assignments in f_
+     `fixed` is the reduced cost among the assigned facilities
+     `c` is filled with the cost of assigning each remaining facility to each remaining location
+     `rows`/`cols` are the remaining facilities and locations, `col` is the bounding assignment
+  */
+  double bound(size_t depth, double fixed, Mat2D<double> &c, std::vector<size_t> &rows, std::vector<size_t> &cols,
+               std::vector<size_t> &col) const {
+    rows.assign(order_.begin() + depth, order_.end());
+    cols.clear();
+    for (size_t k = 0; k < n_; ++k) {
+      if (!taken_[k]) {
+        cols.push_back(k);
+      }
+    }
+    const size_t m = rows.size();
+    c.resize(m, m);
+
+    // remaining distances of each free location, descending
+    Mat2D<double> dv(m - 1, m);
+    for (size_t ck = 0; ck < m; ++ck) {
+      size_t x = 0;
+      for (size_t cl = 0; cl < m; ++cl) {
+        if (cl != ck) {
+          dv.at(ck, x++) = dr_.at(cols[ck], cols[cl]);
+        }
+      }
+      std::sort(dv[ck].begin(), dv[ck].end(), std::greater<double>());
+    }
+
+    std::vector<double> wv(m - 1);
+    for (size_t ri = 0; ri < m; ++ri) {
+      const size_t i = rows[ri];
+
+      // remaining weights of i, ascending
+      size_t x = 0;
+      for (size_t rj = 0; rj < m; ++rj) {
+        if (rj != ri) {
+          wv[x++] = wr_.at(i, rows[rj]);
+        }
+      }
+      std::sort(wv.begin(), wv.end());
+
+      for (size_t ck = 0; ck < m; ++ck) {
+        double mp = 0;
+        for (size_t x = 0; x + 1 < m; ++x) {
+          mp += wv[x] * dv.at(ck, x);
+        }
+        c.at(ri, ck) = interaction(depth, i, cols[ck]) + mp;
+      }
+    }
+    return fixed + lap(c, col);
+  }
+
+  void search(size_t depth, double fixed) {
+    if (Clock::now() > stop_) {
+      timedOut_ = true;
+      return;
+    }
+
+    if (depth == n_) {
+      const double fCost = cost(w_, d_, f_);
+      if (lex_ && fCost <= target_) {
+        best_ = f_;
+        bestCost_ = fCost;
+        found_ = true;
+      } else if (!lex_) {
+        offer(f_, fCost);
+      }
+      return;
+    }
+
+    Mat2D<double> c;
+    std::vector<size_t> rows, cols, col;
+    const double lb = bound(depth, fixed, c, rows, cols, col);
+    ++stats.nodes;
+
+    if (!lex_) {
+      // the assignment that achieves the bound is a complete placement, try it as an incumbent
+      std::vector<size_t> g = f_;
+      for (size_t r = 0; r < rows.size(); ++r) {
+        g[rows[r]] = cols[col[r]];
+      }
+      offer(g, cost(w_, d_, g));
+    }
+
+    if (!promising(lb)) {
+      ++stats.pruned;
+      return;
+    }
+
+    // only the first free location of each set of interchangeable locations
+    const size_t i = order_[depth];
+    std::vector<size_t> visit;
+    for (size_t ck = 0; ck < cols.size(); ++ck) {
+      bool dup = false;
+      for (size_t cl = 0; cl < ck; ++cl) {
+        dup = dup || twin_[cols[cl]] == twin_[cols[ck]];
+      }
+      if (!dup) {
+        visit.push_back(ck);
+      }
+    }
+    // phase 1 visits the cheapest locations first, phase 2 visits them in order
+    if (!lex_) {
+      std::stable_sort(visit.begin(), visit.end(), [&](size_t a, size_t b) { return c.at(0, a) < c.at(0, b); });
+    }
+
+    for (size_t ck : visit) {
+      const size_t k = cols[ck];
+      const double childFixed = fixed + interaction(depth, i, k);
+      f_[i] = k;
+      taken_[k] = true;
+      search(depth + 1, childFixed);
+      taken_[k] = false;
+      if (timedOut_) {
+        lowerBound_ = std::min(lowerBound_, lb);
+        return;
+      }
+      if (found_) {
+        return;
+      }
+    }
+  }
+
+public:
+  SolveStats stats;
+
+  BranchAndBound(const Mat2D<double> &w, const Mat2D<double> &d, const SolveOptions &opts)
+      : w_(w), d_(d), n_(w.shape().x), opts_(opts), wr_(w), dr_(d), l_(n_, n_), twin_(n_), order_(n_), f_(n_),
+        taken_(n_, false), best_(n_), lex_(false), target_(0), found_(false), timedOut_(false),
+        lowerBound_(std::numeric_limits<double>::infinity()) {
+    assert(w.shape() == d.shape());
+    assert(w.shape().x == w.shape().y);
+
+    // locations k and l are interchangeable if exchanging them leaves d unchanged
+    for (size_t k = 0; k < n_; ++k) {
+      twin_[k] = k;
+      for (size_t l = 0; l < k; ++l) {
+        bool same = d.at(k, k) == d.at(l, l) && d.at(k, l) == d.at(l, k);
+        for (size_t x = 0; same && x < n_; ++x) {
+          if (x != k && x != l) {
+            same = d.at(k, x) == d.at(l, x) && d.at(x, k) == d.at(x, l);
+          }
+        }
+        if (same) {
+          twin_[k] = twin_[l];
+          break;
+        }
+      }
+    }
+
+    // replace infinite distances with a value large enough to dominate any finite placement.
+    // this only lowers the cost, so bounds stay valid
+    double maxFinite = 0;
+    for (size_t i = 0; i < n_; ++i) {
+      for (size_t j = 0; j < n_; ++j) {
+        if (std::isfinite(d.at(i, j))) {
+          maxFinite = std::max(maxFinite, std::abs(d.at(i, j)));
+        }
+      }
+    }
+    const double big = (0 == maxFinite ? 1.0 : maxFinite) * 10 * (n_ + 1) * (n_ + 1);
+    for (size_t i = 0; i < n_; ++i) {
+      for (size_t j = 0; j < n_; ++j) {
+        if (!std::isfinite(dr_.at(i, j))) {
+          dr_.at(i, j) = big;
+        }
+      }
+    }
+
+    // d[k][l] = dr[k][l] + r[k] moves r[f(a)] * (row sum of w[a]) into the linear term
+    // w[a][b] = wr[a][b] + s[a] moves s[a] * (row sum of dr[f(a)]) into the linear term
+    for (size_t a = 0; a < n_; ++a) {
+      for (size_t k = 0; k < n_; ++k) {
+        l_.at(a, k) = cost_product(w.at(a, a), dr_.at(k, k));
+      }
+    }
+    for (size_t k = 0; k < n_; ++k) {
+      double r = std::numeric_limits<double>::infinity();
+      for (size_t l = 0; l < n_; ++l) {
+        if (l != k) {
+          r = std::min(r, dr_.at(k, l));
+        }
+      }
+      r = std::isfinite(r) ? r : 0;
+      for (size_t l = 0; l < n_; ++l) {
+        if (l != k) {
+          dr_.at(k, l) -= r;
+        }
+      }
+      for (size_t a = 0; a < n_; ++a) {
+        double rowSum = 0;
+        for (size_t b = 0; b < n_; ++b) {
+          rowSum += (a != b) ? w.at(a, b) : 0;
+        }
+        l_.at(a, k) += r * rowSum;
+      }
+    }
+    for (size_t a = 0; a < n_; ++a) {
+      double s = std::numeric_limits<double>::infinity();
+      for (size_t b = 0; b < n_; ++b) {
+        if (a != b) {
+          s = std::min(s, wr_.at(a, b));
+        }
+      }
+      s = std::isfinite(s) ? s : 0;
+      for (size_t b = 0; b < n_; ++b) {
+        if (a != b) {
+          wr_.at(a, b) -= s;
+        }
+      }
+      for (size_t k = 0; k < n_; ++k) {
+        double rowSum = 0;
+        for (size_t l = 0; l < n_; ++l) {
+          rowSum += (k != l) ? dr_.at(k, l) : 0;
+        }
+        l_.at(a, k) += s * rowSum;
+      }
+    }
+    // the diagonal is entirely in the linear term
+    for (size_t i = 0; i < n_; ++i) {
+      wr_.at(i, i) = 0;
+      dr_.at(i, i) = 0;
+    }
+  }
+
+  std::vector<size_t> run(double *costp) {
+    start_ = Clock::now();
+    stop_ = start_ + std::chrono::duration_cast<Clock::duration>(Duration(opts_.timeLimit));
+
+    for (size_t i = 0; i < n_; ++i) {
+      best_[i] = i;
+    }
+    bestCost_ = cost(w_, d_, best_);
+
+    // a local optimum is usually close, which makes early pruning much more effective
+    std::vector<size_t> f = best_;
+    double fCost = bestCost_;
+    descend(w_, d_, f, fCost);
+    offer(f, fCost);
+
+    // phase 1: assign facilities with the most communication first
+    std::vector<double> flow(n_, 0);
+    for (size_t a = 0; a < n_; ++a) {
+      for (size_t b = 0; b < n_; ++b) {
+        if (a != b) {
+          flow[a] += w_.at(a, b) + w_.at(b, a);
+        }
+      }
+      order_[a] = a;
+    }
+    std::stable_sort(order_.begin(), order_.end(), [&](size_t a, size_t b) { return flow[a] > flow[b]; });
+    search(0, 0);
+    const bool proven = !timedOut_;
+
+    // phase 2: assign facilities in order
+    if (proven) {
+      for (size_t a = 0; a < n_; ++a) {
+        order_[a] = a;
+      }
+      lex_ = true;
+      target_ = bestCost_ + tol();
+      const std::vector<size_t> phase1 = best_;
+      const double phase1Cost = bestCost_;
+      search(0, 0);
+      if (!found_) {
+        best_ = phase1;
+        bestCost_ = phase1Cost;
+      }
+    }
+
+    stats.elapsed = Duration(Clock::now() - start_).count();
+    stats.optimal = proven;
+    stats.lowerBound = proven ? bestCost_ - opts_.gap * std::abs(bestCost_) : std::min(lowerBound_, bestCost_);
+    if (costp) {
+      *costp = bestCost_;
+    }
+    return best_;
+  }
+};
+
+} // namespace detail
+
+/* exhaustive search over all n! bijections.
+   Only practical for small problems, kept as a reference for qap::solve
+*/
+inline std::vector<size_t> solve_exhaustive(const Mat2D<double> &w, const Mat2D<double> &d, double *costp = nullptr) {
 
   assert(w.shape() == d.shape());
   assert(w.shape().x == d.shape().y);
@@ -66,10 +552,6 @@ inline std::vector<size_t> solve(const Mat2D<double> &w, Mat2D<double> &d, doubl
   std::vector<size_t> bestF = f;
   double bestCost = detail::cost(w, d, f);
   do {
-    if (Clock::now() > stop) {
-      LOG_WARN("qap::solve timed out");
-      break;
-    }
     const double cost = detail::cost(w, d, f);
     if (bestCost > cost) {
       bestF = f;
@@ -84,42 +566,50 @@ inline std::vector<size_t> solve(const Mat2D<double> &w, Mat2D<double> &d, doubl
   return bestF;
 }
 
-inline std::vector<size_t> solve_catch(const Mat2D<double> &w, Mat2D<double> &d, double *costp = nullptr) {
+/* find the bijection f minimizing sum w[a][b] * d[f[a]][f[b]]
+
+   If the time limit in `opts` expires, the best placement found so far is returned and stats->optimal is false.
+*/
+inline std::vector<size_t> solve(const Mat2D<double> &w, const Mat2D<double> &d, double *costp = nullptr,
+                                 const SolveOptions &opts = SolveOptions(), SolveStats *stats = nullptr) {
+  detail::BranchAndBound bnb(w, d, opts);
+  std::vector<size_t> f = bnb.run(costp);
+  if (!bnb.stats.optimal) {
+    LOG_WARN("qap::solve timed out after " << bnb.stats.elapsed << "s, returning best-known placement");
+  }
+  if (stats) {
+    *stats = bnb.stats;
+  }
+  return f;
+}
+
+inline std::vector<size_t> solve_catch(const Mat2D<double> &w, const Mat2D<double> &d, double *costp = nullptr) {
 
   assert(w.shape() == d.shape());
   assert(w.shape().x == w.shape().y);
 
   // initial guess
-  std::vector<size_t> bestF(w.shape().x);
+  std::vector<size_t> f(w.shape().x);
   for (size_t i = 0; i < w.shape().x; ++i) {
-    bestF[i] = i;
+    f[i] = i;
   }
-  double bestCost = detail::cost(w, d, bestF);
+  double bestCost = detail::cost(w, d, f);
 
   bool improved;
   do {
     improved = false;
 
-    std::vector<size_t> imprF = bestF;
+    size_t imprI = 0, imprJ = 0;
     double imprCost = bestCost;
 
     // find the best improvement for swapping a single location
     for (size_t i = 0; i < w.shape().x; ++i) {
-      // std::cerr << i << "\n";
       for (size_t j = i + 1; j < w.shape().x; ++j) {
 
         // adjust cost for swap
         // we will be adjusting placements i and j
         // remove contribution from entry i,j on cost
-        std::vector<size_t> f = bestF;
         double cost = bestCost;
-        // for (size_t m = 0; m < w.shape().x; ++m) {
-        //   for (size_t n = 0; n < w.shape().x; ++n) {
-        //     if (m == i || m == j || n == i || n == j) {
-        //       cost -= detail::cost_product(w.at(m,n), d.at(f[m], f[n]));
-        //     }
-        //   }
-        // }
         for (size_t k = 0; k < w.shape().x; ++k) {
           cost -= detail::cost_product(w.at(i, k), d.at(f[i], f[k]));
           cost -= detail::cost_product(w.at(j, k), d.at(f[j], f[k]));
@@ -129,16 +619,8 @@ inline std::vector<size_t> solve_catch(const Mat2D<double> &w, Mat2D<double> &d,
             cost -= detail::cost_product(w.at(k, j), d.at(f[k], f[j]));
           }
         }
-        auto tmp = f[i];
-        f[i] = f[j];
-        f[j] = tmp;
-        // for (size_t m = 0; m < w.shape().x; ++m) {
-        //   for (size_t n = 0; n < w.shape().x; ++n) {
-        //     if (m == i || m == j || n == i || n == j) {
-        //       cost += detail::cost_product(w.at(m,n), d.at(f[m], f[n]));
-        //     }
-        //   }
-        // }
+        // evaluate the swap in place, and undo it afterwards
+        std::swap(f[i], f[j]);
         for (size_t k = 0; k < w.shape().x; ++k) {
           cost += detail::cost_product(w.at(i, k), d.at(f[i], f[k]));
           cost += detail::cost_product(w.at(j, k), d.at(f[j], f[k]));
@@ -148,27 +630,21 @@ inline std::vector<size_t> solve_catch(const Mat2D<double> &w, Mat2D<double> &d,
             cost += detail::cost_product(w.at(k, j), d.at(f[k], f[j]));
           }
         }
+        std::swap(f[i], f[j]);
 
-        // if(cost != detail::cost(w,d,f)) {
-        //   fprintf(stderr, "%.20f %.20f\n", cost, detail::cost(w,d,f));
-        // }
-        // const double cost = detail::cost(w,d,f);
-        if (cost < imprCost) {
-          // std::cerr << cost << " " << imprCost << " " << i << " " << j << "\n";
-          imprF = f;
+        // ignore rounding in the incremental cost, which can otherwise swap back and forth forever on ties
+        if (cost < imprCost - 1e-12 * std::abs(imprCost)) {
+          imprI = i;
+          imprJ = j;
           imprCost = cost;
           improved = true;
-
-          // goto nextiter;
         }
       }
     }
 
-    // nextiter:
     if (improved) {
-      bestF = imprF;
+      std::swap(f[imprI], f[imprJ]);
       bestCost = imprCost;
-      // std::cerr << bestCost << "\n";
     }
 
   } while (improved);
@@ -176,7 +652,245 @@ inline std::vector<size_t> solve_catch(const Mat2D<double> &w, Mat2D<double> &d,
   if (costp) {
     *costp = bestCost;
   }
-  return bestF;
+  return f;
+}
+
+/* options for qap::solve_tabu */
+struct TabuOptions {
+  size_t starts;    // independent random starts
+  size_t threads;   // threads to run starts on (0 for one per hardware thread)
+  size_t iters;     // iterations of each start (0 for 100 * problem size)
+  double timeLimit; // stop every start after this many seconds
+  uint64_t seed;    // start s is seeded with seed + s
+  TabuOptions() : starts(8), threads(0), iters(0), timeLimit(10), seed(0) {}
+};
+
+namespace detail {
+
+/* Robust tabu search (Taillard, 1991) from a single start.
+
+   delta(i,j) holds the change in cost from exchanging f[i] and f[j] for every pair.
+   After a move (r,s), entries that don't involve r or s are updated in O(1) and the rest are recomputed in O(n),
+   so each iteration is O(n^2).
+   A move that puts a facility back on a location it recently left is tabu for a random number of iterations, unless it
+   improves on the best cost. A move that has not been possible for a long time is forced.
+*/
+class RobustTabu {
+  typedef std::chrono::steady_clock Clock;
+
+  const Mat2D<double> &w_;
+  const Mat2D<double> &d_; // finite distances
+  size_t n_;
+
+  std::vector<size_t> f_;
+  double cost_;
+  Mat2D<double> delta_;
+  Mat2D<int64_t> tabu_; // iteration when facility i may return to location k
+
+  double full_delta(size_t r, size_t s) const {
+    const Mat2D<double> &a = w_;
+    const Mat2D<double> &b = d_;
+    const std::vector<size_t> &p = f_;
+    double ret = (a.at(r, r) - a.at(s, s)) * (b.at(p[s], p[s]) - b.at(p[r], p[r])) +
+                 (a.at(r, s) - a.at(s, r)) * (b.at(p[s], p[r]) - b.at(p[r], p[s]));
+    for (size_t k = 0; k < n_; ++k) {
+      if (k != r && k != s) {
+        ret += (a.at(k, r) - a.at(k, s)) * (b.at(p[k], p[s]) - b.at(p[k], p[r])) +
+               (a.at(r, k) - a.at(s, k)) * (b.at(p[s], p[k]) - b.at(p[r], p[k]));
+      }
+    }
+    return ret;
+  }
+
+  // delta(i,j) after (r,s) was exchanged, where {i,j} and {r,s} are disjoint
+  double part_delta(size_t i, size_t j, size_t r, size_t s) const {
+    const Mat2D<double> &a = w_;
+    const Mat2D<double> &b = d_;
+    const std::vector<size_t> &p = f_;
+    return delta_.at(i, j) +
+           (a.at(r, i) - a.at(r, j) + a.at(s, j) - a.at(s, i)) *
+               (b.at(p[s], p[i]) - b.at(p[s], p[j]) + b.at(p[r], p[j]) - b.at(p[r], p[i])) +
+           (a.at(i, r) - a.at(j, r) + a.at(j, s) - a.at(i, s)) *
+               (b.at(p[i], p[s]) - b.at(p[j], p[s]) + b.at(p[j], p[r]) - b.at(p[i], p[r]));
+  }
+
+public:
+  RobustTabu(const Mat2D<double> &w, const Mat2D<double> &d) : w_(w), d_(d), n_(w.shape().x) {}
+
+  /* run `iters` iterations from the identity or a random start, or until `stop`
+     returns the best bijection found, and its cost in `costp`
+  */
+  template <typename RNG>
+  std::vector<size_t> run(size_t iters, Clock::time_point stop, bool shuffle, RNG &rng, double *costp) {
+    f_.resize(n_);
+    for (size_t i = 0; i < n_; ++i) {
+      f_[i] = i;
+    }
+    if (shuffle) {
+      std::shuffle(f_.begin(), f_.end(), rng);
+    }
+    cost_ = cost(w_, d_, f_);
+
+    std::vector<size_t> bestF = f_;
+    double bestCost = cost_;
+
+    delta_ = Mat2D<double>(n_, n_, 0);
+    tabu_ = Mat2D<int64_t>(n_, n_, 0);
+    for (size_t i = 0; i < n_; ++i) {
+      for (size_t j = i + 1; j < n_; ++j) {
+        delta_.at(i, j) = full_delta(i, j);
+      }
+    }
+
+    const int64_t tenure = 8 * n_;
+    const int64_t aspiration = 5 * n_ * n_;
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    for (int64_t iter = 1; iter <= int64_t(iters) && n_ > 1; ++iter) {
+      if (0 == iter % 64 && Clock::now() > stop) {
+        break;
+      }
+
+      // choose the best allowed move, preferring moves that must be made
+      size_t ri = n_, rj = n_;
+      double minDelta = std::numeric_limits<double>::infinity();
+      bool alreadyAspired = false;
+      for (size_t i = 0; i < n_; ++i) {
+        for (size_t j = i + 1; j < n_; ++j) {
+          const double dij = delta_.at(i, j);
+          const bool allowed = tabu_.at(i, f_[j]) < iter || tabu_.at(j, f_[i]) < iter;
+          const bool aspired = tabu_.at(i, f_[j]) < iter - aspiration || tabu_.at(j, f_[i]) < iter - aspiration ||
+                               cost_ + dij < bestCost;
+          if ((aspired && !alreadyAspired) || (aspired && alreadyAspired && dij < minDelta) ||
+              (!aspired && !alreadyAspired && allowed && dij < minDelta)) {
+            ri = i;
+            rj = j;
+            minDelta = dij;
+            if (aspired) {
+              alreadyAspired = true;
+            }
+          }
+        }
+      }
+      if (ri == n_) {
+        continue; // every move is tabu
+      }
+
+      std::swap(f_[ri], f_[rj]);
+      cost_ += minDelta;
+      const double u = uniform(rng);
+      tabu_.at(ri, f_[rj]) = iter + int64_t(u * u * u * tenure);
+      const double v = uniform(rng);
+      tabu_.at(rj, f_[ri]) = iter + int64_t(v * v * v * tenure);
+
+      if (cost_ < bestCost) {
+        bestCost = cost_;
+        bestF = f_;
+      }
+
+      for (size_t i = 0; i < n_; ++i) {
+        for (size_t j = i + 1; j < n_; ++j) {
+          if (i != ri && i != rj && j != ri && j != rj) {
+            delta_.at(i, j) = part_delta(i, j, ri, rj);
+          } else {
+            delta_.at(i, j) = full_delta(i, j);
+          }
+        }
+      }
+    }
+
+    if (costp) {
+      *costp = bestCost;
+    }
+    return bestF;
+  }
+};
+
+} // namespace detail
+
+/* find a good bijection f minimizing sum w[a][b] * d[f[a]][f[b]] with robust tabu search from several starts run
+   across threads. The first start is the identity and the rest are random.
+   Results only depend on `opts.seed`, not the number of threads.
+   Use this when the problem is too large for qap::solve to prove optimality.
+*/
+inline std::vector<size_t> solve_tabu(const Mat2D<double> &w, const Mat2D<double> &d, double *costp = nullptr,
+                                      const TabuOptions &opts = TabuOptions()) {
+  typedef std::chrono::steady_clock Clock;
+  typedef std::chrono::duration<double> Duration;
+
+  assert(w.shape() == d.shape());
+  assert(w.shape().x == w.shape().y);
+  const size_t n = w.shape().x;
+
+  // infinities don't survive the arithmetic in the delta matrix, so replace them with a large distance
+  Mat2D<double> df(d);
+  double maxFinite = 0;
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      if (std::isfinite(d.at(i, j))) {
+        maxFinite = std::max(maxFinite, std::abs(d.at(i, j)));
+      }
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      if (!std::isfinite(df.at(i, j))) {
+        df.at(i, j) = (0 == maxFinite ? 1.0 : maxFinite) * 10 * (n + 1) * (n + 1);
+      }
+    }
+  }
+
+  const size_t starts = std::max(opts.starts, size_t(1));
+  const size_t iters = opts.iters ? opts.iters : 100 * n;
+  const Clock::time_point stop = Clock::now() + std::chrono::duration_cast<Clock::duration>(Duration(opts.timeLimit));
+  size_t nThreads = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+  nThreads = std::min(std::max(nThreads, size_t(1)), starts);
+
+  std::vector<std::vector<size_t>> fs(starts);
+  std::vector<double> costs(starts);
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    detail::RobustTabu tabu(w, df);
+    for (size_t s = next++; s < starts; s = next++) {
+      std::mt19937_64 rng(opts.seed + s);
+      fs[s] = tabu.run(iters, stop, s > 0 /*shuffle*/, rng, nullptr);
+      costs[s] = detail::cost(w, d, fs[s]);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < nThreads; ++t) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  size_t best = 0;
+  for (size_t s = 1; s < starts; ++s) {
+    if (costs[s] < costs[best]) {
+      best = s;
+    }
+  }
+  if (costp) {
+    *costp = costs[best];
+  }
+  return fs[best];
+}
+
+/* the largest problem solve_auto() hands to the exact qap::solve. Past this, branch and bound rarely proves
+   optimality within its time limit, so solve_tabu is used instead
+*/
+constexpr size_t kMaxExactSize = 16;
+
+/* qap::solve for problems of up to kMaxExactSize, and qap::solve_tabu for larger ones
+ */
+inline std::vector<size_t> solve_auto(const Mat2D<double> &w, const Mat2D<double> &d, double *costp = nullptr) {
+  if (w.shape().x <= kMaxExactSize) {
+    return solve(w, d, costp);
+  } else {
+    return solve_tabu(w, d, costp);
+  }
 }
 
 } // namespace qap
@@ -101,6 +101,20 @@ public:
     result.rads_.at_dir(0, 0, 0) = 0;
     return result;
   }
+
+  /* \brief every direction multiplied by k, e.g. the halo needed for k steps of this stencil
+   */
+  Radius scaled(const size_t k) const {
+    Radius result;
+    for (int z = -1; z <= 1; ++z) {
+      for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+          result.dir(x, y, z) = dir(x, y, z) * k;
+        }
+      }
+    }
+    return result;
+  }
 };
 
 #undef SPEW
\ No newline at end of file
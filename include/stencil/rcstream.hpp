@@ -68,5 +68,9 @@ public:
 
   int device() const noexcept { return dev_; }
 
+  /* true if all work issued to the stream is finished. Does not block
+   */
+  bool done() const;
+
   bool operator==(const RcStream &rhs) const noexcept { return stream_ == rhs.stream_; }
 };
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+/*! A pool of host staging buffers shared by every sender and recver in the process, and by every DistributedDomain
+    over its lifetime.
+
+    Memory is reserved in large blocks and sub-allocated, so preparing many senders and recvers costs a few block
+    allocations instead of one cudaHostAlloc each, MPI sees a few large registered regions instead of many small ones,
+    and buffers freed by one DistributedDomain are reused by the next instead of being pinned again. Each new block is
+    at least as large as everything reserved so far, so the number of blocks grows logarithmically with the footprint.
+
+    Pinned arenas reserve with cudaHostAlloc, for copies to and from the devices. Host arenas (for Method::HostMpi)
+    reserve huge-page-aligned blocks, ask the OS to back them with huge pages, and touch them from the reserving
+    thread, so they are placed on its NUMA node.
+
+    Blocks are kept until trim() or the end of the process.
+*/
+class StagingArena {
+public:
+  enum class Kind { Pinned, Host };
+
+  static constexpr size_t kAlign = 256;                // alignment of every buffer
+  static constexpr size_t kMinBlock = 4 * 1024 * 1024; // smallest block reserved
+  static constexpr size_t kHugePage = 2 * 1024 * 1024; // host blocks are a multiple of this
+
+private:
+  struct Block {
+    size_t size;
+    size_t used;                   // bytes in live buffers
+    std::map<size_t, size_t> free; // free[offset] = bytes, coalesced
+  };
+
+  Kind kind_;
+
+  mutable std::mutex mtx_;
+  std::map<char *, Block> blocks_;  // blocks_[base]
+  std::map<char *, size_t> allocs_; // allocs_[buffer] = bytes (rounded up to kAlign)
+
+  size_t footprint_;
+  size_t inUse_;
+  size_t highWater_;
+
+  /* reserve a block of at least `n` bytes. Caller holds mtx_ */
+  std::map<char *, Block>::iterator add_block(size_t n);
+  /* return the memory of the block at `base` */
+  void free_block(char *base);
+
+public:
+  explicit StagingArena(Kind kind);
+  ~StagingArena();
+
+  StagingArena(const StagingArena &other) = delete;
+  StagingArena &operator=(const StagingArena &other) = delete;
+
+  /* the process-wide arenas of page-locked memory, and of plain host memory
+   */
+  static StagingArena &pinned();
+  static StagingArena &host();
+
+  /* a buffer of at least `n` bytes aligned to kAlign, or nullptr if `n` is 0
+   */
+  void *allocate(size_t n);
+
+  /* return a buffer from allocate() to the arena. nullptr is ignored
+   */
+  void deallocate(void *p);
+
+  /* make sure a buffer of `n` bytes can be allocated without reserving another block
+   */
+  void reserve(size_t n);
+
+  /* release the blocks that have no live buffers
+   */
+  void trim();
+
+  // bytes reserved from the system
+  size_t footprint() const;
+  // bytes in live buffers
+  size_t in_use() const;
+  // most bytes in live buffers at once
+  size_t high_water() const;
+
+  Kind kind() const noexcept { return kind_; }
+};
@@ -4,7 +4,10 @@
 #include <cassert>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include <set>
+#include <type_traits>
 #include <vector>
 
 #include <mpi.h>
@@ -14,6 +17,8 @@
 
 #include "cuda_runtime.hpp"
 
+#include "stencil/boundary_condition.hpp"
+#include "stencil/compress.hpp"
 #include "stencil/dim3.hpp"
 #include "stencil/direction_map.hpp"
 #include "stencil/gpu_topology.hpp"
@@ -26,10 +31,82 @@
 #include "stencil/partition.hpp"
 #include "stencil/pitched_ptr.hpp"
 #include "stencil/placement_intranoderandom.hpp"
+#include "stencil/placement_sfc.hpp"
+#include "stencil/plan_cache.hpp"
+#include "stencil/progress.hpp"
 #include "stencil/radius.hpp"
 #include "stencil/topology.hpp"
 #include "stencil/tx.hpp"
 
+/* An exchange in flight, from DistributedDomain::exchange_begin()
+ */
+struct ExchangeHandle {
+  uint64_t id; // which exchange, so a stale handle is caught
+};
+
+/* Called with a domain and the index of one of its get_exterior() regions once the halos that region reads have arrived.
+   See DistributedDomain::set_arrival_callback()
+ */
+typedef std::function<void(size_t domain, size_t region)> ArrivalCallback;
+
+/* Some of the quantities, from DistributedDomain::add_quantity_set()
+ */
+struct QuantitySet {
+  size_t id; // 0 is every quantity
+};
+
+/* How the halos reach the 26 neighbors, from DistributedDomain::set_exchange_rounds()
+ */
+enum class ExchangeRounds {
+  Direct, // one round, a message to each neighbor
+  Phased, // one round per axis, only to the face neighbors. Edges and corners ride along with the faces
+  Auto    // Phased when the edge and corner messages are small enough to be latency-bound
+};
+
+/* The senders and recvers of one round of an exchange. Owns the StatefulSenders and StatefulRecvers
+ */
+struct ExchangeRound {
+  // PeerCopySenders for same-rank exchanges
+  std::vector<std::map<size_t, PeerCopySender>> peerCopySenders;
+
+  std::vector<std::map<Dim3, StatefulSender *>> remoteSenders; // remoteSenders[domain][dstIdx] = sender
+  std::vector<std::map<Dim3, StatefulRecver *>> remoteRecvers; // remoteRecvers[domain][srcIdx] = recver
+
+  // with aggregation, one sender and recver per remote rank replace remoteSenders and remoteRecvers
+  std::map<int, StatefulSender *> rankSenders; // rankSenders[dstRank] = sender
+  std::map<int, StatefulRecver *> rankRecvers; // rankRecvers[srcRank] = recver
+
+  // kernel sender for same-domain sends
+  PeerAccessSender peerAccessSender;
+
+  // Colocated Senders
+  std::vector<std::map<Dim3, StatefulSender *>> coloSenders; // vec[domain][dstIdx] = sender
+  std::vector<std::map<Dim3, StatefulRecver *>> coloRecvers;
+
+  /* Something that fills halos of this rank's domains: a recver, a PeerCopySender, or (with neither) the
+     peerAccessSender. For arrival callbacks and autotuning
+  */
+  struct HaloSource {
+    StatefulRecver *recver;
+    PeerCopySender *peerCopy;
+    Method method;                 // how its messages are sent
+    std::vector<uint32_t> halos;   // halos[domain] = the halo directions it fills (see DistributedDomain::halo_bit())
+    std::vector<size_t> messages;  // DistributedDomain::message_index() of each message it carries
+    bool arrived;                  // in the exchange in flight
+    double elapsed;                // seconds from the start of the round until it arrived
+  };
+  std::vector<HaloSource> haloSources;
+
+  ExchangeRound() = default;
+  ~ExchangeRound() { clear(); }
+  ExchangeRound(const ExchangeRound &) = delete;
+  ExchangeRound &operator=(const ExchangeRound &) = delete;
+
+  /* delete every StatefulSender and StatefulRecver
+   */
+  void clear();
+};
+
 class DistributedDomain {
 private:
   // logical size of the allocation, in elements.
@@ -41,6 +118,13 @@ private:
 
   // the GPUs this distributed domain will use
   std::vector<int> gpus_;
+  // CUDA devices visible to this rank. 0 on a CPU-only node, where gpus_ just numbers the domains
+  int numDevices_;
+  // relative throughput of each GPU in gpus_ (empty for equal)
+  std::vector<double> gpuWeights_;
+
+  // cost minimized by PlacementStrategy::Exhaustive (empty for the default)
+  PartitionCost partitionCost_;
 
   // MPI-related topology information
   MpiTopology mpiTopology_;
@@ -52,6 +136,16 @@ private:
   // the stencil radius in each direction
   Radius radius_;
 
+  // halos are haloDepth_ stencil radii deep, and exchanged every haloDepth_ steps (see set_halo_depth())
+  size_t haloDepth_;
+  // swap()s since the last exchange of every quantity
+  size_t stepsSinceExchange_;
+
+  // the radius of the allocated and exchanged halo
+  Radius halo_radius() const;
+
+  std::vector<Rect3> grow_compute_regions(size_t steps) const;
+
   // typically one per GPU
   // the actual data associated with this rank
   std::vector<LocalDomain> domains_;
@@ -63,25 +157,86 @@ private:
 
   // the names of each quantity
   std::vector<std::string> dataName_;
+  // the encoding of each quantity in inter-rank messages
+  std::vector<WireFormat> dataWire_;
+  // quantitySets_[s-1] = quantities in QuantitySet{s}, added to each LocalDomain in realize()
+  std::vector<std::vector<int64_t>> quantitySets_;
 
   Method flags_;
   PlacementStrategy strategy_;
 
-  // PeerCopySenders for same-rank exchanges
-  std::vector<std::map<size_t, PeerCopySender>> peerCopySenders_;
+  // number of exchanges begun, and whether the last one has not ended
+  uint64_t numExchanges_;
+  bool exchangeActive_;
+
+  // advances exchanges in the background (nullptr for none), and the core to pin it to (-1 for none)
+  ProgressThread *progress_;
+  bool useProgress_;
+  int progressCore_;
+
+  // one round for a direct exchange, or one per axis for a phased exchange (see set_exchange_rounds())
+  ExchangeRound rounds_[3];
+  size_t numRounds_;
+  ExchangeRounds exchangeRounds_;
+  // the round in flight, during an exchange
+  size_t round_;
+
+  // send all remote messages to a rank as one message (see set_aggregate())
+  bool aggregate_;
+
+  // compress host-staged remote messages (see set_compression())
+  CompressConfig compress_;
+
+  // time the methods for each message in realize() (see set_autotune())
+  bool autotune_;
+  int autotuneWarmup_;
+  int autotuneTrials_;
+  // during autotuning, arrivals are timed even without a callback
+  bool tuning_;
+  // tunedMethods_[message_index()] = the methods to plan that message with. Empty to use flags_
+  std::vector<Method> tunedMethods_;
+  // MPI_Wtime() when the round in flight started
+  double roundStart_;
+
+  // called as the halos of each exterior region arrive (see set_arrival_callback()). Empty for none
+  ArrivalCallback arrivalCallback_;
+  // during an exchange, the halo directions of each domain that are in (see halo_bit()). Set by whichever thread polls
+  std::mutex arrivalMutex_;
+  std::vector<uint32_t> haloArrived_;
+  // exteriorNeeds_[domain][region] = the halo directions that get_exterior()[domain][region] reads
+  std::vector<std::vector<uint32_t>> exteriorNeeds_;
+  std::vector<std::vector<bool>> exteriorReported_;
 
-  std::vector<std::map<Dim3, StatefulSender *>> remoteSenders_; // remoteSender_[domain][dstIdx] = sender
-  std::vector<std::map<Dim3, StatefulRecver *>> remoteRecvers_; // remoteRecver_[domain][srcIdx] = recver
+  // prefix for any generated output files
+  std::string outputPrefix_;
 
-  // kernel sender for same-domain sends
-  PeerAccessSender peerAccessSender_;
+  // network model used by NodeAware to place nodes
+  std::string networkFile_;
 
-  // Colocated Senders
-  std::vector<std::map<Dim3, StatefulSender *>> coloSenders_; // vec[domain][dstIdx] = sender
-  std::vector<std::map<Dim3, StatefulRecver *>> coloRecvers_;
+  // directory for the placement and plan cache (empty for no cache)
+  std::string cacheDir_;
+  // fingerprint of the problem and machine for the cache (0 when not caching)
+  uint64_t cacheKey_;
 
-  // prefix for any generated output files
-  std::string outputPrefix_;
+  // measure bandwidth and latency for NodeAware placement
+  bool calibrate_;
+
+  // only Method::HostMpi is allowed: no CUDA devices, or STENCIL_HOST=1
+  bool forceHost_;
+
+  // boundary along each axis of the domain
+  Topology::Boundary boundary_[3];
+
+  // boundaryFills_[quantity][face] fills the halo on `face` of the domain (empty for none). See face_index()
+  std::vector<std::vector<BoundaryFill>> boundaryFills_;
+
+  /* index of a face of the domain, e.g. [-1,0,0] is 0 and [1,0,0] is 1
+   */
+  static int face_index(const Dim3 &face) {
+    assert(1 == std::abs(face.x) + std::abs(face.y) + std::abs(face.z));
+    const int axis = face.x ? 0 : (face.y ? 1 : 2);
+    return 2 * axis + (face.x + face.y + face.z > 0 ? 1 : 0);
+  }
 
 #ifdef STENCIL_SETUP_STATS
   // count of how many bytes are sent through various methods in each exchange
@@ -98,6 +253,11 @@ public:
    */
   double timeExchange_;
   double timeSwap_;
+
+private:
+  double exchangeStart_; // MPI_Wtime() at exchange_begin()
+
+public:
 #endif
 
 #ifdef STENCIL_SETUP_STATS
@@ -125,16 +285,104 @@ public:
 
   void set_radius(const Radius &r) noexcept { radius_ = r; }
 
+  /* Allocate and exchange halos `depth` times the radius deep, so exchange() is only needed every `depth` steps.
+     Between exchanges, each step computes the region from get_step_regions(), which overlaps the neighbors' compute
+     regions and shrinks by the radius every swap(). This trades redundant compute for fewer, larger messages.
+     Also set by STENCIL_HALO_DEPTH.
+
+    dd.set_halo_depth(4);
+    ...
+    for (...) {
+      if (dd.exchange_due()) {
+        dd.exchange();
+      }
+      std::vector<Rect3> regions = dd.get_step_regions();
+      // compute each domain's region into next
+      dd.swap();
+    }
+
+  With an open boundary, the halos on the faces of the domain are only filled by exchange(), so call
+  apply_boundary_conditions() after each swap().
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_halo_depth(size_t depth) noexcept {
+    haloDepth_ = std::max(depth, size_t(1));
+    stepsSinceExchange_ = haloDepth_;
+  }
+  size_t halo_depth() const noexcept { return haloDepth_; }
+
+  /* true when the halos of the "current" quantities have been used up by swap()s, and exchange() is needed before the
+     next step. Always true with a halo depth of 1
+  */
+  bool exchange_due() const noexcept { return stepsSinceExchange_ >= haloDepth_; }
+
+  /* Return the region of each domain where the "current" quantities are valid: the compute region grown by the whole
+     halo right after exchange(), shrinking by the radius every swap(). Halos on open faces of the domain come from
+     the boundary condition, and are not included. One per LocalDomain
+  */
+  std::vector<Rect3> get_valid_regions() const;
+
+  /* Return the region of each domain to compute this step, so that the next quantities are valid over
+     get_valid_regions() after swap(). The compute region, grown by the halo that is not needed for later steps.
+     One per LocalDomain
+  */
+  std::vector<Rect3> get_step_regions() const;
+
   template <typename T> DataHandle<T> add_data(const std::string &name = "") {
+    return add_data<T>(name, WireFormat::native());
+  }
+
+  /* Like add_data(), but the halos sent to other ranks through MPI are encoded as `wire`, e.g. WireFormat::float32()
+     to send a double quantity as float, for about half the inter-rank bytes. The quantity keeps its precision in
+     memory, and halos exchanged within a rank or by colocated copies are exact. Only float and double quantities can
+     use a reduced format.
+
+    auto rho = dd.add_data<double>("rho", WireFormat::float32());
+    auto t = dd.add_data<float>("t", WireFormat::bfloat16());
+    auto c = dd.add_data<double>("c", WireFormat::fixed16(1e-4)); // |c| <= 3.2767
+
+  Should be called by all ranks with the same parameters.
+  */
+  template <typename T> DataHandle<T> add_data(const std::string &name, const WireFormat &wire) {
+    if (WireFormat::Kind::Native != wire.kind && !std::is_same<T, float>::value && !std::is_same<T, double>::value) {
+      LOG_FATAL("quantity " << name << ": only float and double quantities can have a reduced wire format");
+    }
+    if (WireFormat::Kind::Fixed16 == wire.kind && !(wire.scale > 0)) {
+      LOG_FATAL("quantity " << name << ": fixed16 wire format needs a positive scale");
+    }
     dataElemSize_.push_back(sizeof(T));
     dataName_.push_back(name);
+    dataWire_.push_back(wire);
     return DataHandle<T>(dataElemSize_.size() - 1, name);
   }
 
+  /* Group quantities that can be exchanged without the others, e.g. those a kernel phase reads.
+     Packers and MPI messages for every set are planned in realize(), so exchange(set) only moves the set's bytes.
+
+    QuantitySet uv = dd.add_quantity_set(u, v);
+    ...
+    dd.exchange(uv);
+
+  Call before realize()
+  */
+  template <typename... Ts> QuantitySet add_quantity_set(const DataHandle<Ts> &... handles) {
+    std::vector<int64_t> quantities{int64_t(handles.id_)...};
+    if (quantities.empty()) {
+      LOG_FATAL("add_quantity_set() needs at least one quantity");
+    }
+    quantitySets_.push_back(quantities);
+    return QuantitySet{quantitySets_.size()};
+  }
+
   /* Choose comm methods from Method. Call before realize()
 
     d.set_methods(Method::Default);
     d.set_methods(Method::CudaMpi | Method::Kernel);
+
+    Method::HostMpi puts the domains in host memory and does every exchange with MPI, and can't be combined with the
+    others. It is the default on nodes without CUDA devices, or with STENCIL_HOST=1.
   */
   void set_methods(Method flags) noexcept;
 
@@ -145,14 +393,166 @@ public:
   */
   void set_placement(PlacementStrategy strategy) noexcept { strategy_ = strategy; }
 
+  /* Set the boundary along each axis (PERIODIC by default). No halos are exchanged across the faces of an OPEN axis,
+     so those halos are left for the caller to fill.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_boundary(Topology::Boundary x, Topology::Boundary y, Topology::Boundary z) noexcept {
+    boundary_[0] = x;
+    boundary_[1] = y;
+    boundary_[2] = z;
+  }
+  void set_boundary(Topology::Boundary boundary) noexcept { set_boundary(boundary, boundary, boundary); }
+
+  /* Fill the halo of quantity `dh` on `face` of the whole domain (e.g. Dim3(-1, 0, 0) for the -x face) with `bc` at the
+     end of every exchange(), so the halos are valid without a separate fill kernel.
+     Only faces on an OPEN axis (see set_boundary()) have no neighbor to exchange with, so only those are filled.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  template <typename T>
+  void set_boundary_condition(const DataHandle<T> &dh, const Dim3 &face, const BoundaryCondition &bc) {
+    if (boundaryFills_.size() <= dh.id_) {
+      boundaryFills_.resize(dh.id_ + 1, std::vector<BoundaryFill>(6));
+    }
+    boundaryFills_[dh.id_][face_index(face)] = make_boundary_fill<T>(bc);
+  }
+
+  /* set_boundary_condition() on all six faces
+   */
+  template <typename T> void set_boundary_condition(const DataHandle<T> &dh, const BoundaryCondition &bc) {
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int side : {-1, 1}) {
+        Dim3 face(0, 0, 0);
+        face[axis] = side;
+        set_boundary_condition(dh, face, bc);
+      }
+    }
+  }
+
   /*! return true if any provided methods are enabled
    */
   bool any_methods(Method methods) const noexcept { return methods && flags_; }
 
+  /* Set a network model file for NodeAware to map the node-level partition onto (see stencil/network.hpp).
+     Also set by the STENCIL_NETWORK_FILE environment variable.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_network_file(const std::string &path) { networkFile_ = path; }
+
+  /* Measure the bandwidth and latency between GPUs in each node and between nodes before NodeAware placement, and
+     place to minimize the predicted transfer time (see JobLayout::calibrate()).
+     Also set by STENCIL_CALIBRATE=1. Adds a few seconds to realize(), so consider set_cache_dir() as well.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_calibrate(bool calibrate) noexcept { calibrate_ = calibrate; }
+
+  /* Advance exchanges with a background thread, so messages move through their stages (e.g. device-to-host copy to MPI
+     send) between exchange_begin() and exchange_end() without the caller polling with exchange_test().
+     `core` >= 0 pins the thread to that core, which should not be one the caller computes on.
+     Also set by STENCIL_PROGRESS_CORE=<core> (-1 for unpinned). Requires MPI_THREAD_MULTIPLE, otherwise ignored.
+
+  Call before realize()
+  */
+  void set_progress_thread(bool enable, int core = -1) noexcept {
+    useProgress_ = enable;
+    progressCore_ = core;
+  }
+
+  /* Send all remote messages from this rank's subdomains to another rank as one MPI message, instead of one message
+     per pair of subdomains. Fewer, larger messages help when per-message latency limits the exchange.
+     Messages are staged through host memory, even with CUDA-aware MPI. Also set by STENCIL_AGGREGATE=1.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_aggregate(bool aggregate) noexcept { aggregate_ = aggregate; }
+
+  /* Losslessly compress remote messages staged through host memory (Method::CudaMpi without CUDA-aware MPI, not
+     aggregated). Each message is XORed with the same message from the previous exchange and LZ-compressed, on up to
+     `threads` threads per message, and decompressed before it is copied to the device.
+     Each sender times its compression, and sends raw while the compressed bytes plus the time to compress do not beat
+     the raw bytes over a link of `linkBandwidth` bytes / second.
+     Also set by STENCIL_COMPRESS=1, STENCIL_COMPRESS_BANDWIDTH=<bytes/s>, and STENCIL_COMPRESS_THREADS=<n>.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_compression(bool enable, double linkBandwidth = 12.5e9, int threads = 4) noexcept {
+    compress_ = CompressConfig{enable, threads, linkBandwidth};
+  }
+
+  /* Choose the method for each message by timing it in realize(), instead of taking the first of set_methods() that
+     can carry it. Each transport in set_methods() (same-device kernel, peer copy, the colocated method, and
+     Method::CudaMpi, which must be one of them) is tried in turn for every message it can carry: `warmup` untimed
+     and `trials` timed exchanges, timing each message from the start of the exchange until its halo is unpacked. Each
+     message then uses whichever arrived soonest. The choices are logged, written to <output prefix>autotune.txt, and
+     kept in the cache directory (see set_cache_dir()) so a later run on the same machine skips the trials.
+     Also set by STENCIL_AUTOTUNE=1.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_autotune(bool autotune, int warmup = 2, int trials = 5) noexcept {
+    autotune_ = autotune;
+    autotuneWarmup_ = warmup;
+    autotuneTrials_ = trials;
+  }
+
+  /* the methods the message sent in `dir` to subdomain `dstIdx` was planned with (after realize()).
+     set_methods() unless autotuning chose one
+  */
+  Method tuned_method(const Dim3 &dstIdx, const Dim3 &dir) const {
+    return tunedMethods_.empty() ? flags_ : tunedMethods_[message_index(dstIdx, dir)];
+  }
+
+  /* Exchange with all 26 neighbors at once (Direct), or in three rounds of face messages, one axis at a time (Phased).
+     In a phased exchange, each face message also carries the halos received in the earlier rounds, so the edges and
+     corners arrive through the faces: 6 messages instead of 26, but each round waits for the one before it.
+     Auto chooses Phased when the edge and corner messages are small enough that their latency dominates.
+     Also set by STENCIL_EXCHANGE_ROUNDS=direct|phased|auto. Direct by default.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_exchange_rounds(ExchangeRounds rounds) noexcept { exchangeRounds_ = rounds; }
+
+  /* number of rounds in each exchange (after realize())
+   */
+  size_t num_exchange_rounds() const noexcept { return numRounds_; }
+
   /* Choose GPUs for this rank. Call before realize()
    */
   void set_gpus(const std::vector<int> &cudaIds) { gpus_ = cudaIds; }
 
+  /* Set the relative throughput of each GPU from set_gpus(), e.g. {2, 1} if the first is twice as fast.
+     Subdomain volumes scale with throughput so that every GPU finishes a step at about the same time.
+     Used by PlacementStrategy::Trivial, NodeAware, Hilbert, and Morton. No subdomain is made thinner than its halos,
+     and realize() fails if the domain is too small for that. Call before realize()
+  */
+  void set_gpu_weights(const std::vector<double> &weights) { gpuWeights_ = weights; }
+
+  /* Set the cost that PlacementStrategy::Exhaustive minimizes (see partition_cost).
+     Defaults to halo bytes across all quantities, with inter-node halos counting extra.
+     Call before realize()
+  */
+  void set_partition_cost(const PartitionCost &cost) { partitionCost_ = cost; }
+
+  /* Cache the placement and communication plan in `dir`, and reuse them in later runs of the same problem on the same
+     machine (see stencil/plan_cache.hpp). Also set by the STENCIL_CACHE_DIR environment variable.
+
+  Call before realize()
+  Should be called by all ranks with the same parameters.
+  */
+  void set_cache_dir(const std::string &dir) { cacheDir_ = dir; }
+
   /* Set the output prefix for the MPI communication matrix
    */
   void set_output_prefix(const std::string &prefix);
@@ -181,6 +581,16 @@ public:
   */
   void realize();
 
+  /* Move subdomain boundaries so that each subdomain takes about the same time to compute.
+     `computeTimes` is the measured time for each of this rank's domains() (e.g. the average over recent steps).
+     Each subdomain's throughput (cells / time) is used as its weight, as in set_gpu_weights().
+     Data in the "current" quantities moves with the boundaries, and only the senders and recvers of resized subdomains
+     are rebuilt. Halos are stale afterwards, so exchange() before the next step.
+
+     Call after realize() and between exchanges, on all ranks.
+  */
+  void rebalance(const std::vector<double> &computeTimes);
+
   /* Swap current and next pointers
    */
   void swap();
@@ -195,9 +605,25 @@ public:
    * exchange.
    * The GPU kernel can modify this data when the exchange is no occuring
    * One vector per LocalDomain
+   * With set_arrival_callback(), each region can be computed as soon as it is reported
    */
   std::vector<std::vector<Rect3>> get_exterior() const;
 
+  /* Call `callback(domain, region)` as soon as the halos read by get_exterior()[domain][region] have arrived, so the
+     exterior can be computed a region at a time while messages from slower neighbors are still in flight.
+     Each region is reported once per exchange, on the calling thread from exchange_test() or exchange_end() (which
+     polls until every region is reported), never from the progress thread. The callback must not start or end an
+     exchange. Halos filled by a boundary condition arrive at the end of exchange_end(). Empty to disable.
+
+  Call before an exchange
+  */
+  void set_arrival_callback(const ArrivalCallback &callback) { arrivalCallback_ = callback; }
+
+  /* true once get_exterior()[domain][region] has been reported by the arrival callback in the exchange in flight, or
+     in the last one (see set_arrival_callback())
+  */
+  bool exterior_ready(size_t domain, size_t region) const;
+
   /* return the distributed stencil topology for information about neighbors
    */
   const Topology &get_topology() const noexcept { return topology_; }
@@ -205,9 +631,52 @@ public:
   Placement *get_placement() const noexcept { return placement_; }
 
   /*!
-  Do a halo exchange of the "current" quantities and return
+  Do a halo exchange of the "current" quantities, fill the halos on the domain boundary (see set_boundary_condition()),
+  and return
+  */
+  void exchange() { exchange(QuantitySet{0}); }
+
+  /* Like exchange(), but only the quantities in `set` (see add_quantity_set())
+   */
+  void exchange(const QuantitySet &set) {
+    ExchangeHandle handle = exchange_begin(set);
+    exchange_end(handle);
+  }
+
+  /* Start a halo exchange of the "current" quantities and return without waiting for it.
+     Only one exchange may be in flight. Until exchange_end(), only the get_interior() regions may be read, and nothing
+     may be written.
+
+    ExchangeHandle h = dd.exchange_begin();
+    for (...) {
+      // compute a piece of the interior
+      dd.exchange_test(h);
+    }
+    dd.exchange_end(h);
+    // compute the exterior
+  */
+  ExchangeHandle exchange_begin() { return exchange_begin(QuantitySet{0}); }
+
+  /* Like exchange_begin(), but only the quantities in `set` (see add_quantity_set())
+   */
+  ExchangeHandle exchange_begin(const QuantitySet &set);
+
+  /* Move the exchange along without blocking. Messages only advance from one stage to the next (e.g. device-to-host
+     copy to MPI send) when exchange_test() or exchange_end() is called, so call it often while computing, unless there
+     is a progress thread (see set_progress_thread()).
+     Returns true once every message has reached its last stage, when exchange_end() will only wait on copies that
+     are already issued.
   */
-  void exchange();
+  bool exchange_test(const ExchangeHandle &handle);
+
+  /* Block until the exchange is done and fill the halos on the domain boundary
+   */
+  void exchange_end(const ExchangeHandle &handle);
+
+  /* Fill the halos of the "current" quantities in the active quantity set on the faces of the domain that have a
+     boundary condition. Called by exchange(). Copies each face through the host, and fills it a row at a time.
+  */
+  void apply_boundary_conditions();
 
   /* Dump distributed domain to a series of paraview files
 
@@ -217,9 +686,89 @@ public:
   void write_paraview(const std::string &prefix, bool zeroNaNs = false);
 
 protected:
-  /* Try to make progress on all stateful senders once
+  /* fingerprint of the problem and machine for the placement and plan cache, or 0 if they can't be cached
+     Collective.
+  */
+  uint64_t cache_key();
+
+  /* distinguishes the plan files of each round of a phased exchange
+   */
+  std::string round_suffix(size_t r) const { return numRounds_ > 1 ? "_round" + std::to_string(r) : ""; }
+
+  /* Plan messages between subdomains for round `r`
+   */
+  ExchangePlan plan_messages(size_t r);
+
+  /* Plan each round (see plan_round())
+   */
+  void plan_exchanges();
+
+  /* Plan messages between subdomains for round `r` (or load the plan from the cache), then create and prepare any
+     senders and recvers that don't exist yet
+   */
+  void plan_round(size_t r);
+
+  /* bit of halo direction `dir` in haloArrived_ and exteriorNeeds_
+   */
+  static uint32_t halo_bit(const Dim3 &dir) {
+    return uint32_t(1) << ((dir.z + 1) * 9 + (dir.y + 1) * 3 + (dir.x + 1));
+  }
+
+  /* the halo directions filled by a message to the `side` halo in round `r`
+   */
+  uint32_t round_halo_bits(size_t r, const Dim3 &side) const;
+
+  /* index of the message sent in `dir` to subdomain `dstIdx`, among 27 per subdomain
+   */
+  size_t message_index(const Dim3 &dstIdx, const Dim3 &dir) const {
+    const Dim3 dim = placement_->dim();
+    const size_t sd = (dstIdx.z * dim.y + dstIdx.y) * dim.x + dstIdx.x;
+    return sd * 27 + (dir.z + 1) * 9 + (dir.y + 1) * 3 + (dir.x + 1);
+  }
+
+  /* arrivals are tracked for the arrival callback and while autotuning
+   */
+  bool tracking_arrivals() const noexcept { return arrivalCallback_ || tuning_; }
+
+  /* choose tunedMethods_ by timing exchanges with each method, or load them from the cache
+   */
+  void autotune();
+
+  /* record the HaloSources of round `r`, from its plan and the aggregated inboxes
+   */
+  void plan_arrivals(size_t r, const ExchangePlan &plan, const std::map<int, std::vector<Message>> &rankInboxes);
+
+  /* reset arrivals at the start of an exchange: halos without a source are already in, except on faces with a
+     boundary condition
+  */
+  void start_arrivals();
+
+  /* record the halos of round_ that have arrived. Returns true if any have not
+   */
+  bool poll_arrivals();
+
+  /* call arrivalCallback_ for each exterior region whose halos have all arrived, and that was not reported yet
+   */
+  void report_arrivals();
+
+  /* Start the senders and recvers of round_
+   */
+  void start_round();
+
+  /* Wait for the senders and recvers of round_, once they have all reached their last stage
+   */
+  void wait_round();
+
+  /* Try to make progress on all stateful senders of round_ once
 
   return true if any of the senders are still pending
   */
   bool poll_advance_sends();
+
+  /* Try to make progress on all stateful senders of round_, and then recvers until one of them advances, so senders
+     are started as early as possible.
+
+  return true if any sender or recver is still pending
+  */
+  bool poll_exchange();
 };
@@ -1,4 +1,3 @@
-
 #pragma once
 
 #include "stencil/dim3.hpp"
@@ -11,7 +10,8 @@ class Topology {
 public:
   enum class Boundary {
     NONE, // invalid
-    PERIODIC
+    PERIODIC,
+    OPEN // no neighbor past the edge, e.g. a physical wall
   };
 
   struct OptionalNeighbor {
@@ -20,11 +20,20 @@ public:
   };
 
   Topology();
-  Topology(const Dim3 &extent, const Boundary &boundary) : extent_(extent), boundary_(boundary) {}
-
+  Topology(const Dim3 &extent, const Boundary &boundary) : Topology(extent, boundary, boundary, boundary) {}
+  /* a boundary for each axis
+   */
+  Topology(const Dim3 &extent, const Boundary &x, const Boundary &y, const Boundary &z)
+      : extent_(extent), boundary_{x, y, z} {}
+
+  /* the neighbor of `index` in direction `dir`, which does not exist across an OPEN boundary
+   */
   OptionalNeighbor get_neighbor(const Dim3 &index, const Dim3 &dir) const noexcept;
 
+  const Dim3 &extent() const noexcept { return extent_; }
+  Boundary boundary(int axis) const noexcept { return boundary_[axis]; }
+
 private:
   Dim3 extent_;
-  Boundary boundary_;
-};
\ No newline at end of file
+  Boundary boundary_[3];
+};
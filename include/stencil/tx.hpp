@@ -4,4 +4,6 @@
 
 #if STENCIL_USE_CUDA == 1 && defined(__NVCC__)
 #include "tx_cuda.cuh"
+#include "tx_host.hpp"
+#include "tx_rank.cuh"
 #endif
\ No newline at end of file
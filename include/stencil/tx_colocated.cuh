@@ -143,4 +143,5 @@ public:
   bool next_ready();
   void next();
   void wait();
+  bool done() override;
 };
\ No newline at end of file
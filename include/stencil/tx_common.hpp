@@ -10,6 +10,15 @@
  */
 inline uint16_t ipc_tag_payload(uint8_t a, uint8_t b) noexcept { return (uint16_t(a) << 8) | uint16_t(b); }
 
+/* tag of a halo message between ranks from `srcGPU` to `dstGPU`, shared by the RemoteSender, CudaAwareMpiSender,
+   and HostSender transports and their recvers, so each end computes it the same way. Four bits for each GPU
+ */
+inline int remote_tag(int srcGPU, int dstGPU) noexcept {
+  assert(srcGPU >= 0 && srcGPU < 16);
+  assert(dstGPU >= 0 && dstGPU < 16);
+  return ((srcGPU & 0xF) << 4) | (dstGPU & 0xF);
+}
+
 class Message {
 private:
   Dim3 ext_; // for sorting by size, otherwise unused
@@ -21,6 +30,8 @@ public:
   Message(Dim3 dir, int srcGPU, int dstGPU) : Message(dir, srcGPU, dstGPU, Dim3(0, 0, 0)) {}
   Message(Dim3 dir, int srcGPU, int dstGPU, Dim3 ext) : ext_(ext), dir_(dir), srcGPU_(srcGPU), dstGPU_(dstGPU) {}
 
+  const Dim3 &ext() const noexcept { return ext_; }
+
   // true if lhs is larger than rhs. Tie by direction
   static bool by_size(const Message &lhs, const Message &rhs) noexcept {
     if (lhs.ext_.flatten() > rhs.ext_.flatten()) {
@@ -196,5 +207,10 @@ public:
   */
   virtual void wait() = 0;
 
+  /*! true if the received halos are in the domain, without blocking.
+      call after active() becomes false. A recver that can't tell returns false, and its halos are in after wait()
+  */
+  virtual bool done() { return false; }
+
   virtual ~StatefulRecver() {}
 };
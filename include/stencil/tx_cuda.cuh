@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <future>
 #include <iomanip>
@@ -12,12 +13,14 @@
 #include <nvToolsExt.h>
 #include <nvToolsExtCudaRt.h> // nvtxNameCudaStreamA
 
+#include "stencil/compress.hpp"
 #include "stencil/copy.cuh"
 #include "stencil/cuda_runtime.hpp"
 #include "stencil/local_domain.cuh"
 #include "stencil/logging.hpp"
 #include "stencil/packer.cuh"
 #include "stencil/rcstream.hpp"
+#include "stencil/staging_arena.hpp"
 #include "stencil/timer.hpp"
 #include "stencil/tx_common.hpp"
 #include "stencil/tx_ipc.hpp"
@@ -56,6 +59,7 @@ public:
     outbox_ = outbox;
     std::sort(outbox_.begin(), outbox_.end());
 
+    domains_.clear();
     for (auto &e : domains) {
       domains_.push_back(&e);
     }
@@ -110,6 +114,16 @@ public:
       CUDA_RUNTIME(cudaStreamSynchronize(kv.second));
     }
   }
+
+  // true if the kernels from send() are finished. Does not block
+  bool done() const {
+    for (auto &kv : streams_) {
+      if (!kv.second.done()) {
+        return false;
+      }
+    }
+    return true;
+  }
 };
 
 /* Send messages between local domains by pack, cudaMemcpyPeerAsync, unpack
@@ -177,6 +191,9 @@ public:
     CUDA_RUNTIME(cudaSetDevice(dstStream_.device()));
     CUDA_RUNTIME(cudaStreamSynchronize(dstStream_));
   }
+
+  // true if the data from send() is unpacked. The unpack waits on the copy, so only the destination stream is checked
+  bool done() const { return dstStream_.done(); }
 };
 
 /*! Send data between CUDA devices in colocated ranks
@@ -373,7 +390,7 @@ public:
     if (0 == packer_.size()) {
       std::cerr << "WARN: 0-size ColocatedHaloSender was created\n";
     }
-    sender_.start_prepare(packer_.size());
+    sender_.start_prepare(packer_.size(0)); // set 0 (all quantities) is the largest
   }
 
   void finish_prepare() override { sender_.finish_prepare(); }
@@ -489,9 +506,21 @@ public:
     CUDA_RUNTIME(cudaStreamSynchronize(stream_));
     state_ = State::NONE;
   }
+
+  bool done() override { return State::WAIT_COPY == state_ && stream_.done(); }
 };
 
+/* true if the result of `f` is available. Does not block
+ */
+template <typename T> bool future_ready(const std::future<T> &f) {
+  return std::future_status::ready == f.wait_for(std::chrono::seconds(0));
+}
+
 /*! Send from one domain to a remote domain
+
+    Idle -> D2H: pack and copy to the host buffer
+    D2H -> Encode: with compression, encode the message into a frame on other threads (see HaloCodec)
+    D2H or Encode -> Wait: start the MPI send
  */
 class RemoteSender : public StatefulSender {
 private:
@@ -505,20 +534,41 @@ private:
   char *hostBuf_;
 
   RcStream stream_;
-  MPI_Request req_;
+  std::vector<MPI_Request> reqs_; // one persistent send per quantity set
+  size_t set_;                    // quantity set of the send in flight
+
+  // with compression, the packed message is copied to rawBuf_ and encoded into hostBuf_
+  HaloCodec *codec_;
+  char *rawBuf_;
+  std::future<size_t> encoded_; // frame size
+  MPI_Request codecReq_;        // frames vary in size, so are not sent with reqs_
 
-  enum class State { Idle, D2H, Wait };
+  enum class State { Idle, D2H, Encode, Wait };
   State state_;
 
   DevicePacker packer_;
 
 public:
   // RemoteSender() : hostBuf_(nullptr) {}
-  RemoteSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+  RemoteSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain,
+               const CompressConfig &compress = CompressConfig{false, 1, 0})
       : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), hostBuf_(nullptr),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::Idle), packer_(stream_) {}
+        stream_(domain.gpu(), RcStream::Priority::HIGH), set_(0),
+        codec_(compress.enable ? new HaloCodec(compress) : nullptr), rawBuf_(nullptr), codecReq_(MPI_REQUEST_NULL),
+        state_(State::Idle), packer_(stream_, srcRank != dstRank /*wire*/) {}
 
-  ~RemoteSender() { CUDA_RUNTIME(cudaFreeHost(hostBuf_)); }
+  ~RemoteSender() {
+    for (MPI_Request &req : reqs_) {
+      mpi::request_free(req);
+    }
+    if (encoded_.valid()) {
+      encoded_.wait();
+    }
+    mpi::request_free(codecReq_);
+    delete codec_;
+    StagingArena::pinned().deallocate(rawBuf_);
+    StagingArena::pinned().deallocate(hostBuf_);
+  }
 
   /*! Prepare to send a set of messages whose direction vectors are store in
    outbox.
@@ -540,9 +590,24 @@ public:
     if (0 != packer_.size()) {
       CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
 
-      // allocate device & host buffers
-      CUDA_RUNTIME(cudaHostAlloc(&hostBuf_, packer_.size(), cudaHostAllocDefault));
+      // allocate host buffers from the shared pinned arena
+      // set 0 (all quantities) is the largest
+      if (codec_) {
+        rawBuf_ = static_cast<char *>(StagingArena::pinned().allocate(packer_.size(0)));
+        assert(rawBuf_);
+        assert(HaloCodec::max_frame_size(packer_.size(0)) <= size_t(std::numeric_limits<int>::max()));
+        hostBuf_ = static_cast<char *>(StagingArena::pinned().allocate(HaloCodec::max_frame_size(packer_.size(0))));
+        assert(hostBuf_);
+        return; // each frame is sent with MPI_Isend
+      }
+      hostBuf_ = static_cast<char *>(StagingArena::pinned().allocate(packer_.size(0)));
       assert(hostBuf_);
+
+      // buffer, size, peer, and tag are fixed from here on, so each send_h2h() is just an MPI_Start
+      reqs_.resize(domain_->num_quantity_sets(), MPI_REQUEST_NULL);
+      for (size_t s = 0; s < reqs_.size(); ++s) {
+        MPI_Send_init(hostBuf_, packer_.size(s), MPI_BYTE, dstRank_, tag(), MPI_COMM_WORLD, &reqs_[s]);
+      }
     }
   }
 
@@ -560,13 +625,18 @@ public:
   virtual bool next_ready() override {
     if (state_ == State::D2H) {
       return d2h_done();
+    } else if (State::Encode == state_) {
+      return future_ready(encoded_);
     } else {
       return false;
     }
   }
 
   virtual void next() override {
-    if (State::D2H == state_) {
+    if (State::D2H == state_ && codec_ && packer_.size()) {
+      state_ = State::Encode;
+      start_encode();
+    } else if (State::D2H == state_ || State::Encode == state_) {
       state_ = State::Wait;
       send_h2h();
     }
@@ -575,11 +645,13 @@ public:
   virtual void wait() override {
     assert(State::Wait == state_);
     if (packer_.size()) {
-      MPI_Wait(&req_, MPI_STATUS_IGNORE);
+      MPI_Wait(codec_ ? &codecReq_ : &reqs_[set_], MPI_STATUS_IGNORE);
     }
     state_ = State::Idle;
   }
 
+  int tag() const noexcept { return remote_tag(srcGPU_, dstGPU_); }
+
   void send_d2h() {
     if (packer_.size()) {
       nvtxRangePush("RemoteSender::send_d2h");
@@ -588,8 +660,9 @@ public:
       packer_.pack();
 
       // copy to host buffer
-      assert(hostBuf_);
-      CUDA_RUNTIME(rt::time(cudaMemcpyAsync, hostBuf_, packer_.data(), packer_.size(), cudaMemcpyDefault, stream_));
+      char *dst = codec_ ? rawBuf_ : hostBuf_;
+      assert(dst);
+      CUDA_RUNTIME(rt::time(cudaMemcpyAsync, dst, packer_.data(), packer_.size(), cudaMemcpyDefault, stream_));
 
       nvtxRangePop(); // RemoteSender::send_d2h
     }
@@ -614,21 +687,36 @@ public:
     }
   }
 
+  void start_encode() {
+    assert(codec_);
+    const size_t n = packer_.size();
+    const size_t set = domain_->active_quantity_set();
+    encoded_ = std::async(std::launch::async, [this, n, set]() { return codec_->encode(hostBuf_, rawBuf_, n, set); });
+  }
+
   void send_h2h() {
     if (packer_.size()) {
       nvtxRangePush("RemoteSender::send_h2h");
       assert(hostBuf_);
       assert(packer_.size());
-      assert(srcGPU_ < 8);
-      assert(dstGPU_ < 8);
-      const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
-      mpirt::time(MPI_Isend, hostBuf_, packer_.size(), MPI_BYTE, dstRank_, tag, MPI_COMM_WORLD, &req_);
+      set_ = domain_->active_quantity_set();
+      if (codec_) {
+        const size_t frameSize = encoded_.get();
+        mpirt::time(MPI_Isend, hostBuf_, int(frameSize), MPI_BYTE, dstRank_, tag(), MPI_COMM_WORLD, &codecReq_);
+      } else {
+        assert(MPI_REQUEST_NULL != reqs_[set_]);
+        mpirt::time(MPI_Start, &reqs_[set_]);
+      }
       nvtxRangePop(); // RemoteSender::send_h2h
     }
   }
 };
 
 /*! Recv from a remote domain into a domain
+
+    None -> H2H: start the MPI recv
+    H2H -> Decode: with compression, decode the frame on other threads (see HaloCodec)
+    H2H or Decode -> H2D: copy to the device and unpack
  */
 class RemoteRecver : public StatefulRecver {
 private:
@@ -645,20 +733,36 @@ private:
 
   MPI_Request req_;
 
-  enum class State { None, H2H, H2D };
+  // with compression, the frame in hostBuf_ is decoded into rawBuf_
+  HaloCodec *codec_;
+  char *rawBuf_;
+  std::future<void> decoded_;
+
+  enum class State { None, H2H, Decode, H2D };
   State state_;
 
   DeviceUnpacker unpacker_;
 
 public:
   RemoteRecver() = delete;
-  RemoteRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+  RemoteRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain,
+               const CompressConfig &compress = CompressConfig{false, 1, 0})
       : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), hostBuf_(nullptr),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), unpacker_(stream_) {
+        stream_(domain.gpu(), RcStream::Priority::HIGH), req_(MPI_REQUEST_NULL),
+        codec_(compress.enable ? new HaloCodec(compress) : nullptr), rawBuf_(nullptr), state_(State::None),
+        unpacker_(stream_, srcRank != dstRank /*wire*/) {
     CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
   }
 
-  ~RemoteRecver() { CUDA_RUNTIME(cudaFreeHost(hostBuf_)); }
+  ~RemoteRecver() {
+    mpi::request_free(req_);
+    if (decoded_.valid()) {
+      decoded_.wait();
+    }
+    delete codec_;
+    StagingArena::pinned().deallocate(rawBuf_);
+    StagingArena::pinned().deallocate(hostBuf_);
+  }
 
   /*! Prepare to send a set of messages whose direction vectors are store in
    * outbox
@@ -670,9 +774,21 @@ public:
     } else {
       CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
 
-      // allocate device & host buffers
-      CUDA_RUNTIME(cudaHostAlloc(&hostBuf_, unpacker_.size(), cudaHostAllocDefault));
+      // allocate host buffers from the shared pinned arena
+      // with compression, hostBuf_ holds the largest frame
+      const size_t bufSize = codec_ ? HaloCodec::max_frame_size(unpacker_.size(0)) : unpacker_.size(0);
+      hostBuf_ = static_cast<char *>(StagingArena::pinned().allocate(bufSize));
       assert(hostBuf_);
+      if (codec_) {
+        rawBuf_ = static_cast<char *>(StagingArena::pinned().allocate(unpacker_.size(0)));
+        assert(rawBuf_);
+      }
+
+      // each recv_h2h() is just an MPI_Start.
+      // sized for set 0 (all quantities). A smaller set or a compressed frame arrives as a shorter message
+      const int tag = remote_tag(srcGPU_, dstGPU_);
+      assert(bufSize <= size_t(std::numeric_limits<int>::max()));
+      MPI_Recv_init(hostBuf_, int(bufSize), MPI_BYTE, srcRank_, tag, MPI_COMM_WORLD, &req_);
     }
   }
 
@@ -691,12 +807,21 @@ public:
   }
 
   virtual bool next_ready() override {
+    if (State::Decode == state_) {
+      return future_ready(decoded_);
+    }
     assert(State::H2H == state_);
     return h2h_done();
   }
 
   virtual void next() override {
-    if (State::H2H == state_) {
+    if (State::H2H == state_ && codec_ && unpacker_.size()) {
+      state_ = State::Decode;
+      start_decode();
+    } else if (State::H2H == state_ || State::Decode == state_) {
+      if (State::Decode == state_) {
+        decoded_.get();
+      }
       state_ = State::H2D;
       recv_h2d();
     } else {
@@ -712,16 +837,26 @@ public:
     }
   }
 
+  virtual bool done() override { return State::H2D == state_ && (0 == unpacker_.size() || stream_.done()); }
+
   void recv_h2d() {
     if (unpacker_.size()) {
       nvtxRangePush("RemoteRecver::recv_h2d");
       // copy to device buffer
-      CUDA_RUNTIME(rt::time(cudaMemcpyAsync, unpacker_.data(), hostBuf_, unpacker_.size(), cudaMemcpyDefault, stream_));
+      const char *src = codec_ ? rawBuf_ : hostBuf_;
+      CUDA_RUNTIME(rt::time(cudaMemcpyAsync, unpacker_.data(), src, unpacker_.size(), cudaMemcpyDefault, stream_));
       unpacker_.unpack();
       nvtxRangePop(); // RemoteRecver::recv_h2d
     }
   }
 
+  void start_decode() {
+    assert(codec_);
+    const size_t n = unpacker_.size();
+    const size_t set = domain_->active_quantity_set();
+    decoded_ = std::async(std::launch::async, [this, n, set]() { codec_->decode(rawBuf_, n, hostBuf_, set); });
+  }
+
   bool is_h2h() const { return State::H2H == state_; }
 
   bool h2h_done() {
@@ -743,12 +878,8 @@ public:
     if (unpacker_.size()) {
       nvtxRangePush("RemoteRecver::recv_h2h");
       assert(hostBuf_);
-      assert(srcGPU_ < 8);
-      assert(dstGPU_ < 8);
-      const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
-      int numBytes = unpacker_.size();
-      assert(numBytes <= std::numeric_limits<int>::max());
-      mpirt::time(MPI_Irecv, hostBuf_, int(numBytes), MPI_BYTE, srcRank_, tag, MPI_COMM_WORLD, &req_);
+      assert(MPI_REQUEST_NULL != req_);
+      mpirt::time(MPI_Start, &req_);
       nvtxRangePop(); // RemoteRecver::recv_h2h
     }
   }
@@ -776,7 +907,8 @@ private:
   LocalDomain *domain_;
 
   RcStream stream_;
-  MPI_Request req_;
+  std::vector<MPI_Request> reqs_; // one persistent send per quantity set
+  size_t set_;                    // quantity set of the send in flight
 
   enum class State {
     None,
@@ -793,15 +925,17 @@ public:
   CudaAwareMpiSender() = delete;
   CudaAwareMpiSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
       : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), req_({}), state_(State::None), packer_(stream_) {}
+        stream_(domain.gpu(), RcStream::Priority::HIGH), set_(0), state_(State::None),
+        packer_(stream_, srcRank != dstRank /*wire*/) {}
 
-  virtual void start_prepare(const std::vector<Message> &outbox) override {
-    packer_.prepare(domain_, outbox);
-    if (0 == packer_.size()) {
-      LOG_FATAL("a 0-size CudaAwareMpiSender was prepared");
+  ~CudaAwareMpiSender() {
+    for (MPI_Request &req : reqs_) {
+      mpi::request_free(req);
     }
   }
 
+  virtual void start_prepare(const std::vector<Message> &outbox) override;
+
   virtual void finish_prepare() override {
     // no-op
   }
@@ -840,7 +974,7 @@ private:
   // true if pack kernel finished
   bool pack_done();
 
-  // post MPI_Isend
+  // start the persistent send
   void send_d2d();
 };
 
@@ -869,17 +1003,15 @@ public:
   CudaAwareMpiRecver() = delete;
   CudaAwareMpiRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
       : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), unpacker_(stream_) {}
+        stream_(domain.gpu(), RcStream::Priority::HIGH), req_(MPI_REQUEST_NULL), state_(State::None),
+        unpacker_(stream_, srcRank != dstRank /*wire*/) {}
+
+  ~CudaAwareMpiRecver() { mpi::request_free(req_); }
 
   /*! Prepare to send a set of messages whose direction vectors are store in
    * outbox
    */
-  void start_prepare(const std::vector<Message> &inbox) override {
-    unpacker_.prepare(domain_, inbox);
-    if (0 == unpacker_.size()) {
-      LOG_FATAL("a 0-size CudaAwareMpiRecver was created");
-    }
-  }
+  void start_prepare(const std::vector<Message> &inbox) override;
 
   void finish_prepare() override {
     // no-op
@@ -918,13 +1050,15 @@ public:
     CUDA_RUNTIME(cudaStreamSynchronize(stream_));
   }
 
+  virtual bool done() override { return State::Unpack == state_ && stream_.done(); }
+
 private:
   // launch unpack kernel
   void recv_unpack();
 
-  // true if MPI_Irecv is done
+  // true if the recv is done
   bool d2d_done();
 
-  // post MPI_Irecv
+  // start the persistent recv
   void recv_d2d();
 };
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <nvToolsExt.h>
+
+#include "stencil/local_domain.cuh"
+#include "stencil/logging.hpp"
+#include "stencil/packer.cuh"
+#include "stencil/tx_common.hpp"
+
+/*! Send from a domain in host memory to another domain, with plain MPI.
+    Packing is synchronous, so the only state is the persistent send
+ */
+class HostSender : public StatefulSender {
+private:
+  int srcRank_;
+  int srcGPU_;
+  int dstRank_;
+  int dstGPU_;
+
+  LocalDomain *domain_;
+
+  std::vector<MPI_Request> reqs_; // one persistent send per quantity set
+  size_t set_;                    // quantity set of the send in flight
+
+  HostPacker packer_;
+
+public:
+  HostSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), set_(0),
+        packer_(srcRank != dstRank /*wire*/) {}
+
+  ~HostSender() {
+    for (MPI_Request &req : reqs_) {
+      mpi::request_free(req);
+    }
+  }
+
+  void start_prepare(const std::vector<Message> &outbox) override {
+    packer_.prepare(domain_, outbox);
+    LOG_INFO(packer_.size() << "B HostSender was prepared: "
+                            << "r" << srcRank_ << "d" << srcGPU_ << "->"
+                            << "r" << dstRank_ << "d" << dstGPU_);
+    if (packer_.size()) {
+      const int tag = remote_tag(srcGPU_, dstGPU_);
+      reqs_.resize(domain_->num_quantity_sets(), MPI_REQUEST_NULL);
+      for (size_t s = 0; s < reqs_.size(); ++s) {
+        MPI_Send_init(packer_.data(), int(packer_.size(s)), MPI_BYTE, dstRank_, tag, MPI_COMM_WORLD, &reqs_[s]);
+      }
+    }
+  }
+
+  void finish_prepare() override {
+    // no-op
+  }
+
+  void send() override {
+    if (packer_.size()) {
+      nvtxRangePush("HostSender::send");
+      packer_.pack();
+      set_ = domain_->active_quantity_set();
+      MPI_Start(&reqs_[set_]);
+      nvtxRangePop(); // HostSender::send
+    }
+  }
+
+  // nothing to advance once the send is started
+  bool active() override { return false; }
+  bool next_ready() override { return false; }
+  void next() override {}
+
+  void wait() override {
+    if (packer_.size()) {
+      MPI_Wait(&reqs_[set_], MPI_STATUS_IGNORE);
+    }
+  }
+};
+
+/*! Recv into a domain in host memory from another domain, with plain MPI.
+    Unpacks as soon as the persistent recv is done.
+ */
+class HostRecver : public StatefulRecver {
+private:
+  int srcRank_;
+  int srcGPU_;
+  int dstRank_;
+  int dstGPU_;
+
+  LocalDomain *domain_;
+
+  MPI_Request req_;
+
+  enum class State { None, Recv, Unpacked };
+  State state_;
+
+  HostUnpacker unpacker_;
+
+public:
+  HostRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain),
+        req_(MPI_REQUEST_NULL), state_(State::None), unpacker_(srcRank != dstRank /*wire*/) {}
+
+  ~HostRecver() { mpi::request_free(req_); }
+
+  void start_prepare(const std::vector<Message> &inbox) override {
+    unpacker_.prepare(domain_, inbox);
+    if (0 == unpacker_.size()) {
+      LOG_INFO("0-size HostRecver was prepared");
+    } else {
+      const int tag = remote_tag(srcGPU_, dstGPU_);
+      // sized for set 0 (all quantities). A smaller set arrives as a shorter message
+      MPI_Recv_init(unpacker_.data(), int(unpacker_.size(0)), MPI_BYTE, srcRank_, tag, MPI_COMM_WORLD, &req_);
+    }
+  }
+
+  void finish_prepare() override {
+    // no-op
+  }
+
+  void recv() override {
+    state_ = State::Recv;
+    if (unpacker_.size()) {
+      nvtxRangePush("HostRecver::recv");
+      MPI_Start(&req_);
+      nvtxRangePop(); // HostRecver::recv
+    }
+  }
+
+  bool active() override {
+    assert(State::None != state_);
+    return State::Recv == state_;
+  }
+
+  bool next_ready() override {
+    assert(State::Recv == state_);
+    if (unpacker_.size()) {
+      int flag;
+      MPI_Test(&req_, &flag, MPI_STATUS_IGNORE);
+      return flag;
+    } else {
+      return true;
+    }
+  }
+
+  void next() override {
+    assert(State::Recv == state_);
+    if (unpacker_.size()) {
+      nvtxRangePush("HostRecver::unpack");
+      unpacker_.unpack();
+      nvtxRangePop(); // HostRecver::unpack
+    }
+    state_ = State::Unpacked;
+  }
+
+  void wait() override {
+    assert(State::Unpacked == state_);
+    state_ = State::None;
+  }
+
+  // unpacking is synchronous
+  bool done() override { return State::Unpacked == state_; }
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <mpi.h>
+
+#include "stencil/local_domain.cuh"
+#include "stencil/packer.cuh"
+#include "stencil/rcstream.hpp"
+#include "stencil/tx_common.hpp"
+
+/* tag of the one message between a pair of ranks.
+   DistributedDomain::rebalance() also sends MsgKind::Other, with an ipc_tag_payload() and no direction, so this tag
+   sets the direction bits, which keeps the two apart whatever the payload.
+ */
+inline int rank_tag() { return make_tag<MsgKind::Other>(0, Dim3(1, 1, 1)); }
+
+/*! Send every message from this rank's domains to the domains of one other rank as a single MPI message.
+
+    The outbox is all remote messages to `dstRank`. Messages are grouped by (srcGPU_, dstGPU_) into segments, each of
+    which is packed as a RemoteSender would, and copied to its offset in one host buffer. RankRecver groups its inbox
+    the same way, so the segments line up.
+
+    Segments are packed back-to-back, so their offsets depend on the active quantity set.
+
+    Idle -> D2H: pack and copy each segment to the host buffer
+    D2H -> Wait: start the MPI send
+*/
+class RankSender : public StatefulSender {
+private:
+  struct Segment {
+    LocalDomain *domain;
+    RcStream *stream; // nullptr for a domain in host memory
+    Packer *packer;
+    int64_t offset; // into hostBuf_, for the quantity set being sent
+  };
+
+  int srcRank_;
+  int dstRank_;
+
+  std::vector<LocalDomain> *domains_;
+
+  std::vector<Segment> segments_;
+  int64_t size_;
+  char *hostBuf_;
+  bool host_; // domains are in host memory
+
+  std::vector<MPI_Request> reqs_; // one persistent send per quantity set
+  size_t set_;                    // quantity set of the send in flight
+
+  enum class State { Idle, D2H, Wait };
+  State state_;
+
+public:
+  RankSender(int srcRank, int dstRank, std::vector<LocalDomain> &domains);
+  ~RankSender();
+
+  RankSender(const RankSender &) = delete;
+  RankSender &operator=(const RankSender &) = delete;
+
+  void start_prepare(const std::vector<Message> &outbox) override;
+  void finish_prepare() override {
+    // no-op
+  }
+
+  void send() override;
+  bool active() override { return State::Wait != state_; }
+  bool next_ready() override;
+  void next() override;
+  void wait() override;
+
+  // number of bytes in the aggregated message of all quantities
+  int64_t size() const noexcept { return size_; }
+};
+
+/*! Recv the single message from RankSender on `srcRank`, and unpack each segment into its domain.
+
+    None -> H2H: start the MPI recv
+    H2H -> H2D: copy each segment out of the host buffer and unpack it
+*/
+class RankRecver : public StatefulRecver {
+private:
+  struct Segment {
+    LocalDomain *domain;
+    RcStream *stream; // nullptr for a domain in host memory
+    Unpacker *unpacker;
+    int64_t offset; // into hostBuf_, for the quantity set being received
+  };
+
+  int srcRank_;
+  int dstRank_;
+
+  std::vector<LocalDomain> *domains_;
+
+  std::vector<Segment> segments_;
+  int64_t size_;
+  char *hostBuf_;
+  bool host_;
+
+  MPI_Request req_;
+
+  enum class State { None, H2H, H2D };
+  State state_;
+
+public:
+  RankRecver(int srcRank, int dstRank, std::vector<LocalDomain> &domains);
+  ~RankRecver();
+
+  RankRecver(const RankRecver &) = delete;
+  RankRecver &operator=(const RankRecver &) = delete;
+
+  void start_prepare(const std::vector<Message> &inbox) override;
+  void finish_prepare() override {
+    // no-op
+  }
+
+  void recv() override;
+  bool active() override {
+    assert(State::None != state_);
+    return State::H2D != state_;
+  }
+  bool next_ready() override;
+  void next() override;
+  void wait() override;
+  bool done() override;
+
+  int64_t size() const noexcept { return size_; }
+};
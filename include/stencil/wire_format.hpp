@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __CUDACC__
+#define CUDA_CALLABLE_MEMBER __host__ __device__
+#else
+#define CUDA_CALLABLE_MEMBER
+#endif
+
+/* How a quantity's halo is encoded in inter-rank (MPI) messages. See DistributedDomain::add_data().
+   The quantity keeps its precision in memory: packers for MPI messages between ranks narrow each element, and the
+   unpackers widen it back. Same-rank and colocated-copy exchanges always send the native bytes.
+   Only float and double quantities can have a Kind other than Native.
+*/
+struct WireFormat {
+  enum class Kind {
+    Native,   // the bytes in memory
+    Float,    // a double sent as a float
+    Bfloat16, // a float or double sent as the upper 16 bits of a float (8 exponent bits, 7 mantissa bits)
+    Fixed16   // a float or double v sent as the int16 round(v / scale), clamped to +/- 32767. NaN is kFixed16NaN
+  };
+
+  // the Fixed16 code for NaN, which no clamped value takes
+  static constexpr int16_t kFixed16NaN = -32768;
+
+  Kind kind;
+  double scale; // for Fixed16, the value of one step
+
+  static WireFormat native() { return WireFormat{Kind::Native, 0}; }
+  static WireFormat float32() { return WireFormat{Kind::Float, 0}; }
+  static WireFormat bfloat16() { return WireFormat{Kind::Bfloat16, 0}; }
+  static WireFormat fixed16(double scale) { return WireFormat{Kind::Fixed16, scale}; }
+
+  /* bytes of one element on the wire, for a quantity with `elemSize` bytes in memory
+   */
+  CUDA_CALLABLE_MEMBER size_t wire_size(const size_t elemSize) const {
+    switch (kind) {
+    case Kind::Float:
+      return 4;
+    case Kind::Bfloat16:
+    case Kind::Fixed16:
+      return 2;
+    default:
+      return elemSize;
+    }
+  }
+
+  /* convert the element at `src` (`elemSize` bytes, float or double unless Native) to its wire form at `dst`
+   */
+  CUDA_CALLABLE_MEMBER void encode(void *dst, const void *src, const size_t elemSize) const {
+    if (Kind::Native == kind) {
+      memcpy(dst, src, elemSize);
+      return;
+    }
+    double v;
+    if (8 == elemSize) {
+      memcpy(&v, src, 8);
+    } else {
+      float f;
+      memcpy(&f, src, 4);
+      v = f;
+    }
+
+    if (Kind::Float == kind) {
+      const float f = float(v);
+      memcpy(dst, &f, 4);
+    } else if (Kind::Bfloat16 == kind) {
+      const float f = float(v);
+      uint32_t u;
+      memcpy(&u, &f, 4);
+      uint16_t h;
+      if ((u & 0x7fffffffu) > 0x7f800000u) {
+        h = uint16_t((u >> 16) | 0x40); // keep NaN a (quiet) NaN
+      } else {
+        h = uint16_t((u + 0x7fffu + ((u >> 16) & 1)) >> 16); // round to nearest even
+      }
+      memcpy(dst, &h, 2);
+    } else { // Fixed16
+      int16_t i;
+      if (v != v) { // NaN fails both clamps, and converting it is undefined
+        i = kFixed16NaN;
+      } else {
+        double q = floor(v / scale + 0.5);
+        q = q > 32767 ? 32767 : (q < -32767 ? -32767 : q);
+        i = int16_t(q);
+      }
+      memcpy(dst, &i, 2);
+    }
+  }
+
+  /* convert the wire form at `src` back to an element of `elemSize` bytes at `dst`
+   */
+  CUDA_CALLABLE_MEMBER void decode(void *dst, const void *src, const size_t elemSize) const {
+    if (Kind::Native == kind) {
+      memcpy(dst, src, elemSize);
+      return;
+    }
+    double v;
+    if (Kind::Float == kind) {
+      float f;
+      memcpy(&f, src, 4);
+      v = f;
+    } else if (Kind::Bfloat16 == kind) {
+      uint16_t h;
+      memcpy(&h, src, 2);
+      const uint32_t u = uint32_t(h) << 16;
+      float f;
+      memcpy(&f, &u, 4);
+      v = f;
+    } else { // Fixed16
+      int16_t i;
+      memcpy(&i, src, 2);
+      if (kFixed16NaN == i) {
+        const uint64_t u = 0x7ff8000000000000ull; // quiet NaN
+        memcpy(&v, &u, 8);
+      } else {
+        v = i * scale;
+      }
+    }
+
+    if (8 == elemSize) {
+      memcpy(dst, &v, 8);
+    } else {
+      const float f = float(v);
+      memcpy(dst, &f, 4);
+    }
+  }
+};
@@ -0,0 +1,174 @@
+#include "stencil/cuda_runtime.hpp"
+#include "stencil/gpu_topology.hpp"
+#include "stencil/logging.hpp"
+#include "stencil/mpi.hpp"
+#include "stencil/partition.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+#include <vector>
+
+namespace {
+
+// a small message for the latency, and a large one for the bandwidth
+const size_t SMALL_BYTES = 8;
+const size_t LARGE_BYTES = 16 * 1024 * 1024;
+const int ITERS = 10;
+
+/* seconds for one cudaMemcpyPeerAsync of `bytes` from `src` on `srcDev` to `dst` on `dstDev`
+ */
+double time_memcpy_peer(void *dst, int dstDev, const void *src, int srcDev, size_t bytes, cudaStream_t stream,
+                        cudaEvent_t start, cudaEvent_t stop) {
+  CUDA_RUNTIME(cudaMemcpyPeerAsync(dst, dstDev, src, srcDev, bytes, stream)); // warmup
+  CUDA_RUNTIME(cudaEventRecord(start, stream));
+  for (int i = 0; i < ITERS; ++i) {
+    CUDA_RUNTIME(cudaMemcpyPeerAsync(dst, dstDev, src, srcDev, bytes, stream));
+  }
+  CUDA_RUNTIME(cudaEventRecord(stop, stream));
+  CUDA_RUNTIME(cudaEventSynchronize(stop));
+  float ms;
+  CUDA_RUNTIME(cudaEventElapsedTime(&ms, start, stop));
+  return double(ms) / 1e3 / ITERS;
+}
+
+/* seconds for a one-way message of `bytes` between ranks `a` and `b` of `comm`, from a ping-pong.
+   Only `a` and `b` call this
+*/
+double time_ping_pong(MPI_Comm comm, int a, int b, std::vector<char> &buf, size_t bytes) {
+  const int rank = mpi::comm_rank(comm);
+  const int other = rank == a ? b : a;
+  double start = 0;
+  for (int i = -1; i < ITERS; ++i) { // first is warmup
+    if (0 == i) {
+      start = MPI_Wtime();
+    }
+    if (rank == a) {
+      MPI_Send(buf.data(), bytes, MPI_BYTE, other, 0, comm);
+      MPI_Recv(buf.data(), bytes, MPI_BYTE, other, 0, comm, MPI_STATUS_IGNORE);
+    } else {
+      MPI_Recv(buf.data(), bytes, MPI_BYTE, other, 0, comm, MPI_STATUS_IGNORE);
+      MPI_Send(buf.data(), bytes, MPI_BYTE, other, 0, comm);
+    }
+  }
+  return (MPI_Wtime() - start) / ITERS / 2;
+}
+
+/* latency is the small-message time, and bandwidth is the large-message rate without the latency
+ */
+void fit(double tSmall, double tLarge, double &bandwidth, double &latency) {
+  latency = tSmall;
+  bandwidth = double(LARGE_BYTES) / std::max(tLarge - tSmall, 1e-9);
+}
+
+} // namespace
+
+void JobLayout::calibrate() {
+  const int rank = mpi::world_rank();
+  const std::vector<std::vector<int>> nodeRanks = node_ranks();
+  const int numNodes = nodeRanks.size();
+
+  // the first rank in each node measures for the node
+  int node = 0;
+  for (; node < numNodes; ++node) {
+    if (std::find(nodeRanks[node].begin(), nodeRanks[node].end(), rank) != nodeRanks[node].end()) {
+      break;
+    }
+  }
+  const bool leader = nodeRanks[node][0] == rank;
+
+  /* between CUDA devices in each node
+   */
+  int numDevs = 0;
+  for (const auto &ids : cudaIds) {
+    for (int id : ids) {
+      numDevs = std::max(numDevs, id + 1);
+    }
+  }
+  Mat2D<double> bw(numDevs, numDevs, 0.0), lat(numDevs, numDevs, 0.0), count(numDevs, numDevs, 0.0);
+  if (leader) {
+    std::set<int> devs;
+    for (int r : nodeRanks[node]) {
+      devs.insert(cudaIds[r].begin(), cudaIds[r].end());
+    }
+    for (int src : devs) {
+      for (int dst : devs) {
+        gpu_topo::enable_peer(src, dst);
+        void *srcBuf, *dstBuf;
+        cudaStream_t stream;
+        cudaEvent_t start, stop;
+        CUDA_RUNTIME(cudaSetDevice(dst));
+        CUDA_RUNTIME(cudaMalloc(&dstBuf, LARGE_BYTES));
+        CUDA_RUNTIME(cudaSetDevice(src));
+        CUDA_RUNTIME(cudaMalloc(&srcBuf, LARGE_BYTES));
+        CUDA_RUNTIME(cudaStreamCreate(&stream));
+        CUDA_RUNTIME(cudaEventCreate(&start));
+        CUDA_RUNTIME(cudaEventCreate(&stop));
+
+        const double tSmall = time_memcpy_peer(dstBuf, dst, srcBuf, src, SMALL_BYTES, stream, start, stop);
+        const double tLarge = time_memcpy_peer(dstBuf, dst, srcBuf, src, LARGE_BYTES, stream, start, stop);
+        fit(tSmall, tLarge, bw.at(src, dst), lat.at(src, dst));
+        count.at(src, dst) = 1;
+        LOG_DEBUG("calibrate: cuda " << src << " -> " << dst << " " << bw.at(src, dst) / 1e9 << " GB/s, "
+                                     << lat.at(src, dst) * 1e6 << " us");
+
+        CUDA_RUNTIME(cudaEventDestroy(start));
+        CUDA_RUNTIME(cudaEventDestroy(stop));
+        CUDA_RUNTIME(cudaStreamDestroy(stream));
+        CUDA_RUNTIME(cudaFree(srcBuf));
+        CUDA_RUNTIME(cudaSetDevice(dst));
+        CUDA_RUNTIME(cudaFree(dstBuf));
+      }
+    }
+  }
+  // average each pair over the nodes that measured it
+  MPI_Allreduce(MPI_IN_PLACE, bw.data(), bw.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, lat.data(), lat.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, count.data(), count.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  for (int i = 0; i < numDevs; ++i) {
+    for (int j = 0; j < numDevs; ++j) {
+      if (count.at(i, j) > 0) {
+        bw.at(i, j) /= count.at(i, j);
+        lat.at(i, j) /= count.at(i, j);
+      }
+    }
+  }
+  bandwidth = [bw](int src, int dst) { return bw.at(src, dst); };
+  latency = [lat](int src, int dst) { return lat.at(src, dst); };
+
+  /* between nodes, with MPI in host memory between the first rank of each node.
+     Pairs are measured one after another in the same order on every node, so they don't compete for the network
+  */
+  nodeBandwidth = Mat2D<double>(numNodes, numNodes, 0.0);
+  nodeLatency = Mat2D<double>(numNodes, numNodes, 0.0);
+  MPI_Comm leaders;
+  MPI_Comm_split(MPI_COMM_WORLD, leader ? 0 : MPI_UNDEFINED, rank, &leaders);
+  if (leader) {
+    // leaders are ordered by rank, like node_ranks()
+    const int me = mpi::comm_rank(leaders);
+    assert(me == node);
+    std::vector<char> buf(LARGE_BYTES);
+    for (int a = 0; a < numNodes; ++a) {
+      for (int b = a + 1; b < numNodes; ++b) {
+        if (me == a || me == b) {
+          const double tSmall = time_ping_pong(leaders, a, b, buf, SMALL_BYTES);
+          const double tLarge = time_ping_pong(leaders, a, b, buf, LARGE_BYTES);
+          if (me == a) {
+            fit(tSmall, tLarge, nodeBandwidth.at(a, b), nodeLatency.at(a, b));
+            nodeBandwidth.at(b, a) = nodeBandwidth.at(a, b);
+            nodeLatency.at(b, a) = nodeLatency.at(a, b);
+            LOG_DEBUG("calibrate: node " << a << " <-> " << b << " " << nodeBandwidth.at(a, b) / 1e9 << " GB/s, "
+                                         << nodeLatency.at(a, b) * 1e6 << " us");
+          }
+        }
+      }
+    }
+    MPI_Comm_free(&leaders);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, nodeBandwidth.data(), nodeBandwidth.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, nodeLatency.data(), nodeLatency.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+  if (0 == rank) {
+    LOG_INFO("calibrate: measured " << numDevs << " devices and " << numNodes << " nodes");
+  }
+}
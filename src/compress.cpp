@@ -0,0 +1,353 @@
+#include "stencil/compress.hpp"
+
+#include "stencil/logging.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <future>
+
+namespace compress {
+
+namespace {
+
+const size_t kMinMatch = 4;
+const size_t kMaxOffset = 65535;
+const int kHashLog = 14;
+
+inline uint32_t read32(const unsigned char *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t hash32(uint32_t v) { return (v * 2654435761u) >> (32 - kHashLog); }
+
+/* the part of a length past the 15 in its token, as 255s and a final byte < 255
+ */
+bool put_len(unsigned char *&op, const unsigned char *oend, size_t len) {
+  for (; len >= 255; len -= 255) {
+    if (op == oend) {
+      return false;
+    }
+    *op++ = 255;
+  }
+  if (op == oend) {
+    return false;
+  }
+  *op++ = (unsigned char)len;
+  return true;
+}
+
+bool get_len(const unsigned char *&ip, const unsigned char *iend, size_t &len) {
+  unsigned char b;
+  do {
+    if (ip == iend) {
+      return false;
+    }
+    b = *ip++;
+    len += b;
+  } while (255 == b);
+  return true;
+}
+
+/* `litLen` literals, then a match of `matchLen` bytes `offset` back (none for the last sequence, matchLen = 0)
+ */
+bool put_sequence(unsigned char *&op, const unsigned char *oend, const unsigned char *lit, size_t litLen,
+                  size_t offset, size_t matchLen) {
+  if (op == oend) {
+    return false;
+  }
+  unsigned char *token = op++;
+  unsigned char t = (unsigned char)(std::min(litLen, size_t(15)) << 4);
+  if (litLen >= 15 && !put_len(op, oend, litLen - 15)) {
+    return false;
+  }
+  if (size_t(oend - op) < litLen) {
+    return false;
+  }
+  std::memcpy(op, lit, litLen);
+  op += litLen;
+  if (matchLen) {
+    if (oend - op < 2) {
+      return false;
+    }
+    *op++ = (unsigned char)(offset & 0xFF);
+    *op++ = (unsigned char)(offset >> 8);
+    const size_t m = matchLen - kMinMatch;
+    t |= (unsigned char)std::min(m, size_t(15));
+    if (m >= 15 && !put_len(op, oend, m - 15)) {
+      return false;
+    }
+  }
+  *token = t;
+  return true;
+}
+
+} // namespace
+
+size_t lz_compress(void *dst, size_t dstCap, const void *src, size_t n) {
+  const unsigned char *in = static_cast<const unsigned char *>(src);
+  unsigned char *const out = static_cast<unsigned char *>(dst);
+  unsigned char *op = out;
+  const unsigned char *oend = out + dstCap;
+
+  // position + 1 of the last 4 bytes with each hash, 0 for none
+  std::vector<uint32_t> table(size_t(1) << kHashLog, 0);
+
+  size_t anchor = 0; // first byte not yet emitted
+  size_t ip = 0;
+  size_t misses = 0; // step faster through incompressible data
+  while (ip + kMinMatch <= n) {
+    const uint32_t seq = read32(in + ip);
+    const uint32_t h = hash32(seq);
+    const size_t ref = table[h];
+    table[h] = uint32_t(ip + 1);
+    if (ref && ip - (ref - 1) <= kMaxOffset && read32(in + ref - 1) == seq) {
+      const size_t match = ref - 1;
+      size_t len = kMinMatch;
+      while (ip + len < n && in[match + len] == in[ip + len]) {
+        ++len;
+      }
+      if (!put_sequence(op, oend, in + anchor, ip - anchor, ip - match, len)) {
+        return 0;
+      }
+      ip += len;
+      anchor = ip;
+      misses = 0;
+    } else {
+      ip += 1 + (misses++ >> 6);
+    }
+  }
+  if (!put_sequence(op, oend, in + anchor, n - anchor, 0, 0)) {
+    return 0;
+  }
+  return op - out;
+}
+
+bool lz_decompress(void *dst, size_t n, const void *src, size_t srcSize) {
+  const unsigned char *ip = static_cast<const unsigned char *>(src);
+  const unsigned char *iend = ip + srcSize;
+  unsigned char *const out = static_cast<unsigned char *>(dst);
+  unsigned char *op = out;
+  unsigned char *const oend = out + n;
+
+  while (true) {
+    if (ip == iend) {
+      return false;
+    }
+    const unsigned char t = *ip++;
+    size_t lit = t >> 4;
+    if (15 == lit && !get_len(ip, iend, lit)) {
+      return false;
+    }
+    if (size_t(iend - ip) < lit || size_t(oend - op) < lit) {
+      return false;
+    }
+    std::memcpy(op, ip, lit);
+    op += lit;
+    ip += lit;
+    if (op == oend) { // the last sequence has no match
+      return ip == iend;
+    }
+
+    if (iend - ip < 2) {
+      return false;
+    }
+    const size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+    ip += 2;
+    size_t m = t & 0xF;
+    if (15 == m && !get_len(ip, iend, m)) {
+      return false;
+    }
+    m += kMinMatch;
+    if (0 == offset || offset > size_t(op - out) || size_t(oend - op) < m) {
+      return false;
+    }
+    const unsigned char *match = op - offset;
+    if (offset >= m) {
+      std::memcpy(op, match, m);
+    } else { // overlapping, e.g. a run
+      for (size_t i = 0; i < m; ++i) {
+        op[i] = match[i];
+      }
+    }
+    op += m;
+  }
+}
+
+void xor_bytes(void *dst, const void *a, const void *b, size_t n) {
+  unsigned char *d = static_cast<unsigned char *>(dst);
+  const unsigned char *pa = static_cast<const unsigned char *>(a);
+  const unsigned char *pb = static_cast<const unsigned char *>(b);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t x, y;
+    std::memcpy(&x, pa + i, 8);
+    std::memcpy(&y, pb + i, 8);
+    x ^= y;
+    std::memcpy(d + i, &x, 8);
+  }
+  for (; i < n; ++i) {
+    d[i] = pa[i] ^ pb[i];
+  }
+}
+
+} // namespace compress
+
+namespace {
+
+struct FrameHeader {
+  uint32_t kind;
+  uint32_t numChunks;
+};
+
+// a chunk stored without LZ, because it did not shrink
+const uint32_t kStored = uint32_t(1) << 31;
+
+// chunk `i` of `k` covers [lo, hi) of an `n`-byte message
+inline size_t chunk_lo(size_t i, size_t k, size_t n) { return n / k * i + std::min(i, n % k); }
+
+/* run f(0) ... f(k-1): f(0) on the calling thread and the others on their own
+ */
+template <typename F> void parallel_for(size_t k, F f) {
+  std::vector<std::future<void>> futures;
+  for (size_t i = 1; i < k; ++i) {
+    futures.push_back(std::async(std::launch::async, f, i));
+  }
+  if (k) {
+    f(0);
+  }
+  for (auto &fut : futures) {
+    fut.get();
+  }
+}
+
+} // namespace
+
+constexpr size_t HaloCodec::kMaxChunks;
+constexpr size_t HaloCodec::kMinChunk;
+constexpr uint64_t HaloCodec::kProbeInterval;
+
+HaloCodec::HaloCodec(const CompressConfig &config)
+    : threads_(std::max(config.threads, 1)), linkBandwidth_(config.linkBandwidth), compress_(true), numRaw_(0),
+      ratio_(0) {}
+
+size_t HaloCodec::max_frame_size(size_t n) { return sizeof(FrameHeader) + kMaxChunks * sizeof(uint32_t) + n; }
+
+std::vector<unsigned char> &HaloCodec::prev(size_t set, size_t n) {
+  if (set >= prev_.size()) {
+    prev_.resize(set + 1);
+  }
+  if (prev_[set].size() != n) {
+    prev_[set].assign(n, 0);
+  }
+  return prev_[set];
+}
+
+size_t HaloCodec::encode(void *dst, const void *src, size_t n, size_t set) {
+  unsigned char *out = static_cast<unsigned char *>(dst);
+  // the first message has no history to delta against, so it says little about the ones after it
+  const bool first = set >= prev_.size() || prev_[set].size() != n;
+  std::vector<unsigned char> &last = prev(set, n);
+  FrameHeader hdr;
+
+  if (!compressing()) {
+    ++numRaw_;
+    hdr.kind = uint32_t(Kind::Raw);
+    hdr.numChunks = 0;
+    std::memcpy(out, &hdr, sizeof(hdr));
+    std::memcpy(out + sizeof(hdr), src, n);
+    std::memcpy(last.data(), src, n);
+    return sizeof(hdr) + n;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  delta_.resize(n);
+  compress::xor_bytes(delta_.data(), src, last.data(), n);
+
+  const size_t k = std::max(size_t(1), std::min(std::min(n / kMinChunk, size_t(threads_)), kMaxChunks));
+  hdr.kind = uint32_t(Kind::Delta);
+  hdr.numChunks = uint32_t(k);
+  std::memcpy(out, &hdr, sizeof(hdr));
+  uint32_t *chunkBytes = reinterpret_cast<uint32_t *>(out + sizeof(hdr));
+  unsigned char *payload = out + sizeof(hdr) + k * sizeof(uint32_t);
+
+  // each chunk is compressed in place of its raw bytes, and then moved down
+  std::vector<uint32_t> sizes(k);
+  parallel_for(k, [&](size_t i) {
+    const size_t lo = chunk_lo(i, k, n);
+    const size_t hi = chunk_lo(i + 1, k, n);
+    size_t c = compress::lz_compress(payload + lo, hi - lo, delta_.data() + lo, hi - lo);
+    if (0 == c) {
+      std::memcpy(payload + lo, delta_.data() + lo, hi - lo);
+      sizes[i] = uint32_t(hi - lo) | kStored;
+    } else {
+      sizes[i] = uint32_t(c);
+    }
+  });
+  size_t wire = 0;
+  for (size_t i = 0; i < k; ++i) {
+    const size_t bytes = sizes[i] & ~kStored;
+    std::memmove(payload + wire, payload + chunk_lo(i, k, n), bytes);
+    std::memcpy(&chunkBytes[i], &sizes[i], sizeof(uint32_t));
+    wire += bytes;
+  }
+  wire += payload - out;
+  std::memcpy(last.data(), src, n);
+  numRaw_ = 0;
+  if (first) {
+    return wire;
+  }
+
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const bool worthIt = 2 * elapsed + wire / linkBandwidth_ < n / linkBandwidth_;
+  ratio_ = double(n) / wire;
+  if (worthIt != compress_) {
+    LOG_DEBUG("HaloCodec: " << n << "B compressed " << ratio_ << "x in " << elapsed << "s, "
+                            << (worthIt ? "compressing" : "sending raw"));
+  }
+  compress_ = worthIt;
+  return wire;
+}
+
+void HaloCodec::decode(void *dst, size_t n, const void *src, size_t set) {
+  unsigned char *out = static_cast<unsigned char *>(dst);
+  const unsigned char *in = static_cast<const unsigned char *>(src);
+  std::vector<unsigned char> &last = prev(set, n);
+  FrameHeader hdr;
+  std::memcpy(&hdr, in, sizeof(hdr));
+
+  if (uint32_t(Kind::Raw) == hdr.kind) {
+    std::memcpy(out, in + sizeof(hdr), n);
+  } else if (uint32_t(Kind::Delta) == hdr.kind) {
+    const size_t k = hdr.numChunks;
+    if (0 == k || k > kMaxChunks) {
+      LOG_FATAL("HaloCodec: frame has " << k << " chunks");
+    }
+    std::vector<uint32_t> sizes(k);
+    std::memcpy(sizes.data(), in + sizeof(hdr), k * sizeof(uint32_t));
+    std::vector<size_t> offsets(k, 0);
+    for (size_t i = 1; i < k; ++i) {
+      offsets[i] = offsets[i - 1] + (sizes[i - 1] & ~kStored);
+    }
+    const unsigned char *payload = in + sizeof(hdr) + k * sizeof(uint32_t);
+
+    parallel_for(k, [&](size_t i) {
+      const size_t lo = chunk_lo(i, k, n);
+      const size_t hi = chunk_lo(i + 1, k, n);
+      if (sizes[i] & kStored) {
+        assert((sizes[i] & ~kStored) == hi - lo);
+        std::memcpy(out + lo, payload + offsets[i], hi - lo);
+      } else if (!compress::lz_decompress(out + lo, hi - lo, payload + offsets[i], sizes[i])) {
+        LOG_FATAL("HaloCodec: chunk " << i << " of a " << n << "B message is malformed");
+      }
+    });
+    compress::xor_bytes(out, out, last.data(), n);
+  } else {
+    LOG_FATAL("HaloCodec: unknown frame kind " << hdr.kind);
+  }
+  std::memcpy(last.data(), out, n);
+}
@@ -0,0 +1,198 @@
+#include "stencil/exchange_plan.hpp"
+
+#include "stencil/local_domain.cuh"
+#include "stencil/logging.hpp"
+
+ExchangePlan plan_exchange(Placement &placement, const Topology &topology, const Radius &radius, Method methods,
+                           int rank, size_t numDomains, const std::function<bool(int, int)> &peer,
+                           const std::function<bool(int)> &colocated, int axis,
+                           const std::function<Method(const Dim3 &dstIdx, const Dim3 &dir)> &messageMethods) {
+
+  ExchangePlan plan;
+  plan.resize(numDomains);
+
+  // outbox for same-GPU exchanges
+  std::vector<Message> &peerAccessOutbox = plan.peerAccessOutbox;
+
+  // outboxes for same-rank exchanges
+  std::vector<std::vector<std::vector<Message>>> &peerCopyOutboxes = plan.peerCopyOutboxes;
+  // peerCopyOutboxes[di][dj] = peer copy from di to dj
+
+  // outbox for co-located domains in different ranks
+  // one outbox for each co-located domain
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloOutboxes = plan.coloOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloInboxes = plan.coloInboxes;
+  // coloOutboxes[di][dstRank] = messages
+
+  // inbox for each remote domain my domains recv from
+  // remoteInboxes[domain][srcIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteInboxes = plan.remoteInboxes;
+  // outbox for each remote domain my domains send to
+  // remoteOutboxes[domain][dstIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteOutboxes = plan.remoteOutboxes;
+
+  const Method coloMethods = Method::ColoPackMemcpyUnpack | Method::ColoQuantityKernel | Method::ColoRegionKernel |
+                             Method::ColoMemcpy3d | Method::ColoDomainKernel;
+
+  /*
+  For each direction, look up where the destination device is and decide which
+  communication method to use. We do not create a message where the message
+  size would be zero
+  */
+  for (size_t di = 0; di < numDomains; ++di) {
+    const Dim3 myIdx = placement.get_idx(rank, di);
+    const int myDev = placement.get_cuda(myIdx);
+    const Dim3 mySize = placement.subdomain_size(myIdx);
+    for (int z = -1; z <= 1; ++z) {
+      for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+          // send direction
+          const Dim3 dir(x, y, z);
+          if (Dim3(0, 0, 0) == dir) {
+            continue; // no message
+          }
+          if (axis >= 0 && axis != LocalDomain::face_axis(dir)) {
+            continue; // sent in another round, or carried by the face messages
+          }
+
+          // Only do sends when the stencil radius in the opposite
+          // direction is non-zero for example, if +x radius is 2, our -x
+          // neighbor needs a halo region from us, so we need to plan to send
+          // in that direction
+          if (0 == radius.dir(dir * -1)) {
+            continue; // no sends or recvs for this dir
+          } else {
+            LOG_DEBUG(dir << " radius = " << radius.dir(dir * -1));
+          }
+
+          // nothing to send across an open boundary, but there may still be something to recv from -dir
+          const Topology::OptionalNeighbor dstNbr = topology.get_neighbor(myIdx, dir);
+          if (dstNbr.exists) {
+            const Dim3 dstIdx = dstNbr.index;
+            const int dstRank = placement.get_rank(dstIdx);
+            const int dstGPU = placement.get_subdomain_id(dstIdx);
+            const int dstDev = placement.get_cuda(dstIdx);
+            // size of our send is the size of the recieving neighbor's halo in -dir
+            const Dim3 dstSize = placement.subdomain_size(dstIdx);
+            const Dim3 sExt = LocalDomain::halo_extent(dir * -1, dstSize, radius, axis >= 0);
+            Message sMsg(dir, di, dstGPU, sExt);
+            const Method sMethods = messageMethods ? messageMethods(dstIdx, dir) : methods;
+
+            // TODO: this method can be removed, in place of the peer access method
+            if (sMethods && Method::CudaKernel) {
+              if (dstRank == rank && myDev == dstDev) {
+                peerAccessOutbox.push_back(sMsg);
+                goto send_planned;
+              }
+            }
+            if (sMethods && Method::CudaMemcpyPeer) {
+              LOG_DEBUG("peer " << rank << " " << dstRank << " peer(" << myDev << "," << dstDev
+                                << ")=" << peer(myDev, dstDev));
+              if (dstRank == rank && peer(myDev, dstDev)) {
+                peerCopyOutboxes[di][dstGPU].push_back(sMsg);
+                goto send_planned;
+              }
+            }
+            /*
+            FIXME: for now, we require that all GPUs be visible to all colocated ranks.
+            This is used to detect the GPU distance.
+            Ultimately, we'd like to be able to figure this out even in the presence of CUDA_VISIBLE_DEVICES making each
+            rank have a different CUDA device 0 Then, we could restrict CPU code to run on CPUs nearby to the GPU
+            */
+            if (sMethods && coloMethods) {
+              if ((dstRank != rank) && colocated(dstRank) && peer(myDev, dstDev)) {
+                assert(di < coloOutboxes.size());
+                coloOutboxes[di].emplace(dstIdx, std::vector<Message>());
+                coloOutboxes[di][dstIdx].push_back(sMsg);
+                LOG_DEBUG("Plan send <colocated> for Mesage dir=" << sMsg.dir_);
+                goto send_planned;
+              }
+            }
+            // with HostMpi, nothing above matches and everything goes over MPI, even within a rank
+            if (sMethods && (Method::CudaMpi | Method::HostMpi)) {
+              assert(di < remoteOutboxes.size());
+              remoteOutboxes[di][dstIdx].push_back(sMsg);
+              LOG_DEBUG("Plan send <remote> "
+                        << myIdx << " (r" << rank << "d" << di << "g" << myDev << ")"
+                        << " -> " << dstIdx << " (r" << dstRank << "d" << dstGPU << "g" << dstDev << ")"
+                        << " (dir=" << dir << ", rad" << dir * -1 << "=" << radius.dir(dir * -1) << ")");
+              goto send_planned;
+            }
+            LOG_FATAL("No method available to send required message " << sMsg.dir_ << "\n");
+          }
+        send_planned: // successfully found a way to send
+
+          const Topology::OptionalNeighbor srcNbr = topology.get_neighbor(myIdx, dir * -1);
+          if (!srcNbr.exists) {
+            continue;
+          }
+          const Dim3 srcIdx = srcNbr.index;
+          const int srcRank = placement.get_rank(srcIdx);
+          const int srcGPU = placement.get_subdomain_id(srcIdx);
+          const int srcDev = placement.get_cuda(srcIdx);
+          // size of our recv is the size of our halo in -dir
+          const Dim3 rExt = LocalDomain::halo_extent(dir * -1, mySize, radius, axis >= 0);
+          Message rMsg(dir, srcGPU, di, rExt);
+          // the sender planned this message with the methods for (myIdx, dir)
+          const Method rMethods = messageMethods ? messageMethods(myIdx, dir) : methods;
+
+          if (rMethods && Method::CudaKernel) {
+            if (srcRank == rank && srcDev == myDev) {
+              // no recver needed
+              goto recv_planned;
+            }
+          }
+          if (rMethods && Method::CudaMemcpyPeer) {
+            if (srcRank == rank && peer(srcDev, myDev)) {
+              // no recver needed
+              goto recv_planned;
+            }
+          }
+          if (rMethods && coloMethods) {
+            if ((srcRank != rank) && colocated(srcRank) && peer(srcDev, myDev)) {
+              assert(di < coloInboxes.size());
+              coloInboxes[di].emplace(srcIdx, std::vector<Message>());
+              coloInboxes[di][srcIdx].push_back(rMsg);
+              LOG_SPEW("Plan recv <colo> " << srcIdx << "->" << myIdx << " (dir=" << dir << "): r" << dir * -1 << "="
+                                           << radius.dir(dir * -1));
+              goto recv_planned;
+            }
+          }
+          if (rMethods && (Method::CudaMpi | Method::HostMpi)) {
+            assert(di < remoteInboxes.size());
+            remoteInboxes[di].emplace(srcIdx, std::vector<Message>());
+            remoteInboxes[di][srcIdx].push_back(rMsg);
+            LOG_SPEW("Plan recv <remote> " << srcIdx << "->" << myIdx << " (dir=" << dir << "): r" << dir * -1 << "="
+                                           << radius.dir(dir * -1));
+            goto recv_planned;
+          }
+          LOG_FATAL("No method available to recv required message");
+        recv_planned: // found a way to recv
+          (void)0;
+        }
+      }
+    }
+  }
+
+  return plan;
+}
+
+bool prefer_phased(const Dim3 &sz, const Radius &radius, size_t bytesPerCell, size_t latencyBytes) {
+  bool diagonal = false; // any edge or corner messages to save
+  for (int z = -1; z <= 1; ++z) {
+    for (int y = -1; y <= 1; ++y) {
+      for (int x = -1; x <= 1; ++x) {
+        const Dim3 dir(x, y, z);
+        if (Dim3(0, 0, 0) == dir || LocalDomain::face_axis(dir) >= 0 || 0 == radius.dir(dir)) {
+          continue;
+        }
+        diagonal = true;
+        const size_t bytes = LocalDomain::halo_extent(dir, sz, radius).flatten() * bytesPerCell;
+        if (bytes >= latencyBytes) {
+          return false;
+        }
+      }
+    }
+  }
+  return diagonal;
+}
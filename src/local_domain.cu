@@ -2,33 +2,98 @@
 
 #include <nvToolsExt.h>
 
-LocalDomain::LocalDomain(Dim3 sz, Dim3 origin, int dev)
-    : sz_(sz), origin_(origin), dev_(dev), devCurrDataPtrs_(nullptr), devNextDataPtrs_(nullptr),
-      devDataElemSize_(nullptr) {}
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+/* Host memory for a LocalDomain, aligned to a cache line.
+   Pages are placed on the NUMA node of the thread that first touches them, so zero the allocation here in the rank
+   that will compute on it. With ranks bound to NUMA nodes, each rank's domains end up in its local memory.
+*/
+static void *host_alloc(size_t bytes) {
+  void *p = nullptr;
+  if (0 != posix_memalign(&p, 64, bytes)) {
+    LOG_FATAL("unable to allocate " << bytes << "B of host memory");
+  }
+  std::memset(p, 0, bytes);
+  return p;
+}
+
+LocalDomain::LocalDomain(Dim3 sz, Dim3 origin, int dev, bool host)
+    : sz_(sz), origin_(origin), phased_(false), devCurrDataPtrs_(nullptr), devNextDataPtrs_(nullptr),
+      devDataElemSize_(nullptr), devWireFormats_(nullptr), quantitySets_(1), activeQuantitySet_(0), dev_(dev),
+      host_(host) {}
+
+LocalDomain::~LocalDomain() { release(); }
+
+void LocalDomain::release() {
+  if (host_) {
+    for (auto &p : currDataPtrs_) {
+      std::free(p.ptr);
+      p = {};
+    }
+    for (auto &p : nextDataPtrs_) {
+      std::free(p.ptr);
+      p = {};
+    }
+    delete[] devCurrDataPtrs_;
+    delete[] devNextDataPtrs_;
+    delete[] devDataElemSize_;
+    delete[] devWireFormats_;
+    devCurrDataPtrs_ = nullptr;
+    devNextDataPtrs_ = nullptr;
+    devDataElemSize_ = nullptr;
+    devWireFormats_ = nullptr;
+    for (int64_t *p : devQuantitySets_) {
+      delete[] p;
+    }
+    devQuantitySets_.clear();
+    return;
+  }
 
-LocalDomain::~LocalDomain() {
   CUDA_RUNTIME(cudaGetLastError());
 
   CUDA_RUNTIME(cudaSetDevice(dev_));
-  for (auto p : currDataPtrs_) {
+  for (auto &p : currDataPtrs_) {
     if (p.ptr)
       CUDA_RUNTIME(cudaFree(p.ptr));
+    p = {};
   }
   if (devCurrDataPtrs_)
     CUDA_RUNTIME(cudaFree(devCurrDataPtrs_));
   if (devNextDataPtrs_)
     CUDA_RUNTIME(cudaFree(devNextDataPtrs_));
+  devCurrDataPtrs_ = nullptr;
+  devNextDataPtrs_ = nullptr;
 
-  for (auto p : nextDataPtrs_) {
+  for (auto &p : nextDataPtrs_) {
     if (p.ptr)
       CUDA_RUNTIME(cudaFree(p.ptr));
+    p = {};
   }
   if (devDataElemSize_)
     CUDA_RUNTIME(cudaFree(devDataElemSize_));
+  devDataElemSize_ = nullptr;
+  if (devWireFormats_)
+    CUDA_RUNTIME(cudaFree(devWireFormats_));
+  devWireFormats_ = nullptr;
+  for (int64_t *p : devQuantitySets_) {
+    CUDA_RUNTIME(cudaFree(p));
+  }
+  devQuantitySets_.clear();
   CUDA_RUNTIME(cudaGetLastError());
 }
 
+void LocalDomain::resize(const Dim3 &sz, const Dim3 &origin) {
+  release();
+  sz_ = sz;
+  origin_ = origin;
+}
+
 void LocalDomain::set_device(CudaErrorsFatal fatal) {
+  if (host_) {
+    return;
+  }
   cudaError_t err = cudaSetDevice(dev_);
   if (CudaErrorsFatal::YES == fatal) {
     CUDA_RUNTIME(err)
@@ -83,7 +148,8 @@ void LocalDomain::swap() noexcept {
   nvtxRangePop();
 }
 
-Dim3 LocalDomain::halo_pos(const Dim3 &dir, const Dim3 &sz, const Radius &radius, const bool halo) noexcept {
+Dim3 LocalDomain::halo_pos(const Dim3 &dir, const Dim3 &sz, const Radius &radius, const bool halo,
+                           const bool phased) noexcept {
   assert(dir.all_gt(-2));
   assert(dir.all_lt(2));
 
@@ -121,11 +187,20 @@ Dim3 LocalDomain::halo_pos(const Dim3 &dir, const Dim3 &sz, const Radius &radius
     LOG_FATAL("unreachable");
   }
 
+  // face halos of later axes start at the edge of the allocation along earlier ones
+  const int axis = phased ? face_axis(dir) : -1;
+  if (axis > 0) {
+    ret.x = 0;
+  }
+  if (axis > 1) {
+    ret.y = 0;
+  }
+
   return ret;
 }
 
 Dim3 LocalDomain::halo_pos(const Dim3 &dir, const bool halo) const noexcept {
-  return halo_pos(dir, sz_, radius_, halo);
+  return halo_pos(dir, sz_, radius_, halo, phased_);
 }
 
 std::vector<unsigned char> LocalDomain::region_to_host(const Dim3 &pos, const Dim3 &ext,
@@ -134,6 +209,12 @@ std::vector<unsigned char> LocalDomain::region_to_host(const Dim3 &pos, const Di
 
   const size_t bytes = elem_size(qi) * ext.flatten();
 
+  if (host_) {
+    std::vector<unsigned char> hostBuf(bytes);
+    host_pack(hostBuf.data(), curr_data(qi), pos, ext, elem_size(qi));
+    return hostBuf;
+  }
+
   // pack quantity into device buffer
   CUDA_RUNTIME(cudaSetDevice(gpu()));
   void *devBuf = nullptr;
@@ -156,14 +237,84 @@ std::vector<unsigned char> LocalDomain::region_to_host(const Dim3 &pos, const Di
   return hostBuf;
 }
 
+void LocalDomain::region_from_host(const Dim3 &pos, const Dim3 &ext,
+                                   const size_t qi, // quantity index
+                                   const std::vector<unsigned char> &buf) {
+  const size_t bytes = elem_size(qi) * ext.flatten();
+  assert(buf.size() == bytes);
+
+  if (host_) {
+    host_unpack(curr_data(qi), buf.data(), pos, ext, elem_size(qi));
+    return;
+  }
+
+  // copy quantity to device buffer
+  CUDA_RUNTIME(cudaSetDevice(gpu()));
+  void *devBuf = nullptr;
+  CUDA_RUNTIME(cudaMalloc(&devBuf, bytes));
+  CUDA_RUNTIME(cudaMemcpy(devBuf, buf.data(), bytes, cudaMemcpyDefault));
+
+  // unpack into the quantity
+  dim3 dimBlock = Dim3::make_block_dim(ext, 512);
+  dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
+  unpack_kernel<<<dimGrid, dimBlock>>>(curr_data(qi), devBuf, pos, ext, elem_size(qi));
+  CUDA_RUNTIME(cudaDeviceSynchronize());
+
+  // free device buffer
+  CUDA_RUNTIME(cudaFree(devBuf));
+}
+
 void LocalDomain::realize() {
   LOG_SPEW("in realize()");
-  CUDA_RUNTIME(cudaGetLastError());
   assert(currDataPtrs_.size() == nextDataPtrs_.size());
   assert(dataElemSize_.size() == nextDataPtrs_.size());
 
   LOG_INFO("origin is " << origin_);
 
+  quantitySets_[0].clear();
+  for (int64_t i = 0; i < num_data(); ++i) {
+    quantitySets_[0].push_back(i);
+  }
+  for (const auto &set : quantitySets_) {
+    for (int64_t qi : set) {
+      if (qi < 0 || qi >= num_data()) {
+        LOG_FATAL("quantity set has quantity " << qi << " but there are " << num_data() << " quantities");
+      }
+    }
+  }
+
+  if (host_) {
+    for (int64_t i = 0; i < num_data(); ++i) {
+      const size_t elemSz = dataElemSize_[i];
+      const Dim3 raw = raw_size();
+      cudaPitchedPtr c{}; // current
+      cudaPitchedPtr n{}; // next
+      c.ptr = host_alloc(raw.flatten() * elemSz);
+      n.ptr = host_alloc(raw.flatten() * elemSz);
+      c.pitch = n.pitch = raw.x * elemSz;
+      c.xsize = n.xsize = raw.x * elemSz;
+      c.ysize = n.ysize = raw.y;
+      currDataPtrs_[i] = c;
+      nextDataPtrs_[i] = n;
+    }
+    devCurrDataPtrs_ = new cudaPitchedPtr[currDataPtrs_.size()];
+    std::copy(currDataPtrs_.begin(), currDataPtrs_.end(), devCurrDataPtrs_);
+    devNextDataPtrs_ = new cudaPitchedPtr[nextDataPtrs_.size()];
+    std::copy(nextDataPtrs_.begin(), nextDataPtrs_.end(), devNextDataPtrs_);
+    devDataElemSize_ = new size_t[dataElemSize_.size()];
+    std::copy(dataElemSize_.begin(), dataElemSize_.end(), devDataElemSize_);
+    devWireFormats_ = new WireFormat[wireFormats_.size()];
+    std::copy(wireFormats_.begin(), wireFormats_.end(), devWireFormats_);
+    for (const auto &set : quantitySets_) {
+      int64_t *p = new int64_t[set.size()];
+      std::copy(set.begin(), set.end(), p);
+      devQuantitySets_.push_back(p);
+    }
+    return;
+  }
+
+  CUDA_RUNTIME(cudaGetLastError());
+
   // allocate each data region
   CUDA_RUNTIME(cudaSetDevice(dev_));
   for (int64_t i = 0; i < num_data(); ++i) {
@@ -216,5 +367,16 @@ void LocalDomain::realize() {
 
   CUDA_RUNTIME(cudaMemcpy(devDataElemSize_, dataElemSize_.data(), dataElemSize_.size() * sizeof(dataElemSize_[0]),
                           cudaMemcpyHostToDevice));
+
+  CUDA_RUNTIME(cudaMalloc(&devWireFormats_, wireFormats_.size() * sizeof(wireFormats_[0])));
+  CUDA_RUNTIME(cudaMemcpy(devWireFormats_, wireFormats_.data(), wireFormats_.size() * sizeof(wireFormats_[0]),
+                          cudaMemcpyHostToDevice));
+
+  for (const auto &set : quantitySets_) {
+    int64_t *p = nullptr;
+    CUDA_RUNTIME(cudaMalloc(&p, set.size() * sizeof(set[0])));
+    CUDA_RUNTIME(cudaMemcpy(p, set.data(), set.size() * sizeof(set[0]), cudaMemcpyHostToDevice));
+    devQuantitySets_.push_back(p);
+  }
   CUDA_RUNTIME(cudaGetLastError());
 }
\ No newline at end of file
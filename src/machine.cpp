@@ -5,8 +5,10 @@
 #include "stencil/mpi.hpp"
 
 #include <algorithm>
-#include <set>
+#include <fstream>
 #include <map>
+#include <set>
+#include <sstream>
 
 std::ostream &operator<<(std::ostream &os, const UUID &uuid) {
   os << std::string(uuid);
@@ -15,6 +17,9 @@ std::ostream &operator<<(std::ostream &os, const UUID &uuid) {
 
 typedef Machine::Distance Distance;
 
+// bandwidth of a GPU to itself, like gpu_topo::bandwidth
+static const double SAME_BANDWIDTH = 10;
+
 #if STENCIL_USE_MPI == 1
 Machine Machine::build(MPI_Comm comm) {
 
@@ -129,7 +134,174 @@ Machine Machine::build(MPI_Comm comm) {
 };
 #endif
 
-Distance Machine::gpu_distance(const unsigned srcId, const unsigned dstId) const {}
+Distance Machine::gpu_distance(const unsigned srcId, const unsigned dstId) const {
+  const int srcNode = node_of_gpu(srcId);
+  const int dstNode = node_of_gpu(dstId);
+  if (srcNode == dstNode) {
+    if (cudaOfGpu_.empty()) { // don't know the CUDA devices
+      return Distance{srcId == dstId ? SAME_BANDWIDTH : 1.0, 0};
+    }
+    return Distance{cuda_bandwidth(cudaOfGpu_[srcId], cudaOfGpu_[dstId]), 0};
+  }
+
+  double hops = 1;
+  const std::string &src = hostnames_[srcNode];
+  const std::string &dst = hostnames_[dstNode];
+  if (network_.has_host(src) && network_.has_host(dst)) {
+    hops = network_.route(src, dst).hops;
+  }
+  return Distance{interNodeBandwidth_, hops};
+}
+
+double Machine::cuda_bandwidth(const int src, const int dst) const {
+  if (src < int64_t(cudaBandwidth_.shape().y) && dst < int64_t(cudaBandwidth_.shape().x)) {
+    return cudaBandwidth_.at(src, dst);
+  }
+  return src == dst ? SAME_BANDWIDTH : 1.0;
+}
+
+Machine Machine::from_file(const std::string &path) {
+  std::ifstream is(path);
+  if (!is.good()) {
+    LOG_FATAL("machine: unable to open " << path);
+  }
+  return parse(is);
+}
+
+/* read a non-negative device index or a positive bandwidth
+ */
+static bool parse_device(std::istream &is, int &dev) { return (is >> dev) && dev >= 0; }
+static bool parse_bandwidth(std::istream &is, double &bw) { return (is >> bw) && bw > 0; }
+
+Machine Machine::parse(std::istream &is) {
+  Machine machine;
+
+  std::vector<int> nodeGpus, nodeRanks;
+  int maxGpus = 0;
+  std::vector<std::pair<std::pair<int, int>, double>> bandwidths;
+
+  // network entries, with blank lines for everything else so Network reports the right line numbers
+  std::stringstream net;
+
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(is, line)) {
+    ++lineNo;
+    line = line.substr(0, line.find('#'));
+
+    std::stringstream ss(line);
+    std::string kind;
+    if (!(ss >> kind) || "host" == kind || "link" == kind) {
+      net << line << "\n";
+      continue;
+    }
+    net << "\n";
+
+    if ("node" == kind) {
+      std::string name;
+      int gpus, ranks;
+      if (!(ss >> name >> gpus) || gpus < 1) {
+        LOG_FATAL("machine: line " << lineNo << ": expected `node <hostname> <gpus> [ranks]`");
+      }
+      if (!(ss >> ranks)) {
+        ranks = gpus;
+        ss.clear();
+      } else if (ranks < 1) {
+        LOG_FATAL("machine: line " << lineNo << ": ranks must be positive");
+      }
+      if (std::find(machine.hostnames_.begin(), machine.hostnames_.end(), name) != machine.hostnames_.end()) {
+        LOG_FATAL("machine: line " << lineNo << ": node " << name << " is listed twice");
+      }
+      machine.hostnames_.push_back(name);
+      nodeGpus.push_back(gpus);
+      nodeRanks.push_back(ranks);
+      maxGpus = std::max(maxGpus, gpus);
+    } else if ("gpu-bandwidth" == kind) {
+      int i, j;
+      double bw;
+      if (!parse_device(ss, i) || !parse_device(ss, j) || !parse_bandwidth(ss, bw)) {
+        LOG_FATAL("machine: line " << lineNo << ": expected `gpu-bandwidth <device> <device> <bandwidth>`");
+      }
+      bandwidths.push_back(std::make_pair(std::make_pair(i, j), bw));
+    } else if ("no-peer" == kind) {
+      int i, j;
+      if (!parse_device(ss, i) || !parse_device(ss, j)) {
+        LOG_FATAL("machine: line " << lineNo << ": expected `no-peer <device> <device>`");
+      }
+      machine.noPeer_.insert(std::make_pair(i, j));
+      machine.noPeer_.insert(std::make_pair(j, i));
+    } else if ("inter-node-bandwidth" == kind) {
+      if (!parse_bandwidth(ss, machine.interNodeBandwidth_)) {
+        LOG_FATAL("machine: line " << lineNo << ": expected `inter-node-bandwidth <bandwidth>`");
+      }
+    } else {
+      LOG_FATAL("machine: line " << lineNo << ": unknown entry `" << kind << "`");
+    }
+
+    std::string extra;
+    if (ss >> extra) {
+      LOG_FATAL("machine: line " << lineNo << ": unexpected `" << extra << "`");
+    }
+  }
+
+  if (machine.hostnames_.empty()) {
+    LOG_FATAL("machine: no nodes");
+  }
+
+  machine.cudaBandwidth_ = Mat2D<double>(maxGpus, maxGpus, 1.0);
+  for (int i = 0; i < maxGpus; ++i) {
+    machine.cudaBandwidth_.at(i, i) = SAME_BANDWIDTH;
+  }
+  for (const auto &e : bandwidths) {
+    const int i = e.first.first;
+    const int j = e.first.second;
+    if (i >= maxGpus || j >= maxGpus) {
+      LOG_FATAL("machine: no node has device " << std::max(i, j));
+    }
+    machine.cudaBandwidth_.at(i, j) = e.second;
+    machine.cudaBandwidth_.at(j, i) = e.second;
+  }
+
+  // ranks are numbered by node, and get devices like DistributedDomain gives them
+  for (size_t node = 0; node < machine.hostnames_.size(); ++node) {
+    const int firstRank = machine.nodeOfRank_.size();
+    const int ranks = nodeRanks[node];
+    const int gpus = nodeGpus[node];
+    std::vector<std::vector<int>> gpuRanks(gpus);
+    for (int r = 0; r < ranks; ++r) {
+      std::vector<int> ids;
+      if (ranks <= gpus) {
+        for (int id = r; id < gpus; id += ranks) {
+          ids.push_back(id);
+        }
+      } else {
+        ids.push_back(r % gpus);
+      }
+      for (int id : ids) {
+        gpuRanks[id].push_back(firstRank + r);
+      }
+      machine.nodeOfRank_.push_back(node);
+      machine.rankCudaIds_.push_back(ids);
+    }
+    for (int id = 0; id < gpus; ++id) {
+      // a made-up UUID from the node and device
+      const int32_t words[2] = {int32_t(node), id};
+      machine.gpus_.push_back(GPU(UUID(words, sizeof(words)), gpuRanks[id]));
+      machine.cudaOfGpu_.push_back(id);
+    }
+    LOG_DEBUG("machine: node " << machine.hostnames_[node] << " ranks " << firstRank << ".." << firstRank + ranks - 1
+                               << " with " << gpus << " gpus");
+  }
+
+  machine.network_ = Network::parse(net);
+  for (const std::string &name : machine.hostnames_) {
+    if (!machine.network_.hosts().empty() && !machine.network_.has_host(name)) {
+      LOG_WARN("machine: node " << name << " is not in the network");
+    }
+  }
+
+  return machine;
+}
 
 #if 0
 
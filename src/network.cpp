@@ -0,0 +1,181 @@
+#include "stencil/network.hpp"
+
+#include "stencil/logging.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <sstream>
+
+size_t Network::add_vertex(const std::string &name, bool host) {
+  auto it = vertices_.find(name);
+  if (it != vertices_.end()) {
+    if (host != isHost_[it->second]) {
+      LOG_FATAL("network: " << name << " is used as both a host and a switch");
+    }
+    return it->second;
+  }
+
+  const size_t v = names_.size();
+  vertices_[name] = v;
+  names_.push_back(name);
+  isHost_.push_back(host);
+  adj_.resize(v + 1);
+  return v;
+}
+
+void Network::add_link(size_t a, size_t b, double bandwidth) {
+  adj_[a].push_back(std::make_pair(b, 1.0 / bandwidth));
+  adj_[b].push_back(std::make_pair(a, 1.0 / bandwidth));
+}
+
+int64_t Network::host_vertex(const std::string &name) const {
+  auto it = vertices_.find(name);
+  if (it != vertices_.end() && isHost_[it->second]) {
+    return it->second;
+  }
+
+  // compare short names
+  const std::string shortName = name.substr(0, name.find('.'));
+  for (size_t v = 0; v < names_.size(); ++v) {
+    if (isHost_[v] && names_[v].substr(0, names_[v].find('.')) == shortName) {
+      return v;
+    }
+  }
+  return -1;
+}
+
+std::vector<Network::Route> Network::routes(size_t src) const {
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<Route> ret(names_.size(), Route{inf, -1});
+
+  // Dijkstra, preferring fewer hops between equal distances
+  typedef std::pair<Route, size_t> Entry;
+  auto later = [](const Entry &a, const Entry &b) {
+    if (a.first.distance != b.first.distance) {
+      return a.first.distance > b.first.distance;
+    }
+    return a.first.hops > b.first.hops;
+  };
+  std::priority_queue<Entry, std::vector<Entry>, decltype(later)> queue(later);
+
+  ret[src] = Route{0, 0};
+  queue.push(Entry(ret[src], src));
+  while (!queue.empty()) {
+    const Entry e = queue.top();
+    queue.pop();
+    const size_t v = e.second;
+    if (e.first.distance != ret[v].distance || e.first.hops != ret[v].hops) {
+      continue; // stale
+    }
+    for (const auto &link : adj_[v]) {
+      const size_t u = link.first;
+      const Route r{e.first.distance + link.second, e.first.hops + 1};
+      if (r.distance < ret[u].distance || (r.distance == ret[u].distance && r.hops < ret[u].hops)) {
+        ret[u] = r;
+        queue.push(Entry(r, u));
+      }
+    }
+  }
+  return ret;
+}
+
+Network Network::from_file(const std::string &path) {
+  std::ifstream is(path);
+  if (!is.good()) {
+    LOG_FATAL("network: unable to open " << path);
+  }
+  return parse(is);
+}
+
+Network Network::parse(std::istream &is) {
+  Network net;
+
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(is, line)) {
+    ++lineNo;
+    line = line.substr(0, line.find('#'));
+
+    std::stringstream ss(line);
+    std::string kind;
+    if (!(ss >> kind)) {
+      continue; // blank
+    }
+
+    std::string a, b;
+    if (!(ss >> a >> b)) {
+      LOG_FATAL("network: line " << lineNo << ": expected `" << kind << " <name> <name> [bandwidth]`");
+    }
+    double bandwidth = 1;
+    std::string bwStr, extra;
+    if (ss >> bwStr) {
+      char *end;
+      bandwidth = std::strtod(bwStr.c_str(), &end);
+      if (*end != '\0' || !(bandwidth > 0)) {
+        LOG_FATAL("network: line " << lineNo << ": bandwidth must be a positive number");
+      }
+    }
+    if (ss >> extra) {
+      LOG_FATAL("network: line " << lineNo << ": unexpected `" << extra << "`");
+    }
+
+    if ("host" == kind) {
+      const size_t h = net.add_vertex(a, true);
+      const size_t s = net.add_vertex(b, false);
+      net.add_link(h, s, bandwidth);
+    } else if ("link" == kind) {
+      const size_t s1 = net.add_vertex(a, false);
+      const size_t s2 = net.add_vertex(b, false);
+      net.add_link(s1, s2, bandwidth);
+    } else {
+      LOG_FATAL("network: line " << lineNo << ": unknown entry `" << kind << "`");
+    }
+  }
+
+  return net;
+}
+
+std::vector<std::string> Network::hosts() const {
+  std::vector<std::string> ret;
+  for (size_t v = 0; v < names_.size(); ++v) {
+    if (isHost_[v]) {
+      ret.push_back(names_[v]);
+    }
+  }
+  return ret;
+}
+
+Network::Route Network::route(const std::string &src, const std::string &dst) const {
+  const int64_t s = host_vertex(src);
+  const int64_t d = host_vertex(dst);
+  if (s < 0) {
+    LOG_FATAL("network: no host " << src);
+  }
+  if (d < 0) {
+    LOG_FATAL("network: no host " << dst);
+  }
+  return routes(s)[d];
+}
+
+Mat2D<double> Network::distance(const std::vector<std::string> &hosts) const {
+  std::vector<size_t> vs;
+  for (const std::string &host : hosts) {
+    const int64_t v = host_vertex(host);
+    if (v < 0) {
+      LOG_FATAL("network: no host " << host);
+    }
+    vs.push_back(v);
+  }
+
+  Mat2D<double> ret(hosts.size(), hosts.size(), 0.0);
+  for (size_t i = 0; i < vs.size(); ++i) {
+    const std::vector<Route> r = routes(vs[i]);
+    for (size_t j = 0; j < vs.size(); ++j) {
+      ret.at(i, j) = r[vs[j]].distance;
+    }
+  }
+  return ret;
+}
@@ -105,4 +105,66 @@ __device__ void grid_unpack(cudaPitchedPtr dst, const void *__restrict__ src, co
 __global__ void unpack_kernel(cudaPitchedPtr dst, const void *src, const Dim3 dstPos, const Dim3 dstExtent,
                               const size_t elemSize) {
   grid_unpack(dst, src, dstPos, dstExtent, elemSize);
-}
\ No newline at end of file
+}
+
+__device__ void grid_pack_wire(void *__restrict__ dst, const cudaPitchedPtr src, const Dim3 srcPos,
+                               const Dim3 srcExtent, const size_t elemSize, const WireFormat wire) {
+  if (WireFormat::Kind::Native == wire.kind) {
+    grid_pack(dst, src, srcPos, srcExtent, elemSize);
+    return;
+  }
+
+  const char *__restrict__ sp = static_cast<char *>(src.ptr);
+  char *__restrict__ dp = static_cast<char *>(dst);
+  const size_t wireSize = wire.wire_size(elemSize);
+
+  const unsigned int tz = blockDim.z * blockIdx.z + threadIdx.z;
+  const unsigned int ty = blockDim.y * blockIdx.y + threadIdx.y;
+  const unsigned int tx = blockDim.x * blockIdx.x + threadIdx.x;
+
+  for (unsigned int zo = tz; zo < srcExtent.z; zo += blockDim.z * gridDim.z) {
+    unsigned int zi = zo + srcPos.z;
+    for (unsigned int yo = ty; yo < srcExtent.y; yo += blockDim.y * gridDim.y) {
+      unsigned int yi = yo + srcPos.y;
+      for (unsigned int xo = tx; xo < srcExtent.x; xo += blockDim.x * gridDim.x) {
+        unsigned int xi = xo + srcPos.x;
+        // logical offset of packed output
+        const size_t oi = zo * srcExtent.y * srcExtent.x + yo * srcExtent.x + xo;
+        // byte offset of input
+        const size_t bi = zi * src.ysize * src.pitch + yi * src.pitch + xi * elemSize;
+        wire.encode(dp + oi * wireSize, sp + bi, elemSize);
+      }
+    }
+  }
+}
+
+__device__ void grid_unpack_wire(cudaPitchedPtr dst, const void *__restrict__ src, const Dim3 dstPos,
+                                 const Dim3 dstExtent, const size_t elemSize, const WireFormat wire) {
+  if (WireFormat::Kind::Native == wire.kind) {
+    grid_unpack(dst, src, dstPos, dstExtent, elemSize);
+    return;
+  }
+
+  char *__restrict__ dp = static_cast<char *>(dst.ptr);
+  const char *__restrict__ sp = static_cast<const char *>(src);
+  const size_t wireSize = wire.wire_size(elemSize);
+
+  const unsigned int tz = blockDim.z * blockIdx.z + threadIdx.z;
+  const unsigned int ty = blockDim.y * blockIdx.y + threadIdx.y;
+  const unsigned int tx = blockDim.x * blockIdx.x + threadIdx.x;
+
+  for (unsigned int zi = tz; zi < dstExtent.z; zi += blockDim.z * gridDim.z) {
+    unsigned int zo = zi + dstPos.z;
+    for (unsigned int yi = ty; yi < dstExtent.y; yi += blockDim.y * gridDim.y) {
+      unsigned int yo = yi + dstPos.y;
+      for (unsigned int xi = tx; xi < dstExtent.x; xi += blockDim.x * gridDim.x) {
+        unsigned int xo = xi + dstPos.x;
+        // logical offset of packed input
+        const size_t ii = zi * dstExtent.y * dstExtent.x + yi * dstExtent.x + xi;
+        // byte offset of output
+        const size_t bo = zo * dst.ysize * dst.pitch + yo * dst.pitch + xo * elemSize;
+        wire.decode(dp + bo, sp + ii * wireSize, elemSize);
+      }
+    }
+  }
+}
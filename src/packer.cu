@@ -2,49 +2,101 @@
 
 #include "stencil/pack_kernel.cuh"
 #include "stencil/rt.hpp"
+#include "stencil/staging_arena.hpp"
 
 #include <algorithm>
+#include <cstdlib>
 
-/*! pack all quantities in a single domain into a destination buffer
+/*! pack some quantities in a single domain into a destination buffer
  */
 __global__ void dev_packer_pack_domain(void *dst,               // buffer to pack into
                                        cudaPitchedPtr *srcs,    // pointer to each quantity
                                        const size_t *elemSizes, // element size for each quantity
-                                       const size_t nQuants,    // number of quantities
+                                       const WireFormat *wires, // encoding of each quantity (nullptr for native)
+                                       const int64_t *quants,   // quantities to pack
+                                       const size_t nQuants,    // number of quantities to pack
                                        const Dim3 pos,          // halo position
                                        const Dim3 ext           // halo extent
 ) {
   size_t offset = 0;
-  for (size_t qi = 0; qi < nQuants; ++qi) {
+  for (size_t i = 0; i < nQuants; ++i) {
+    const int64_t qi = quants[i];
     const size_t elemSz = elemSizes[qi];
-    offset = next_align_of(offset, elemSz);
+    const WireFormat wire = wires ? wires[qi] : WireFormat{WireFormat::Kind::Native, 0};
+    const size_t wireSz = wire.wire_size(elemSz);
+    offset = next_align_of(offset, wireSz);
     cudaPitchedPtr src = srcs[qi];
     void *dstp = &((char *)dst)[offset];
-    grid_pack(dstp, src, pos, ext, elemSz);
-    offset += elemSz * ext.flatten();
+    grid_pack_wire(dstp, src, pos, ext, elemSz, wire);
+    offset += wireSz * ext.flatten();
   }
 }
 
 __global__ void dev_unpacker_unpack_domain(cudaPitchedPtr *dsts,    // buffers to unpack into
                                            const void *src,         // raw pointer to each quanitity
                                            const size_t *elemSizes, // element size for each quantity
-                                           const size_t nQuants,    // number of quantities
+                                           const WireFormat *wires, // encoding of each quantity (nullptr for native)
+                                           const int64_t *quants,   // quantities to unpack
+                                           const size_t nQuants,    // number of quantities to unpack
                                            const Dim3 pos,          // halo position
                                            const Dim3 ext           // halo extent
 ) {
   size_t offset = 0;
-  for (unsigned int qi = 0; qi < nQuants; ++qi) {
+  for (unsigned int i = 0; i < nQuants; ++i) {
+    const int64_t qi = quants[i];
     cudaPitchedPtr dst = dsts[qi];
     const size_t elemSz = elemSizes[qi];
-    offset = next_align_of(offset, elemSz);
+    const WireFormat wire = wires ? wires[qi] : WireFormat{WireFormat::Kind::Native, 0};
+    const size_t wireSz = wire.wire_size(elemSz);
+    offset = next_align_of(offset, wireSz);
     void *srcp = &((char *)src)[offset];
-    grid_unpack(dst, srcp, pos, ext, elemSz);
-    offset += elemSz * ext.flatten();
+    grid_unpack_wire(dst, srcp, pos, ext, elemSz, wire);
+    offset += wireSz * ext.flatten();
   }
 }
 
-DevicePacker::DevicePacker(cudaStream_t stream)
-    : domain_(nullptr), size_(-1), devBuf_(0), stream_(stream), graph_(NULL), instance_(NULL) {}
+/* bytes of one element of quantity `qi` in a packed buffer
+ */
+static size_t packed_elem_size(const LocalDomain *domain, int64_t qi, bool wire) {
+  return wire ? domain->wire_elem_size(qi) : domain->elem_size(qi);
+}
+
+/* bytes of the halo of quantity `qi` in direction `dir` in a packed buffer
+ */
+static int64_t packed_bytes(const LocalDomain *domain, const Dim3 &dir, int64_t qi, bool wire) {
+  return wire ? domain->wire_bytes(dir, qi) : domain->halo_bytes(dir, qi);
+}
+
+/* bytes needed to pack `quantities` of `domain` for `messages`, in order
+ */
+static int64_t packed_size(const LocalDomain *domain, const std::vector<Message> &messages,
+                           const std::vector<int64_t> &quantities, bool wire) {
+  int64_t size = 0;
+  for (const auto &msg : messages) {
+    for (int64_t qi : quantities) {
+      size = next_align_of(size, packed_elem_size(domain, qi, wire));
+
+      // if message sends in +x, we are sending to -x halo, so the size of the
+      // data will be the size of the -x halo region (the +x halo region may
+      // be different due to an uncentered kernel)
+      size += packed_bytes(domain, msg.dir_ * -1, qi, wire);
+    }
+  }
+  return size;
+}
+
+/* packed size of each quantity set of `domain`
+ */
+static std::vector<int64_t> packed_sizes(const LocalDomain *domain, const std::vector<Message> &messages, bool wire) {
+  std::vector<int64_t> sizes;
+  for (size_t s = 0; s < domain->num_quantity_sets(); ++s) {
+    sizes.push_back(packed_size(domain, messages, domain->quantity_set(s), wire));
+  }
+  return sizes;
+}
+
+DevicePacker::DevicePacker(cudaStream_t stream, bool wire)
+    : domain_(nullptr), wire_(wire), devBuf_(0), stream_(stream) {}
 
 DevicePacker::~DevicePacker() {
 #ifdef STENCIL_USE_CUDA_GRAPH
@@ -52,13 +104,13 @@ DevicePacker::~DevicePacker() {
   //    CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
   //    domain_ = nullptr;
   //  }
-  if (graph_) {
-    CUDA_RUNTIME(cudaGraphDestroy(graph_));
-    graph_ = 0;
+  for (cudaGraph_t &graph : graphs_) {
+    CUDA_RUNTIME(cudaGraphDestroy(graph));
+    graph = 0;
   }
-  if (instance_) {
-    CUDA_RUNTIME(cudaGraphExecDestroy(instance_));
-    instance_ = 0;
+  for (cudaGraphExec_t &instance : instances_) {
+    CUDA_RUNTIME(cudaGraphExecDestroy(instance));
+    instance = 0;
   }
 #endif
 }
@@ -68,48 +120,43 @@ void DevicePacker::prepare(LocalDomain *domain, const std::vector<Message> &mess
   dirs_ = messages;
   std::sort(dirs_.begin(), dirs_.end(), Message::by_size);
 
-  // compute the required buffer size for all messages
-  size_ = 0;
-  for (const auto &msg : dirs_) {
-    LOG_SPEW("DevicePacker::prepare(): msg.dir_=" << msg.dir_);
-    for (int64_t qi = 0; qi < domain_->num_data(); ++qi) {
-      size_ = next_align_of(size_, domain_->elem_size(qi));
-
-      // if message sends in +x, we are sending to -x halo, so the size of the
-      // data will be the size of the -x halo region (the +x halo region may
-      // be different due to an uncentered kernel)
-      size_ += domain_->halo_bytes(msg.dir_ * -1, qi);
-    }
-
-    if (0 == size_) {
-      LOG_FATAL("zero-size packer was prepared");
-    }
+  // compute the required buffer size for all messages, for each quantity set
+  sizes_ = packed_sizes(domain_, dirs_, wire_);
+  if (!dirs_.empty() && 0 == sizes_[0]) {
+    LOG_FATAL("zero-size packer was prepared");
   }
 
-  // allocate the buffer for the packing
+  // allocate the buffer for the packing. Set 0 is every quantity, so it is the largest
   CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
-  CUDA_RUNTIME(cudaMalloc(&devBuf_, size_));
+  CUDA_RUNTIME(cudaMalloc(&devBuf_, sizes_[0]));
 
 /* if we are using the graph API, record all the kernel launches here, otherwise
  * they will be done on-demand
  */
 #ifdef STENCIL_USE_CUDA_GRAPH
   assert(stream_ != 0 && "can't capture the NULL stream, unless cudaStreamPerThread");
-  CUDA_RUNTIME(cudaStreamBeginCapture(stream_, cudaStreamCaptureModeThreadLocal));
-  launch_pack_kernels();
-  CUDA_RUNTIME(cudaStreamEndCapture(stream_, &graph_));
-  assert(graph_);
-  CUDA_RUNTIME(cudaGraphInstantiate(&instance_, graph_, NULL, NULL, 0));
-  assert(instance_);
+  for (size_t s = 0; s < sizes_.size(); ++s) {
+    cudaGraph_t graph;
+    cudaGraphExec_t instance;
+    CUDA_RUNTIME(cudaStreamBeginCapture(stream_, cudaStreamCaptureModeThreadLocal));
+    launch_pack_kernels(s);
+    CUDA_RUNTIME(cudaStreamEndCapture(stream_, &graph));
+    assert(graph);
+    CUDA_RUNTIME(cudaGraphInstantiate(&instance, graph, NULL, NULL, 0));
+    assert(instance);
+    graphs_.push_back(graph);
+    instances_.push_back(instance);
+  }
 #else
   // no other prep to do
 #endif
 }
 
-void DevicePacker::launch_pack_kernels() {
+void DevicePacker::launch_pack_kernels(size_t set) {
   // record packing operations
   CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
 
+  const std::vector<int64_t> &quants = domain_->quantity_set(set);
   int64_t offset = 0;
   for (const auto &msg : dirs_) {
     // pack from from +x interior
@@ -124,23 +171,25 @@ void DevicePacker::launch_pack_kernels() {
     LOG_SPEW("dir=" << msg.dir_ << " ext=" << ext << " pos=" << pos << " @ " << offset);
     const dim3 dimBlock = Dim3::make_block_dim(ext, 512);
     const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / Dim3(dimBlock);
-    assert(offset < size_);
+    assert(offset < sizes_[set]);
 
     LOG_SPEW("dev_packer_pack_domain grid=" << dimGrid << " block=" << dimBlock);
 #if 0
     dev_packer_pack_domain<<<dimGrid, dimBlock, 0, stream_>>>(&devBuf_[offset], domain_->dev_curr_datas(),
-                                                              domain_->dev_elem_sizes(), domain_->num_data(), pos, ext);
+                                                              domain_->dev_elem_sizes(), domain_->dev_quantity_set(set),
+                                                              quants.size(), pos, ext);
 #endif
     rt::launch(dev_packer_pack_domain, dimGrid, dimBlock, 0, stream_, &devBuf_[offset], domain_->dev_curr_datas(),
-               domain_->dev_elem_sizes(), domain_->num_data(), pos, ext);
+               domain_->dev_elem_sizes(), wire_ ? domain_->dev_wire_formats() : nullptr,
+               domain_->dev_quantity_set(set), quants.size(), pos, ext);
 #ifndef STENCIL_USE_CUDA_GRAPH
     // 900: not allowed while stream is capturing
     CUDA_RUNTIME(rt::time(cudaGetLastError));
 #endif
-    for (int64_t qi = 0; qi < domain_->num_data(); ++qi) {
-      offset = next_align_of(offset, domain_->elem_size(qi));
+    for (int64_t qi : quants) {
+      offset = next_align_of(offset, packed_elem_size(domain_, qi, wire_));
       // send +x means recv into -x halo. +x halo size could be different
-      offset += domain_->halo_bytes(msg.dir_ * -1, qi);
+      offset += packed_bytes(domain_, msg.dir_ * -1, qi, wire_);
     }
   }
   // with cuda graph, this is called during setup so dont time it
@@ -148,29 +197,29 @@ void DevicePacker::launch_pack_kernels() {
 }
 
 void DevicePacker::pack() {
-  assert(size_);
+  assert(size());
+  const size_t set = domain_->active_quantity_set();
 #ifdef STENCIL_USE_CUDA_GRAPH
   CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
-  CUDA_RUNTIME(rt::time(cudaGraphLaunch, instance_, stream_));
+  CUDA_RUNTIME(rt::time(cudaGraphLaunch, instances_[set], stream_));
 #else
-  launch_pack_kernels();
+  launch_pack_kernels(set);
 #endif
 }
 
-DeviceUnpacker::DeviceUnpacker(cudaStream_t stream)
-    : domain_(nullptr), size_(-1), devBuf_(0), stream_(stream), graph_(NULL), instance_(NULL) {}
+DeviceUnpacker::DeviceUnpacker(cudaStream_t stream, bool wire)
+    : domain_(nullptr), wire_(wire), devBuf_(0), stream_(stream) {}
 
 DeviceUnpacker::~DeviceUnpacker() {
 
 #ifdef STENCIL_USE_CUDA_GRAPH
-  // TODO: these need to be guarded from ctor without prepare()?
-  if (graph_) {
-    CUDA_RUNTIME(cudaGraphDestroy(graph_));
-    graph_ = 0;
+  for (cudaGraph_t &graph : graphs_) {
+    CUDA_RUNTIME(cudaGraphDestroy(graph));
+    graph = 0;
   }
-  if (instance_) {
-    CUDA_RUNTIME(cudaGraphExecDestroy(instance_));
-    instance_ = 0;
+  for (cudaGraphExec_t &instance : instances_) {
+    CUDA_RUNTIME(cudaGraphExecDestroy(instance));
+    instance = 0;
   }
 #endif
 }
@@ -184,25 +233,14 @@ void DeviceUnpacker::prepare(LocalDomain *domain, const std::vector<Message> &me
 
   CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
 
-  // compute the required buffer size for all messages
-  size_ = 0;
-  for (const auto &msg : dirs_) {
-    for (int64_t qi = 0; qi < domain_->num_data(); ++qi) {
-      size_ = next_align_of(size_, domain_->elem_size(qi));
-
-      // if message sends in +x, we are sending to -x halo, so the size of the
-      // data will be the size of the -x halo region (the +x halo region may
-      // be different due to an uncentered kernel)
-      size_ += domain_->halo_bytes(msg.dir_ * -1, qi);
-    }
-
-    if (0 == size_) {
-      LOG_FATAL("0-size packer was prepared");
-    }
+  // compute the required buffer size for all messages, for each quantity set
+  sizes_ = packed_sizes(domain_, dirs_, wire_);
+  if (!dirs_.empty() && 0 == sizes_[0]) {
+    LOG_FATAL("0-size packer was prepared");
   }
 
   // allocate the buffer that will be unpacked
-  CUDA_RUNTIME(cudaMalloc(&devBuf_, size_));
+  CUDA_RUNTIME(cudaMalloc(&devBuf_, sizes_[0]));
 
 /* if we are using the graph API, record all the kernel launches here, otherwise
  * they will be done on-demand
@@ -210,19 +248,26 @@ void DeviceUnpacker::prepare(LocalDomain *domain, const std::vector<Message> &me
 #ifdef STENCIL_USE_CUDA_GRAPH
   CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
   assert(stream_ != 0 && "can't capture the NULL stream, unless cudaStreamPerThread");
-  // TODO: safer if thread-local?
-  CUDA_RUNTIME(cudaStreamBeginCapture(stream_, cudaStreamCaptureModeGlobal));
-  launch_unpack_kernels();
-  CUDA_RUNTIME(cudaStreamEndCapture(stream_, &graph_));
-  CUDA_RUNTIME(cudaGraphInstantiate(&instance_, graph_, NULL, NULL, 0));
+  for (size_t s = 0; s < sizes_.size(); ++s) {
+    cudaGraph_t graph;
+    cudaGraphExec_t instance;
+    // TODO: safer if thread-local?
+    CUDA_RUNTIME(cudaStreamBeginCapture(stream_, cudaStreamCaptureModeGlobal));
+    launch_unpack_kernels(s);
+    CUDA_RUNTIME(cudaStreamEndCapture(stream_, &graph));
+    CUDA_RUNTIME(cudaGraphInstantiate(&instance, graph, NULL, NULL, 0));
+    graphs_.push_back(graph);
+    instances_.push_back(instance);
+  }
 #else
   // no other prep to do
 #endif
 }
 
-void DeviceUnpacker::launch_unpack_kernels() {
+void DeviceUnpacker::launch_unpack_kernels(size_t set) {
   CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
 
+  const std::vector<int64_t> &quants = domain_->quantity_set(set);
   int64_t offset = 0;
   for (const auto &msg : dirs_) {
 
@@ -235,29 +280,105 @@ void DeviceUnpacker::launch_unpack_kernels() {
     const dim3 dimBlock = Dim3::make_block_dim(ext, 512);
     const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
 #if 0
-    dev_unpacker_unpack_domain<<<dimGrid, dimBlock, 0, stream_>>>(
-        domain_->dev_curr_datas(), &devBuf_[offset], domain_->dev_elem_sizes(), domain_->num_data(), pos, ext);
+    dev_unpacker_unpack_domain<<<dimGrid, dimBlock, 0, stream_>>>(domain_->dev_curr_datas(), &devBuf_[offset],
+                                                                  domain_->dev_elem_sizes(),
+                                                                  domain_->dev_quantity_set(set), quants.size(), pos,
+                                                                  ext);
 #endif
     rt::launch(dev_unpacker_unpack_domain, dimGrid, dimBlock, 0, stream_, domain_->dev_curr_datas(), &devBuf_[offset],
-               domain_->dev_elem_sizes(), domain_->num_data(), pos, ext);
+               domain_->dev_elem_sizes(), wire_ ? domain_->dev_wire_formats() : nullptr,
+               domain_->dev_quantity_set(set), quants.size(), pos, ext);
 #ifndef STENCIL_USE_CUDA_GRAPH
     // 900: operation not permitted while stream is capturing
     CUDA_RUNTIME(rt::time(cudaGetLastError));
 #endif
-    for (int64_t qi = 0; qi < domain_->num_data(); ++qi) {
-      offset = next_align_of(offset, domain_->elem_size(qi));
-      offset += domain_->halo_bytes(dir, qi);
+    for (int64_t qi : quants) {
+      offset = next_align_of(offset, packed_elem_size(domain_, qi, wire_));
+      offset += packed_bytes(domain_, dir, qi, wire_);
     }
   }
   CUDA_RUNTIME(rt::time(cudaGetLastError));
 }
 
 void DeviceUnpacker::unpack() {
-  assert(size_);
+  assert(size());
+  const size_t set = domain_->active_quantity_set();
 #ifdef STENCIL_USE_CUDA_GRAPH
   CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
-  CUDA_RUNTIME(rt::time(cudaGraphLaunch, instance_, stream_));
+  CUDA_RUNTIME(rt::time(cudaGraphLaunch, instances_[set], stream_));
 #else
-  launch_unpack_kernels();
+  launch_unpack_kernels(set);
 #endif
 }
+
+HostPacker::HostPacker(bool wire) : domain_(nullptr), wire_(wire), buf_(nullptr) {}
+
+HostPacker::~HostPacker() { StagingArena::host().deallocate(buf_); }
+
+void HostPacker::prepare(LocalDomain *domain, const std::vector<Message> &messages) {
+  assert(domain->is_host());
+  domain_ = domain;
+  dirs_ = messages;
+  std::sort(dirs_.begin(), dirs_.end(), Message::by_size);
+
+  sizes_ = packed_sizes(domain_, dirs_, wire_);
+  if (!dirs_.empty() && 0 == sizes_[0]) {
+    LOG_FATAL("zero-size packer was prepared");
+  }
+  StagingArena::host().deallocate(buf_);
+  buf_ = static_cast<char *>(StagingArena::host().allocate(sizes_[0]));
+}
+
+void HostPacker::pack() {
+  assert(size());
+  int64_t offset = 0;
+  for (const auto &msg : dirs_) {
+    // pack from the +x interior into the -x halo of the recver
+    const Dim3 pos = domain_->halo_pos(msg.dir_, false /*interior*/);
+    const Dim3 ext = domain_->halo_extent(msg.dir_ * -1);
+    for (int64_t qi : domain_->quantity_set(domain_->active_quantity_set())) {
+      const WireFormat wire = wire_ ? domain_->wire_format(qi) : WireFormat::native();
+      offset = next_align_of(offset, packed_elem_size(domain_, qi, wire_));
+      host_pack_wire(&buf_[offset], domain_->curr_data(qi), pos, ext, domain_->elem_size(qi), wire);
+      offset += packed_bytes(domain_, msg.dir_ * -1, qi, wire_);
+    }
+  }
+  assert(offset == size());
+}
+
+HostUnpacker::HostUnpacker(bool wire) : domain_(nullptr), wire_(wire), buf_(nullptr) {}
+
+HostUnpacker::~HostUnpacker() { StagingArena::host().deallocate(buf_); }
+
+void HostUnpacker::prepare(LocalDomain *domain, const std::vector<Message> &messages) {
+  assert(domain->is_host());
+  domain_ = domain;
+  dirs_ = messages;
+
+  // sort so we unpack in the same order as the sender packed
+  std::sort(dirs_.begin(), dirs_.end(), Message::by_size);
+
+  sizes_ = packed_sizes(domain_, dirs_, wire_);
+  if (!dirs_.empty() && 0 == sizes_[0]) {
+    LOG_FATAL("0-size packer was prepared");
+  }
+  StagingArena::host().deallocate(buf_);
+  buf_ = static_cast<char *>(StagingArena::host().allocate(sizes_[0]));
+}
+
+void HostUnpacker::unpack() {
+  assert(size());
+  int64_t offset = 0;
+  for (const auto &msg : dirs_) {
+    const Dim3 dir = msg.dir_ * -1; // unpack into opposite side as sent
+    const Dim3 ext = domain_->halo_extent(dir);
+    const Dim3 pos = domain_->halo_pos(dir, true /*exterior*/);
+    for (int64_t qi : domain_->quantity_set(domain_->active_quantity_set())) {
+      const WireFormat wire = wire_ ? domain_->wire_format(qi) : WireFormat::native();
+      offset = next_align_of(offset, packed_elem_size(domain_, qi, wire_));
+      host_unpack_wire(domain_->curr_data(qi), &buf_[offset], pos, ext, domain_->elem_size(qi), wire);
+      offset += packed_bytes(domain_, dir, qi, wire_);
+    }
+  }
+  assert(offset == size());
+}
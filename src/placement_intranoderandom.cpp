@@ -6,94 +6,39 @@ IntraNodeRandom::IntraNodeRandom(const Dim3 &size, // total domain size
                                                                      // rank wants to contribute
                                  )
     : generator_(0) {
+  (void)mpiTopo;
   LOG_DEBUG("IntraNodeRandom: entered ctor");
   MPI_Barrier(MPI_COMM_WORLD);
   LOG_DEBUG("IntraNodeRandom: after barrier");
 
-  // TODO: actually check that everyone has the same number of GPUs
-  const int gpusPerRank = rankCudaIds.size();
-  const int ranksPerNode = mpiTopo.colocated_size();
-  const int gpusPerNode = gpusPerRank * ranksPerNode;
-  const int numNodes = mpiTopo.size() / mpiTopo.colocated_size();
-  const int numSubdomains = numNodes * gpusPerNode;
+  place(size, radius, JobLayout::gather(rankCudaIds), true);
+}
 
-  partition_ = NodePartition(size, radius, numNodes, gpusPerNode);
+IntraNodeRandom::IntraNodeRandom(const Dim3 &size, const JobLayout &job, Radius radius) : generator_(0) {
+  place(size, radius, job, false);
+}
 
-  if (0 == mpi::world_rank()) {
-    LOG_INFO("IntraNodeRandom: " << partition_.sys_dim() << "x" << partition_.node_dim());
-  }
-
-  // get the name of each node
-  char name[MPI_MAX_PROCESSOR_NAME] = {0};
-  int nameLen;
-  MPI_Get_processor_name(name, &nameLen);
-  if (0 == mpiTopo.rank()) {
-    LOG_DEBUG("IntraNodeRandom: got name " << name);
-  }
-
-  // gather the names to root
-  std::vector<char> allNames;
-  if (0 == mpiTopo.rank()) {
-    allNames.resize(MPI_MAX_PROCESSOR_NAME * mpiTopo.size());
-  }
-  MPI_Gather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, allNames.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0,
-             MPI_COMM_WORLD);
-  if (0 == mpiTopo.rank()) {
-    LOG_DEBUG("IntraNodeRandom: gathered names to root");
-  }
-
-  // get the name for each rank
-  std::vector<std::string> rankNames;
-  if (0 == mpiTopo.rank()) {
-    for (int rank = 0; rank < mpiTopo.size(); ++rank) {
-      std::string _name(allNames.data() + rank * MPI_MAX_PROCESSOR_NAME);
-      rankNames.push_back(_name);
-    }
-  }
-  if (0 == mpiTopo.rank()) {
-    std::cerr << "DEBUG: IntraNodeRandom: built names for each rank\n";
-  }
+void IntraNodeRandom::place(const Dim3 &size, const Radius &radius, const JobLayout &job, bool collective) {
+  const bool root = !collective || 0 == mpi::world_rank();
 
-  // number each name
-  std::map<std::string, size_t> nodeNumbers;
-  size_t nn = 0;
-  if (0 == mpiTopo.rank()) {
-    for (int rank = 0; rank < mpiTopo.size(); ++rank) {
-      auto p = nodeNumbers.emplace(rankNames[rank], nn);
-      if (p.second) {
-        ++nn;
-      }
+  const int gpusPerRank = job.cudaIds[0].size();
+  for (int rank = 0; rank < job.num_ranks(); ++rank) {
+    if (int(job.cudaIds[rank].size()) != gpusPerRank) {
+      LOG_FATAL("IntraNodeRandom: rank " << rank << " has " << job.cudaIds[rank].size() << " GPUs but rank 0 has "
+                                         << gpusPerRank);
     }
   }
-  if (0 == mpiTopo.rank()) {
-    std::cerr << "DEBUG: IntraNodeRandom: numbered each name\n";
-  }
-
-  // store the node number for each rank
-  std::vector<int> rankNode(mpiTopo.size());
   // a vec of ranks that are in each node
-  std::vector<std::vector<int>> nodeRanks(nodeNumbers.size());
-  if (0 == mpiTopo.rank()) {
-    for (int rank = 0; rank < mpiTopo.size(); ++rank) {
-      int node = nodeNumbers[rankNames[rank]];
-      rankNode[rank] = node;
-      nodeRanks[node].push_back(rank);
-    }
-  }
-  if (0 == mpiTopo.rank()) {
-    std::cerr << "DEBUG: IntraNodeRandom: build ranks in each node\n";
-  }
+  const std::vector<std::vector<int>> nodeRanks = job.node_ranks();
+  const int numNodes = nodeRanks.size();
+  const int ranksPerNode = job.num_ranks() / numNodes;
+  const int gpusPerNode = gpusPerRank * ranksPerNode;
+  const int numSubdomains = numNodes * gpusPerNode;
 
-  // gather up all CUDA ids that all ranks are contributing
-  std::vector<int> globalCudaIds(numSubdomains);
-  MPI_Allgather(rankCudaIds.data(), rankCudaIds.size(), MPI_INT, globalCudaIds.data(), rankCudaIds.size(), MPI_INT,
-                mpiTopo.comm());
+  partition_ = NodePartition(size, radius, numNodes, gpusPerNode);
 
-  if (0 == mpiTopo.rank()) {
-    std::cerr << "globalCudaIds:";
-    for (auto &e : globalCudaIds)
-      std::cerr << " " << e;
-    std::cerr << "\n";
+  if (root) {
+    LOG_INFO("IntraNodeRandom: " << partition_.sys_dim() << "x" << partition_.node_dim());
   }
 
   // OUTPUTS
@@ -104,7 +49,7 @@ IntraNodeRandom::IntraNodeRandom(const Dim3 &size, // total domain size
   // subdomain ID for each subdomain
   std::vector<int> idForDomain(numSubdomains);
 
-  if (0 == mpiTopo.rank()) {
+  if (root) {
 
     // randomize placement on each node
     for (int node = 0; node < numNodes; ++node) {
@@ -116,7 +61,10 @@ IntraNodeRandom::IntraNodeRandom(const Dim3 &size, // total domain size
       for (auto &e : ranks)
         std::cerr << " " << e;
       std::cerr << "\n";
-      assert(ranks.size() == ranksPerNode);
+      if (int(ranks.size()) != ranksPerNode) {
+        LOG_FATAL("IntraNodeRandom: node " << node << " has " << ranks.size() << " ranks, expected "
+                                           << ranksPerNode);
+      }
 
       // which component each subdomain should be on. assign randomly
       std::vector<size_t> components(gpusPerNode);
@@ -135,7 +83,7 @@ IntraNodeRandom::IntraNodeRandom(const Dim3 &size, // total domain size
         const int ri = component / gpusPerRank;
         const int rank = ranks[ri];
         const int gpuId = component % gpusPerRank;
-        const int cuda = globalCudaIds[rank * gpusPerRank + gpuId];
+        const int cuda = job.cudaIds[rank][gpuId];
 
         // implicitly, the global ID is grouped by node, and subdomain id within that node
         const size_t gi = node * gpusPerNode + id;
@@ -155,12 +103,14 @@ IntraNodeRandom::IntraNodeRandom(const Dim3 &size, // total domain size
       }
     }
 
-  } // 0 == rank
+  } // root
 
   // broadcast the data to all ranks
-  MPI_Bcast(rankAssignment.data(), rankAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(idForDomain.data(), idForDomain.size(), MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(cudaAssignment.data(), cudaAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
+  if (collective) {
+    MPI_Bcast(rankAssignment.data(), rankAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(idForDomain.data(), idForDomain.size(), MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(cudaAssignment.data(), cudaAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
+  }
 
   // implicitly first M are first node, next M are second node, so not okay to use partition_.idx()
   for (size_t gi = 0; gi < rankAssignment.size(); ++gi) {
@@ -182,7 +132,7 @@ IntraNodeRandom::IntraNodeRandom(const Dim3 &size, // total domain size
     subdomainId_[idx] = subdomain;
     cuda_[idx] = cuda;
 
-    if (0 == mpiTopo.rank()) {
+    if (root) {
       std::cerr << "idx=" << idx << " size=" << partition_.subdomain_size(idx) << " rank=" << rank << " node=" << node
                 << " inNodeId=" << inNodeId << " sysIdx=" << sysIdx << " nodeIdx=" << nodeIdx
                 << " subdomain=" << subdomain << " cuda=" << cuda << "\n";
@@ -197,4 +147,4 @@ IntraNodeRandom::IntraNodeRandom(const Dim3 &size, // total domain size
       idx_[rank].resize(subdomain + 1);
     idx_[rank][subdomain] = idx;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,145 @@
+#include "stencil/placement_sfc.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace sfc {
+
+uint64_t morton(const Dim3 &p, int bits) {
+  assert(bits <= 21);
+  uint64_t ret = 0;
+  for (int b = bits - 1; b >= 0; --b) {
+    ret = (ret << 3) | (((uint64_t(p.z) >> b) & 1) << 2) | (((uint64_t(p.y) >> b) & 1) << 1) |
+          ((uint64_t(p.x) >> b) & 1);
+  }
+  return ret;
+}
+
+/* J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707 (2004).
+   Transform the coordinates in place into the "transposed" Hilbert index, then interleave the bits
+*/
+uint64_t hilbert(const Dim3 &p, int bits) {
+  assert(bits <= 21);
+  const int n = 3;
+  uint32_t x[n] = {uint32_t(p.z), uint32_t(p.y), uint32_t(p.x)};
+
+  const uint32_t m = uint32_t(1) << (bits - 1);
+  // inverse undo
+  for (uint32_t q = m; q > 1; q >>= 1) {
+    const uint32_t mask = q - 1;
+    for (int i = 0; i < n; ++i) {
+      if (x[i] & q) {
+        x[0] ^= mask; // invert
+      } else {
+        const uint32_t t = (x[0] ^ x[i]) & mask; // exchange
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
+  }
+  // gray encode
+  for (int i = 1; i < n; ++i) {
+    x[i] ^= x[i - 1];
+  }
+  uint32_t t = 0;
+  for (uint32_t q = m; q > 1; q >>= 1) {
+    if (x[n - 1] & q) {
+      t ^= q - 1;
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    x[i] ^= t;
+  }
+
+  uint64_t ret = 0;
+  for (int b = bits - 1; b >= 0; --b) {
+    for (int i = 0; i < n; ++i) {
+      ret = (ret << 1) | ((x[i] >> b) & 1);
+    }
+  }
+  return ret;
+}
+
+int bits_for(const Dim3 &dim) {
+  const int64_t side = std::max(dim.x, std::max(dim.y, dim.z));
+  int bits = 1;
+  while ((int64_t(1) << bits) < side) {
+    ++bits;
+  }
+  return bits;
+}
+
+} // namespace sfc
+
+SpaceFillingCurve::SpaceFillingCurve(const Dim3 &size, MpiTopology &mpiTopo, const std::vector<int> &rankCudaIds,
+                                     const std::vector<double> &rankWeights, Curve curve, const Radius &radius) {
+  (void)mpiTopo;
+  place(size, JobLayout::gather(rankCudaIds, rankWeights), curve, radius);
+}
+
+SpaceFillingCurve::SpaceFillingCurve(const Dim3 &size, const JobLayout &job, Curve curve, const Radius &radius) {
+  place(size, job, curve, radius);
+}
+
+void SpaceFillingCurve::place(const Dim3 &size, const JobLayout &job, Curve curve, const Radius &radius) {
+
+  // (rank, subdomain id) of every device, grouped by node so each node gets a contiguous run of the curve
+  std::vector<std::pair<int, int>> slots;
+  for (const std::vector<int> &ranks : job.node_ranks()) {
+    for (int rank : ranks) {
+      for (size_t id = 0; id < job.cudaIds[rank].size(); ++id) {
+        slots.push_back(std::make_pair(rank, int(id)));
+      }
+    }
+  }
+  const int64_t numSubdomains = slots.size();
+
+  partition_ = RankPartition(size, numSubdomains);
+  const Dim3 dim = partition_.dim();
+  assert(dim.flatten() == numSubdomains);
+
+  // linear index of each subdomain, in curve order
+  const int bits = sfc::bits_for(dim);
+  std::vector<uint64_t> keys(numSubdomains);
+  for (int64_t z = 0; z < dim.z; ++z) {
+    for (int64_t y = 0; y < dim.y; ++y) {
+      for (int64_t x = 0; x < dim.x; ++x) {
+        const Dim3 idx(x, y, z);
+        keys[linear(idx)] = Curve::Hilbert == curve ? sfc::hilbert(idx, bits) : sfc::morton(idx, bits);
+      }
+    }
+  }
+  std::vector<size_t> order(numSubdomains);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+  rank_.assign(numSubdomains, -1);
+  subdomainId_.assign(numSubdomains, -1);
+  cuda_.assign(numSubdomains, -1);
+  idx_.assign(job.num_ranks(), {});
+  std::vector<double> weights(numSubdomains);
+  for (int64_t i = 0; i < numSubdomains; ++i) {
+    const size_t li = order[i];
+    const int rank = slots[i].first;
+    const int id = slots[i].second;
+    const Dim3 idx(li % dim.x, (li / dim.x) % dim.y, li / (dim.x * dim.y));
+
+    rank_[li] = rank;
+    subdomainId_[li] = id;
+    cuda_[li] = job.cudaIds[rank][id];
+    weights[li] = job.weights[rank][id];
+    if (idx_[rank].size() <= size_t(id)) {
+      idx_[rank].resize(id + 1);
+    }
+    idx_[rank][id] = idx;
+  }
+
+  // size subdomains by the throughput of the device they are assigned to
+  if (job.weighted()) {
+    partition_.set_weights(weights, min_extent(radius));
+  }
+
+  if (0 == mpi::world_rank()) {
+    LOG_INFO("SpaceFillingCurve: " << (Curve::Hilbert == curve ? "hilbert" : "morton") << " order over " << dim);
+  }
+}
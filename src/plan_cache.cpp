@@ -0,0 +1,366 @@
+#include "stencil/plan_cache.hpp"
+
+#include "stencil/logging.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+const int VERSION = 1;
+
+std::string key_str(uint64_t key) {
+  std::stringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << key;
+  return ss.str();
+}
+
+/* read "<word> <version>" and "key <key>". return false if they don't match
+ */
+bool read_header(std::istream &is, const std::string &word, uint64_t key) {
+  std::string w, k;
+  int version;
+  if (!(is >> w >> version) || w != word || version != VERSION) {
+    return false;
+  }
+  if (!(is >> w >> k) || w != "key" || k != key_str(key)) {
+    return false;
+  }
+  return true;
+}
+
+bool read_dim3(std::istream &is, Dim3 &d) { return bool(is >> d.x >> d.y >> d.z); }
+
+void write_messages(std::ostream &os, const std::vector<Message> &msgs) {
+  os << msgs.size() << "\n";
+  for (const Message &m : msgs) {
+    os << m.dir_.x << " " << m.dir_.y << " " << m.dir_.z << " " << m.srcGPU_ << " " << m.dstGPU_ << " " << m.ext().x
+       << " " << m.ext().y << " " << m.ext().z << "\n";
+  }
+}
+
+bool read_messages(std::istream &is, std::vector<Message> &msgs) {
+  size_t n;
+  if (!(is >> n)) {
+    return false;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    Dim3 dir, ext;
+    int srcGPU, dstGPU;
+    if (!read_dim3(is, dir) || !(is >> srcGPU >> dstGPU) || !read_dim3(is, ext)) {
+      return false;
+    }
+    msgs.push_back(Message(dir, srcGPU, dstGPU, ext));
+  }
+  return true;
+}
+
+void write_boxes(std::ostream &os, const std::string &word,
+                 const std::vector<std::map<Dim3, std::vector<Message>>> &boxes) {
+  for (size_t di = 0; di < boxes.size(); ++di) {
+    for (const auto &kv : boxes[di]) {
+      os << word << " " << di << " " << kv.first.x << " " << kv.first.y << " " << kv.first.z << " ";
+      write_messages(os, kv.second);
+    }
+  }
+}
+
+bool read_box(std::istream &is, size_t numDomains, std::vector<std::map<Dim3, std::vector<Message>>> &boxes) {
+  size_t di;
+  Dim3 idx;
+  if (!(is >> di) || di >= numDomains || !read_dim3(is, idx)) {
+    return false;
+  }
+  return read_messages(is, boxes[di][idx]);
+}
+
+} // namespace
+
+CachedPlacement::CachedPlacement(const Dim3 &dim, const AxisCuts &cuts, const std::vector<int> &ranks,
+                                 const std::vector<int> &ids, const std::vector<int> &cudas)
+    : dim_(dim), cuts_(cuts) {
+  assert(ranks.size() == size_t(dim.flatten()));
+  assert(ids.size() == ranks.size());
+  assert(cudas.size() == ranks.size());
+  size_t i = 0;
+  for (int64_t z = 0; z < dim.z; ++z) {
+    for (int64_t y = 0; y < dim.y; ++y) {
+      for (int64_t x = 0; x < dim.x; ++x, ++i) {
+        const Dim3 idx(x, y, z);
+        if (ranks[i] >= int(idx_.size())) {
+          idx_.resize(ranks[i] + 1);
+        }
+        if (ids[i] >= int(idx_[ranks[i]].size())) {
+          idx_[ranks[i]].resize(ids[i] + 1);
+        }
+        idx_[ranks[i]][ids[i]] = idx;
+        rank_[idx] = ranks[i];
+        subdomain_id_[idx] = ids[i];
+        cuda_[idx] = cudas[i];
+      }
+    }
+  }
+}
+
+namespace plan_cache {
+
+std::string path(const std::string &dir, uint64_t key, const std::string &what) {
+  std::string ret = dir;
+  if (!ret.empty() && ret.back() != '/') {
+    ret += "/";
+  }
+  return ret + "stencil_" + key_str(key) + "_" + what + ".txt";
+}
+
+uint64_t placement_key(uint64_t key, Placement &placement) {
+  Fnv1a hash;
+  hash.add(key);
+  const Dim3 dim = placement.dim();
+  hash.add(dim);
+  for (int64_t z = 0; z < dim.z; ++z) {
+    for (int64_t y = 0; y < dim.y; ++y) {
+      for (int64_t x = 0; x < dim.x; ++x) {
+        const Dim3 idx(x, y, z);
+        hash.add(placement.get_rank(idx)).add(placement.get_subdomain_id(idx)).add(placement.get_cuda(idx));
+        hash.add(placement.subdomain_size(idx)).add(placement.subdomain_origin(idx));
+      }
+    }
+  }
+  return hash.value();
+}
+
+bool write_placement(std::ostream &os, uint64_t key, const Dim3 &size, Placement &placement) {
+  Dim3 dim = placement.dim();
+
+  // slab widths along each axis, from the subdomains on the axis
+  std::vector<int64_t> widths[3];
+  for (int64_t x = 0; x < dim.x; ++x) {
+    widths[0].push_back(placement.subdomain_size(Dim3(x, 0, 0)).x);
+  }
+  for (int64_t y = 0; y < dim.y; ++y) {
+    widths[1].push_back(placement.subdomain_size(Dim3(0, y, 0)).y);
+  }
+  for (int64_t z = 0; z < dim.z; ++z) {
+    widths[2].push_back(placement.subdomain_size(Dim3(0, 0, z)).z);
+  }
+  const AxisCuts cuts(widths[0], widths[1], widths[2]);
+
+  // the slabs must describe every subdomain
+  for (int64_t z = 0; z < dim.z; ++z) {
+    for (int64_t y = 0; y < dim.y; ++y) {
+      for (int64_t x = 0; x < dim.x; ++x) {
+        const Dim3 idx(x, y, z);
+        if (!(cuts.size(idx) == placement.subdomain_size(idx)) ||
+            !(cuts.origin(idx) == placement.subdomain_origin(idx))) {
+          LOG_WARN("plan_cache: subdomain " << idx << " is not on a rectilinear grid, not caching placement");
+          return false;
+        }
+      }
+    }
+  }
+  if (!(cuts.origin(dim - 1) + cuts.size(dim - 1) == size)) {
+    LOG_WARN("plan_cache: subdomains do not cover " << size << ", not caching placement");
+    return false;
+  }
+
+  os << "stencil-placement " << VERSION << "\n";
+  os << "key " << key_str(key) << "\n";
+  os << "size " << size.x << " " << size.y << " " << size.z << "\n";
+  os << "dim " << dim.x << " " << dim.y << " " << dim.z << "\n";
+  for (int a = 0; a < 3; ++a) {
+    os << "cuts";
+    for (int64_t w : widths[a]) {
+      os << " " << w;
+    }
+    os << "\n";
+  }
+  // rank, subdomain id, and cuda id of each subdomain
+  for (int64_t z = 0; z < dim.z; ++z) {
+    for (int64_t y = 0; y < dim.y; ++y) {
+      for (int64_t x = 0; x < dim.x; ++x) {
+        const Dim3 idx(x, y, z);
+        os << placement.get_rank(idx) << " " << placement.get_subdomain_id(idx) << " " << placement.get_cuda(idx)
+           << "\n";
+      }
+    }
+  }
+  os << "end\n";
+  return bool(os);
+}
+
+CachedPlacement *read_placement(std::istream &is, uint64_t key, const Dim3 &size, int worldSize) {
+  if (!read_header(is, "stencil-placement", key)) {
+    return nullptr;
+  }
+
+  std::string w;
+  Dim3 sz, dim;
+  if (!(is >> w) || w != "size" || !read_dim3(is, sz) || !(sz == size)) {
+    return nullptr;
+  }
+  if (!(is >> w) || w != "dim" || !read_dim3(is, dim) || dim.x < 1 || dim.y < 1 || dim.z < 1) {
+    return nullptr;
+  }
+
+  std::vector<int64_t> widths[3];
+  for (int a = 0; a < 3; ++a) {
+    if (!(is >> w) || w != "cuts") {
+      return nullptr;
+    }
+    const int64_t n = a == 0 ? dim.x : (a == 1 ? dim.y : dim.z);
+    int64_t total = 0;
+    for (int64_t i = 0; i < n; ++i) {
+      int64_t width;
+      if (!(is >> width) || width < 1) {
+        return nullptr;
+      }
+      widths[a].push_back(width);
+      total += width;
+    }
+    if (total != (a == 0 ? size.x : (a == 1 ? size.y : size.z))) {
+      return nullptr;
+    }
+  }
+
+  const size_t n = dim.flatten();
+  std::vector<int> ranks(n), ids(n), cudas(n);
+  std::vector<std::vector<int>> seen(worldSize); // seen[rank][id] = times that subdomain id was seen
+  for (size_t i = 0; i < n; ++i) {
+    if (!(is >> ranks[i] >> ids[i] >> cudas[i])) {
+      return nullptr;
+    }
+    if (ranks[i] < 0 || ranks[i] >= worldSize || ids[i] < 0 || ids[i] >= int(n)) {
+      return nullptr;
+    }
+    if (ids[i] >= int(seen[ranks[i]].size())) {
+      seen[ranks[i]].resize(ids[i] + 1, 0);
+    }
+    ++seen[ranks[i]][ids[i]];
+  }
+  if (!(is >> w) || w != "end") {
+    return nullptr;
+  }
+
+  // every rank has subdomains 0..<N exactly once
+  for (const auto &s : seen) {
+    if (s.empty()) {
+      return nullptr;
+    }
+    for (int c : s) {
+      if (1 != c) {
+        return nullptr;
+      }
+    }
+  }
+
+  return new CachedPlacement(dim, AxisCuts(widths[0], widths[1], widths[2]), ranks, ids, cudas);
+}
+
+void write_plan(std::ostream &os, uint64_t key, const ExchangePlan &plan) {
+  os << "stencil-plan " << VERSION << "\n";
+  os << "key " << key_str(key) << "\n";
+  os << "domains " << plan.coloOutboxes.size() << "\n";
+  os << "peer-access ";
+  write_messages(os, plan.peerAccessOutbox);
+  for (size_t di = 0; di < plan.peerCopyOutboxes.size(); ++di) {
+    for (size_t dj = 0; dj < plan.peerCopyOutboxes[di].size(); ++dj) {
+      if (!plan.peerCopyOutboxes[di][dj].empty()) {
+        os << "peer-copy " << di << " " << dj << " ";
+        write_messages(os, plan.peerCopyOutboxes[di][dj]);
+      }
+    }
+  }
+  write_boxes(os, "colo-out", plan.coloOutboxes);
+  write_boxes(os, "colo-in", plan.coloInboxes);
+  write_boxes(os, "remote-out", plan.remoteOutboxes);
+  write_boxes(os, "remote-in", plan.remoteInboxes);
+  os << "end\n";
+}
+
+bool read_plan(std::istream &is, uint64_t key, size_t numDomains, ExchangePlan &plan) {
+  if (!read_header(is, "stencil-plan", key)) {
+    return false;
+  }
+
+  std::string w;
+  size_t n;
+  if (!(is >> w >> n) || w != "domains" || n != numDomains) {
+    return false;
+  }
+
+  ExchangePlan ret;
+  ret.resize(numDomains);
+  while (is >> w) {
+    if (w == "end") {
+      plan = ret;
+      return true;
+    } else if (w == "peer-access") {
+      if (!read_messages(is, ret.peerAccessOutbox)) {
+        return false;
+      }
+    } else if (w == "peer-copy") {
+      size_t di, dj;
+      if (!(is >> di >> dj) || di >= numDomains || dj >= numDomains ||
+          !read_messages(is, ret.peerCopyOutboxes[di][dj])) {
+        return false;
+      }
+    } else if (w == "colo-out") {
+      if (!read_box(is, numDomains, ret.coloOutboxes)) {
+        return false;
+      }
+    } else if (w == "colo-in") {
+      if (!read_box(is, numDomains, ret.coloInboxes)) {
+        return false;
+      }
+    } else if (w == "remote-out") {
+      if (!read_box(is, numDomains, ret.remoteOutboxes)) {
+        return false;
+      }
+    } else if (w == "remote-in") {
+      if (!read_box(is, numDomains, ret.remoteInboxes)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return false; // truncated
+}
+
+void write_methods(std::ostream &os, uint64_t key, const std::vector<Method> &methods) {
+  os << "stencil-methods " << VERSION << "\n";
+  os << "key " << key_str(key) << "\n";
+  os << "messages " << methods.size() << "\n";
+  for (const Method &m : methods) {
+    os << int(m) << "\n";
+  }
+  os << "end\n";
+}
+
+bool read_methods(std::istream &is, uint64_t key, size_t n, std::vector<Method> &methods) {
+  if (!read_header(is, "stencil-methods", key)) {
+    return false;
+  }
+
+  std::string w;
+  size_t m;
+  if (!(is >> w >> m) || w != "messages" || m != n) {
+    return false;
+  }
+
+  std::vector<Method> ret(n);
+  for (size_t i = 0; i < n; ++i) {
+    int flags;
+    if (!(is >> flags)) {
+      return false;
+    }
+    ret[i] = Method(flags);
+  }
+  if (!(is >> w) || w != "end") {
+    return false;
+  }
+  methods = ret;
+  return true;
+}
+
+} // namespace plan_cache
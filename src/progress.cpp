@@ -0,0 +1,72 @@
+#include "stencil/progress.hpp"
+
+#include "stencil/logging.hpp"
+
+#include <cassert>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+ProgressThread::ProgressThread(const std::function<bool()> &poll, int core)
+    : poll_(poll), active_(false), shutdown_(false), thread_(&ProgressThread::run, this) {
+  if (core >= 0) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (0 != pthread_setaffinity_np(thread_.native_handle(), sizeof(set), &set)) {
+      LOG_WARN("ProgressThread: unable to pin to core " << core);
+    }
+#else
+    LOG_WARN("ProgressThread: pinning to core " << core << " is not supported on this platform");
+#endif
+  }
+}
+
+ProgressThread::~ProgressThread() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !active_; });
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void ProgressThread::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return active_ || shutdown_; });
+    if (shutdown_) {
+      return;
+    }
+    lock.unlock();
+    while (poll_()) {
+      std::this_thread::yield();
+    }
+    lock.lock();
+    active_ = false;
+    cv_.notify_all();
+  }
+}
+
+void ProgressThread::start() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(!active_);
+    active_ = true;
+  }
+  cv_.notify_all();
+}
+
+bool ProgressThread::done() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !active_;
+}
+
+void ProgressThread::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return !active_; });
+}
@@ -20,6 +20,15 @@ void RcStream::decrement() {
   }
 }
 
+bool RcStream::done() const {
+  cudaError_t err = cudaStreamQuery(stream_);
+  if (cudaErrorNotReady == err) {
+    return false;
+  }
+  CUDA_RUNTIME(err);
+  return true;
+}
+
 RcStream::RcStream(int dev, Priority requestedPriority) : count_(new size_t), dev_(dev) {
   *count_ = 1;
   CUDA_RUNTIME(cudaSetDevice(dev_));
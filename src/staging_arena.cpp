@@ -0,0 +1,204 @@
+#include "stencil/staging_arena.hpp"
+
+#include "stencil/cuda_runtime.hpp"
+#include "stencil/logging.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+#include <sys/mman.h>
+
+namespace {
+size_t round_up(size_t n, size_t to) { return (n + to - 1) / to * to; }
+} // namespace
+
+constexpr size_t StagingArena::kAlign;
+constexpr size_t StagingArena::kMinBlock;
+constexpr size_t StagingArena::kHugePage;
+
+StagingArena::StagingArena(Kind kind) : kind_(kind), footprint_(0), inUse_(0), highWater_(0) {}
+
+StagingArena::~StagingArena() {
+  if (!allocs_.empty()) {
+    LOG_WARN("StagingArena: " << allocs_.size() << " buffers still allocated at exit");
+  }
+  while (!blocks_.empty()) {
+    free_block(blocks_.begin()->first);
+  }
+}
+
+StagingArena &StagingArena::pinned() {
+  static StagingArena arena(Kind::Pinned);
+  return arena;
+}
+
+StagingArena &StagingArena::host() {
+  static StagingArena arena(Kind::Host);
+  return arena;
+}
+
+std::map<char *, StagingArena::Block>::iterator StagingArena::add_block(size_t n) {
+  // at least doubles the footprint, so there are few blocks
+  size_t size = std::max(std::max(round_up(n, kAlign), footprint_), kMinBlock);
+  char *base = nullptr;
+  if (Kind::Pinned == kind_) {
+    CUDA_RUNTIME(cudaHostAlloc(&base, size, cudaHostAllocDefault));
+  } else {
+    size = round_up(size, kHugePage);
+    void *p = nullptr;
+    if (0 != posix_memalign(&p, kHugePage, size)) {
+      LOG_FATAL("StagingArena: unable to reserve " << size << "B");
+    }
+    base = static_cast<char *>(p);
+#ifdef MADV_HUGEPAGE
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+    std::memset(base, 0, size); // first touch places the pages near this thread
+  }
+  assert(base);
+  LOG_DEBUG("StagingArena: reserved " << size << "B " << (Kind::Pinned == kind_ ? "pinned" : "host"));
+
+  Block block;
+  block.size = size;
+  block.used = 0;
+  block.free[0] = size;
+  footprint_ += size;
+  return blocks_.emplace(base, block).first;
+}
+
+void StagingArena::free_block(char *base) {
+  auto it = blocks_.find(base);
+  assert(it != blocks_.end());
+  footprint_ -= it->second.size;
+  blocks_.erase(it);
+  if (Kind::Pinned == kind_) {
+    // the process-wide arenas are destroyed at exit, possibly after the CUDA runtime
+    cudaError_t err = cudaFreeHost(base);
+    if (cudaErrorCudartUnloading != err) {
+      CUDA_RUNTIME(err);
+    }
+  } else {
+    std::free(base);
+  }
+}
+
+void *StagingArena::allocate(size_t n) {
+  if (0 == n) {
+    return nullptr;
+  }
+  n = round_up(n, kAlign);
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  // first fit
+  auto bit = blocks_.begin();
+  std::map<size_t, size_t>::iterator fit;
+  for (; bit != blocks_.end(); ++bit) {
+    std::map<size_t, size_t> &free = bit->second.free;
+    for (fit = free.begin(); fit != free.end() && fit->second < n; ++fit) {
+    }
+    if (fit != free.end()) {
+      break;
+    }
+  }
+  if (bit == blocks_.end()) {
+    bit = add_block(n);
+    fit = bit->second.free.begin();
+  }
+
+  Block &block = bit->second;
+  const size_t offset = fit->first;
+  const size_t left = fit->second - n;
+  block.free.erase(fit);
+  if (left) {
+    block.free[offset + n] = left;
+  }
+  block.used += n;
+
+  char *ret = bit->first + offset;
+  allocs_[ret] = n;
+  inUse_ += n;
+  highWater_ = std::max(highWater_, inUse_);
+  return ret;
+}
+
+void StagingArena::deallocate(void *p) {
+  if (!p) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mtx_);
+  char *c = static_cast<char *>(p);
+  auto ait = allocs_.find(c);
+  if (ait == allocs_.end()) {
+    LOG_FATAL("StagingArena: " << p << " was not allocated here");
+  }
+  const size_t n = ait->second;
+  allocs_.erase(ait);
+  inUse_ -= n;
+
+  // the block that holds it is the last one that starts at or before it
+  auto bit = blocks_.upper_bound(c);
+  assert(bit != blocks_.begin());
+  --bit;
+  Block &block = bit->second;
+  block.used -= n;
+
+  // put it back, merged with the free ranges on either side
+  size_t offset = c - bit->first;
+  size_t len = n;
+  auto next = block.free.lower_bound(offset);
+  if (next != block.free.end() && offset + len == next->first) {
+    len += next->second;
+    next = block.free.erase(next);
+  }
+  if (next != block.free.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      len += prev->second;
+      block.free.erase(prev);
+    }
+  }
+  block.free[offset] = len;
+}
+
+void StagingArena::reserve(size_t n) {
+  n = round_up(n, kAlign);
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto &kv : blocks_) {
+    for (auto &f : kv.second.free) {
+      if (f.second >= n) {
+        return;
+      }
+    }
+  }
+  add_block(n);
+}
+
+void StagingArena::trim() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto it = blocks_.begin(); it != blocks_.end();) {
+    char *base = it->first;
+    ++it;
+    if (0 == blocks_[base].used) {
+      free_block(base);
+    }
+  }
+}
+
+size_t StagingArena::footprint() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return footprint_;
+}
+
+size_t StagingArena::in_use() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return inUse_;
+}
+
+size_t StagingArena::high_water() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return highWater_;
+}
@@ -1,13 +1,26 @@
 #include "stencil/stencil.hpp"
 
 #include "stencil/logging.hpp"
+#include "stencil/staging_arena.hpp"
 #include "stencil/tx_colocated.cuh"
 
+#include <cstdio>
 #include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <sstream>
 #include <vector>
 
 DistributedDomain::DistributedDomain(size_t x, size_t y, size_t z)
-    : size_(x, y, z), placement_(nullptr), flags_(Method::Default), strategy_(PlacementStrategy::NodeAware) {
+    : size_(x, y, z), numDevices_(0), placement_(nullptr), haloDepth_(1), stepsSinceExchange_(1),
+      flags_(Method::Default), strategy_(PlacementStrategy::NodeAware), numExchanges_(0), exchangeActive_(false),
+      progress_(nullptr), useProgress_(false), progressCore_(-1), numRounds_(1),
+      exchangeRounds_(ExchangeRounds::Direct), round_(0), aggregate_(false),
+      compress_(CompressConfig{false, 4, 12.5e9}), autotune_(false), autotuneWarmup_(2), autotuneTrials_(5),
+      tuning_(false), roundStart_(0), cacheKey_(0), calibrate_(false),
+      forceHost_(false),
+      boundary_{Topology::Boundary::PERIODIC, Topology::Boundary::PERIODIC, Topology::Boundary::PERIODIC} {
 
 #ifdef STENCIL_SETUP_STATS
   timeMpiTopo_ = 0;
@@ -32,6 +45,51 @@ DistributedDomain::DistributedDomain(size_t x, size_t y, size_t z)
   if (const char *s = std::getenv("STENCIL_OUTPUT_PREFIX")) {
     outputPrefix_ = std::string(s);
   }
+  if (const char *s = std::getenv("STENCIL_NETWORK_FILE")) {
+    networkFile_ = std::string(s);
+  }
+  if (const char *s = std::getenv("STENCIL_CACHE_DIR")) {
+    cacheDir_ = std::string(s);
+  }
+  if (const char *s = std::getenv("STENCIL_CALIBRATE")) {
+    calibrate_ = std::string("1") == s;
+  }
+  if (const char *s = std::getenv("STENCIL_HOST")) {
+    forceHost_ = std::string("1") == s;
+  }
+  if (const char *s = std::getenv("STENCIL_AGGREGATE")) {
+    aggregate_ = std::string("1") == s;
+  }
+  if (const char *s = std::getenv("STENCIL_COMPRESS")) {
+    compress_.enable = std::string("1") == s;
+  }
+  if (const char *s = std::getenv("STENCIL_COMPRESS_BANDWIDTH")) {
+    compress_.linkBandwidth = std::atof(s);
+  }
+  if (const char *s = std::getenv("STENCIL_COMPRESS_THREADS")) {
+    compress_.threads = std::atoi(s);
+  }
+  if (const char *s = std::getenv("STENCIL_AUTOTUNE")) {
+    autotune_ = std::string("1") == s;
+  }
+  if (const char *s = std::getenv("STENCIL_EXCHANGE_ROUNDS")) {
+    if (std::string("direct") == s) {
+      exchangeRounds_ = ExchangeRounds::Direct;
+    } else if (std::string("phased") == s) {
+      exchangeRounds_ = ExchangeRounds::Phased;
+    } else if (std::string("auto") == s) {
+      exchangeRounds_ = ExchangeRounds::Auto;
+    } else {
+      LOG_WARN("STENCIL_EXCHANGE_ROUNDS=" << s << " is not direct, phased, or auto");
+    }
+  }
+  if (const char *s = std::getenv("STENCIL_HALO_DEPTH")) {
+    set_halo_depth(std::atoi(s));
+  }
+  if (const char *s = std::getenv("STENCIL_PROGRESS_CORE")) {
+    useProgress_ = true;
+    progressCore_ = std::atoi(s);
+  }
 
 #ifdef STENCIL_SETUP_STATS
   MPI_Barrier(MPI_COMM_WORLD);
@@ -49,9 +107,23 @@ DistributedDomain::DistributedDomain(size_t x, size_t y, size_t z)
 
   LOG_DEBUG("colocated with " << mpiTopology_.colocated_size() << " ranks");
 
-  int deviceCount;
-  CUDA_RUNTIME(cudaGetDeviceCount(&deviceCount));
+  int deviceCount = 0;
+  if (cudaSuccess != cudaGetDeviceCount(&deviceCount)) {
+    // no driver or no devices. Clear the error so a later CUDA_RUNTIME doesn't report it
+    (void)cudaGetLastError();
+    deviceCount = 0;
+  }
   std::cerr << "[" << rank_ << "] cudaGetDeviceCount= " << deviceCount << "\n";
+  numDevices_ = deviceCount;
+
+  // without CUDA devices, domains are in host memory and every exchange is over MPI
+  if (0 == numDevices_) {
+    LOG_INFO("no CUDA devices, using host memory");
+    forceHost_ = true;
+  }
+  if (forceHost_) {
+    flags_ = Method::HostMpi;
+  }
 
   /*
   cudaComputeModeDefault = 0
@@ -72,8 +144,12 @@ DistributedDomain::DistributedDomain(size_t x, size_t y, size_t z)
 
   // Determine GPUs this DistributedDomain is reposible for
   if (gpus_.empty()) {
+    // one domain per rank in host memory
+    if (0 == deviceCount) {
+      gpus_.push_back(0);
+    }
     // if fewer colocated ranks than GPUs, round-robin GPUs to ranks
-    if (mpiTopology_.colocated_size() <= deviceCount) {
+    else if (mpiTopology_.colocated_size() <= deviceCount) {
       for (int id = 0; id < deviceCount; ++id) {
         if (id % mpiTopology_.colocated_size() == mpiTopology_.colocated_rank()) {
           gpus_.push_back(id);
@@ -120,9 +196,11 @@ DistributedDomain::DistributedDomain(size_t x, size_t y, size_t z)
 #endif
   // Try to enable peer access between all GPUs
   nvtxRangePush("peer_en");
-  for (const auto &srcGpu : gpus_) {
-    for (const auto &dstGpu : nodeCudaIds) {
-      gpu_topo::enable_peer(srcGpu, dstGpu);
+  if (numDevices_) {
+    for (const auto &srcGpu : gpus_) {
+      for (const auto &dstGpu : nodeCudaIds) {
+        gpu_topo::enable_peer(srcGpu, dstGpu);
+      }
     }
   }
   nvtxRangePop();
@@ -133,13 +211,15 @@ DistributedDomain::DistributedDomain(size_t x, size_t y, size_t z)
     timePeerEn_ += maxElapsed;
   }
 #endif
-  CUDA_RUNTIME(cudaGetLastError());
+  if (numDevices_) {
+    CUDA_RUNTIME(cudaGetLastError());
+  }
 }
 
 uint64_t DistributedDomain::exchange_bytes_for_method(const Method &method) const {
   uint64_t ret = 0;
 #ifdef STENCIL_SETUP_STATS
-  if (method && Method::CudaMpi) {
+  if (method && (Method::CudaMpi | Method::HostMpi)) {
     ret += numBytesCudaMpi_;
   }
   if (method && Method::ColoQuantityKernel) {
@@ -162,40 +242,141 @@ uint64_t DistributedDomain::exchange_bytes_for_method(const Method &method) cons
 
 DistributedDomain::~DistributedDomain() {
   LOG_SPEW("~DD entry");
-  for (auto &m : remoteSenders_) {
+  // joins the thread, which may still be polling the senders and recvers
+  delete progress_;
+  progress_ = nullptr;
+  for (ExchangeRound &round : rounds_) {
+    round.clear();
+  }
+  if (placement_) {
+    delete placement_;
+    placement_ = nullptr;
+  }
+  LOG_SPEW("~DD: exit");
+}
+
+void ExchangeRound::clear() {
+  for (auto &m : remoteSenders) {
     for (auto &kv : m) {
       delete kv.second;
     }
   }
-  for (auto &m : remoteRecvers_) {
+  for (auto &m : remoteRecvers) {
     for (auto &kv : m) {
       delete kv.second;
     }
   }
-  for (auto &m : coloSenders_) {
+  for (auto &kv : rankSenders) {
+    delete kv.second;
+  }
+  for (auto &kv : rankRecvers) {
+    delete kv.second;
+  }
+  for (auto &m : coloSenders) {
     for (auto &kv : m) {
       delete kv.second;
     }
   }
-  for (auto &m : coloRecvers_) {
+  for (auto &m : coloRecvers) {
     for (auto &kv : m) {
       delete kv.second;
     }
   }
-  if (placement_) {
-    delete placement_;
-    placement_ = nullptr;
-  }
-  LOG_SPEW("~DD: exit");
+  remoteSenders.clear();
+  remoteRecvers.clear();
+  rankSenders.clear();
+  rankRecvers.clear();
+  coloSenders.clear();
+  coloRecvers.clear();
+  haloSources.clear();
 }
 
 void DistributedDomain::set_methods(Method flags) noexcept {
   if ((flags && Method::ColoQuantityKernel) && (flags && Method::ColoPackMemcpyUnpack)) {
     LOG_FATAL("can't use Direct Access and Pack-Memcpy-Unpack for colocated ranks");
   }
+  if (forceHost_ && !(Method::HostMpi == flags)) {
+    LOG_INFO("using " << to_string(Method::HostMpi) << " instead of " << to_string(flags)
+                      << (numDevices_ ? " (STENCIL_HOST=1)" : " (no CUDA devices)"));
+    flags = Method::HostMpi;
+  } else if ((flags && Method::HostMpi) && !(Method::HostMpi == flags)) {
+    LOG_WARN("Method::HostMpi can't be combined with other methods, using only Method::HostMpi");
+    flags = Method::HostMpi;
+  }
   flags_ = flags;
 }
 
+uint64_t DistributedDomain::cache_key() {
+  if (PlacementStrategy::Exhaustive == strategy_ && partitionCost_) {
+    LOG_INFO("placement: a custom partition cost can't be fingerprinted, not caching");
+    return 0;
+  }
+
+  // the devices this rank uses
+  Fnv1a rankHash;
+  for (size_t i = 0; i < gpus_.size(); ++i) {
+    rankHash.add(gpus_[i]);
+    if (numDevices_) {
+      cudaDeviceProp prop;
+      CUDA_RUNTIME(cudaGetDeviceProperties(&prop, gpus_[i]));
+      rankHash.add(prop.uuid.bytes, sizeof(prop.uuid.bytes));
+    }
+  }
+  for (double w : gpuWeights_) {
+    rankHash.add(w);
+  }
+  const uint64_t rankKey = rankHash.value();
+  std::vector<uint64_t> rankKeys(worldSize_);
+  MPI_Allgather(&rankKey, 1, MPI_UINT64_T, rankKeys.data(), 1, MPI_UINT64_T, MPI_COMM_WORLD);
+
+  // the machine
+  Machine machine = Machine::build(MPI_COMM_WORLD);
+
+  Fnv1a hash;
+  hash.add(size_);
+  const Radius halo = halo_radius();
+  for (int z = -1; z <= 1; ++z) {
+    for (int y = -1; y <= 1; ++y) {
+      for (int x = -1; x <= 1; ++x) {
+        hash.add(halo.dir(x, y, z));
+      }
+    }
+  }
+  hash.add(dataElemSize_.size());
+  for (size_t elemSize : dataElemSize_) {
+    hash.add(elemSize);
+  }
+  hash.add(int(flags_)).add(int(strategy_)).add(calibrate_).add(autotune_);
+  hash.add(int(boundary_[0])).add(int(boundary_[1])).add(int(boundary_[2]));
+  if (!networkFile_.empty()) {
+    std::ifstream file(networkFile_);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    hash.add(ss.str());
+  }
+  hash.add(machine.num_nodes());
+  for (int node = 0; node < machine.num_nodes(); ++node) {
+    hash.add(machine.hostname(node));
+  }
+  hash.add(machine.num_ranks());
+  for (int rank = 0; rank < machine.num_ranks(); ++rank) {
+    hash.add(machine.node_of_rank(rank)).add(rankKeys[rank]);
+  }
+  hash.add(machine.num_gpus());
+  for (int i = 0; i < machine.num_gpus(); ++i) {
+    const GPU &gpu = machine.gpu(i);
+    hash.add(gpu.uuid().bytes_, sizeof(gpu.uuid().bytes_));
+    for (int rank : gpu.ranks()) {
+      hash.add(rank);
+    }
+  }
+
+  // use rank 0's key everywhere, in case a rank sees a different network file
+  uint64_t key = hash.value() ? hash.value() : 1; // 0 means "not caching"
+  MPI_Bcast(&key, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+  return key;
+}
+
 /* place domains on GPUs, and initialize topology
  */
 void DistributedDomain::do_placement() {
@@ -207,25 +388,123 @@ void DistributedDomain::do_placement() {
   double start = MPI_Wtime();
 #endif
   nvtxRangePush("placement");
-  switch (strategy_) {
-  case PlacementStrategy::NodeAware: {
-    assert(!placement_);
-    placement_ = new NodeAware(size_, mpiTopology_, radius_, gpus_);
-    break;
-  }
-  case PlacementStrategy::Trivial: {
-    assert(!placement_);
-    placement_ = new Trivial(size_, mpiTopology_, gpus_);
-    break;
-  }
-  case PlacementStrategy::IntraNodeRandom: {
-    assert(!placement_);
-    placement_ = new IntraNodeRandom(size_, mpiTopology_, radius_, gpus_);
-    break;
+
+  // try to reuse a placement from the cache.
+  // Rank 0 reads it for everyone, so all ranks agree whether to skip the (collective) placement
+  cacheKey_ = cacheDir_.empty() ? 0 : cache_key();
+  if (cacheKey_) {
+    const std::string path = plan_cache::path(cacheDir_, cacheKey_, "placement");
+    std::string contents;
+    if (0 == rank_) {
+      std::ifstream file(path);
+      std::stringstream ss;
+      ss << file.rdbuf();
+      contents = ss.str();
+    }
+    uint64_t len = contents.size();
+    MPI_Bcast(&len, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    contents.resize(len);
+    MPI_Bcast(&contents[0], len, MPI_CHAR, 0, MPI_COMM_WORLD);
+    std::istringstream is(contents);
+    placement_ = plan_cache::read_placement(is, cacheKey_, size_, worldSize_);
+    if (placement_) {
+      LOG_INFO("placement: loaded " << path);
+    } else if (len) {
+      LOG_INFO("placement: ignoring stale " << path);
+    }
   }
+
+  if (!placement_) {
+    // weigh halos by their bytes across all quantities
+    CommModel model;
+    model.bytesPerCell = std::accumulate(dataElemSize_.begin(), dataElemSize_.end(), size_t(0));
+    model.calibrate = calibrate_;
+    std::copy(boundary_, boundary_ + 3, model.boundary);
+
+    // these ask the GPUs in each node how they are connected, which doesn't matter in host memory
+    PlacementStrategy strategy = strategy_;
+    if (any_methods(Method::HostMpi) && (PlacementStrategy::NodeAware == strategy ||
+                                         PlacementStrategy::Exhaustive == strategy ||
+                                         PlacementStrategy::IntraNodeRandom == strategy)) {
+      LOG_WARN("placement: " << to_string(strategy) << " placement needs GPUs, but domains are in host memory. Using "
+                             << to_string(PlacementStrategy::Hilbert) << " placement instead");
+      strategy = PlacementStrategy::Hilbert;
+    }
+
+    switch (strategy) {
+    case PlacementStrategy::NodeAware: {
+      assert(!placement_);
+      placement_ = new NodeAware(size_, mpiTopology_, halo_radius(), gpus_, networkFile_, gpuWeights_, nullptr, model);
+      break;
+    }
+    case PlacementStrategy::Trivial: {
+      assert(!placement_);
+      placement_ = new Trivial(size_, mpiTopology_, gpus_, gpuWeights_, halo_radius());
+      break;
+    }
+    case PlacementStrategy::Exhaustive: {
+      assert(!placement_);
+      PartitionCost cost = partitionCost_;
+      if (!cost) {
+        // inter-node links are several times slower than intra-node links
+        cost = partition_cost::halo_bytes(halo_radius(), model.bytesPerCell, 4);
+      }
+      placement_ = new NodeAware(size_, mpiTopology_, halo_radius(), gpus_, networkFile_, gpuWeights_, cost, model);
+      break;
+    }
+    case PlacementStrategy::IntraNodeRandom: {
+      assert(!placement_);
+      if (!gpuWeights_.empty()) {
+        LOG_WARN("IntraNodeRandom placement ignores GPU weights");
+      }
+      placement_ = new IntraNodeRandom(size_, mpiTopology_, halo_radius(), gpus_);
+      break;
+    }
+    case PlacementStrategy::Hilbert: {
+      assert(!placement_);
+      placement_ = new SpaceFillingCurve(size_, mpiTopology_, gpus_, gpuWeights_, SpaceFillingCurve::Curve::Hilbert,
+                                         halo_radius());
+      break;
+    }
+    case PlacementStrategy::Morton: {
+      assert(!placement_);
+      placement_ = new SpaceFillingCurve(size_, mpiTopology_, gpus_, gpuWeights_, SpaceFillingCurve::Curve::Morton,
+                                         halo_radius());
+      break;
+    }
+    }
+
+    // save for next time. Written to a temporary file first so a concurrent reader never sees part of it
+    if (cacheKey_ && 0 == rank_) {
+      const std::string path = plan_cache::path(cacheDir_, cacheKey_, "placement");
+      std::ofstream file(path + ".tmp");
+      if (plan_cache::write_placement(file, cacheKey_, size_, *placement_)) {
+        file.close();
+        if (0 != std::rename((path + ".tmp").c_str(), path.c_str())) {
+          LOG_WARN("placement: unable to write " << path);
+        }
+      } else {
+        file.close();
+        std::remove((path + ".tmp").c_str());
+      }
+    }
   }
   assert(placement_);
   nvtxRangePop(); // "placement"
+
+  // a subdomain thinner than its halos would send part of its own halo as its neighbor's
+  {
+    const Dim3 minSize = min_extent(halo_radius());
+    const Dim3 dim = placement_->dim();
+    for (int64_t i = 0; i < dim.flatten(); ++i) {
+      const Dim3 idx(i % dim.x, (i / dim.x) % dim.y, i / (dim.x * dim.y));
+      const Dim3 sz = placement_->subdomain_size(idx);
+      if (sz.x < minSize.x || sz.y < minSize.y || sz.z < minSize.z) {
+        LOG_FATAL("placement: subdomain " << idx << " is " << sz << ", thinner than its halos need (" << minSize
+                                          << "). Use fewer GPUs, a larger domain, or less skewed weights");
+      }
+    }
+  }
 #ifdef STENCIL_SETUP_STATS
   double maxElapsed = -1;
   double elapsed = MPI_Wtime() - start;
@@ -235,13 +514,80 @@ void DistributedDomain::do_placement() {
   }
 #endif
 
-  topology_ = Topology(placement_->dim(), Topology::Boundary::PERIODIC);
+  // report the volume each rank ended up with
+  if (0 == rank_) {
+    std::vector<uint64_t> rankVolume(worldSize_, 0);
+    const Dim3 dim = placement_->dim();
+    for (int64_t z = 0; z < dim.z; ++z) {
+      for (int64_t y = 0; y < dim.y; ++y) {
+        for (int64_t x = 0; x < dim.x; ++x) {
+          const Dim3 idx(x, y, z);
+          rankVolume[placement_->get_rank(idx)] += placement_->subdomain_size(idx).flatten();
+        }
+      }
+    }
+    const double avgVolume = double(size_.flatten()) / worldSize_;
+    for (int r = 0; r < worldSize_; ++r) {
+      LOG_INFO("placement: rank " << r << " volume=" << rankVolume[r] << " (" << rankVolume[r] / avgVolume
+                                  << "x average)");
+    }
+  }
+
+  topology_ = Topology(placement_->dim(), boundary_[0], boundary_[1], boundary_[2]);
 }
 
 void DistributedDomain::realize() {
 
+  for (int axis = 0; axis < 3; ++axis) {
+    if (Topology::Boundary::OPEN == boundary_[axis]) {
+      continue;
+    }
+    for (const auto &fills : boundaryFills_) {
+      if (fills[2 * axis] || fills[2 * axis + 1]) {
+        LOG_WARN("boundary condition on periodic axis " << axis << " is ignored");
+      }
+    }
+  }
+
+  // only RemoteSender and RemoteRecver compress
+#if STENCIL_USE_CUDA_AWARE_MPI == 1
+  const bool staged = false;
+#else
+  const bool staged = any_methods(Method::CudaMpi) && !any_methods(Method::HostMpi);
+#endif
+  if (compress_.enable && (!staged || aggregate_)) {
+    LOG_WARN("compression only applies to host-staged Method::CudaMpi messages that are not aggregated");
+  }
+  if (compress_.enable && compress_.linkBandwidth <= 0) {
+    LOG_FATAL("compression link bandwidth must be positive");
+  }
+
   do_placement();
 
+  // every rank sees the same placement, so they agree on the number of rounds
+  numRounds_ = 1;
+  if (ExchangeRounds::Phased == exchangeRounds_) {
+    numRounds_ = 3;
+  } else if (ExchangeRounds::Auto == exchangeRounds_) {
+    size_t bytesPerCell = 0; // in the remote messages
+    for (size_t qi = 0; qi < dataElemSize_.size(); ++qi) {
+      bytesPerCell += dataWire_[qi].wire_size(dataElemSize_[qi]);
+    }
+    // about latency times bandwidth of the interconnect (1us at 16 GB/s)
+    const size_t latencyBytes = 16 * 1024;
+    // weighted subdomains differ in size, so every one of them must prefer it
+    bool phased = true;
+    const Dim3 dim = placement_->dim();
+    for (int64_t i = 0; i < dim.flatten() && phased; ++i) {
+      const Dim3 idx(i % dim.x, (i / dim.x) % dim.y, i / (dim.x * dim.y));
+      phased = prefer_phased(placement_->subdomain_size(idx), halo_radius(), bytesPerCell, latencyBytes);
+    }
+    if (phased) {
+      numRounds_ = 3;
+    }
+  }
+  LOG_INFO(numRounds_ << " exchange round(s)");
+
 #ifdef STENCIL_SETUP_STATS
   MPI_Barrier(MPI_COMM_WORLD);
   double start = MPI_Wtime();
@@ -258,10 +604,15 @@ void DistributedDomain::realize() {
 
     LOG_DEBUG("domain=" << domId << " cuda=" << cudaId << " idx=" << idx);
 
-    LocalDomain sd(sdSize, sdOrigin, cudaId);
-    sd.set_radius(radius_);
+    LocalDomain sd(sdSize, sdOrigin, cudaId, any_methods(Method::HostMpi));
+    sd.set_radius(halo_radius());
+    sd.set_phased(numRounds_ > 1);
     for (size_t dataIdx = 0; dataIdx < dataElemSize_.size(); ++dataIdx) {
       sd.add_data(dataElemSize_[dataIdx]);
+      sd.set_wire_format(dataIdx, dataWire_[dataIdx]);
+    }
+    for (const std::vector<int64_t> &set : quantitySets_) {
+      sd.add_quantity_set(set);
     }
 
     domains_.push_back(sd);
@@ -279,198 +630,60 @@ void DistributedDomain::realize() {
   }
 #endif
 
-#ifdef STENCIL_SETUP_STATS
-  MPI_Barrier(MPI_COMM_WORLD);
-  start = MPI_Wtime();
-#endif
-
-  // outbox for same-GPU exchanges
-  std::vector<Message> peerAccessOutbox;
-
-  // outboxes for same-rank exchanges
-  std::vector<std::vector<std::vector<Message>>> peerCopyOutboxes;
-  // peerCopyOutboxes[di][dj] = peer copy from di to dj
-
-  // outbox for co-located domains in different ranks
-  // one outbox for each co-located domain
-  std::vector<std::map<Dim3, std::vector<Message>>> coloOutboxes;
-  std::vector<std::map<Dim3, std::vector<Message>>> coloInboxes;
-  // coloOutboxes[di][dstRank] = messages
+  if (autotune_) {
+    autotune();
+  }
+  plan_exchanges();
+}
 
-  // inbox for each remote domain my domains recv from
-  std::vector<std::map<Dim3, std::vector<Message>>> remoteInboxes; // remoteOutboxes_[domain][srcIdx] = messages
-  // outbox for each remote domain my domains send to
-  std::vector<std::map<Dim3, std::vector<Message>>> remoteOutboxes; // remoteOutboxes[domain][dstIdx] = messages
+ExchangePlan DistributedDomain::plan_messages(size_t r) {
 
   LOG_DEBUG("comm plan");
-  /*
-  For each direction, look up where the destination device is and decide which
-  communication method to use. We do not create a message where the message
-  size would be zero
-  */
   nvtxRangePush("DistributedDomain::realize() plan messages");
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    assert(domains_[di].gpu() == placement_->get_cuda(placement_->get_idx(rank_, di)));
+  }
+  // a phased exchange plans the face messages of one axis per round
+  const int axis = numRounds_ > 1 ? int(r) : -1;
+  std::function<Method(const Dim3 &, const Dim3 &)> messageMethods;
+  if (!tunedMethods_.empty()) {
+    messageMethods = [&](const Dim3 &dstIdx, const Dim3 &dir) { return tunedMethods_[message_index(dstIdx, dir)]; };
+  }
+  ExchangePlan plan =
+      plan_exchange(*placement_, topology_, halo_radius(), flags_, rank_, domains_.size(), gpu_topo::peer,
+                    [&](int rank) { return mpiTopology_.colocated(rank); }, axis, messageMethods);
 
 #ifdef STENCIL_SETUP_STATS
   // rank-rank communication amount matrix
   Mat2D<uint64_t> rankCommBytes(mpi::comm_size(MPI_COMM_WORLD), mpi::comm_size(MPI_COMM_WORLD), 0);
-#endif
-
-  peerCopyOutboxes.resize(gpus_.size());
-  for (auto &v : peerCopyOutboxes) {
-    v.resize(gpus_.size());
-  }
-  coloOutboxes.resize(gpus_.size());
-  coloInboxes.resize(gpus_.size());
-  remoteOutboxes.resize(gpus_.size());
-  remoteInboxes.resize(gpus_.size());
-
-  for (size_t di = 0; di < domains_.size(); ++di) {
-    const Dim3 myIdx = placement_->get_idx(rank_, di);
-    const int myDev = domains_[di].gpu();
-    assert(myDev == placement_->get_cuda(myIdx));
-    for (int z = -1; z <= 1; ++z) {
-      for (int y = -1; y <= 1; ++y) {
-        for (int x = -1; x <= 1; ++x) {
-          // send direction
-          const Dim3 dir(x, y, z);
-          if (Dim3(0, 0, 0) == dir) {
-            continue; // no message
-          }
-
-          // Only do sends when the stencil radius in the opposite
-          // direction is non-zero for example, if +x radius is 2, our -x
-          // neighbor needs a halo region from us, so we need to plan to send
-          // in that direction
-          if (0 == radius_.dir(dir * -1)) {
-            continue; // no sends or recvs for this dir
-          } else {
-            LOG_DEBUG(dir << " radius = " << radius_.dir(dir * -1));
-          }
-
-          const Topology::OptionalNeighbor dstNbr = topology_.get_neighbor(myIdx, dir);
-          if (!dstNbr.exists) {
-            continue;
-          }
-          const Dim3 dstIdx = dstNbr.index;
-          const int dstRank = placement_->get_rank(dstIdx);
-          const int dstGPU = placement_->get_subdomain_id(dstIdx);
-          const int dstDev = placement_->get_cuda(dstIdx);
-          // size of our send is the size of the recieving neighbor's halo in -dir
-          const Dim3 dstSize = placement_->subdomain_size(dstIdx);
-          const Dim3 sExt = LocalDomain::halo_extent(dir * -1, dstSize, radius_);
-          Message sMsg(dir, di, dstGPU, sExt);
-
-          // TODO: move this out of the plan so that this time isn't accumulated into the statistics
-#ifdef STENCIL_SETUP_STATS
-          for (int qi = 0; qi < domains_[di].num_data(); ++qi) {
-            // send size matches size of halo that we're recving into
-            const size_t bytes = domains_[di].halo_bytes(dir * -1, qi); // FIXME: directionality?
-            rankCommBytes.at(rank_, dstRank) += bytes;
-          }
-#endif
-
-          // TODO: this method can be removed, in place of the peer access method
-          if (any_methods(Method::CudaKernel)) {
-            if (dstRank == rank_ && myDev == dstDev) {
-              peerAccessOutbox.push_back(sMsg);
-              goto send_planned;
-            }
-          }
-          if (any_methods(Method::CudaMemcpyPeer)) {
-            LOG_DEBUG("peer " << rank_ << " " << dstRank << " peer(" << myDev << "," << dstDev
-                              << ")=" << gpu_topo::peer(myDev, dstDev));
-            if (dstRank == rank_ && gpu_topo::peer(myDev, dstDev)) {
-              peerCopyOutboxes[di][dstGPU].push_back(sMsg);
-              goto send_planned;
-            }
-          }
-          /*
-          FIXME: for now, we require that all GPUs be visible to all colocated ranks.
-          This is used to detect the GPU distance.
-          Ultimately, we'd like to be able to figure this out even in the presence of CUDA_VISIBLE_DEVICES making each
-          rank have a different CUDA device 0 Then, we could restrict CPU code to run on CPUs nearby to the GPU
-          */
-          if (any_methods(Method::ColoPackMemcpyUnpack | Method::ColoQuantityKernel | Method::ColoRegionKernel |
-                          Method::ColoMemcpy3d | Method::ColoDomainKernel)) {
-            if ((dstRank != rank_) && mpiTopology_.colocated(dstRank) && gpu_topo::peer(myDev, dstDev)) {
-              assert(di < coloOutboxes.size());
-              coloOutboxes[di].emplace(dstIdx, std::vector<Message>());
-              coloOutboxes[di][dstIdx].push_back(sMsg);
-              LOG_DEBUG("Plan send <colocated> for Mesage dir=" << sMsg.dir_);
-              goto send_planned;
-            }
-          }
-          if (any_methods(Method::CudaMpi)) {
-            assert(di < remoteOutboxes.size());
-            remoteOutboxes[di][dstIdx].push_back(sMsg);
-            LOG_DEBUG("Plan send <remote> "
-                      << myIdx << " (r" << rank_ << "d" << di << "g" << myDev << ")"
-                      << " -> " << dstIdx << " (r" << dstRank << "d" << dstGPU << "g" << dstDev << ")"
-                      << " (dir=" << dir << ", rad" << dir * -1 << "=" << radius_.dir(dir * -1) << ")");
-            goto send_planned;
-          }
-          LOG_FATAL("No method available to send required message " << sMsg.dir_ << "\n");
-        send_planned: // successfully found a way to send
-
-          const Topology::OptionalNeighbor srcNbr = topology_.get_neighbor(myIdx, dir * -1);
-          if (!srcNbr.exists) {
-            continue;
-          }
-          const Dim3 srcIdx = srcNbr.index;
-          const int srcRank = placement_->get_rank(srcIdx);
-          const int srcGPU = placement_->get_subdomain_id(srcIdx);
-          const int srcDev = placement_->get_cuda(srcIdx);
-          // size of our recv is the size of our halo in -dir
-          const Dim3 rExt = domains_[di].halo_extent(dir * -1);
-          Message rMsg(dir, srcGPU, di, rExt);
-
-          if (any_methods(Method::CudaKernel)) {
-            if (srcRank == rank_ && srcDev == myDev) {
-              // no recver needed
-              goto recv_planned;
-            }
-          }
-          if (any_methods(Method::CudaMemcpyPeer)) {
-            if (srcRank == rank_ && gpu_topo::peer(srcDev, myDev)) {
-              // no recver needed
-              goto recv_planned;
-            }
-          }
-          if (any_methods(Method::ColoPackMemcpyUnpack | Method::ColoQuantityKernel | Method::ColoRegionKernel |
-                          Method::ColoMemcpy3d | Method::ColoDomainKernel)) {
-            if ((srcRank != rank_) && mpiTopology_.colocated(srcRank) && gpu_topo::peer(srcDev, myDev)) {
-              assert(di < coloInboxes.size());
-              coloInboxes[di].emplace(srcIdx, std::vector<Message>());
-              coloInboxes[di][srcIdx].push_back(sMsg);
-              LOG_SPEW("Plan recv <colo> " << srcIdx << "->" << myIdx << " (dir=" << dir << "): r" << dir * -1 << "="
-                                           << radius_.dir(dir * -1));
-              goto recv_planned;
-            }
-          }
-          if (any_methods(Method::CudaMpi)) {
-            assert(di < remoteInboxes.size());
-            remoteInboxes[di].emplace(srcIdx, std::vector<Message>());
-            remoteInboxes[di][srcIdx].push_back(sMsg);
-            LOG_SPEW("Plan recv <remote> " << srcIdx << "->" << myIdx << " (dir=" << dir << "): r" << dir * -1 << "="
-                                           << radius_.dir(dir * -1));
-            goto recv_planned;
+  {
+    size_t elemBytes = 0;
+    for (size_t sz : dataElemSize_) {
+      elemBytes += sz;
+    }
+    for (const Message &msg : plan.peerAccessOutbox) {
+      rankCommBytes.at(rank_, rank_) += elemBytes * msg.ext().flatten();
+    }
+    for (const auto &v : plan.peerCopyOutboxes) {
+      for (const auto &msgs : v) {
+        for (const Message &msg : msgs) {
+          rankCommBytes.at(rank_, rank_) += elemBytes * msg.ext().flatten();
+        }
+      }
+    }
+    for (const auto *boxes : {&plan.coloOutboxes, &plan.remoteOutboxes}) {
+      for (const auto &box : *boxes) {
+        for (const auto &kv : box) {
+          for (const Message &msg : kv.second) {
+            rankCommBytes.at(rank_, placement_->get_rank(kv.first)) += elemBytes * msg.ext().flatten();
           }
-          LOG_FATAL("No method available to recv required message");
-        recv_planned: // found a way to recv
-          (void)0;
         }
       }
     }
   }
+#endif
 
   nvtxRangePop(); // plan
-#ifdef STENCIL_SETUP_STATS
-  elapsed = MPI_Wtime() - start;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-  if (0 == rank_) {
-    timePlan_ += maxElapsed;
-  }
-#endif
 
 /*
  -------------------------
@@ -490,7 +703,7 @@ to be loaded with numpy.loadtxt
 
     if (0 == rank_) {
 
-      std::string matFileName = outputPrefix_ + "mat_npy_loadtxt" + ".txt";
+      std::string matFileName = outputPrefix_ + "mat_npy_loadtxt" + round_suffix(r) + ".txt";
       std::ofstream matFile(matFileName, std::ofstream::out);
 
       for (unsigned r = 0; r < rankCommBytes.shape().y; ++r) {
@@ -503,6 +716,123 @@ to be loaded with numpy.loadtxt
   }
 #endif
 
+  return plan;
+}
+
+void DistributedDomain::plan_exchanges() {
+#ifdef STENCIL_SETUP_STATS
+  numBytesCudaMpi_ = 0;
+  numBytesColoDirectAccess_ = 0;
+  numBytesColoPackMemcpyUnpack_ = 0;
+  numBytesCudaMemcpyPeer_ = 0;
+  numBytesCudaKernel_ = 0;
+#endif
+
+  for (size_t r = 0; r < numRounds_; ++r) {
+    plan_round(r);
+  }
+
+// give every rank the total send volume
+#ifdef STENCIL_SETUP_STATS
+  nvtxRangePush("allreduce communication stats");
+  MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMpi_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &numBytesColoDirectAccess_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &numBytesColoPackMemcpyUnpack_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMemcpyPeer_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaKernel_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  nvtxRangePop();
+
+  if (rank_ == 0) {
+    LOG_INFO(numBytesCudaMpi_ << "B CudaMpi / exchange");
+    LOG_INFO(numBytesColoDirectAccess_ << "B ColoDirectAccess / exchange");
+    LOG_INFO(numBytesColoPackMemcpyUnpack_ << "B ColoPackMemcpyUnpack / exchange");
+    LOG_INFO(numBytesCudaMemcpyPeer_ << "B CudaMemcpyPeer / exchange");
+    LOG_INFO(numBytesCudaKernel_ << "B CudaKernel / exchange");
+  }
+#endif
+
+  // shared by every DistributedDomain in this process
+  LOG_INFO("staging: " << StagingArena::pinned().footprint() << "B pinned (" << StagingArena::pinned().high_water()
+                       << "B high water), " << StagingArena::host().footprint() << "B host ("
+                       << StagingArena::host().high_water() << "B high water)");
+
+  if (useProgress_ && !progress_) {
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+      LOG_WARN("progress thread needs MPI_THREAD_MULTIPLE, exchanges will only advance in exchange_test() and "
+               "exchange_end()");
+      useProgress_ = false;
+    } else {
+      LOG_INFO("progress thread on core " << progressCore_);
+      progress_ = new ProgressThread([this]() { return poll_exchange(); }, progressCore_);
+    }
+  }
+}
+
+void DistributedDomain::plan_round(size_t r) {
+
+  ExchangeRound &round = rounds_[r];
+
+#ifdef STENCIL_SETUP_STATS
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime();
+  double elapsed;
+  double maxElapsed = -1;
+#endif
+
+  // try to reuse this rank's plan from the cache.
+  // Everyone has to agree, since planning has collectives
+  // The plan key includes the placement, in case the placement was recomputed
+  ExchangePlan plan;
+  if (cacheKey_) {
+    const uint64_t planKey = plan_cache::placement_key(cacheKey_, *placement_);
+    const std::string path = plan_cache::path(cacheDir_, planKey, "plan_" + std::to_string(rank_) + round_suffix(r));
+    std::ifstream file(path);
+    int hit = file && plan_cache::read_plan(file, planKey, gpus_.size(), plan);
+    MPI_Allreduce(MPI_IN_PLACE, &hit, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (hit) {
+      LOG_INFO("plan: loaded " << path);
+    } else {
+      plan = plan_messages(r);
+      std::ofstream out(path + ".tmp");
+      plan_cache::write_plan(out, planKey, plan);
+      out.close();
+      if (!out || 0 != std::rename((path + ".tmp").c_str(), path.c_str())) {
+        LOG_WARN("plan: unable to write " << path);
+      }
+    }
+  } else {
+    plan = plan_messages(r);
+  }
+#ifdef STENCIL_SETUP_STATS
+  elapsed = MPI_Wtime() - start;
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  if (0 == rank_) {
+    timePlan_ += maxElapsed;
+  }
+#endif
+
+  // outbox for same-GPU exchanges
+  std::vector<Message> &peerAccessOutbox = plan.peerAccessOutbox;
+
+  // outboxes for same-rank exchanges
+  std::vector<std::vector<std::vector<Message>>> &peerCopyOutboxes = plan.peerCopyOutboxes;
+  // peerCopyOutboxes[di][dj] = peer copy from di to dj
+
+  // outbox for co-located domains in different ranks
+  // one outbox for each co-located domain
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloOutboxes = plan.coloOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloInboxes = plan.coloInboxes;
+  // coloOutboxes[di][dstRank] = messages
+
+  // inbox for each remote domain my domains recv from
+  // remoteInboxes[domain][srcIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteInboxes = plan.remoteInboxes;
+  // outbox for each remote domain my domains send to
+  // remoteOutboxes[domain][dstIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteOutboxes = plan.remoteOutboxes;
+
   /* -------------------------
   summarize communication plan
   ----------------------------
@@ -513,14 +843,7 @@ to be loaded with numpy.loadtxt
 
   ----------------------------*/
   {
-#ifdef STENCIL_SETUP_STATS
-    numBytesCudaMpi_ = 0;
-    numBytesColoDirectAccess_ = 0;
-    numBytesColoPackMemcpyUnpack_ = 0;
-    numBytesCudaMemcpyPeer_ = 0;
-    numBytesCudaKernel_ = 0;
-#endif
-    std::string planFileName = outputPrefix_ + "plan_" + std::to_string(rank_) + ".txt";
+    std::string planFileName = outputPrefix_ + "plan_" + std::to_string(rank_) + round_suffix(r) + ".txt";
     std::ofstream planFile(planFileName, std::ofstream::out);
 
     planFile << "rank=" << rank_ << "\n\n";
@@ -607,33 +930,14 @@ to be loaded with numpy.loadtxt
           planFile << "dir=" << msg.dir_ << " (" << msg.srcGPU_ << "->" << msg.dstGPU_ << ")\n";
 #ifdef STENCIL_SETUP_STATS
           for (int64_t i = 0; i < domains_[di].num_data(); ++i) {
-            // send size matches size of halo that we're recving into
-            numBytesCudaMpi_ += domains_[di].halo_bytes(msg.dir_ * -1, i);
+            // send size matches size of halo that we're recving into, in the wire format
+            numBytesCudaMpi_ += domains_[di].wire_bytes(msg.dir_ * -1, i);
           }
 #endif
         }
       }
     }
     planFile.close();
-
-// give every rank the total send volume
-#ifdef STENCIL_SETUP_STATS
-    nvtxRangePush("allreduce communication stats");
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMpi_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesColoDirectAccess_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesColoPackMemcpyUnpack_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMemcpyPeer_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaKernel_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    nvtxRangePop();
-
-    if (rank_ == 0) {
-      LOG_INFO(numBytesCudaMpi_ << "B CudaMpi / exchange");
-      LOG_INFO(numBytesColoDirectAccess_ << "B ColoDirectAccess / exchange");
-      LOG_INFO(numBytesColoPackMemcpyUnpack_ << "B ColoPackMemcpyUnpack / exchange");
-      LOG_INFO(numBytesCudaMemcpyPeer_ << "B CudaMemcpyPeer / exchange");
-      LOG_INFO(numBytesCudaKernel_ << "B CudaKernel / exchange");
-    }
-#endif
   }
 
 #ifdef STENCIL_SETUP_STATS
@@ -644,8 +948,45 @@ to be loaded with numpy.loadtxt
   LOG_DEBUG("create remote");
   nvtxRangePush("DistributedDomain::realize: create remote");
   // per-domain senders and messages
-  remoteSenders_.resize(gpus_.size());
-  remoteRecvers_.resize(gpus_.size());
+  round.remoteSenders.resize(gpus_.size());
+  round.remoteRecvers.resize(gpus_.size());
+
+  // senders and recvers created by this call, which need to be prepared
+  std::set<StatefulSender *> newSenders;
+  std::set<StatefulRecver *> newRecvers;
+
+  // with aggregate_, move every remote message into the box for its rank, so there are no per-domain ones to create.
+  // The rank senders and recvers are rebuilt from scratch, since the domains that take part may have changed
+  std::map<int, std::vector<Message>> rankOutboxes; // rankOutboxes[dstRank] = messages
+  std::map<int, std::vector<Message>> rankInboxes;  // rankInboxes[srcRank] = messages
+  if (aggregate_) {
+    for (auto &kv : round.rankSenders) {
+      delete kv.second;
+    }
+    for (auto &kv : round.rankRecvers) {
+      delete kv.second;
+    }
+    round.rankSenders.clear();
+    round.rankRecvers.clear();
+    for (size_t di = 0; di < domains_.size(); ++di) {
+      for (auto &kv : remoteOutboxes[di]) {
+        std::vector<Message> &box = rankOutboxes[placement_->get_rank(kv.first)];
+        box.insert(box.end(), kv.second.begin(), kv.second.end());
+      }
+      for (auto &kv : remoteInboxes[di]) {
+        std::vector<Message> &box = rankInboxes[placement_->get_rank(kv.first)];
+        box.insert(box.end(), kv.second.begin(), kv.second.end());
+      }
+      remoteOutboxes[di].clear();
+      remoteInboxes[di].clear();
+    }
+    for (auto &kv : rankOutboxes) {
+      round.rankSenders.emplace(kv.first, new RankSender(rank_, kv.first, domains_));
+    }
+    for (auto &kv : rankInboxes) {
+      round.rankRecvers.emplace(kv.first, new RankRecver(kv.first, rank_, domains_));
+    }
+  }
 
   // create all required remote senders/recvers
   for (size_t di = 0; di < domains_.size(); ++di) {
@@ -653,34 +994,40 @@ to be loaded with numpy.loadtxt
       const Dim3 dstIdx = kv.first;
       const int dstRank = placement_->get_rank(dstIdx);
       const int dstGPU = placement_->get_subdomain_id(dstIdx);
-      if (0 == remoteSenders_[di].count(dstIdx)) {
+      if (0 == round.remoteSenders[di].count(dstIdx)) {
         StatefulSender *sender = nullptr;
-        if (any_methods(Method::CudaMpi)) {
+        if (any_methods(Method::HostMpi)) {
+          sender = new HostSender(rank_, di, dstRank, dstGPU, domains_[di]);
+        } else if (any_methods(Method::CudaMpi)) {
 #if STENCIL_USE_CUDA_AWARE_MPI == 1
           sender = new CudaAwareMpiSender(rank_, di, dstRank, dstGPU, domains_[di]);
 #else
-          sender = new RemoteSender(rank_, di, dstRank, dstGPU, domains_[di]);
+          sender = new RemoteSender(rank_, di, dstRank, dstGPU, domains_[di], compress_);
 #endif
         }
         assert(sender);
-        remoteSenders_[di].emplace(dstIdx, sender);
+        round.remoteSenders[di].emplace(dstIdx, sender);
+        newSenders.insert(sender);
       }
     }
     for (auto &kv : remoteInboxes[di]) {
       const Dim3 srcIdx = kv.first;
       const int srcRank = placement_->get_rank(srcIdx);
       const int srcGPU = placement_->get_subdomain_id(srcIdx);
-      if (0 == remoteRecvers_[di].count(srcIdx)) {
+      if (0 == round.remoteRecvers[di].count(srcIdx)) {
         StatefulRecver *recver = nullptr;
-        if (any_methods(Method::CudaMpi)) {
+        if (any_methods(Method::HostMpi)) {
+          recver = new HostRecver(srcRank, srcGPU, rank_, di, domains_[di]);
+        } else if (any_methods(Method::CudaMpi)) {
 #if STENCIL_USE_CUDA_AWARE_MPI == 1
           recver = new CudaAwareMpiRecver(srcRank, srcGPU, rank_, di, domains_[di]);
 #else
-          recver = new RemoteRecver(srcRank, srcGPU, rank_, di, domains_[di]);
+          recver = new RemoteRecver(srcRank, srcGPU, rank_, di, domains_[di], compress_);
 #endif
         }
         assert(recver);
-        remoteRecvers_[di].emplace(srcIdx, recver);
+        round.remoteRecvers[di].emplace(srcIdx, recver);
+        newRecvers.insert(recver);
       }
     }
   }
@@ -690,14 +1037,17 @@ to be loaded with numpy.loadtxt
   // create colocated sender/recvers
   nvtxRangePush("DistributedDomain::realize: create colocated");
   // per-domain senders and messages
-  coloSenders_.resize(gpus_.size());
-  coloRecvers_.resize(gpus_.size());
+  round.coloSenders.resize(gpus_.size());
+  round.coloRecvers.resize(gpus_.size());
 
   // create all required colocated senders/recvers
   for (size_t di = 0; di < domains_.size(); ++di) {
     for (auto &kv : coloOutboxes[di]) {
       StatefulSender *sender = nullptr;
       const Dim3 dstIdx = kv.first;
+      if (round.coloSenders[di].count(dstIdx)) {
+        continue;
+      }
       const int dstRank = placement_->get_rank(dstIdx);
       const int dstGPU = placement_->get_subdomain_id(dstIdx);
       LOG_DEBUG("create ColoSender to " << dstIdx << " on " << dstRank << " (" << dstGPU << ")");
@@ -712,11 +1062,15 @@ to be loaded with numpy.loadtxt
       } else if (any_methods(Method::ColoDomainKernel)) {
         sender = new ColoDomainKernelSender(rank_, di, dstRank, dstGPU, domains_[di], placement_);
       }
-      coloSenders_[di].emplace(dstIdx, sender);
+      round.coloSenders[di].emplace(dstIdx, sender);
+      newSenders.insert(sender);
     }
     for (auto &kv : coloInboxes[di]) {
       StatefulRecver *recver;
       const Dim3 srcIdx = kv.first;
+      if (round.coloRecvers[di].count(srcIdx)) {
+        continue;
+      }
       const int srcRank = placement_->get_rank(srcIdx);
       const int srcGPU = placement_->get_subdomain_id(srcIdx);
       LOG_DEBUG("create ColoRecver from " << srcIdx << " on " << srcRank << " (" << srcGPU << ")");
@@ -731,7 +1085,8 @@ to be loaded with numpy.loadtxt
       } else if (any_methods(Method::ColoDomainKernel)) {
         recver = new ColoHaloRecver(srcRank, srcGPU, rank_, di, domains_[di]);
       }
-      coloRecvers_[di].emplace(srcIdx, recver);
+      round.coloRecvers[di].emplace(srcIdx, recver);
+      newRecvers.insert(recver);
     }
   }
   nvtxRangePop(); // create colocated
@@ -740,18 +1095,20 @@ to be loaded with numpy.loadtxt
   // create colocated sender/recvers
   nvtxRangePush("DistributedDomain::realize: create PeerCopySender");
   // per-domain senders and messages
-  peerCopySenders_.resize(gpus_.size());
-  LOG_SPEW("Peer Copy Sender for " << peerCopySenders_.size() << " sources");
+  round.peerCopySenders.resize(gpus_.size());
+  std::set<std::pair<size_t, size_t>> newPeerCopySenders;
+  LOG_SPEW("Peer Copy Sender for " << round.peerCopySenders.size() << " sources");
   // create all required colocated senders/recvers
   for (size_t srcGPU = 0; srcGPU < peerCopyOutboxes.size(); ++srcGPU) {
     LOG_SPEW("srcGPU = " << srcGPU);
     for (size_t dstGPU = 0; dstGPU < peerCopyOutboxes[srcGPU].size(); ++dstGPU) {
       LOG_SPEW("dstGPU = " << dstGPU);
-      if (!peerCopyOutboxes[srcGPU][dstGPU].empty()) {
+      if (!peerCopyOutboxes[srcGPU][dstGPU].empty() && 0 == round.peerCopySenders[srcGPU].count(dstGPU)) {
         LOG_SPEW("create PeerCopySender(" << srcGPU << "," << dstGPU << "...)");
         PeerCopySender pcs(srcGPU, dstGPU, domains_[srcGPU], domains_[dstGPU]);
         LOG_SPEW("finished create");
-        peerCopySenders_[srcGPU].emplace(dstGPU, pcs);
+        round.peerCopySenders[srcGPU].emplace(dstGPU, pcs);
+        newPeerCopySenders.insert(std::make_pair(srcGPU, dstGPU));
       } else {
         LOG_SPEW("no msg between srcGPU=" << srcGPU << " and dstGPU=" << dstGPU);
       }
@@ -762,50 +1119,62 @@ to be loaded with numpy.loadtxt
   // prepare senders and receivers
   LOG_DEBUG("DistributedDomain::realize: prepare PeerAccessSender");
   nvtxRangePush("DistributedDomain::realize: prep peerAccessSender");
-  peerAccessSender_.prepare(peerAccessOutbox, domains_);
+  round.peerAccessSender.prepare(peerAccessOutbox, domains_);
   nvtxRangePop();
   std::cerr << "DistributedDomain::realize: prepare PeerCopySender\n";
   nvtxRangePush("DistributedDomain::realize: prep peerCopySender");
-  for (size_t srcGPU = 0; srcGPU < peerCopySenders_.size(); ++srcGPU) {
-    for (auto &kv : peerCopySenders_[srcGPU]) {
+  for (size_t srcGPU = 0; srcGPU < round.peerCopySenders.size(); ++srcGPU) {
+    for (auto &kv : round.peerCopySenders[srcGPU]) {
       const int dstGPU = kv.first;
       auto &sender = kv.second;
-      sender.prepare(peerCopyOutboxes[srcGPU][dstGPU]);
+      if (newPeerCopySenders.count(std::make_pair(srcGPU, size_t(dstGPU)))) {
+        sender.prepare(peerCopyOutboxes[srcGPU][dstGPU]);
+      }
     }
   }
   nvtxRangePop();
   std::cerr << "DistributedDomain::realize: start_prepare "
                "ColocatedSender/ColocatedRecver\n";
   nvtxRangePush("DistributedDomain::realize: prep colocated");
-  assert(coloSenders_.size() == coloRecvers_.size());
-  for (size_t di = 0; di < coloSenders_.size(); ++di) {
-    for (auto &kv : coloSenders_[di]) {
+  assert(round.coloSenders.size() == round.coloRecvers.size());
+  for (size_t di = 0; di < round.coloSenders.size(); ++di) {
+    for (auto &kv : round.coloSenders[di]) {
       const Dim3 dstIdx = kv.first;
       const int dstRank = placement_->get_rank(dstIdx);
       StatefulSender *sender = kv.second;
+      if (!newSenders.count(sender)) {
+        continue;
+      }
       LOG_DEBUG(" colo sender.start_prepare " << placement_->get_idx(rank_, di) << "->" << dstIdx << "(rank " << dstRank
                                               << ")");
       sender->start_prepare(coloOutboxes[di][dstIdx]);
     }
-    for (auto &kv : coloRecvers_[di]) {
+    for (auto &kv : round.coloRecvers[di]) {
       const Dim3 srcIdx = kv.first;
       StatefulRecver *recver = kv.second;
+      if (!newRecvers.count(recver)) {
+        continue;
+      }
       LOG_DEBUG(" colo recver.start_prepare " << srcIdx << "->" << placement_->get_idx(rank_, di));
       recver->start_prepare(coloInboxes[di][srcIdx]);
     }
   }
   LOG_DEBUG("DistributedDomain::realize: finish_prepare ColocatedSender/ColocatedRecver");
-  for (size_t di = 0; di < coloSenders_.size(); ++di) {
-    for (auto &kv : coloSenders_[di]) {
+  for (size_t di = 0; di < round.coloSenders.size(); ++di) {
+    for (auto &kv : round.coloSenders[di]) {
       const Dim3 dstIdx = kv.first;
       StatefulSender *sender = kv.second;
-      const int srcDev = domains_[di].gpu();
-      const int dstDev = placement_->get_cuda(dstIdx);
+      if (!newSenders.count(sender)) {
+        continue;
+      }
       LOG_DEBUG("colo sender.finish_prepare " << placement_->get_idx(rank_, di) << " -> " << dstIdx);
       sender->finish_prepare();
     }
-    for (auto &kv : coloRecvers_[di]) {
+    for (auto &kv : round.coloRecvers[di]) {
       StatefulRecver *recver = kv.second;
+      if (!newRecvers.count(recver)) {
+        continue;
+      }
       LOG_DEBUG("colo recver.finish_prepare for colo from " << kv.first);
       recver->finish_prepare();
     }
@@ -813,33 +1182,55 @@ to be loaded with numpy.loadtxt
   nvtxRangePop(); // prep remote
   LOG_DEBUG("DistributedDomain::realize: prepare RemoteSender/RemoteRecver");
   nvtxRangePush("DistributedDomain::realize: prep remote");
-  assert(remoteSenders_.size() == remoteRecvers_.size());
-  for (size_t di = 0; di < remoteSenders_.size(); ++di) {
-    for (auto &kv : remoteSenders_[di]) {
+  assert(round.remoteSenders.size() == round.remoteRecvers.size());
+  for (size_t di = 0; di < round.remoteSenders.size(); ++di) {
+    for (auto &kv : round.remoteSenders[di]) {
       const Dim3 dstIdx = kv.first;
       auto &sender = kv.second;
-      sender->start_prepare(remoteOutboxes[di][dstIdx]);
+      if (newSenders.count(sender)) {
+        sender->start_prepare(remoteOutboxes[di][dstIdx]);
+      }
     }
-    for (auto &kv : remoteRecvers_[di]) {
+    for (auto &kv : round.remoteRecvers[di]) {
       const Dim3 srcIdx = kv.first;
       auto &recver = kv.second;
-      recver->start_prepare(remoteInboxes[di][srcIdx]);
+      if (newRecvers.count(recver)) {
+        recver->start_prepare(remoteInboxes[di][srcIdx]);
+      }
     }
   }
-  for (size_t di = 0; di < remoteSenders_.size(); ++di) {
-    for (auto &kv : remoteSenders_[di]) {
+  for (size_t di = 0; di < round.remoteSenders.size(); ++di) {
+    for (auto &kv : round.remoteSenders[di]) {
       // const Dim3 dstIdx = kv.first;
       StatefulSender *sender = kv.second;
-      sender->finish_prepare();
+      if (newSenders.count(sender)) {
+        sender->finish_prepare();
+      }
     }
-    for (auto &kv : remoteRecvers_[di]) {
+    for (auto &kv : round.remoteRecvers[di]) {
       // const Dim3 srcIdx = kv.first;
       StatefulRecver *recver = kv.second;
-      recver->finish_prepare();
+      if (newRecvers.count(recver)) {
+        recver->finish_prepare();
+      }
     }
   }
+  for (auto &kv : round.rankSenders) {
+    kv.second->start_prepare(rankOutboxes[kv.first]);
+  }
+  for (auto &kv : round.rankRecvers) {
+    kv.second->start_prepare(rankInboxes[kv.first]);
+  }
+  for (auto &kv : round.rankSenders) {
+    kv.second->finish_prepare();
+  }
+  for (auto &kv : round.rankRecvers) {
+    kv.second->finish_prepare();
+  }
   nvtxRangePop(); // prep remote
 
+  plan_arrivals(r, plan, rankInboxes);
+
 #ifdef STENCIL_SETUP_STATS
   elapsed = MPI_Wtime() - start;
   MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
@@ -849,8 +1240,455 @@ to be loaded with numpy.loadtxt
 #endif
 }
 
+uint32_t DistributedDomain::round_halo_bits(size_t r, const Dim3 &side) const {
+  if (numRounds_ <= 1) {
+    return halo_bit(side);
+  }
+  // a face message of round r also carries the halos along the earlier axes
+  uint32_t bits = 0;
+  for (int dz = -1; dz <= 1; ++dz) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      for (int dx = -1; dx <= 1; ++dx) {
+        Dim3 d(dx, dy, dz);
+        Dim3 s = side;
+        bool carried = d[r] == s[r];
+        for (int b = r + 1; b < 3; ++b) {
+          carried = carried && 0 == d[b];
+        }
+        if (carried) {
+          bits |= halo_bit(d);
+        }
+      }
+    }
+  }
+  return bits;
+}
+
+void DistributedDomain::plan_arrivals(size_t r, const ExchangePlan &plan,
+                                      const std::map<int, std::vector<Message>> &rankInboxes) {
+  ExchangeRound &round = rounds_[r];
+  round.haloSources.clear();
+
+  // a message in direction `dir` fills the halo on the opposite side of its destination
+  auto add = [&](StatefulRecver *recver, PeerCopySender *peerCopy, Method method, const std::vector<Message> &msgs) {
+    if (msgs.empty()) {
+      return;
+    }
+    ExchangeRound::HaloSource src{
+        recver, peerCopy, method, std::vector<uint32_t>(domains_.size(), 0), std::vector<size_t>(), false, 0};
+    for (const Message &msg : msgs) {
+      src.halos[msg.dstGPU_] |= round_halo_bits(r, msg.dir_ * -1);
+      src.messages.push_back(message_index(placement_->get_idx(rank_, msg.dstGPU_), msg.dir_));
+    }
+    round.haloSources.push_back(src);
+  };
+
+  const Method colo = flags_ & (Method::ColoPackMemcpyUnpack | Method::ColoQuantityKernel | Method::ColoRegionKernel |
+                                Method::ColoMemcpy3d | Method::ColoDomainKernel);
+  const Method remote = flags_ & (Method::CudaMpi | Method::HostMpi);
+  add(nullptr, nullptr, Method::CudaKernel, plan.peerAccessOutbox);
+  for (size_t srcGPU = 0; srcGPU < plan.peerCopyOutboxes.size(); ++srcGPU) {
+    for (size_t dstGPU = 0; dstGPU < plan.peerCopyOutboxes[srcGPU].size(); ++dstGPU) {
+      const std::vector<Message> &msgs = plan.peerCopyOutboxes[srcGPU][dstGPU];
+      if (!msgs.empty()) {
+        add(nullptr, &round.peerCopySenders[srcGPU].at(dstGPU), Method::CudaMemcpyPeer, msgs);
+      }
+    }
+  }
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    for (auto &kv : plan.coloInboxes[di]) {
+      if (!kv.second.empty()) {
+        add(round.coloRecvers[di].at(kv.first), nullptr, colo, kv.second);
+      }
+    }
+    for (auto &kv : plan.remoteInboxes[di]) {
+      if (!kv.second.empty()) {
+        add(round.remoteRecvers[di].at(kv.first), nullptr, remote, kv.second);
+      }
+    }
+  }
+  for (auto &kv : rankInboxes) {
+    add(round.rankRecvers.at(kv.first), nullptr, remote, kv.second);
+  }
+}
+
+void DistributedDomain::autotune() {
+  // the transports to choose between, in the order plan_exchange() tries them
+  const Method colo = flags_ & (Method::ColoPackMemcpyUnpack | Method::ColoQuantityKernel | Method::ColoRegionKernel |
+                                Method::ColoMemcpy3d | Method::ColoDomainKernel);
+  std::vector<Method> candidates;
+  for (Method m : {Method::CudaKernel, Method::CudaMemcpyPeer, colo, Method::CudaMpi}) {
+    if (flags_ && m) {
+      candidates.push_back(m);
+    }
+  }
+  if (candidates.size() < 2) {
+    LOG_INFO("autotune: nothing to choose between in " << to_string(flags_));
+    return;
+  }
+  // each trial needs something that can carry the messages the transport being timed can't
+  if (!(flags_ && Method::CudaMpi)) {
+    LOG_WARN("autotune: needs " << to_string(Method::CudaMpi) << ", using " << to_string(flags_) << " as given");
+    return;
+  }
+  if (autotuneWarmup_ < 0 || autotuneTrials_ < 1) {
+    LOG_FATAL("autotune: needs at least 0 warmup and 1 timed exchange");
+  }
+
+  const size_t numMessages = placement_->dim().flatten() * 27;
+
+  // reuse the choices from the cache. Rank 0 reads them for everyone, so all ranks plan the same way
+  const uint64_t tuneKey = cacheKey_ ? plan_cache::placement_key(cacheKey_, *placement_) : 0;
+  const std::string cachePath = tuneKey ? plan_cache::path(cacheDir_, tuneKey, "autotune") : "";
+  if (tuneKey) {
+    std::string contents;
+    if (0 == rank_) {
+      std::ifstream file(cachePath);
+      std::stringstream ss;
+      ss << file.rdbuf();
+      contents = ss.str();
+    }
+    uint64_t len = contents.size();
+    MPI_Bcast(&len, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    contents.resize(len);
+    MPI_Bcast(&contents[0], len, MPI_CHAR, 0, MPI_COMM_WORLD);
+    std::istringstream is(contents);
+    if (plan_cache::read_methods(is, tuneKey, numMessages, tunedMethods_)) {
+      LOG_INFO("autotune: loaded " << cachePath);
+      return;
+    }
+  }
+
+  nvtxRangePush("DD::autotune");
+  const uint64_t cacheKey = cacheKey_;
+  cacheKey_ = 0; // trial plans are not cached
+  ArrivalCallback callback;
+  std::swap(callback, arrivalCallback_); // not called for trial exchanges
+  tuning_ = true;
+
+  // times[ci * numMessages + m] = mean seconds for message m to arrive by candidates[ci], -1 if not timed
+  std::vector<double> times(candidates.size() * numMessages, -1);
+  for (size_t ci = 0; ci < candidates.size(); ++ci) {
+    // the candidate wherever it can carry a message, otherwise the usual order of the ones after it
+    Method trial = Method::None;
+    for (size_t cj = ci; cj < candidates.size(); ++cj) {
+      trial |= candidates[cj];
+    }
+    tunedMethods_.assign(numMessages, trial);
+    for (size_t r = 0; r < numRounds_; ++r) {
+      rounds_[r].clear();
+      rounds_[r].peerCopySenders.clear();
+    }
+    plan_exchanges();
+
+    std::vector<double> sum(numMessages, 0);
+    std::vector<int> used(numMessages, -1); // index in candidates of the method each message used
+    for (int i = 0; i < autotuneWarmup_ + autotuneTrials_; ++i) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      exchange();
+      if (i < autotuneWarmup_) {
+        continue;
+      }
+      for (size_t r = 0; r < numRounds_; ++r) {
+        for (const ExchangeRound::HaloSource &src : rounds_[r].haloSources) {
+          const int cj = int(std::find(candidates.begin(), candidates.end(), src.method) - candidates.begin());
+          for (size_t m : src.messages) {
+            sum[m] += src.elapsed;
+            used[m] = cj;
+          }
+        }
+      }
+    }
+    for (size_t m = 0; m < numMessages; ++m) {
+      const int cj = used[m];
+      if (cj >= 0 && size_t(cj) < candidates.size()) {
+        double &t = times[cj * numMessages + m];
+        const double mean = sum[m] / autotuneTrials_;
+        t = t < 0 ? mean : std::min(t, mean);
+      }
+    }
+  }
+
+  tuning_ = false;
+  std::swap(callback, arrivalCallback_);
+  cacheKey_ = cacheKey;
+  for (size_t r = 0; r < numRounds_; ++r) {
+    rounds_[r].clear();
+    rounds_[r].peerCopySenders.clear();
+  }
+
+  // each message was timed by the rank that receives it
+  MPI_Allreduce(MPI_IN_PLACE, times.data(), int(times.size()), MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  // every rank picks the same fastest method for each message, so the sender and recver agree
+  tunedMethods_.assign(numMessages, flags_);
+  std::vector<size_t> numChosen(candidates.size(), 0);
+  for (size_t m = 0; m < numMessages; ++m) {
+    int best = -1;
+    for (size_t ci = 0; ci < candidates.size(); ++ci) {
+      const double t = times[ci * numMessages + m];
+      if (t >= 0 && (best < 0 || t < times[best * numMessages + m])) {
+        best = int(ci);
+      }
+    }
+    if (best >= 0) {
+      tunedMethods_[m] = candidates[best];
+      ++numChosen[best];
+    }
+  }
+
+  if (0 == rank_) {
+    for (size_t ci = 0; ci < candidates.size(); ++ci) {
+      LOG_INFO("autotune: " << numChosen[ci] << " messages use " << to_string(candidates[ci]));
+    }
+
+    // seconds for each timed message by each candidate
+    std::ofstream report(outputPrefix_ + "autotune.txt");
+    report << "dst dir";
+    for (const Method &m : candidates) {
+      report << " " << to_string(m);
+    }
+    report << " chosen\n";
+    const Dim3 dim = placement_->dim();
+    for (int64_t z = 0; z < dim.z; ++z) {
+      for (int64_t y = 0; y < dim.y; ++y) {
+        for (int64_t x = 0; x < dim.x; ++x) {
+          for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+              for (int dx = -1; dx <= 1; ++dx) {
+                const Dim3 idx(x, y, z);
+                const Dim3 dir(dx, dy, dz);
+                const size_t m = message_index(idx, dir);
+                if (tunedMethods_[m] == flags_) {
+                  continue; // not timed
+                }
+                report << idx << " " << dir;
+                for (size_t ci = 0; ci < candidates.size(); ++ci) {
+                  report << " " << times[ci * numMessages + m];
+                }
+                report << " " << to_string(tunedMethods_[m]) << "\n";
+              }
+            }
+          }
+        }
+      }
+    }
+
+    // save for next time. Written to a temporary file first so a concurrent reader never sees part of it
+    if (tuneKey) {
+      std::ofstream file(cachePath + ".tmp");
+      plan_cache::write_methods(file, tuneKey, tunedMethods_);
+      file.close();
+      if (!file || 0 != std::rename((cachePath + ".tmp").c_str(), cachePath.c_str())) {
+        LOG_WARN("autotune: unable to write " << cachePath);
+      }
+    }
+  }
+  nvtxRangePop(); // DD::autotune
+}
+
+void DistributedDomain::rebalance(const std::vector<double> &computeTimes) {
+  if (exchangeActive_) {
+    LOG_FATAL("rebalance() while an exchange is in flight");
+  }
+  if (computeTimes.size() != domains_.size()) {
+    LOG_FATAL("rebalance: expected " << domains_.size() << " compute times, got " << computeTimes.size());
+  }
+  nvtxRangePush("DD::rebalance");
+  stepsSinceExchange_ = haloDepth_; // halos are stale
+
+  const Dim3 dim = placement_->dim();
+  auto linearize = [&](const Dim3 &idx) { return idx.x + idx.y * dim.x + idx.z * dim.y * dim.x; };
+  auto dimensionize = [&](int64_t i) { return Dim3(i % dim.x, (i / dim.x) % dim.y, i / (dim.x * dim.y)); };
+
+  // throughput of every subdomain
+  std::vector<double> weights(dim.flatten(), 0);
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    if (!(computeTimes[di] > 0)) {
+      LOG_FATAL("rebalance: compute times must be positive, got " << computeTimes[di]);
+    }
+    const Dim3 idx = placement_->get_idx(rank_, di);
+    weights[linearize(idx)] = domains_[di].size().flatten() / computeTimes[di];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, weights.data(), weights.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+  // compute region of every subdomain before and after
+  std::vector<Rect3> oldRegion(dim.flatten());
+  std::vector<Rect3> newRegion(dim.flatten());
+  for (int64_t i = 0; i < dim.flatten(); ++i) {
+    const Dim3 idx = dimensionize(i);
+    oldRegion[i] = Rect3(placement_->subdomain_origin(idx),
+                         placement_->subdomain_origin(idx) + placement_->subdomain_size(idx));
+  }
+  // fatal here, before any data moves, if a subdomain would be thinner than its halos
+  placement_->set_cuts(weighted_cuts(size_, dim, weights, min_extent(halo_radius())));
+  std::vector<bool> changed(dim.flatten());
+  for (int64_t i = 0; i < dim.flatten(); ++i) {
+    const Dim3 idx = dimensionize(i);
+    newRegion[i] = Rect3(placement_->subdomain_origin(idx),
+                         placement_->subdomain_origin(idx) + placement_->subdomain_size(idx));
+    changed[i] = !(oldRegion[i].lo == newRegion[i].lo && oldRegion[i].hi == newRegion[i].hi);
+    if (0 == rank_) {
+      LOG_DEBUG("rebalance: " << idx << " " << oldRegion[i] << " -> " << newRegion[i]);
+    }
+  }
+  if (std::none_of(changed.begin(), changed.end(), [](bool b) { return b; })) {
+    nvtxRangePop();
+    return;
+  }
+
+  // unchanged subdomains keep all their data, so data only moves between changed ones
+  auto intersect = [](const Rect3 &a, const Rect3 &b) {
+    Rect3 ret(Dim3(std::max(a.lo.x, b.lo.x), std::max(a.lo.y, b.lo.y), std::max(a.lo.z, b.lo.z)),
+              Dim3(std::min(a.hi.x, b.hi.x), std::min(a.hi.y, b.hi.y), std::min(a.hi.z, b.hi.z)));
+    return ret;
+  };
+  auto empty = [](const Rect3 &r) { return r.hi.x <= r.lo.x || r.hi.y <= r.lo.y || r.hi.z <= r.lo.z; };
+  const Radius halo = halo_radius();
+  const Dim3 haloLo(halo.x(-1), halo.y(-1), halo.z(-1));
+  const size_t bytesPerCell = std::accumulate(dataElemSize_.begin(), dataElemSize_.end(), size_t(0));
+
+  // a region of all quantities, on its way to domain `dst` of this rank
+  struct Piece {
+    size_t dst;
+    Rect3 region;
+    std::vector<unsigned char> buf;
+  };
+  std::vector<Piece> pieces;
+  std::vector<std::vector<unsigned char>> sendBufs;
+  std::vector<int> sendRanks, sendTags;
+
+  // pack the parts of my old subdomains that move
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    const int64_t a = linearize(placement_->get_idx(rank_, di));
+    if (!changed[a]) {
+      continue;
+    }
+    for (int64_t b = 0; b < dim.flatten(); ++b) {
+      const Rect3 region = intersect(oldRegion[a], newRegion[b]);
+      if (!changed[b] || empty(region)) {
+        continue;
+      }
+      std::vector<unsigned char> buf;
+      for (int64_t qi = 0; qi < domains_[di].num_data(); ++qi) {
+        std::vector<unsigned char> q = domains_[di].region_to_host(region.lo - oldRegion[a].lo + haloLo,
+                                                                   region.extent(), qi);
+        buf.insert(buf.end(), q.begin(), q.end());
+      }
+      const Dim3 dstIdx = dimensionize(b);
+      const int dstRank = placement_->get_rank(dstIdx);
+      const int dstId = placement_->get_subdomain_id(dstIdx);
+      if (dstRank == rank_) {
+        pieces.push_back(Piece{size_t(dstId), region, buf});
+      } else {
+        sendBufs.push_back(buf);
+        sendRanks.push_back(dstRank);
+        // no direction, unlike rank_tag()
+        sendTags.push_back(make_tag<MsgKind::Other>(ipc_tag_payload(di, dstId)));
+      }
+    }
+  }
+  std::vector<MPI_Request> reqs(sendBufs.size());
+  for (size_t i = 0; i < sendBufs.size(); ++i) {
+    MPI_Isend(sendBufs[i].data(), sendBufs[i].size(), MPI_BYTE, sendRanks[i], sendTags[i], MPI_COMM_WORLD, &reqs[i]);
+  }
+
+  // receive the parts of my new subdomains that come from other ranks
+  std::vector<Piece> recvPieces;
+  std::vector<int> recvRanks, recvTags;
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    const int64_t b = linearize(placement_->get_idx(rank_, di));
+    if (!changed[b]) {
+      continue;
+    }
+    for (int64_t a = 0; a < dim.flatten(); ++a) {
+      const Rect3 region = intersect(oldRegion[a], newRegion[b]);
+      const Dim3 srcIdx = dimensionize(a);
+      const int srcRank = placement_->get_rank(srcIdx);
+      if (!changed[a] || empty(region) || srcRank == rank_) {
+        continue;
+      }
+      const int srcId = placement_->get_subdomain_id(srcIdx);
+      recvPieces.push_back(Piece{di, region, std::vector<unsigned char>(region.extent().flatten() * bytesPerCell)});
+      recvRanks.push_back(srcRank);
+      recvTags.push_back(make_tag<MsgKind::Other>(ipc_tag_payload(srcId, di)));
+    }
+  }
+  for (size_t i = 0; i < recvPieces.size(); ++i) {
+    std::vector<unsigned char> &buf = recvPieces[i].buf;
+    reqs.push_back(MPI_Request{});
+    MPI_Irecv(buf.data(), buf.size(), MPI_BYTE, recvRanks[i], recvTags[i], MPI_COMM_WORLD, &reqs.back());
+  }
+
+  // reallocate changed domains. Anything they send has already been copied out
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    const Dim3 idx = placement_->get_idx(rank_, di);
+    if (changed[linearize(idx)]) {
+      domains_[di].resize(placement_->subdomain_size(idx), placement_->subdomain_origin(idx));
+      domains_[di].realize();
+    }
+  }
+
+  MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+  pieces.insert(pieces.end(), recvPieces.begin(), recvPieces.end());
+  for (const Piece &piece : pieces) {
+    LocalDomain &dom = domains_[piece.dst];
+    const Dim3 ext = piece.region.extent();
+    size_t off = 0;
+    for (int64_t qi = 0; qi < dom.num_data(); ++qi) {
+      const size_t bytes = dom.elem_size(qi) * ext.flatten();
+      std::vector<unsigned char> q(piece.buf.begin() + off, piece.buf.begin() + off + bytes);
+      dom.region_from_host(piece.region.lo - dom.origin() + haloLo, ext, qi, q);
+      off += bytes;
+    }
+  }
+
+  // tear down communication that involves a changed subdomain, and re-plan it
+  for (size_t r = 0; r < numRounds_; ++r) {
+    ExchangeRound &round = rounds_[r];
+    for (size_t di = 0; di < domains_.size(); ++di) {
+      const bool myChanged = changed[linearize(placement_->get_idx(rank_, di))];
+      for (auto *senders : {&round.remoteSenders[di], &round.coloSenders[di]}) {
+        for (auto it = senders->begin(); it != senders->end();) {
+          if (myChanged || changed[linearize(it->first)]) {
+            delete it->second;
+            it = senders->erase(it);
+          } else {
+            ++it;
+          }
+        }
+      }
+      for (auto *recvers : {&round.remoteRecvers[di], &round.coloRecvers[di]}) {
+        for (auto it = recvers->begin(); it != recvers->end();) {
+          if (myChanged || changed[linearize(it->first)]) {
+            delete it->second;
+            it = recvers->erase(it);
+          } else {
+            ++it;
+          }
+        }
+      }
+      for (auto it = round.peerCopySenders[di].begin(); it != round.peerCopySenders[di].end();) {
+        if (myChanged || changed[linearize(placement_->get_idx(rank_, it->first))]) {
+          it = round.peerCopySenders[di].erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+  // the cached plan is for the old subdomain sizes
+  cacheKey_ = 0;
+  plan_exchanges();
+
+  nvtxRangePop(); // DD::rebalance
+}
+
 void DistributedDomain::swap() {
   LOG_DEBUG("swap()");
+  if (exchangeActive_) {
+    LOG_FATAL("swap() while an exchange is in flight");
+  }
 
 #ifdef STENCIL_EXCHANGE_STATS
   MPI_Barrier(MPI_COMM_WORLD);
@@ -860,6 +1698,7 @@ void DistributedDomain::swap() {
   for (auto &d : domains_) {
     d.swap();
   }
+  ++stepsSinceExchange_;
 
 #ifdef STENCIL_EXCHANGE_STATS
   double elapsed = MPI_Wtime() - start;
@@ -978,12 +1817,213 @@ std::vector<std::vector<Rect3>> DistributedDomain::get_exterior() const {
 
 const Rect3 DistributedDomain::get_compute_region() const noexcept { return Rect3(Dim3(0, 0, 0), size_); }
 
+/* radius_ scaled by haloDepth_. Between exchanges, points in a face halo are computed too, and they read from the
+   neighboring edge and corner halos even when the stencil itself does not reach diagonally, so with deep halos those
+   are exchanged wherever the faces they touch are
+*/
+Radius DistributedDomain::halo_radius() const {
+  Radius ret = radius_.scaled(haloDepth_);
+  if (haloDepth_ > 1) {
+    for (int dz = -1; dz <= 1; ++dz) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          if (0 != ret.dir(dx, dy, dz) || (0 == dx && 0 == dy && 0 == dz)) {
+            continue;
+          }
+          size_t r = std::numeric_limits<size_t>::max();
+          if (dx) {
+            r = std::min(r, ret.x(dx));
+          }
+          if (dy) {
+            r = std::min(r, ret.y(dy));
+          }
+          if (dz) {
+            r = std::min(r, ret.z(dz));
+          }
+          ret.dir(dx, dy, dz) = r;
+        }
+      }
+    }
+  }
+  return ret;
+}
+
+/* the compute region of each domain, grown outward by `steps` stencil radii, except across the faces of the domain
+   with an open boundary, where the halo comes from the boundary condition rather than the stencil
+*/
+std::vector<Rect3> DistributedDomain::grow_compute_regions(size_t steps) const {
+  std::vector<Rect3> ret(domains_.size());
+  const Dim3 dim = placement_->dim();
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    Rect3 reg = domains_[di].get_compute_region();
+    Dim3 idx = placement_->get_idx(rank_, di);
+    Dim3 lim = dim;
+    for (int axis = 0; axis < 3; ++axis) {
+      const bool open = Topology::Boundary::OPEN == boundary_[axis];
+      Dim3 lo(0, 0, 0), hi(0, 0, 0);
+      lo[axis] = -1;
+      hi[axis] = 1;
+      if (!open || 0 != idx[axis]) {
+        reg.lo[axis] -= int64_t(steps * radius_.dir(lo));
+      }
+      if (!open || lim[axis] - 1 != idx[axis]) {
+        reg.hi[axis] += int64_t(steps * radius_.dir(hi));
+      }
+    }
+    ret[di] = reg;
+  }
+  return ret;
+}
+
+std::vector<Rect3> DistributedDomain::get_valid_regions() const {
+  if (stepsSinceExchange_ > haloDepth_) {
+    LOG_FATAL("get_valid_regions(): " << stepsSinceExchange_ << " steps since the last exchange, halo depth is "
+                                      << haloDepth_);
+  }
+  return grow_compute_regions(haloDepth_ - stepsSinceExchange_);
+}
+
+std::vector<Rect3> DistributedDomain::get_step_regions() const {
+  if (exchange_due()) {
+    LOG_FATAL("get_step_regions(): the halos are used up, exchange() first");
+  }
+  return grow_compute_regions(haloDepth_ - stepsSinceExchange_ - 1);
+}
+
+bool DistributedDomain::exterior_ready(size_t domain, size_t region) const {
+  if (domain >= exteriorReported_.size() || region >= exteriorReported_[domain].size()) {
+    return false;
+  }
+  return exteriorReported_[domain][region];
+}
+
+void DistributedDomain::start_arrivals() {
+  const std::vector<std::vector<Rect3>> exterior = get_exterior();
+  exteriorNeeds_.assign(domains_.size(), std::vector<uint32_t>());
+  exteriorReported_.assign(domains_.size(), std::vector<bool>());
+
+  /* a region reads the halo in direction d if moving radius_.dir(d) from it along d leaves the compute region on
+     every non-zero axis of d
+  */
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    Rect3 comReg = domains_[di].get_compute_region();
+    for (const Rect3 &extConst : exterior[di]) {
+      Rect3 ext = extConst;
+      uint32_t needs = 0;
+      for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dx = -1; dx <= 1; ++dx) {
+            Dim3 d(dx, dy, dz);
+            const int64_t rad = radius_.dir(d);
+            if (Dim3(0, 0, 0) == d || 0 == rad) {
+              continue;
+            }
+            bool reads = true;
+            for (int a = 0; a < 3; ++a) {
+              if (d[a] < 0) {
+                reads = reads && ext.lo[a] - rad < comReg.lo[a];
+              } else if (d[a] > 0) {
+                reads = reads && ext.hi[a] + rad > comReg.hi[a];
+              }
+            }
+            if (reads) {
+              needs |= halo_bit(d);
+            }
+          }
+        }
+      }
+      exteriorNeeds_[di].push_back(needs);
+      exteriorReported_[di].push_back(false);
+    }
+  }
+
+  // halos nothing sends to are already as they will be, except those a boundary condition fills at the end
+  std::vector<uint32_t> arrived(domains_.size(), ~uint32_t(0));
+  for (size_t r = 0; r < numRounds_; ++r) {
+    for (ExchangeRound::HaloSource &src : rounds_[r].haloSources) {
+      src.arrived = false;
+      for (size_t di = 0; di < domains_.size(); ++di) {
+        arrived[di] &= ~src.halos[di];
+      }
+    }
+  }
+  if (!boundaryFills_.empty()) {
+    Dim3 lim = placement_->dim();
+    for (size_t di = 0; di < domains_.size(); ++di) {
+      Dim3 idx = placement_->get_idx(rank_, di);
+      for (int axis = 0; axis < 3; ++axis) {
+        if (Topology::Boundary::OPEN != boundary_[axis]) {
+          continue;
+        }
+        for (int dz = -1; dz <= 1; ++dz) {
+          for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+              Dim3 d(dx, dy, dz);
+              if ((d[axis] < 0 && 0 == idx[axis]) || (d[axis] > 0 && lim[axis] - 1 == idx[axis])) {
+                arrived[di] &= ~halo_bit(d);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(arrivalMutex_);
+  haloArrived_ = arrived;
+}
+
+bool DistributedDomain::poll_arrivals() {
+  ExchangeRound &round = rounds_[round_];
+  bool pending = false;
+  for (ExchangeRound::HaloSource &src : round.haloSources) {
+    if (src.arrived) {
+      continue;
+    }
+    if (src.recver) {
+      src.arrived = src.recver->done();
+    } else if (src.peerCopy) {
+      src.arrived = src.peerCopy->done();
+    } else {
+      src.arrived = round.peerAccessSender.done();
+    }
+    if (src.arrived) {
+      src.elapsed = MPI_Wtime() - roundStart_;
+      std::lock_guard<std::mutex> lock(arrivalMutex_);
+      for (size_t di = 0; di < src.halos.size(); ++di) {
+        haloArrived_[di] |= src.halos[di];
+      }
+    } else {
+      pending = true;
+    }
+  }
+  return pending;
+}
+
+void DistributedDomain::report_arrivals() {
+  std::vector<uint32_t> arrived;
+  {
+    std::lock_guard<std::mutex> lock(arrivalMutex_);
+    arrived = haloArrived_;
+  }
+  for (size_t di = 0; di < exteriorNeeds_.size(); ++di) {
+    for (size_t ri = 0; ri < exteriorNeeds_[di].size(); ++ri) {
+      const uint32_t needs = exteriorNeeds_[di][ri];
+      if (!exteriorReported_[di][ri] && needs == (needs & arrived[di])) {
+        exteriorReported_[di][ri] = true;
+        arrivalCallback_(di, ri);
+      }
+    }
+  }
+}
+
 bool DistributedDomain::poll_advance_sends() {
   nvtxRangePush("DD::poll_advance_sends");
+  ExchangeRound &round = rounds_[round_];
   bool pending = false;
 
   // move senders from d2h to h2h
-  for (auto &domSenders : remoteSenders_) {
+  for (auto &domSenders : round.remoteSenders) {
     for (auto &kv : domSenders) {
       StatefulSender *sender = kv.second;
       if (sender->active()) {
@@ -994,19 +2034,100 @@ bool DistributedDomain::poll_advance_sends() {
       }
     }
   }
+  for (auto &kv : round.rankSenders) {
+    StatefulSender *sender = kv.second;
+    if (sender->active()) {
+      pending = true;
+      if (sender->next_ready()) {
+        sender->next();
+      }
+    }
+  }
 
   nvtxRangePop();
   return pending;
 }
 
-void DistributedDomain::exchange() {
+bool DistributedDomain::poll_exchange() {
+  ExchangeRound &round = rounds_[round_];
+  bool pending = poll_advance_sends();
+  // a recver that cannot tell when its halos are in never arrives before wait_round(), so this does not hold up polling
+  if (tracking_arrivals()) {
+    poll_arrivals();
+  }
+
+  // move recvers from h2h to h2d
+  for (auto &domRecvers : round.remoteRecvers) {
+    for (auto &kv : domRecvers) {
+      StatefulRecver *recver = kv.second;
+      if (recver->active()) {
+        pending = true;
+        if (recver->next_ready()) {
+          recver->next();
+          return true; // try to send as early as possible
+        }
+      }
+    }
+  }
+  for (auto &kv : round.rankRecvers) {
+    StatefulRecver *recver = kv.second;
+    if (recver->active()) {
+      pending = true;
+      if (recver->next_ready()) {
+        recver->next();
+        return true; // try to send as early as possible
+      }
+    }
+  }
+  for (auto &domRecvers : round.coloRecvers) {
+    for (auto &kv : domRecvers) {
+      StatefulRecver *recver = kv.second;
+      if (recver->active()) {
+        pending = true;
+        if (recver->next_ready()) {
+          recver->next();
+          return true; // try to send as early as possible
+        }
+      }
+    }
+  }
+  // colosender: none of them are stateful, so we do not check them
+  return pending;
+}
+
+ExchangeHandle DistributedDomain::exchange_begin(const QuantitySet &set) {
+  if (exchangeActive_) {
+    LOG_FATAL("exchange_begin() while exchange " << numExchanges_ << " has not ended");
+  }
+  if (set.id > quantitySets_.size()) {
+    LOG_FATAL("exchange_begin(): unknown quantity set " << set.id);
+  }
+  exchangeActive_ = true;
+
+  // packers, unpackers, and senders read the active set from their domain
+  for (LocalDomain &domain : domains_) {
+    domain.set_active_quantity_set(set.id);
+  }
   nvtxRangePush("DD::exchange()");
 
 #ifdef STENCIL_EXCHANGE_STATS
   MPI_Barrier(MPI_COMM_WORLD);
-  double start = MPI_Wtime();
+  exchangeStart_ = MPI_Wtime();
 #endif
 
+  if (tracking_arrivals()) {
+    start_arrivals();
+  }
+  round_ = 0;
+  start_round();
+
+  return ExchangeHandle{++numExchanges_};
+}
+
+void DistributedDomain::start_round() {
+  ExchangeRound &round = rounds_[round_];
+  roundStart_ = MPI_Wtime();
+
   /*! Try to start sends in order from longest to shortest
    * we expect remote to be longest, followed by peer copy, followed by colo
    * colo is shorter than peer copy due to the node-aware data placement:
@@ -1016,19 +2137,23 @@ void DistributedDomain::exchange() {
   // start remote send d2h
   LOG_DEBUG("remote send start");
   nvtxRangePush("DD::exchange: remote send d2h");
-  for (auto &domSenders : remoteSenders_) {
+  for (auto &domSenders : round.remoteSenders) {
     for (auto &kv : domSenders) {
       StatefulSender *sender = kv.second;
       sender->send();
       poll_advance_sends();
     }
   }
+  for (auto &kv : round.rankSenders) {
+    kv.second->send();
+    poll_advance_sends();
+  }
   nvtxRangePop();
 
   // start colocated Senders
   LOG_DEBUG("start colo send");
   nvtxRangePush("DD::exchange: colo send");
-  for (auto &domSenders : coloSenders_) {
+  for (auto &domSenders : round.coloSenders) {
     for (auto &kv : domSenders) {
       StatefulSender *sender = kv.second;
       sender->send();
@@ -1039,7 +2164,7 @@ void DistributedDomain::exchange() {
   // send same-rank messages
   LOG_DEBUG("send peer copy");
   nvtxRangePush("DD::exchange: peer copy send");
-  for (auto &src : peerCopySenders_) {
+  for (auto &src : round.peerCopySenders) {
     for (auto &kv : src) {
       PeerCopySender &sender = kv.second;
       sender.send();
@@ -1050,13 +2175,13 @@ void DistributedDomain::exchange() {
   // send self messages
   LOG_DEBUG("send peer access");
   nvtxRangePush("DD::exchange: peer access send");
-  peerAccessSender_.send();
+  round.peerAccessSender.send();
   nvtxRangePop();
 
   // start colocated recvers
   LOG_DEBUG("start colo recv");
   nvtxRangePush("DD::exchange: colo recv");
-  for (auto &domRecvers : coloRecvers_) {
+  for (auto &domRecvers : round.coloRecvers) {
     for (auto &kv : domRecvers) {
       StatefulRecver *recver = kv.second;
       recver->recv();
@@ -1067,65 +2192,122 @@ void DistributedDomain::exchange() {
   // start remote recv h2h
   LOG_DEBUG("[" << rank_ << "] remote recv start");
   nvtxRangePush("DD::exchange: remote recv h2h");
-  for (auto &domRecvers : remoteRecvers_) {
+  for (auto &domRecvers : round.remoteRecvers) {
     for (auto &kv : domRecvers) {
       StatefulRecver *recver = kv.second;
       recver->recv();
     }
   }
+  for (auto &kv : round.rankRecvers) {
+    kv.second->recv();
+  }
   nvtxRangePop();
 
-  // poll stateful senders and recvers to move onto next step until all are done
-  LOG_DEBUG("[" << rank_ << "] start poll");
-  nvtxRangePush("DD::exchange: poll");
-  bool pending = true;
-  /* the intuition here is to prefer senders.
-  as soon as we make progress on anything that's not a sender, jump back to the senders and try again
-  */
-  while (pending) {
-    pending = false;
-  senders:
-    pending |= poll_advance_sends();
-    // move recvers from h2h to h2d
-    for (auto &domRecvers : remoteRecvers_) {
-      for (auto &kv : domRecvers) {
-        StatefulRecver *recver = kv.second;
-        if (recver->active()) {
-          pending = true;
-          if (recver->next_ready()) {
-            // const Dim3 srcIdx = kv.first;
-            // std::cerr << "[" << rank_ << "] src=" << srcIdx << "
-            // recv_h2d\n";
-            recver->next();
-            goto senders; // try to send as early as possible
-          }
-        }
+  // the caller may not touch the senders and recvers until exchange_end()
+  if (progress_) {
+    progress_->start();
+  }
+}
+
+bool DistributedDomain::exchange_test(const ExchangeHandle &handle) {
+  if (!exchangeActive_ || handle.id != numExchanges_) {
+    LOG_FATAL("exchange_test(): exchange " << handle.id << " is not in flight");
+  }
+  nvtxRangePush("DD::exchange_test");
+  bool done = progress_ ? progress_->done() : !poll_exchange();
+  // the next round packs halos the last one filled, so it can only start once the last one is done
+  while (done && round_ + 1 < numRounds_) {
+    wait_round();
+    ++round_;
+    start_round();
+    done = progress_ ? progress_->done() : !poll_exchange();
+  }
+  if (arrivalCallback_) {
+    report_arrivals();
+  }
+  nvtxRangePop();
+  return done;
+}
+
+void DistributedDomain::exchange_end(const ExchangeHandle &handle) {
+  if (!exchangeActive_ || handle.id != numExchanges_) {
+    LOG_FATAL("exchange_end(): exchange " << handle.id << " is not in flight");
+  }
+
+  while (true) {
+    // poll stateful senders and recvers to move onto next step until all are done
+    LOG_DEBUG("[" << rank_ << "] start poll");
+    nvtxRangePush("DD::exchange: poll");
+    /* the intuition here is to prefer senders.
+    as soon as we make progress on anything that's not a sender, jump back to the senders and try again
+    */
+    if (progress_) {
+      // the progress thread records arrivals, but the callback runs here
+      while (arrivalCallback_ && !progress_->done()) {
+        report_arrivals();
       }
-    }
-    for (auto &domRecvers : coloRecvers_) {
-      for (auto &kv : domRecvers) {
-        StatefulRecver *recver = kv.second;
-        if (recver->active()) {
-          pending = true;
-          if (recver->next_ready()) {
-            recver->next();
-            goto senders; // try to send as early as possible
-          }
+      progress_->wait();
+    } else {
+      while (poll_exchange()) {
+        if (arrivalCallback_) {
+          report_arrivals();
         }
       }
     }
-    // colosender: none of them are stateful, so we do not check them
+    nvtxRangePop(); // DD::exchange: poll
+
+    wait_round();
+    if (arrivalCallback_) {
+      report_arrivals();
+    }
+    if (round_ + 1 == numRounds_) {
+      break;
+    }
+    ++round_;
+    start_round();
   }
-  nvtxRangePop(); // DD::exchange: poll
+
+  apply_boundary_conditions();
+  if (arrivalCallback_) {
+    {
+      std::lock_guard<std::mutex> lock(arrivalMutex_);
+      haloArrived_.assign(domains_.size(), ~uint32_t(0));
+    }
+    report_arrivals();
+  }
+  if (domains_.empty() || 0 == domains_[0].active_quantity_set()) {
+    stepsSinceExchange_ = 0; // the whole deep halo is valid again
+  }
+  for (LocalDomain &domain : domains_) {
+    domain.set_active_quantity_set(0);
+  }
+
+#ifdef STENCIL_EXCHANGE_STATS
+  double maxElapsed = -1;
+  double elapsed = MPI_Wtime() - exchangeStart_;
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  if (0 == rank_) {
+    timeExchange_ += maxElapsed;
+  }
+#endif
+
+  exchangeActive_ = false;
+  nvtxRangePop(); // "DD::excchange"
+
+  // No barrier necessary: the CPU thread has already blocked until all recvs are done, so it is safe to proceed.
+}
+
+void DistributedDomain::wait_round() {
+  ExchangeRound &round = rounds_[round_];
 
   // wait for sends
   LOG_SPEW("wait for peer access senders");
   nvtxRangePush("peerAccessSender.wait()");
-  peerAccessSender_.wait();
+  round.peerAccessSender.wait();
   nvtxRangePop();
 
   nvtxRangePush("peerCopySender.wait()");
-  for (auto &src : peerCopySenders_) {
+  for (auto &src : round.peerCopySenders) {
     for (auto &kv : src) {
       PeerCopySender &sender = kv.second;
       sender.wait();
@@ -1135,14 +2317,14 @@ void DistributedDomain::exchange() {
 
   // wait for colocated
   nvtxRangePush("colocated.wait()");
-  for (auto &domSenders : coloSenders_) {
+  for (auto &domSenders : round.coloSenders) {
     for (auto &kv : domSenders) {
       LOG_SPEW("domain=" << kv.first << " wait colocated sender");
       StatefulSender *sender = kv.second;
       sender->wait();
     }
   }
-  for (auto &domRecvers : coloRecvers_) {
+  for (auto &domRecvers : round.coloRecvers) {
     for (auto &kv : domRecvers) {
       LOG_SPEW("domain=" << kv.first << " wait colocated recver");
       StatefulRecver *recver = kv.second;
@@ -1153,7 +2335,7 @@ void DistributedDomain::exchange() {
   nvtxRangePush("remote wait");
   // wait for remote senders and recvers
   // printf("rank=%d wait for RemoteRecver/RemoteSender\n", rank_);
-  for (auto &domRecvers : remoteRecvers_) {
+  for (auto &domRecvers : round.remoteRecvers) {
     for (auto &kv : domRecvers) {
       LOG_SPEW("domain=" << kv.first << " wait remote recver");
       StatefulRecver *recver = kv.second;
@@ -1161,7 +2343,7 @@ void DistributedDomain::exchange() {
       recver->wait();
     }
   }
-  for (auto &domSenders : remoteSenders_) {
+  for (auto &domSenders : round.remoteSenders) {
     for (auto &kv : domSenders) {
       LOG_SPEW("domain=" << kv.first << " wait remote sender");
       StatefulSender *sender = kv.second;
@@ -1169,20 +2351,92 @@ void DistributedDomain::exchange() {
       sender->wait();
     }
   }
+  for (auto &kv : round.rankRecvers) {
+    LOG_SPEW("rank=" << kv.first << " wait rank recver");
+    kv.second->wait();
+  }
+  for (auto &kv : round.rankSenders) {
+    LOG_SPEW("rank=" << kv.first << " wait rank sender");
+    kv.second->wait();
+  }
   nvtxRangePop(); // remote wait
 
-#ifdef STENCIL_EXCHANGE_STATS
-  double maxElapsed = -1;
-  double elapsed = MPI_Wtime() - start;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-  if (0 == rank_) {
-    timeExchange_ += maxElapsed;
+  // everything in this round has arrived, even what polling did not see
+  if (tracking_arrivals()) {
+    const double now = MPI_Wtime();
+    std::lock_guard<std::mutex> lock(arrivalMutex_);
+    for (ExchangeRound::HaloSource &src : round.haloSources) {
+      if (!src.arrived) {
+        src.elapsed = now - roundStart_;
+      }
+      src.arrived = true;
+      for (size_t di = 0; di < src.halos.size(); ++di) {
+        haloArrived_[di] |= src.halos[di];
+      }
+    }
   }
-#endif
+}
 
-  nvtxRangePop(); // "DD::excchange"
+void DistributedDomain::apply_boundary_conditions() {
+  if (boundaryFills_.empty()) {
+    return;
+  }
+  nvtxRangePush("DD::apply_boundary_conditions");
 
-  // No barrier necessary: the CPU thread has already blocked until all recvs are done, so it is safe to proceed.
+  /* One axis at a time, each face covering the whole allocation along the other axes, so edges and corners are filled
+     from halos that are already valid: exchanged on periodic axes, and filled by an earlier axis on open ones.
+  */
+  const Radius halo = halo_radius();
+  const Dim3 dim = placement_->dim();
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    LocalDomain &domain = domains_[di];
+    Dim3 idx = placement_->get_idx(rank_, di);
+    Dim3 sz = domain.size();
+    Dim3 rawSz = domain.raw_size();
+    Dim3 lim = dim;
+    for (int axis = 0; axis < 3; ++axis) {
+      if (Topology::Boundary::OPEN != boundary_[axis]) {
+        continue;
+      }
+      for (int side : {-1, 1}) {
+        if ((side < 0 && 0 != idx[axis]) || (side > 0 && lim[axis] - 1 != idx[axis])) {
+          continue; // not on the boundary
+        }
+        Dim3 face(0, 0, 0);
+        face[axis] = side;
+        const int64_t radius = halo.dir(face);
+        if (0 == radius) {
+          continue;
+        }
+
+        // the halo and the interior points next to it, as far as a mirror condition could need
+        Dim3 pos(0, 0, 0);
+        Dim3 ext = rawSz;
+        ext[axis] = radius + std::min(sz[axis], radius + 1);
+        if (side > 0) {
+          pos[axis] = rawSz[axis] - ext[axis];
+        }
+        Dim3 origin = domain.origin() + pos;
+        origin.x -= halo.x(-1);
+        origin.y -= halo.y(-1);
+        origin.z -= halo.z(-1);
+
+        for (int64_t qi : domain.quantity_set(domain.active_quantity_set())) {
+          if (size_t(qi) >= boundaryFills_.size()) {
+            continue;
+          }
+          const BoundaryFill &fill = boundaryFills_[qi][face_index(face)];
+          if (!fill) {
+            continue;
+          }
+          std::vector<unsigned char> buf = domain.region_to_host(pos, ext, qi);
+          fill(buf.data(), ext, axis, side, radius, origin);
+          domain.region_from_host(pos, ext, qi, buf);
+        }
+      }
+    }
+  }
+  nvtxRangePop();
 }
 
 void DistributedDomain::write_paraview(const std::string &prefix, bool zeroNaNs) {
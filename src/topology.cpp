@@ -7,12 +7,21 @@ Topology::OptionalNeighbor Topology::get_neighbor(const Dim3 &index, const Dim3
   assert(dir.all_gt(-2));
   assert(index.all_ge(0));
 
-  if (Boundary::PERIODIC == boundary_) {
-    OptionalNeighbor nbr;
-    nbr.exists = true; // everyone has a nbr in every dir for period boundary conditions
-    nbr.index = (index + dir).wrap(extent_);
-    return nbr;
-  } else {
-    LOG_FATAL("unexpected Boundary type");
+  OptionalNeighbor nbr;
+  nbr.exists = true;
+  nbr.index = index + dir;
+  Dim3 extent = extent_;
+  for (int a = 0; a < 3; ++a) {
+    int64_t &i = nbr.index[a];
+    if (Boundary::PERIODIC == boundary_[a]) {
+      i = (i + extent[a]) % extent[a];
+    } else if (Boundary::OPEN == boundary_[a]) {
+      if (i < 0 || i >= extent[a]) {
+        nbr.exists = false;
+      }
+    } else {
+      LOG_FATAL("unexpected Boundary type");
+    }
   }
-}
\ No newline at end of file
+  return nbr;
+}
@@ -118,7 +118,8 @@ void ColoHaloSender::finish_prepare() {
 
     // determine the size of the destination
     const Dim3 dstSz = placement_->subdomain_size(dstIdx);
-    const Dim3 dstPos = LocalDomain::halo_pos(msg.dir_ * -1, dstSz, domain_->radius(), true /*exterior*/);
+    const Dim3 dstPos =
+        LocalDomain::halo_pos(msg.dir_ * -1, dstSz, domain_->radius(), true /*exterior*/, domain_->phased());
 
     const Dim3 srcPos = domain_->halo_pos(msg.dir_, false /*interior*/);
     const Dim3 extent = domain_->halo_extent(msg.dir_);
@@ -290,6 +291,18 @@ void ColoHaloRecver::next() {
   }
 }
 
+bool ColoHaloRecver::done() {
+  if (State::WAIT_KERNEL != state_) {
+    return false;
+  }
+  cudaError_t err = cudaEventQuery(ipcRecver_.event());
+  if (cudaErrorNotReady == err) {
+    return false;
+  }
+  CUDA_RUNTIME(err);
+  return true;
+}
+
 void ColoHaloRecver::wait() {
   // wait on the event that the sender recorded after the kernel
   assert(stream_.device() == domain_->gpu());
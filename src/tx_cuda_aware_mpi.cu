@@ -1,11 +1,26 @@
 #include "stencil/tx_cuda.cuh"
 
+void CudaAwareMpiSender::start_prepare(const std::vector<Message> &outbox) {
+  packer_.prepare(domain_, outbox);
+  if (0 == packer_.size()) {
+    LOG_FATAL("a 0-size CudaAwareMpiSender was prepared");
+  }
+  // the packed buffer, size, peer, and tag are fixed from here on, so each send_d2d() is just an MPI_Start
+  CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
+  const int tag = remote_tag(srcGPU_, dstGPU_);
+  assert(packer_.size(0) <= size_t(std::numeric_limits<int>::max()));
+  reqs_.resize(domain_->num_quantity_sets(), MPI_REQUEST_NULL);
+  for (size_t s = 0; s < reqs_.size(); ++s) {
+    MPI_Send_init(packer_.data(), int(packer_.size(s)), MPI_BYTE, dstRank_, tag, MPI_COMM_WORLD, &reqs_[s]);
+  }
+}
+
 void CudaAwareMpiSender::wait() {
   assert(State::Send == state_);
   CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
   MPI_Status status;
   LOG_SPEW("CudaAwareMpiSender::wait(): dstRank=" << dstRank_);
-  MPI_Wait(&req_, &status);
+  MPI_Wait(&reqs_[set_], &status);
   state_ = State::None;
 }
 
@@ -32,28 +47,34 @@ bool CudaAwareMpiSender::pack_done() {
 void CudaAwareMpiSender::send_d2d() {
   assert(packer_.size());
   nvtxRangePush("CudaAwareMpiSender::send_d2d");
-  assert(packer_.data());
-  assert(srcGPU_ < 8);
-  assert(dstGPU_ < 8);
+  set_ = domain_->active_quantity_set();
+  assert(MPI_REQUEST_NULL != reqs_[set_]);
   CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
-  const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
-  size_t numBytes = packer_.size();
-  assert(numBytes <= std::numeric_limits<int>::max());
-  LOG_SPEW("CudaAwareMpiSender::send_d2d() MPI_Isend t=" << tag << " r=" << dstRank_);
-  mpirt::time(MPI_Isend, packer_.data(), int(numBytes), MPI_BYTE, dstRank_, tag, MPI_COMM_WORLD, &req_);
+  LOG_SPEW("CudaAwareMpiSender::send_d2d() MPI_Start r=" << dstRank_);
+  mpirt::time(MPI_Start, &reqs_[set_]);
   nvtxRangePop(); // CudaAwareMpiSender::send_d2d
 }
 
+void CudaAwareMpiRecver::start_prepare(const std::vector<Message> &inbox) {
+  unpacker_.prepare(domain_, inbox);
+  if (0 == unpacker_.size()) {
+    LOG_FATAL("a 0-size CudaAwareMpiRecver was created");
+  }
+  // each recv_d2d() is just an MPI_Start
+  CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
+  const int tag = remote_tag(srcGPU_, dstGPU_);
+  // sized for set 0 (all quantities). A smaller set arrives as a shorter message
+  assert(unpacker_.size(0) <= size_t(std::numeric_limits<int>::max()));
+  MPI_Recv_init(unpacker_.data(), int(unpacker_.size(0)), MPI_BYTE, srcRank_, tag, MPI_COMM_WORLD, &req_);
+}
+
 void CudaAwareMpiRecver::recv_d2d() {
   assert(unpacker_.size());
   nvtxRangePush("CudaAwareMpiRecver::recv_d2d");
-  assert(unpacker_.data());
-  assert(srcGPU_ < 8);
-  assert(dstGPU_ < 8);
+  assert(MPI_REQUEST_NULL != req_);
   CUDA_RUNTIME(rt::time(cudaSetDevice, domain_->gpu()));
-  const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
-  LOG_SPEW("CudaAwareMpiSender::recv_d2d() MPI_Irecv t=" << tag << " r=" << srcRank_);
-  mpirt::time(MPI_Irecv, unpacker_.data(), int(unpacker_.size()), MPI_BYTE, srcRank_, tag, MPI_COMM_WORLD, &req_);
+  LOG_SPEW("CudaAwareMpiRecver::recv_d2d() MPI_Start r=" << srcRank_);
+  mpirt::time(MPI_Start, &req_);
   nvtxRangePop(); // CudaAwareMpiRecver::recv_d2d
 }
 
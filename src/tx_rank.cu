@@ -0,0 +1,261 @@
+#include "stencil/tx_rank.cuh"
+
+#include <cstring>
+#include <limits>
+
+#include <nvToolsExt.h>
+
+#include "stencil/logging.hpp"
+#include "stencil/rt.hpp"
+#include "stencil/staging_arena.hpp"
+
+/* messages grouped by (srcGPU_, dstGPU_). Both ends of a rank pair see the same keys in the same order
+ */
+static std::map<std::pair<int, int>, std::vector<Message>> segment_boxes(const std::vector<Message> &box) {
+  std::map<std::pair<int, int>, std::vector<Message>> ret;
+  for (const Message &msg : box) {
+    ret[std::make_pair(msg.srcGPU_, msg.dstGPU_)].push_back(msg);
+  }
+  return ret;
+}
+
+/* host domains stage in plain host memory, device domains in pinned memory for the copies to and from the devices
+ */
+static StagingArena &host_buf_arena(bool host) { return host ? StagingArena::host() : StagingArena::pinned(); }
+
+static char *alloc_host_buf(int64_t size, bool host) {
+  char *ret = static_cast<char *>(host_buf_arena(host).allocate(size));
+  assert(ret);
+  return ret;
+}
+
+static void free_host_buf(char *buf, bool host) { host_buf_arena(host).deallocate(buf); }
+
+static bool streams_done(const std::vector<RcStream *> &streams) {
+  for (RcStream *stream : streams) {
+    cudaError_t err = rt::time(cudaStreamQuery, *stream);
+    if (cudaErrorNotReady == err) {
+      return false;
+    } else if (cudaSuccess != err) {
+      CUDA_RUNTIME(err);
+    }
+  }
+  return true;
+}
+
+RankSender::RankSender(int srcRank, int dstRank, std::vector<LocalDomain> &domains)
+    : srcRank_(srcRank), dstRank_(dstRank), domains_(&domains), size_(0), hostBuf_(nullptr), host_(false), set_(0),
+      state_(State::Idle) {}
+
+RankSender::~RankSender() {
+  for (MPI_Request &req : reqs_) {
+    mpi::request_free(req);
+  }
+  for (Segment &seg : segments_) {
+    delete seg.packer;
+    delete seg.stream;
+  }
+  free_host_buf(hostBuf_, host_);
+}
+
+void RankSender::start_prepare(const std::vector<Message> &outbox) {
+  for (auto &kv : segment_boxes(outbox)) {
+    const int di = kv.first.first;
+    assert(di < int(domains_->size()));
+    Segment seg;
+    seg.domain = &(*domains_)[di];
+    host_ = seg.domain->is_host();
+    if (host_) {
+      seg.stream = nullptr;
+      seg.packer = new HostPacker(true /*wire*/);
+    } else {
+      CUDA_RUNTIME(cudaSetDevice(seg.domain->gpu()));
+      seg.stream = new RcStream(seg.domain->gpu(), RcStream::Priority::HIGH);
+      seg.packer = new DevicePacker(*seg.stream, true /*wire*/);
+    }
+    seg.packer->prepare(seg.domain, kv.second);
+    seg.offset = 0;
+    size_ += seg.packer->size(0);
+    segments_.push_back(seg);
+  }
+
+  LOG_INFO(size_ << "B RankSender was prepared: r" << srcRank_ << "->r" << dstRank_ << " (" << outbox.size()
+                 << " messages in " << segments_.size() << " segments)");
+
+  if (size_) {
+    assert(size_ <= std::numeric_limits<int>::max());
+    hostBuf_ = alloc_host_buf(size_, host_);
+    reqs_.resize(segments_[0].domain->num_quantity_sets(), MPI_REQUEST_NULL);
+    for (size_t s = 0; s < reqs_.size(); ++s) {
+      int64_t setSize = 0;
+      for (Segment &seg : segments_) {
+        setSize += seg.packer->size(s);
+      }
+      MPI_Send_init(hostBuf_, int(setSize), MPI_BYTE, dstRank_, rank_tag(), MPI_COMM_WORLD, &reqs_[s]);
+    }
+  }
+}
+
+void RankSender::send() {
+  assert(State::Idle == state_);
+  state_ = State::D2H;
+  nvtxRangePush("RankSender::send");
+  int64_t offset = 0;
+  for (Segment &seg : segments_) {
+    seg.offset = offset;
+    offset += seg.packer->size();
+    if (0 == seg.packer->size()) {
+      continue;
+    }
+    seg.packer->pack();
+    if (seg.stream) {
+      CUDA_RUNTIME(rt::time(cudaSetDevice, seg.domain->gpu()));
+      CUDA_RUNTIME(rt::time(cudaMemcpyAsync, hostBuf_ + seg.offset, seg.packer->data(), seg.packer->size(),
+                            cudaMemcpyDefault, *seg.stream));
+    } else {
+      std::memcpy(hostBuf_ + seg.offset, seg.packer->data(), seg.packer->size());
+    }
+  }
+  nvtxRangePop(); // RankSender::send
+}
+
+bool RankSender::next_ready() {
+  assert(State::D2H == state_);
+  if (host_) {
+    return true; // packing was synchronous
+  }
+  std::vector<RcStream *> streams;
+  for (Segment &seg : segments_) {
+    streams.push_back(seg.stream);
+  }
+  return streams_done(streams);
+}
+
+void RankSender::next() {
+  assert(State::D2H == state_);
+  state_ = State::Wait;
+  if (size_) {
+    nvtxRangePush("RankSender::next");
+    set_ = segments_[0].domain->active_quantity_set();
+    mpirt::time(MPI_Start, &reqs_[set_]);
+    nvtxRangePop(); // RankSender::next
+  }
+}
+
+void RankSender::wait() {
+  assert(State::Wait == state_);
+  if (size_) {
+    MPI_Wait(&reqs_[set_], MPI_STATUS_IGNORE);
+  }
+  state_ = State::Idle;
+}
+
+RankRecver::RankRecver(int srcRank, int dstRank, std::vector<LocalDomain> &domains)
+    : srcRank_(srcRank), dstRank_(dstRank), domains_(&domains), size_(0), hostBuf_(nullptr), host_(false),
+      req_(MPI_REQUEST_NULL), state_(State::None) {}
+
+RankRecver::~RankRecver() {
+  mpi::request_free(req_);
+  for (Segment &seg : segments_) {
+    delete seg.unpacker;
+    delete seg.stream;
+  }
+  free_host_buf(hostBuf_, host_);
+}
+
+void RankRecver::start_prepare(const std::vector<Message> &inbox) {
+  for (auto &kv : segment_boxes(inbox)) {
+    const int di = kv.first.second;
+    assert(di < int(domains_->size()));
+    Segment seg;
+    seg.domain = &(*domains_)[di];
+    host_ = seg.domain->is_host();
+    if (host_) {
+      seg.stream = nullptr;
+      seg.unpacker = new HostUnpacker(true /*wire*/);
+    } else {
+      CUDA_RUNTIME(cudaSetDevice(seg.domain->gpu()));
+      seg.stream = new RcStream(seg.domain->gpu(), RcStream::Priority::HIGH);
+      seg.unpacker = new DeviceUnpacker(*seg.stream, true /*wire*/);
+    }
+    seg.unpacker->prepare(seg.domain, kv.second);
+    seg.offset = 0;
+    size_ += seg.unpacker->size(0);
+    segments_.push_back(seg);
+  }
+
+  LOG_INFO(size_ << "B RankRecver was prepared: r" << srcRank_ << "->r" << dstRank_ << " (" << inbox.size()
+                 << " messages in " << segments_.size() << " segments)");
+
+  if (size_) {
+    assert(size_ <= std::numeric_limits<int>::max());
+    hostBuf_ = alloc_host_buf(size_, host_);
+    // sized for set 0 (all quantities). A smaller set arrives as a shorter message
+    MPI_Recv_init(hostBuf_, int(size_), MPI_BYTE, srcRank_, rank_tag(), MPI_COMM_WORLD, &req_);
+  }
+}
+
+void RankRecver::recv() {
+  state_ = State::H2H;
+  if (size_) {
+    nvtxRangePush("RankRecver::recv");
+    mpirt::time(MPI_Start, &req_);
+    nvtxRangePop(); // RankRecver::recv
+  }
+}
+
+bool RankRecver::next_ready() {
+  assert(State::H2H == state_);
+  if (size_) {
+    int flag;
+    mpirt::time(MPI_Test, &req_, &flag, MPI_STATUS_IGNORE);
+    return flag;
+  } else {
+    return true;
+  }
+}
+
+void RankRecver::next() {
+  assert(State::H2H == state_);
+  state_ = State::H2D;
+  nvtxRangePush("RankRecver::next");
+  int64_t offset = 0;
+  for (Segment &seg : segments_) {
+    seg.offset = offset;
+    offset += seg.unpacker->size();
+    if (0 == seg.unpacker->size()) {
+      continue;
+    }
+    if (seg.stream) {
+      CUDA_RUNTIME(rt::time(cudaSetDevice, seg.domain->gpu()));
+      CUDA_RUNTIME(rt::time(cudaMemcpyAsync, seg.unpacker->data(), hostBuf_ + seg.offset, seg.unpacker->size(),
+                            cudaMemcpyDefault, *seg.stream));
+    } else {
+      std::memcpy(seg.unpacker->data(), hostBuf_ + seg.offset, seg.unpacker->size());
+    }
+    seg.unpacker->unpack();
+  }
+  nvtxRangePop(); // RankRecver::next
+}
+
+bool RankRecver::done() {
+  if (State::H2D != state_) {
+    return false;
+  }
+  std::vector<RcStream *> streams;
+  for (Segment &seg : segments_) {
+    if (seg.stream) {
+      streams.push_back(seg.stream);
+    }
+  }
+  return streams_done(streams);
+}
+
+void RankRecver::wait() {
+  assert(State::H2D == state_);
+  for (Segment &seg : segments_) {
+    if (seg.stream) {
+      CUDA_RUNTIME(cudaStreamSynchronize(*seg.stream));
+    }
+  }
+}
@@ -0,0 +1,121 @@
+#include "catch2/catch.hpp"
+
+#include <functional>
+#include <vector>
+
+#include "stencil/boundary_condition.hpp"
+
+TEST_CASE("boundary condition") {
+
+  // 3 halo points and 4 interior points along each axis, interior values are their distance from the face
+  const int64_t radius = 3;
+  const int64_t n = 7;
+
+  auto make = [&](int axis, int side, Dim3 &ext) {
+    ext = Dim3(2, 2, 2);
+    ext[axis] = n;
+    std::vector<double> buf(ext.flatten(), -100);
+    for (int64_t z = 0; z < ext.z; ++z) {
+      for (int64_t y = 0; y < ext.y; ++y) {
+        for (int64_t x = 0; x < ext.x; ++x) {
+          Dim3 p(x, y, z);
+          const int64_t i = side < 0 ? p[axis] - radius : n - radius - 1 - p[axis];
+          if (i >= 0) {
+            buf[x + y * ext.x + z * ext.x * ext.y] = i + 1;
+          }
+        }
+      }
+    }
+    return buf;
+  };
+
+  // value at distance `k` into the halo
+  auto halo = [&](const std::vector<double> &buf, const Dim3 &ext, int axis, int side, int64_t k) {
+    Dim3 p(1, 1, 1);
+    p[axis] = side < 0 ? radius - k : n - radius - 1 + k;
+    return buf[p.x + p.y * ext.x + p.z * ext.x * ext.y];
+  };
+
+  // every face
+  auto each_face = [](const std::function<void(int, int)> &f) {
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int side : {-1, 1}) {
+        INFO("axis=" << axis << " side=" << side);
+        f(axis, side);
+      }
+    }
+  };
+
+  SECTION("dirichlet") {
+    each_face([&](int axis, int side) {
+      Dim3 ext;
+      std::vector<double> buf = make(axis, side, ext);
+      fill_boundary(buf.data(), ext, axis, side, radius, Dim3(0, 0, 0), BoundaryCondition::dirichlet(5));
+      for (int64_t k = 1; k <= radius; ++k) {
+        REQUIRE(halo(buf, ext, axis, side, k) == 5);
+      }
+    });
+  }
+
+  SECTION("neumann") {
+    each_face([&](int axis, int side) {
+      Dim3 ext;
+      std::vector<double> buf = make(axis, side, ext);
+      fill_boundary(buf.data(), ext, axis, side, radius, Dim3(0, 0, 0), BoundaryCondition::neumann(0.5));
+      for (int64_t k = 1; k <= radius; ++k) {
+        REQUIRE(halo(buf, ext, axis, side, k) == 1 + 0.5 * k);
+      }
+    });
+  }
+
+  SECTION("symmetric") {
+    each_face([&](int axis, int side) {
+      Dim3 ext;
+      std::vector<double> buf = make(axis, side, ext);
+      fill_boundary(buf.data(), ext, axis, side, radius, Dim3(0, 0, 0), BoundaryCondition::symmetric());
+      for (int64_t k = 1; k <= radius; ++k) {
+        REQUIRE(halo(buf, ext, axis, side, k) == 1 + k);
+      }
+    });
+  }
+
+  SECTION("antisymmetric") {
+    each_face([&](int axis, int side) {
+      Dim3 ext;
+      std::vector<double> buf = make(axis, side, ext);
+      fill_boundary(buf.data(), ext, axis, side, radius, Dim3(0, 0, 0), BoundaryCondition::antisymmetric());
+      for (int64_t k = 1; k <= radius; ++k) {
+        REQUIRE(halo(buf, ext, axis, side, k) == -(1 + k));
+      }
+    });
+  }
+
+  SECTION("function") {
+    each_face([&](int axis, int side) {
+      Dim3 ext;
+      std::vector<double> buf = make(axis, side, ext);
+      const Dim3 origin(10, 20, 30);
+      fill_boundary(buf.data(), ext, axis, side, radius, origin,
+                    BoundaryCondition::function([](const Dim3 &p) { return double(p.x + p.y + p.z); }));
+      for (int64_t k = 1; k <= radius; ++k) {
+        Dim3 p(1, 1, 1);
+        p[axis] = side < 0 ? radius - k : n - radius - 1 + k;
+        REQUIRE(halo(buf, ext, axis, side, k) == 60 + p.x + p.y + p.z);
+      }
+    });
+  }
+
+  SECTION("interior untouched") {
+    each_face([&](int axis, int side) {
+      Dim3 ext;
+      std::vector<double> buf = make(axis, side, ext);
+      const std::vector<double> before = buf;
+      fill_boundary(buf.data(), ext, axis, side, radius, Dim3(0, 0, 0), BoundaryCondition::symmetric());
+      for (size_t i = 0; i < buf.size(); ++i) {
+        if (before[i] > 0) {
+          REQUIRE(buf[i] == before[i]);
+        }
+      }
+    });
+  }
+}
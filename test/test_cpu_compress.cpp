@@ -0,0 +1,129 @@
+#include "catch2/catch.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "stencil/compress.hpp"
+
+TEST_CASE("lz compress") {
+
+  std::vector<unsigned char> src;
+
+  SECTION("empty") {}
+  SECTION("zeros") { src.assign(100000, 0); }
+  SECTION("short") { src = {1, 2, 3}; }
+  SECTION("repeated pattern") {
+    for (int i = 0; i < 50000; ++i) {
+      src.push_back((unsigned char)(i % 7));
+    }
+  }
+  SECTION("long literal runs") {
+    std::mt19937 gen(0);
+    for (int i = 0; i < 20000; ++i) {
+      src.push_back((unsigned char)gen());
+    }
+    src.insert(src.end(), 1000, 0xAB);
+    for (int i = 0; i < 300; ++i) {
+      src.push_back((unsigned char)gen());
+    }
+  }
+
+  std::vector<unsigned char> dst(src.size() + 1024);
+  const size_t c = compress::lz_compress(dst.data(), dst.size(), src.data(), src.size());
+  REQUIRE(c > 0);
+  std::vector<unsigned char> out(src.size());
+  REQUIRE(compress::lz_decompress(out.data(), out.size(), dst.data(), c));
+  REQUIRE(out == src);
+
+  if (src.size() >= 50000) {
+    REQUIRE(c < src.size() / 10);
+  }
+}
+
+TEST_CASE("lz compress incompressible") {
+  std::mt19937 gen(1);
+  std::vector<unsigned char> src(10000);
+  for (auto &b : src) {
+    b = (unsigned char)gen();
+  }
+
+  std::vector<unsigned char> dst(src.size());
+  INFO("does not fit in the raw size");
+  REQUIRE(0 == compress::lz_compress(dst.data(), dst.size(), src.data(), src.size()));
+
+  INFO("truncated input is rejected");
+  std::vector<unsigned char> zeros(1000, 0);
+  const size_t c = compress::lz_compress(dst.data(), dst.size(), zeros.data(), zeros.size());
+  REQUIRE(c > 0);
+  std::vector<unsigned char> out(zeros.size());
+  REQUIRE_FALSE(compress::lz_decompress(out.data(), out.size(), dst.data(), c - 1));
+}
+
+TEST_CASE("halo codec") {
+
+  // a smooth field that changes a little each step
+  const size_t n = 200000;
+  auto field = [](size_t step) {
+    std::vector<double> v(n);
+    for (size_t i = 0; i < n; ++i) {
+      v[i] = std::sin(i * 1e-3) + (i < 1000 ? step * 1e-3 : 0);
+    }
+    return v;
+  };
+
+  std::vector<unsigned char> frame(HaloCodec::max_frame_size(n * sizeof(double)));
+  std::vector<double> got(n);
+
+  SECTION("fast link sends raw, then probes") {
+    HaloCodec sender(CompressConfig{true, 4, 1e30});
+    HaloCodec recver(CompressConfig{true, 4, 1e30});
+    for (size_t step = 0; step < HaloCodec::kProbeInterval + 3; ++step) {
+      const std::vector<double> v = field(step);
+      const bool compressing = sender.compressing();
+      const size_t wire = sender.encode(frame.data(), v.data(), n * sizeof(double), 0);
+      if (compressing && step > 0) {
+        REQUIRE(sender.ratio() > 1);
+      } else {
+        REQUIRE(wire > n * sizeof(double));
+      }
+      recver.decode(got.data(), n * sizeof(double), frame.data(), 0);
+      REQUIRE(0 == std::memcmp(got.data(), v.data(), n * sizeof(double)));
+      // the first message does not count, the second turns compression off
+      if (step <= 1 || HaloCodec::kProbeInterval + 2 == step) {
+        REQUIRE(compressing);
+      } else {
+        REQUIRE_FALSE(compressing);
+      }
+    }
+  }
+
+  SECTION("slow link compresses") {
+    HaloCodec sender(CompressConfig{true, 4, 1});
+    HaloCodec recver(CompressConfig{true, 4, 1});
+    size_t lastWire = 0;
+    for (size_t step = 0; step < 4; ++step) {
+      const std::vector<double> v = field(step);
+      REQUIRE(sender.compressing());
+      lastWire = sender.encode(frame.data(), v.data(), n * sizeof(double), 0);
+      recver.decode(got.data(), n * sizeof(double), frame.data(), 0);
+      REQUIRE(0 == std::memcmp(got.data(), v.data(), n * sizeof(double)));
+    }
+    INFO("only the changed elements are left after the delta");
+    REQUIRE(lastWire < n * sizeof(double) / 50);
+  }
+
+  SECTION("quantity sets have their own history") {
+    HaloCodec sender(CompressConfig{true, 2, 1});
+    HaloCodec recver(CompressConfig{true, 2, 1});
+    for (size_t step = 0; step < 3; ++step) {
+      for (size_t set = 0; set < 2; ++set) {
+        const size_t m = (set + 1) * n / 2;
+        const std::vector<double> v = field(step + 10 * set);
+        sender.encode(frame.data(), v.data(), m * sizeof(double), set);
+        recver.decode(got.data(), m * sizeof(double), frame.data(), set);
+        REQUIRE(0 == std::memcmp(got.data(), v.data(), m * sizeof(double)));
+      }
+    }
+  }
+}
@@ -0,0 +1,169 @@
+#include "catch2/catch.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "stencil/host_pack.hpp"
+
+TEST_CASE("host pack") {
+
+  // a 5x4x3 allocation of int, with 2 bytes of padding on each row
+  const Dim3 raw(5, 4, 3);
+  const size_t pitch = raw.x * sizeof(int) + 2;
+  std::vector<char> alloc(pitch * raw.y * raw.z);
+  cudaPitchedPtr p{alloc.data(), pitch, raw.x * sizeof(int), size_t(raw.y)};
+  auto at = [&](int64_t x, int64_t y, int64_t z) -> int & {
+    return *reinterpret_cast<int *>(&alloc[z * raw.y * pitch + y * pitch + x * sizeof(int)]);
+  };
+  for (int64_t z = 0; z < raw.z; ++z) {
+    for (int64_t y = 0; y < raw.y; ++y) {
+      for (int64_t x = 0; x < raw.x; ++x) {
+        at(x, y, z) = x + 10 * y + 100 * z;
+      }
+    }
+  }
+
+  const Dim3 pos(1, 2, 1);
+  const Dim3 ext(3, 2, 2);
+
+  SECTION("pack") {
+    std::vector<int> buf(ext.flatten());
+    host_pack(buf.data(), p, pos, ext, sizeof(int));
+    size_t i = 0;
+    for (int64_t z = 0; z < ext.z; ++z) {
+      for (int64_t y = 0; y < ext.y; ++y) {
+        for (int64_t x = 0; x < ext.x; ++x) {
+          REQUIRE(buf[i++] == at(pos.x + x, pos.y + y, pos.z + z));
+        }
+      }
+    }
+  }
+
+  SECTION("unpack") {
+    std::vector<int> buf(ext.flatten());
+    for (size_t i = 0; i < buf.size(); ++i) {
+      buf[i] = -int(i) - 1;
+    }
+    host_unpack(p, buf.data(), pos, ext, sizeof(int));
+    for (int64_t z = 0; z < raw.z; ++z) {
+      for (int64_t y = 0; y < raw.y; ++y) {
+        for (int64_t x = 0; x < raw.x; ++x) {
+          const Dim3 o = Dim3(x, y, z) - pos;
+          if (o.all_ge(0) && o.all_lt(ext)) {
+            REQUIRE(at(x, y, z) == buf[o.x + o.y * ext.x + o.z * ext.x * ext.y]);
+          } else {
+            REQUIRE(at(x, y, z) == x + 10 * y + 100 * z);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("host pack wire") {
+
+  // a 4x3x2 allocation of double
+  const Dim3 raw(4, 3, 2);
+  std::vector<double> alloc(raw.flatten());
+  cudaPitchedPtr p{alloc.data(), raw.x * sizeof(double), raw.x * sizeof(double), size_t(raw.y)};
+  for (size_t i = 0; i < alloc.size(); ++i) {
+    alloc[i] = 1.0 / 3 + double(i);
+  }
+  const std::vector<double> orig = alloc;
+
+  const Dim3 pos(1, 1, 0);
+  const Dim3 ext(2, 2, 2);
+
+  auto roundtrip = [&](const WireFormat &wire) {
+    std::vector<char> buf(ext.flatten() * wire.wire_size(sizeof(double)));
+    host_pack_wire(buf.data(), p, pos, ext, sizeof(double), wire);
+    for (double &v : alloc) {
+      v = -1;
+    }
+    host_unpack_wire(p, buf.data(), pos, ext, sizeof(double), wire);
+  };
+  auto in_ext = [&](size_t i) {
+    const Dim3 o = Dim3(i % raw.x, (i / raw.x) % raw.y, i / (raw.x * raw.y)) - pos;
+    return o.all_ge(0) && o.all_lt(ext);
+  };
+
+  SECTION("native") {
+    roundtrip(WireFormat::native());
+    for (size_t i = 0; i < alloc.size(); ++i) {
+      REQUIRE(alloc[i] == (in_ext(i) ? orig[i] : -1));
+    }
+  }
+
+  SECTION("float") {
+    REQUIRE(WireFormat::float32().wire_size(8) == 4);
+    roundtrip(WireFormat::float32());
+    for (size_t i = 0; i < alloc.size(); ++i) {
+      REQUIRE(alloc[i] == (in_ext(i) ? double(float(orig[i])) : -1));
+    }
+  }
+
+  SECTION("bfloat16") {
+    REQUIRE(WireFormat::bfloat16().wire_size(4) == 2);
+    roundtrip(WireFormat::bfloat16());
+    for (size_t i = 0; i < alloc.size(); ++i) {
+      if (in_ext(i)) {
+        // 8 bits of mantissa, counting the implicit one
+        REQUIRE(std::abs(alloc[i] - orig[i]) <= orig[i] / 256);
+        REQUIRE(alloc[i] != orig[i]);
+      } else {
+        REQUIRE(alloc[i] == -1);
+      }
+    }
+  }
+
+  SECTION("fixed16") {
+    const double scale = 1.0 / 1024;
+    roundtrip(WireFormat::fixed16(scale));
+    for (size_t i = 0; i < alloc.size(); ++i) {
+      if (in_ext(i)) {
+        REQUIRE(std::abs(alloc[i] - orig[i]) <= scale / 2);
+      } else {
+        REQUIRE(alloc[i] == -1);
+      }
+    }
+  }
+
+  SECTION("fixed16 clamps") {
+    const WireFormat wire = WireFormat::fixed16(1e-3);
+    const float big = 1000;
+    int16_t enc;
+    wire.encode(&enc, &big, sizeof(big));
+    REQUIRE(enc == 32767);
+    float dec;
+    wire.decode(&dec, &enc, sizeof(dec));
+    REQUIRE(std::abs(dec - 32.767f) < 1e-4);
+  }
+
+  SECTION("fixed16 keeps nan") {
+    const WireFormat wire = WireFormat::fixed16(1e-3);
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    int16_t enc;
+    wire.encode(&enc, &nan, sizeof(nan));
+    REQUIRE(int(WireFormat::kFixed16NaN) == enc);
+    float dec;
+    wire.decode(&dec, &enc, sizeof(dec));
+    REQUIRE(std::isnan(dec));
+
+    // the most negative value clamps to -32767, not the NaN code
+    const float small = -1000;
+    wire.encode(&enc, &small, sizeof(small));
+    REQUIRE(enc == -32767);
+  }
+
+  SECTION("bfloat16 keeps inf and nan") {
+    const WireFormat wire = WireFormat::bfloat16();
+    for (float v : {std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN()}) {
+      uint16_t enc;
+      wire.encode(&enc, &v, sizeof(v));
+      float dec;
+      wire.decode(&dec, &enc, sizeof(dec));
+      REQUIRE((std::isnan(v) ? std::isnan(dec) : dec == v));
+    }
+  }
+}
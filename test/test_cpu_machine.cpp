@@ -0,0 +1,320 @@
+#include "catch2/catch.hpp"
+
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+#include "stencil/exchange_plan.hpp"
+#include "stencil/machine.hpp"
+#include "stencil/mat2d.hpp"
+#include "stencil/partition.hpp"
+
+TEST_CASE("machine") {
+
+  // two nodes with 4 GPUs and 2 ranks each, where devices 0 and 3 can't access each other
+  std::stringstream ss;
+  ss << "# a small cluster\n"
+     << "node a 4 2\n"
+     << "node b 4 2\n"
+     << "gpu-bandwidth 0 1 2 # faster link\n"
+     << "no-peer 0 3\n"
+     << "gpu-bandwidth 0 3 0.2\n"
+     << "inter-node-bandwidth 0.05\n"
+     << "host a sw0\n"
+     << "host b sw1\n"
+     << "link sw0 sw1\n";
+  const Machine machine = Machine::parse(ss);
+
+  SECTION("parse") {
+    REQUIRE(machine.num_nodes() == 2);
+    REQUIRE(machine.num_ranks() == 4);
+    REQUIRE(machine.num_gpus() == 8);
+    REQUIRE(machine.hostname(1) == "b");
+    REQUIRE(machine.node_of_rank(1) == 0);
+    REQUIRE(machine.node_of_rank(2) == 1);
+
+    // devices are round-robin to the ranks in a node
+    REQUIRE(machine.cuda_ids(0) == std::vector<int>({0, 2}));
+    REQUIRE(machine.cuda_ids(3) == std::vector<int>({1, 3}));
+
+    REQUIRE(machine.cuda_bandwidth(0, 1) == 2);
+    REQUIRE(machine.cuda_bandwidth(1, 0) == 2);
+    REQUIRE(machine.cuda_bandwidth(1, 2) == 1);
+    REQUIRE(machine.cuda_bandwidth(2, 2) == 10);
+    REQUIRE(!machine.cuda_peer(3, 0));
+    REQUIRE(machine.cuda_peer(1, 3));
+
+    // same node, and different nodes across the network
+    REQUIRE(machine.gpu_distance(0, 3).bandwidth == 0.2);
+    REQUIRE(machine.gpu_distance(0, 3).latency == 0);
+    REQUIRE(machine.gpu_distance(0, 4).bandwidth == 0.05);
+    REQUIRE(machine.gpu_distance(0, 4).latency == 3);
+
+    // GPUs are different
+    std::set<std::string> uuids;
+    for (int i = 0; i < machine.num_gpus(); ++i) {
+      uuids.insert(std::string(machine.gpu(i).uuid()));
+    }
+    REQUIRE(uuids.size() == 8);
+  }
+
+  SECTION("more ranks than gpus") {
+    std::stringstream is("node a 2 4\n");
+    Machine m = Machine::parse(is);
+    REQUIRE(m.num_ranks() == 4);
+    REQUIRE(m.cuda_ids(2) == std::vector<int>({0}));
+    REQUIRE(m.cuda_ids(3) == std::vector<int>({1}));
+    REQUIRE(m.gpu(1).ranks() == std::vector<int>({1, 3}));
+  }
+
+  SECTION("job layout") {
+    const JobLayout job = JobLayout::from_machine(machine);
+    REQUIRE(job.num_ranks() == 4);
+    REQUIRE(!job.weighted());
+    REQUIRE(job.node_names() == std::vector<std::string>({"a", "b"}));
+    REQUIRE(job.node_ranks() == std::vector<std::vector<int>>({{0, 1}, {2, 3}}));
+    REQUIRE(job.bandwidth(0, 1) == 2);
+    REQUIRE(!job.peer(0, 3));
+  }
+
+  SECTION("placement") {
+    const JobLayout job = JobLayout::from_machine(machine);
+    const Dim3 size(16, 16, 16);
+    Trivial trivial(size, job);
+    NodeAware nodeAware(size, job, Radius::constant(1), machine.network());
+
+    for (Placement *p : std::vector<Placement *>({&trivial, &nodeAware})) {
+      REQUIRE(p->dim().flatten() == 8);
+      // every device of every rank gets one subdomain
+      for (int rank = 0; rank < job.num_ranks(); ++rank) {
+        std::set<int> cudas;
+        for (int id = 0; id < 2; ++id) {
+          const Dim3 idx = p->get_idx(rank, id);
+          REQUIRE(p->get_rank(idx) == rank);
+          REQUIRE(p->get_subdomain_id(idx) == id);
+          cudas.insert(p->get_cuda(idx));
+        }
+        REQUIRE(cudas == std::set<int>(job.cudaIds[rank].begin(), job.cudaIds[rank].end()));
+      }
+    }
+  }
+
+  SECTION("comm model") {
+    Mat2D<double> bw(2, 2, 0.0), lat(2, 2, 0.0);
+    bw.at(0, 1) = 4;
+    bw.at(1, 0) = 2;
+    lat.at(0, 1) = 1;
+    lat.at(1, 0) = 1;
+    REQUIRE(mean_nonzero(bw) == 3);
+    REQUIRE(mean_nonzero(Mat2D<double>(2, 2, 0.0)) == 0);
+
+    // 1 / bandwidth + latency / bytes, and no cost for pairs without bandwidth
+    Mat2D<double> t = transfer_time(bw, lat, 2);
+    REQUIRE(t.at(0, 1) == Approx(0.75));
+    REQUIRE(t.at(1, 0) == Approx(1.0));
+    REQUIRE(t.at(0, 0) == 0);
+  }
+
+  SECTION("calibrated placement") {
+    // nodes a and b are slow to reach each other, so they should not be neighbors in the ring of 4x1x1 blocks
+    std::stringstream is("node a 1 1\nnode b 1 1\nnode c 1 1\nnode d 1 1\n");
+    const Machine m = Machine::parse(is);
+    JobLayout job = JobLayout::from_machine(m);
+    job.nodeBandwidth = Mat2D<double>(4, 4, 10.0);
+    job.nodeLatency = Mat2D<double>(4, 4, 1e-6);
+    for (int i = 0; i < 4; ++i) {
+      job.nodeBandwidth.at(i, i) = 0;
+    }
+    job.nodeBandwidth.at(0, 1) = 1;
+    job.nodeBandwidth.at(1, 0) = 1;
+
+    CommModel model;
+    model.bytesPerCell = 8;
+    NodeAware p(Dim3(64, 8, 8), job, Radius::constant(1), Network(), nullptr, model);
+    REQUIRE(p.dim() == Dim3(4, 1, 1));
+    REQUIRE(std::abs(p.get_idx(0, 0).x - p.get_idx(1, 0).x) == 2);
+  }
+
+  SECTION("plan") {
+    const JobLayout job = JobLayout::from_machine(machine);
+    Trivial placement(Dim3(16, 16, 16), job);
+    const Topology topology(placement.dim(), Topology::Boundary::PERIODIC);
+    const Radius radius = Radius::constant(1);
+
+    size_t sends = 0;
+    for (int rank = 0; rank < machine.num_ranks(); ++rank) {
+      const int node = machine.node_of_rank(rank);
+      ExchangePlan plan =
+          plan_exchange(placement, topology, radius, Method::Default, rank, 2, job.peer,
+                        [&](int other) { return machine.node_of_rank(other) == node; });
+      sends += plan.peerAccessOutbox.size();
+      for (const auto &v : plan.peerCopyOutboxes) {
+        for (const auto &msgs : v) {
+          sends += msgs.size();
+        }
+      }
+      for (const auto *boxes : {&plan.coloOutboxes, &plan.remoteOutboxes}) {
+        for (const auto &box : *boxes) {
+          for (const auto &kv : box) {
+            sends += kv.second.size();
+            for (const Message &msg : kv.second) {
+              const bool colocated = machine.node_of_rank(placement.get_rank(kv.first)) == node;
+              const bool peer = machine.cuda_peer(placement.get_cuda(placement.get_idx(rank, msg.srcGPU_)),
+                                                  placement.get_cuda(kv.first));
+              if (boxes == &plan.coloOutboxes) {
+                REQUIRE((colocated && peer));
+              } else { // MPI if not colocated, or no peer access between colocated devices
+                REQUIRE((!colocated || !peer));
+              }
+            }
+          }
+        }
+      }
+    }
+    // 26 neighbors of each subdomain
+    REQUIRE(sends == 8 * 26);
+  }
+
+  SECTION("per-message methods") {
+    // +x messages over MPI, everything else by the usual order
+    const JobLayout job = JobLayout::from_machine(machine);
+    Trivial placement(Dim3(16, 16, 16), job);
+    const Topology topology(placement.dim(), Topology::Boundary::PERIODIC);
+    const Radius radius = Radius::constant(1);
+    auto messageMethods = [](const Dim3 &, const Dim3 &dir) {
+      return Dim3(1, 0, 0) == dir ? Method::CudaMpi : Method::Default;
+    };
+
+    size_t sends = 0;
+    size_t recvs = 0;
+    for (int rank = 0; rank < machine.num_ranks(); ++rank) {
+      const int node = machine.node_of_rank(rank);
+      ExchangePlan plan = plan_exchange(
+          placement, topology, radius, Method::Default, rank, 2, job.peer,
+          [&](int other) { return machine.node_of_rank(other) == node; }, -1, messageMethods);
+      for (const Message &msg : plan.peerAccessOutbox) {
+        REQUIRE(!(Dim3(1, 0, 0) == msg.dir_));
+      }
+      for (const auto &v : plan.peerCopyOutboxes) {
+        for (const auto &msgs : v) {
+          for (const Message &msg : msgs) {
+            REQUIRE(!(Dim3(1, 0, 0) == msg.dir_));
+          }
+        }
+      }
+      for (size_t di = 0; di < 2; ++di) {
+        for (const auto &kv : plan.remoteOutboxes[di]) {
+          for (const Message &msg : kv.second) {
+            sends += Dim3(1, 0, 0) == msg.dir_;
+          }
+        }
+        for (const auto &kv : plan.remoteInboxes[di]) {
+          for (const Message &msg : kv.second) {
+            recvs += Dim3(1, 0, 0) == msg.dir_;
+          }
+        }
+      }
+    }
+    // every subdomain sends and recvs one +x message over MPI
+    REQUIRE(sends == 8);
+    REQUIRE(recvs == 8);
+  }
+
+  SECTION("open boundary") {
+    const Topology t(Dim3(2, 2, 2), Topology::Boundary::OPEN, Topology::Boundary::PERIODIC, Topology::Boundary::OPEN);
+    REQUIRE(!t.get_neighbor(Dim3(0, 0, 0), Dim3(-1, 0, 0)).exists);
+    REQUIRE(t.get_neighbor(Dim3(0, 0, 0), Dim3(1, 0, 0)).exists);
+    REQUIRE(t.get_neighbor(Dim3(0, 0, 0), Dim3(0, -1, 0)).exists);
+    REQUIRE(t.get_neighbor(Dim3(0, 0, 0), Dim3(0, -1, 0)).index == Dim3(0, 1, 0));
+    REQUIRE(!t.get_neighbor(Dim3(0, 1, 1), Dim3(0, 0, 1)).exists);
+
+    // only MPI, so every message shows up in an outbox and an inbox
+    const JobLayout job = JobLayout::from_machine(machine);
+    Trivial placement(Dim3(16, 16, 16), job);
+    const Topology topology(placement.dim(), Topology::Boundary::OPEN);
+    const Radius radius = Radius::constant(1);
+    size_t sends = 0;
+    size_t recvs = 0;
+    for (int rank = 0; rank < machine.num_ranks(); ++rank) {
+      ExchangePlan plan = plan_exchange(placement, topology, radius, Method::CudaMpi, rank, 2, job.peer,
+                                        [](int) { return false; });
+      for (size_t di = 0; di < 2; ++di) {
+        for (const auto &kv : plan.remoteOutboxes[di]) {
+          sends += kv.second.size();
+        }
+        for (const auto &kv : plan.remoteInboxes[di]) {
+          recvs += kv.second.size();
+        }
+      }
+    }
+    // each corner of 2x2x2 has 7 neighbors
+    REQUIRE(sends == 8 * 7);
+    REQUIRE(recvs == sends);
+  }
+
+  SECTION("host plan") {
+    // everything over MPI, even within a rank, without asking about the GPUs
+    const JobLayout job = JobLayout::from_machine(machine);
+    Trivial placement(Dim3(16, 16, 16), job);
+    const Topology topology(placement.dim(), Topology::Boundary::PERIODIC);
+    const Radius radius = Radius::constant(1);
+    size_t sends = 0;
+    size_t recvs = 0;
+    int asked = 0;
+    for (int rank = 0; rank < machine.num_ranks(); ++rank) {
+      ExchangePlan plan = plan_exchange(
+          placement, topology, radius, Method::HostMpi, rank, 2,
+          [&](int, int) {
+            ++asked;
+            return true;
+          },
+          [](int) { return true; });
+      REQUIRE(plan.peerAccessOutbox.empty());
+      for (size_t di = 0; di < 2; ++di) {
+        REQUIRE(plan.coloOutboxes[di].empty());
+        for (const auto &kv : plan.remoteOutboxes[di]) {
+          sends += kv.second.size();
+        }
+        for (const auto &kv : plan.remoteInboxes[di]) {
+          recvs += kv.second.size();
+        }
+      }
+    }
+    REQUIRE(0 == asked);
+    REQUIRE(sends == 8 * 26);
+    REQUIRE(recvs == sends);
+  }
+
+  SECTION("phased plan") {
+    // one round per axis, with only the two face messages. Later rounds also carry the halos of earlier axes
+    const JobLayout job = JobLayout::from_machine(machine);
+    Trivial placement(Dim3(16, 16, 16), job);
+    const Topology topology(placement.dim(), Topology::Boundary::PERIODIC);
+    const Radius radius = Radius::constant(1);
+    const Dim3 exts[3] = {Dim3(1, 8, 8), Dim3(10, 1, 8), Dim3(10, 10, 1)};
+    for (int axis = 0; axis < 3; ++axis) {
+      size_t sends = 0;
+      for (int rank = 0; rank < machine.num_ranks(); ++rank) {
+        ExchangePlan plan = plan_exchange(
+            placement, topology, radius, Method::HostMpi, rank, 2, [](int, int) { return true; },
+            [](int) { return true; }, axis);
+        for (size_t di = 0; di < 2; ++di) {
+          for (const auto &kv : plan.remoteOutboxes[di]) {
+            sends += kv.second.size();
+            for (const Message &msg : kv.second) {
+              REQUIRE(LocalDomain::face_axis(msg.dir_) == axis);
+              REQUIRE(msg.ext() == exts[axis]);
+            }
+          }
+        }
+      }
+      REQUIRE(sends == 8 * 2);
+    }
+
+    // 8x8x8 subdomains with radius 1 have 8-cell edge messages
+    REQUIRE(prefer_phased(Dim3(8, 8, 8), radius, 8, 16 * 1024));
+    REQUIRE(!prefer_phased(Dim3(8, 8, 8), radius, 8, 64));
+    // nothing to save without edges and corners
+    REQUIRE(!prefer_phased(Dim3(8, 8, 8), Radius::face_edge_corner(1, 0, 0), 8, 16 * 1024));
+  }
+}
@@ -0,0 +1,98 @@
+#include "catch2/catch.hpp"
+
+#include <sstream>
+
+#include "stencil/network.hpp"
+#include "stencil/qap.hpp"
+
+TEST_CASE("network") {
+
+  SECTION("fat tree") {
+    // 2 leaves with 2 hosts each, 2 spines
+    std::stringstream ss;
+    ss << "# a small fat tree\n"
+       << "host a leaf0\n"
+       << "host b leaf0\n"
+       << "host c leaf1\n"
+       << "host d.example.com leaf1 # fqdn\n"
+       << "\n"
+       << "link leaf0 spine0\n"
+       << "link leaf0 spine1\n"
+       << "link leaf1 spine0 2\n"
+       << "link leaf1 spine1 2\n";
+    Network net = Network::parse(ss);
+
+    REQUIRE(net.hosts().size() == 4);
+    REQUIRE(net.has_host("a"));
+    REQUIRE(net.has_host("a.example.com"));
+    REQUIRE(net.has_host("d"));
+    REQUIRE(!net.has_host("leaf0"));
+    REQUIRE(!net.has_host("e"));
+
+    REQUIRE(net.route("a", "a").hops == 0);
+    REQUIRE(net.route("a", "a").distance == 0);
+    REQUIRE(net.route("a", "b").hops == 2);
+    REQUIRE(net.route("a", "b").distance == Approx(2));
+    REQUIRE(net.route("a", "c").hops == 4);
+    REQUIRE(net.route("a", "c").distance == Approx(3.5));
+
+    Mat2D<double> dist = net.distance({"a", "b", "c", "d"});
+    REQUIRE(dist.at(0, 1) == Approx(2));
+    REQUIRE(dist.at(1, 3) == Approx(3.5));
+    REQUIRE(dist.at(3, 1) == Approx(3.5));
+    REQUIRE(dist.at(2, 3) == Approx(2));
+  }
+
+  SECTION("dragonfly") {
+    // 2 groups of 2 routers, one global link between r01 and r10
+    std::stringstream ss;
+    ss << "host h0 r00\n"
+       << "host h1 r01\n"
+       << "host h2 r10\n"
+       << "host h3 r11\n"
+       << "link r00 r01\n"
+       << "link r10 r11\n"
+       << "link r01 r10 0.5\n";
+    Network net = Network::parse(ss);
+
+    REQUIRE(net.route("h0", "h1").hops == 3);
+    REQUIRE(net.route("h1", "h2").hops == 3);
+    REQUIRE(net.route("h1", "h2").distance == Approx(4));
+    REQUIRE(net.route("h0", "h3").hops == 5);
+    REQUIRE(net.route("h0", "h3").distance == Approx(6));
+  }
+
+  SECTION("disconnected") {
+    std::stringstream ss;
+    ss << "host a s0\n"
+       << "host b s1\n";
+    Network net = Network::parse(ss);
+    REQUIRE(std::isinf(net.route("a", "b").distance));
+  }
+
+  SECTION("heavy pairs share a leaf") {
+    // 4 hosts on 2 leaves, listed so that neighbors in the host list are on different leaves
+    std::stringstream ss;
+    ss << "host n0 leaf0\n"
+       << "host n1 leaf1\n"
+       << "host n2 leaf0\n"
+       << "host n3 leaf1\n"
+       << "link leaf0 spine\n"
+       << "link leaf1 spine\n";
+    Network net = Network::parse(ss);
+    Mat2D<double> dist = net.distance({"n0", "n1", "n2", "n3"});
+
+    // blocks 0-1 and 2-3 exchange faces
+    // clang-format off
+    Mat2D<double> comm = {
+      {0, 10, 1, 0},
+      {10, 0, 0, 1},
+      {1, 0, 0, 10},
+      {0, 1, 10, 0}
+    };
+    // clang-format on
+    std::vector<size_t> f = qap::solve(comm, dist);
+    REQUIRE(dist.at(f[0], f[1]) == Approx(2));
+    REQUIRE(dist.at(f[2], f[3]) == Approx(2));
+  }
+}
@@ -71,4 +71,167 @@ TEST_CASE("partition") {
     REQUIRE(Dim3(4, 5, 0) == part.subdomain_origin(Dim3(1, 1, 0)));
     REQUIRE(Dim3(7, 10, 0) == part.subdomain_origin(Dim3(2, 2, 0)));
   }
-}
\ No newline at end of file
+
+  SECTION("split weighted") {
+    REQUIRE(split_weighted(10, {1, 1, 1, 1}) == std::vector<int64_t>({3, 3, 2, 2}));
+    REQUIRE(split_weighted(12, {2, 1, 1}) == std::vector<int64_t>({6, 3, 3}));
+    REQUIRE(split_weighted(10, {1, 2}) == std::vector<int64_t>({3, 7}));
+    // no empty slabs
+    REQUIRE(split_weighted(4, {100, 1, 1}) == std::vector<int64_t>({2, 1, 1}));
+  }
+
+  SECTION("extreme weights keep slabs as wide as the halo") {
+    REQUIRE(split_weighted(100, {100, 1, 1}) == std::vector<int64_t>({98, 1, 1}));
+    REQUIRE(split_weighted(100, {100, 1, 1}, 3) == std::vector<int64_t>({94, 3, 3}));
+    REQUIRE(split_weighted(100, {1, 100, 1}, 3) == std::vector<int64_t>({3, 94, 3}));
+
+    // a 100:1 rebalance with a radius-2 stencil and 2-deep halos
+    Radius rad = Radius::constant(2).scaled(2);
+    REQUIRE(Dim3(4, 4, 4) == min_extent(rad));
+    AxisCuts cuts = weighted_cuts(Dim3(40, 8, 8), Dim3(2, 1, 1), {100, 1}, min_extent(rad));
+    REQUIRE(Dim3(36, 8, 8) == cuts.size(Dim3(0, 0, 0)));
+    REQUIRE(Dim3(4, 8, 8) == cuts.size(Dim3(1, 0, 0)));
+
+    // only the axes the stencil reaches along need to be wide
+    Radius xOnly = Radius::constant(0);
+    xOnly.dir(1, 0, 0) = 3;
+    xOnly.dir(-1, 0, 0) = 1;
+    REQUIRE(Dim3(3, 1, 1) == min_extent(xOnly));
+  }
+
+  SECTION("uniform weights") {
+    Dim3 sz(13, 14, 2);
+    RankPartition part(sz, 12);
+    RankPartition weighted(sz, 12);
+    weighted.set_weights(std::vector<double>(12, 3.5));
+
+    const Dim3 dim = part.dim();
+    for (int64_t i = 0; i < dim.flatten(); ++i) {
+      const Dim3 idx = part.dimensionize(i);
+      REQUIRE(part.subdomain_size(idx) == weighted.subdomain_size(idx));
+      REQUIRE(part.subdomain_origin(idx) == weighted.subdomain_origin(idx));
+    }
+  }
+
+  SECTION("10x5x5 into 2x1x1 weighted 3:2") {
+    RankPartition part(Dim3(10, 5, 5), 2);
+    part.set_weights({3, 2});
+
+    REQUIRE(Dim3(6, 5, 5) == part.subdomain_size(Dim3(0, 0, 0)));
+    REQUIRE(Dim3(4, 5, 5) == part.subdomain_size(Dim3(1, 0, 0)));
+    REQUIRE(Dim3(6, 0, 0) == part.subdomain_origin(Dim3(1, 0, 0)));
+  }
+
+  SECTION("weighted cuts") {
+    // 2x2x1 grid, the +x column is twice as fast
+    AxisCuts cuts = weighted_cuts(Dim3(30, 30, 4), Dim3(2, 2, 1), {1, 2, 1, 2});
+    REQUIRE(Dim3(10, 15, 4) == cuts.size(Dim3(0, 0, 0)));
+    REQUIRE(Dim3(20, 15, 4) == cuts.size(Dim3(1, 1, 0)));
+    REQUIRE(Dim3(10, 15, 0) == cuts.origin(Dim3(1, 1, 0)));
+
+    RankPartition part(Dim3(30, 30, 4), 4);
+    REQUIRE(Dim3(2, 2, 1) == part.dim());
+    part.set_cuts(cuts);
+    REQUIRE(Dim3(20, 15, 4) == part.subdomain_size(Dim3(1, 1, 0)));
+    REQUIRE(Dim3(10, 15, 0) == part.subdomain_origin(Dim3(1, 1, 0)));
+  }
+
+  SECTION("node partition weighted") {
+    // 2 nodes of 2 GPUs. Node 1 is twice as fast, and the second GPU in each node is three times as fast
+    NodePartition part(Dim3(60, 10, 10), Radius::constant(1), 2, 2);
+    REQUIRE(Dim3(2, 1, 1) == part.sys_dim());
+    REQUIRE(Dim3(2, 1, 1) == part.node_dim());
+    part.set_weights({1, 2}, {1, 3});
+
+    REQUIRE(Dim3(5, 10, 10) == part.subdomain_size(Dim3(0, 0, 0)));
+    REQUIRE(Dim3(15, 10, 10) == part.subdomain_size(Dim3(1, 0, 0)));
+    REQUIRE(Dim3(10, 10, 10) == part.subdomain_size(Dim3(2, 0, 0)));
+    REQUIRE(Dim3(30, 10, 10) == part.subdomain_size(Dim3(3, 0, 0)));
+    REQUIRE(Dim3(30, 0, 0) == part.subdomain_origin(Dim3(3, 0, 0)));
+  }
+
+  SECTION("skewed GPU weights keep subdomains as wide as the halo") {
+    RankPartition rankPart(Dim3(40, 8, 8), 2);
+    rankPart.set_weights({100, 1}, Dim3(4, 4, 4));
+    REQUIRE(Dim3(36, 8, 8) == rankPart.subdomain_size(Dim3(0, 0, 0)));
+    REQUIRE(Dim3(4, 8, 8) == rankPart.subdomain_size(Dim3(1, 0, 0)));
+
+    // each node block must hold a halo-wide subdomain per GPU
+    NodePartition nodePart(Dim3(60, 10, 10), Radius::constant(1), 2, 2);
+    nodePart.set_weights({1, 100}, {100, 1}, Dim3(4, 4, 4));
+    REQUIRE(Dim3(4, 10, 10) == nodePart.subdomain_size(Dim3(0, 0, 0)));
+    REQUIRE(Dim3(4, 10, 10) == nodePart.subdomain_size(Dim3(1, 0, 0)));
+    REQUIRE(Dim3(48, 10, 10) == nodePart.subdomain_size(Dim3(2, 0, 0)));
+    REQUIRE(Dim3(4, 10, 10) == nodePart.subdomain_size(Dim3(3, 0, 0)));
+  }
+
+  SECTION("factorizations") {
+    REQUIRE(factorizations(1) == std::vector<Dim3>({Dim3(1, 1, 1)}));
+    REQUIRE(factorizations(7).size() == 3);
+    REQUIRE(factorizations(12).size() == 18);
+    for (const Dim3 &f : factorizations(12)) {
+      REQUIRE(12 == f.flatten());
+    }
+  }
+
+  SECTION("halo bytes") {
+    // compare against every subdomain and direction
+    const Radius radius = Radius::constant(2);
+    const double interNode = 3;
+    for (const Dim3 &sysDim : factorizations(4)) {
+      for (const Dim3 &nodeDim : factorizations(6)) {
+        NodePartition part(Dim3(23, 19, 17), sysDim, nodeDim);
+        const Dim3 dim = part.dim();
+
+        double expected = 0;
+        for (int64_t i = 0; i < dim.flatten(); ++i) {
+          const Dim3 idx(i % dim.x, (i / dim.x) % dim.y, i / (dim.x * dim.y));
+          for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+              for (int dx = -1; dx <= 1; ++dx) {
+                const Dim3 dir(dx, dy, dz);
+                if (Dim3(0, 0, 0) == dir) {
+                  continue;
+                }
+                const Dim3 nbr = (idx + dir).wrap(dim);
+                const bool cross = !(idx / nodeDim == nbr / nodeDim);
+                const double bytes = 8 * LocalDomain::halo_extent(dir, part.subdomain_size(idx), radius).flatten();
+                expected += bytes * (cross ? interNode : 1);
+              }
+            }
+          }
+        }
+
+        INFO(sysDim << " " << nodeDim);
+        REQUIRE(partition_cost::halo_bytes(radius, 8, interNode)(part) == Approx(expected));
+      }
+    }
+  }
+
+  SECTION("exhaustive") {
+    const Radius radius = Radius::constant(1);
+    PartitionCost cost = partition_cost::halo_bytes(radius, 4);
+
+    // 12 subdomains of a cube should be 2x2x3-ish, not slabs
+    NodePartition part = exhaustive_partition(Dim3(120, 120, 120), 12, 1, cost);
+    REQUIRE(12 == part.dim().flatten());
+    REQUIRE(part.dim().x <= 3);
+    REQUIRE(part.dim().y <= 3);
+    REQUIRE(part.dim().z <= 3);
+
+    // never worse than the greedy split
+    for (int64_t nodes : {1, 2, 6, 7, 12}) {
+      for (int64_t gpus : {1, 4, 6}) {
+        const Dim3 sz(300, 200, 100);
+        double best;
+        exhaustive_partition(sz, nodes, gpus, cost, &best);
+        INFO(nodes << "x" << gpus);
+        REQUIRE(best <= cost(NodePartition(sz, radius, nodes, gpus)));
+      }
+    }
+
+    // long x rows
+    part = exhaustive_partition(Dim3(64, 64, 64), 4, 1, partition_cost::x_rows());
+    REQUIRE(1 == part.dim().x);
+  }
+}
@@ -0,0 +1,94 @@
+#include "catch2/catch.hpp"
+
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+#include "stencil/machine.hpp"
+#include "stencil/placement_sfc.hpp"
+
+TEST_CASE("sfc") {
+
+  SECTION("hilbert steps to a neighbor") {
+    for (int bits : {1, 2, 3}) {
+      const int64_t side = int64_t(1) << bits;
+      std::vector<Dim3> points(side * side * side);
+      for (int64_t z = 0; z < side; ++z) {
+        for (int64_t y = 0; y < side; ++y) {
+          for (int64_t x = 0; x < side; ++x) {
+            const uint64_t h = sfc::hilbert(Dim3(x, y, z), bits);
+            REQUIRE(h < points.size());
+            points[h] = Dim3(x, y, z);
+          }
+        }
+      }
+      for (size_t i = 1; i < points.size(); ++i) {
+        const Dim3 d = points[i] - points[i - 1];
+        INFO(bits << " " << points[i - 1] << " -> " << points[i]);
+        REQUIRE(std::abs(d.x) + std::abs(d.y) + std::abs(d.z) == 1);
+      }
+    }
+  }
+
+  SECTION("morton") {
+    REQUIRE(sfc::morton(Dim3(1, 0, 0), 2) == 1);
+    REQUIRE(sfc::morton(Dim3(0, 1, 0), 2) == 2);
+    REQUIRE(sfc::morton(Dim3(0, 0, 1), 2) == 4);
+    REQUIRE(sfc::morton(Dim3(2, 0, 0), 2) == 8);
+    REQUIRE(sfc::morton(Dim3(3, 3, 3), 2) == 63);
+  }
+
+  SECTION("bits") {
+    REQUIRE(sfc::bits_for(Dim3(1, 1, 1)) == 1);
+    REQUIRE(sfc::bits_for(Dim3(2, 1, 1)) == 1);
+    REQUIRE(sfc::bits_for(Dim3(3, 8, 1)) == 3);
+    REQUIRE(sfc::bits_for(Dim3(1, 1, 9)) == 4);
+  }
+
+  SECTION("placement") {
+    // 8 nodes of 2 ranks with 4 GPUs each
+    std::stringstream ss;
+    for (int i = 0; i < 8; ++i) {
+      ss << "node n" << i << " 8 2\n";
+    }
+    const Machine machine = Machine::parse(ss);
+    const JobLayout job = JobLayout::from_machine(machine);
+
+    for (auto curve : {SpaceFillingCurve::Curve::Hilbert, SpaceFillingCurve::Curve::Morton}) {
+      SpaceFillingCurve p(Dim3(256, 256, 256), job, curve);
+      const Dim3 dim = p.dim();
+      REQUIRE(dim.flatten() == 64);
+
+      std::set<Dim3> seen;
+      for (int rank = 0; rank < job.num_ranks(); ++rank) {
+        std::set<int> cudas;
+        for (int id = 0; id < 4; ++id) {
+          const Dim3 idx = p.get_idx(rank, id);
+          REQUIRE(p.get_rank(idx) == rank);
+          REQUIRE(p.get_subdomain_id(idx) == id);
+          cudas.insert(p.get_cuda(idx));
+          seen.insert(idx);
+        }
+        REQUIRE(cudas == std::set<int>(job.cudaIds[rank].begin(), job.cudaIds[rank].end()));
+      }
+      REQUIRE(seen.size() == 64);
+
+      // 4x4x4 subdomains, so each node gets a 2x2x2 block of the curve
+      for (int node = 0; node < 8; ++node) {
+        std::set<int64_t> xs, ys, zs;
+        for (int rank = 2 * node; rank < 2 * node + 2; ++rank) {
+          for (int id = 0; id < 4; ++id) {
+            const Dim3 idx = p.get_idx(rank, id);
+            xs.insert(idx.x);
+            ys.insert(idx.y);
+            zs.insert(idx.z);
+          }
+        }
+        REQUIRE(xs.size() == 2);
+        REQUIRE(ys.size() == 2);
+        REQUIRE(zs.size() == 2);
+        REQUIRE(*xs.rbegin() - *xs.begin() == 1);
+      }
+    }
+  }
+}
@@ -0,0 +1,146 @@
+#include "catch2/catch.hpp"
+
+#include <memory>
+#include <sstream>
+
+#include "stencil/plan_cache.hpp"
+
+TEST_CASE("plan_cache") {
+
+  // 2x2x1 subdomains over 2 ranks with 2 GPUs each
+  const Dim3 size(10, 8, 3);
+  const Dim3 dim(2, 2, 1);
+  CachedPlacement placement(dim, AxisCuts({6, 4}, {3, 5}, {3}), {0, 0, 1, 1}, {0, 1, 0, 1}, {0, 1, 0, 1});
+
+  SECTION("fnv1a") {
+    // reference values for FNV-1a
+    REQUIRE(Fnv1a().value() == 14695981039346656037ull);
+    REQUIRE(Fnv1a().add("a", 1).value() == 0xaf63dc4c8601ec8cull);
+    REQUIRE(Fnv1a().add(std::string("ab")).value() != Fnv1a().add(std::string("ba")).value());
+    REQUIRE(Fnv1a().add(Dim3(1, 2, 3)).value() != Fnv1a().add(Dim3(3, 2, 1)).value());
+  }
+
+  SECTION("path") {
+    REQUIRE(plan_cache::path("dir", 0xabc, "placement") == "dir/stencil_0000000000000abc_placement.txt");
+    REQUIRE(plan_cache::path("dir/", 0xabc, "plan_1") == "dir/stencil_0000000000000abc_plan_1.txt");
+  }
+
+  SECTION("placement") {
+    std::stringstream ss;
+    REQUIRE(plan_cache::write_placement(ss, 7, size, placement));
+    std::unique_ptr<CachedPlacement> read(plan_cache::read_placement(ss, 7, size, 2));
+    REQUIRE(read);
+    REQUIRE(read->dim() == dim);
+    for (int64_t y = 0; y < dim.y; ++y) {
+      for (int64_t x = 0; x < dim.x; ++x) {
+        const Dim3 idx(x, y, 0);
+        REQUIRE(read->get_rank(idx) == placement.get_rank(idx));
+        REQUIRE(read->get_subdomain_id(idx) == placement.get_subdomain_id(idx));
+        REQUIRE(read->get_cuda(idx) == placement.get_cuda(idx));
+        REQUIRE(read->subdomain_size(idx) == placement.subdomain_size(idx));
+        REQUIRE(read->subdomain_origin(idx) == placement.subdomain_origin(idx));
+      }
+    }
+    REQUIRE(read->get_idx(1, 1) == Dim3(1, 1, 0));
+    REQUIRE(plan_cache::placement_key(7, *read) == plan_cache::placement_key(7, placement));
+    REQUIRE(plan_cache::placement_key(7, placement) != plan_cache::placement_key(8, placement));
+  }
+
+  SECTION("stale placement") {
+    std::stringstream ss;
+    REQUIRE(plan_cache::write_placement(ss, 7, size, placement));
+    const std::string s = ss.str();
+
+    { // different key
+      std::stringstream is(s);
+      REQUIRE(nullptr == plan_cache::read_placement(is, 8, size, 2));
+    }
+    { // different size
+      std::stringstream is(s);
+      REQUIRE(nullptr == plan_cache::read_placement(is, 7, Dim3(10, 8, 4), 2));
+    }
+    { // different number of ranks
+      std::stringstream is(s);
+      REQUIRE(nullptr == plan_cache::read_placement(is, 7, size, 3));
+    }
+    { // truncated
+      std::stringstream is(s.substr(0, s.size() - 6));
+      REQUIRE(nullptr == plan_cache::read_placement(is, 7, size, 2));
+    }
+    { // empty
+      std::stringstream is;
+      REQUIRE(nullptr == plan_cache::read_placement(is, 7, size, 2));
+    }
+  }
+
+  SECTION("plan") {
+    ExchangePlan plan;
+    plan.resize(2);
+    plan.peerAccessOutbox.push_back(Message(Dim3(1, 0, 0), 0, 0, Dim3(1, 3, 3)));
+    plan.peerCopyOutboxes[0][1].push_back(Message(Dim3(0, 1, 0), 0, 1, Dim3(6, 1, 3)));
+    plan.coloOutboxes[1][Dim3(0, 1, 0)].push_back(Message(Dim3(-1, 0, 0), 1, 0, Dim3(1, 5, 3)));
+    plan.remoteInboxes[0][Dim3(1, 1, 0)].push_back(Message(Dim3(1, 1, 0), 1, 0, Dim3(1, 1, 3)));
+    plan.remoteInboxes[0][Dim3(1, 1, 0)].push_back(Message(Dim3(-1, -1, 0), 1, 0, Dim3(1, 1, 3)));
+
+    std::stringstream ss;
+    plan_cache::write_plan(ss, 7, plan);
+    const std::string s = ss.str();
+
+    ExchangePlan read;
+    {
+      std::stringstream is(s);
+      REQUIRE(plan_cache::read_plan(is, 7, 2, read));
+    }
+    REQUIRE(read.peerAccessOutbox.size() == 1);
+    REQUIRE(read.peerAccessOutbox[0] == plan.peerAccessOutbox[0]);
+    REQUIRE(read.peerAccessOutbox[0].ext() == Dim3(1, 3, 3));
+    REQUIRE(read.peerCopyOutboxes[0][1].size() == 1);
+    REQUIRE(read.peerCopyOutboxes[1][0].empty());
+    REQUIRE(read.coloOutboxes[1].count(Dim3(0, 1, 0)));
+    REQUIRE(read.coloInboxes[0].empty());
+    REQUIRE(read.remoteOutboxes[0].empty());
+    REQUIRE(read.remoteInboxes[0][Dim3(1, 1, 0)].size() == 2);
+    REQUIRE(read.remoteInboxes[0][Dim3(1, 1, 0)][1] == plan.remoteInboxes[0][Dim3(1, 1, 0)][1]);
+
+    { // different key
+      std::stringstream is(s);
+      REQUIRE(!plan_cache::read_plan(is, 8, 2, read));
+    }
+    { // different number of domains
+      std::stringstream is(s);
+      REQUIRE(!plan_cache::read_plan(is, 7, 1, read));
+    }
+    { // truncated
+      std::stringstream is(s.substr(0, s.size() - 4));
+      REQUIRE(!plan_cache::read_plan(is, 7, 2, read));
+    }
+  }
+
+  SECTION("methods") {
+    const std::vector<Method> methods = {Method::CudaKernel, Method::None, Method::CudaMpi,
+                                         Method::ColoPackMemcpyUnpack | Method::CudaMpi};
+    std::stringstream ss;
+    plan_cache::write_methods(ss, 7, methods);
+    const std::string s = ss.str();
+
+    std::vector<Method> read;
+    {
+      std::stringstream is(s);
+      REQUIRE(plan_cache::read_methods(is, 7, methods.size(), read));
+    }
+    REQUIRE(read == methods);
+
+    { // different key
+      std::stringstream is(s);
+      REQUIRE(!plan_cache::read_methods(is, 8, methods.size(), read));
+    }
+    { // different number of messages
+      std::stringstream is(s);
+      REQUIRE(!plan_cache::read_methods(is, 7, methods.size() + 1, read));
+    }
+    { // truncated
+      std::stringstream is(s.substr(0, s.size() - 4));
+      REQUIRE(!plan_cache::read_methods(is, 7, methods.size(), read));
+    }
+  }
+}
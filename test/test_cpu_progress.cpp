@@ -0,0 +1,47 @@
+#include "catch2/catch.hpp"
+
+#include <atomic>
+
+#include "stencil/progress.hpp"
+
+TEST_CASE("progress thread") {
+
+  // pending until polled `n` times
+  std::atomic<int> polls(0);
+  int n = 0;
+  ProgressThread progress([&]() { return ++polls < n; });
+
+  SECTION("polls until done") {
+    n = 100;
+    progress.start();
+    progress.wait();
+    REQUIRE(progress.done());
+    REQUIRE(polls == 100);
+  }
+
+  SECTION("restart") {
+    for (int i = 1; i <= 3; ++i) {
+      polls = 0;
+      n = 10 * i;
+      progress.start();
+      while (!progress.done()) {
+      }
+      REQUIRE(polls == 10 * i);
+    }
+  }
+
+  SECTION("idle") { REQUIRE(progress.done()); }
+}
+
+TEST_CASE("progress thread pinned") {
+  bool polled = false;
+  ProgressThread progress(
+      [&]() {
+        polled = true;
+        return false;
+      },
+      0);
+  progress.start();
+  progress.wait();
+  REQUIRE(polled);
+}
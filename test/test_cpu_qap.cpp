@@ -1,5 +1,6 @@
 #include "catch2/catch.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 #include "stencil/mat2d.hpp"
@@ -107,4 +108,188 @@ TEST_CASE("qap") {
     INFO("check");
   }
 
-}
\ No newline at end of file
+  SECTION("solve matches exhaustive") {
+    srand(0);
+    for (size_t n = 2; n <= 8; ++n) {
+      Mat2D<double> bw(n, n);
+      Mat2D<double> comm(n, n);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          bw.at(i, j) = i == j ? inf : rand() % 100 + 1;
+          comm.at(i, j) = rand() % 10;
+        }
+      }
+      Mat2D<double> dist = make_reciprocal(bw);
+
+      double exCost, bbCost;
+      auto fEx = qap::solve_exhaustive(comm, dist, &exCost);
+      qap::SolveStats stats;
+      auto fBb = qap::solve(comm, dist, &bbCost, qap::SolveOptions(), &stats);
+
+      INFO("n=" << n);
+      REQUIRE(stats.optimal);
+      REQUIRE(bbCost == Approx(exCost));
+      REQUIRE(bbCost == Approx(qap::detail::cost(comm, dist, fBb)));
+      REQUIRE(fBb == fEx);
+    }
+  }
+
+  SECTION("solve infinite distance") {
+    // 0-1 can't talk, and 0 must talk to 1 or 2
+    Mat2D<double> bw = {{inf, 0, 1}, {0, inf, 1}, {1, 1, inf}};
+    Mat2D<double> comm = {{0, 0, 3}, {0, 0, 1}, {3, 1, 0}};
+    Mat2D<double> dist = make_reciprocal(bw);
+
+    double cost;
+    auto f = qap::solve(comm, dist, &cost);
+    REQUIRE(f[2] == 2);
+    REQUIRE(cost == Approx(8));
+  }
+
+  SECTION("solve 12") {
+    const size_t n = 12;
+    Mat2D<double> bw(n, n);
+    Mat2D<double> comm(n, n);
+    // two nodes of 6 GPUs, 3-GPU cliques in each node
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        if (i == j) {
+          bw.at(i, j) = inf;
+        } else if (i / 3 == j / 3) {
+          bw.at(i, j) = 75;
+        } else if (i / 6 == j / 6) {
+          bw.at(i, j) = 25;
+        } else {
+          bw.at(i, j) = 10;
+        }
+        // scrambled groups of 3 with heavy communication
+        comm.at(i, j) = ((i * 5) % n) / 3 == ((j * 5) % n) / 3 ? 100 : 1;
+      }
+    }
+    Mat2D<double> dist = make_reciprocal(bw);
+
+    double cost;
+    qap::SolveStats stats;
+    auto f = qap::solve(comm, dist, &cost, qap::SolveOptions(), &stats);
+    REQUIRE(stats.optimal);
+    REQUIRE(stats.lowerBound == Approx(cost));
+
+    // every heavy pair is within a clique
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        if (comm.at(i, j) == 100) {
+          REQUIRE(f[i] / 3 == f[j] / 3);
+        }
+      }
+    }
+  }
+
+  SECTION("solve time limit") {
+    const size_t n = 20;
+    Mat2D<double> bw(n, n);
+    Mat2D<double> comm(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        bw.at(i, j) = rand() % 100 + 1;
+        comm.at(i, j) = rand() % 100;
+      }
+    }
+    Mat2D<double> dist = make_reciprocal(bw);
+
+    qap::SolveOptions opts;
+    opts.timeLimit = 0.01;
+    double cost;
+    qap::SolveStats stats;
+    auto f = qap::solve(comm, dist, &cost, opts, &stats);
+    REQUIRE(!stats.optimal);
+    REQUIRE(stats.lowerBound <= cost);
+    REQUIRE(cost == Approx(qap::detail::cost(comm, dist, f)));
+    std::sort(f.begin(), f.end());
+    for (size_t i = 0; i < n; ++i) {
+      REQUIRE(f[i] == i);
+    }
+  }
+
+  SECTION("tabu matches exhaustive") {
+    srand(1);
+    for (size_t n = 2; n <= 8; ++n) {
+      Mat2D<double> bw(n, n);
+      Mat2D<double> comm(n, n);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          bw.at(i, j) = i == j ? inf : rand() % 100 + 1;
+          comm.at(i, j) = rand() % 10;
+        }
+      }
+      Mat2D<double> dist = make_reciprocal(bw);
+
+      double exCost, tabuCost;
+      qap::solve_exhaustive(comm, dist, &exCost);
+      auto f = qap::solve_tabu(comm, dist, &tabuCost);
+
+      INFO("n=" << n);
+      REQUIRE(tabuCost == Approx(exCost));
+      REQUIRE(tabuCost == Approx(qap::detail::cost(comm, dist, f)));
+    }
+  }
+
+  SECTION("tabu threads") {
+    const size_t n = 32;
+    Mat2D<double> bw(n, n);
+    Mat2D<double> comm(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        bw.at(i, j) = rand() % 100 + 1;
+        comm.at(i, j) = rand() % 100;
+      }
+    }
+    Mat2D<double> dist = make_reciprocal(bw);
+
+    qap::TabuOptions opts;
+    opts.threads = 1;
+    double cost1;
+    auto f1 = qap::solve_tabu(comm, dist, &cost1, opts);
+    opts.threads = 4;
+    double cost4;
+    auto f4 = qap::solve_tabu(comm, dist, &cost4, opts);
+
+    // same starts, same result
+    REQUIRE(f1 == f4);
+    REQUIRE(cost1 == cost4);
+
+    // no worse than a greedy descent
+    double catchCost;
+    qap::solve_catch(comm, dist, &catchCost);
+    REQUIRE(cost1 <= catchCost);
+
+    std::sort(f1.begin(), f1.end());
+    for (size_t i = 0; i < n; ++i) {
+      REQUIRE(f1[i] == i);
+    }
+  }
+
+  SECTION("solve auto") {
+    // exact up to kMaxExactSize, tabu past it
+    Mat2D<double> bw = {{inf, 0, 1}, {0, inf, 1}, {1, 1, inf}};
+    Mat2D<double> comm = {{0, 0, 3}, {0, 0, 1}, {3, 1, 0}};
+    Mat2D<double> dist = make_reciprocal(bw);
+    double exactCost, autoCost;
+    REQUIRE(qap::solve(comm, dist, &exactCost) == qap::solve_auto(comm, dist, &autoCost));
+    REQUIRE(autoCost == exactCost);
+
+    const size_t n = qap::kMaxExactSize + 1;
+    Mat2D<double> bigBw(n, n);
+    Mat2D<double> bigComm(n, n);
+    srand(0);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        bigBw.at(i, j) = rand() % 100 + 1;
+        bigComm.at(i, j) = rand() % 100;
+      }
+    }
+    Mat2D<double> bigDist = make_reciprocal(bigBw);
+    double tabuCost;
+    REQUIRE(qap::solve_tabu(bigComm, bigDist, &tabuCost) == qap::solve_auto(bigComm, bigDist, &autoCost));
+    REQUIRE(autoCost == tabuCost);
+  }
+}
@@ -32,4 +32,15 @@ TEST_CASE("radius") {
     REQUIRE(r0.z(-1) == 1);
     REQUIRE(r0.z(1) == 1);
   }
+
+  SECTION("scaled") {
+    r0 = Radius::face_edge_corner(2, 1, 0);
+    r1 = r0.scaled(3);
+
+    REQUIRE(r1.x(-1) == 6);
+    REQUIRE(r1.z(1) == 6);
+    REQUIRE(r1.dir(1, 1, 0) == 3);
+    REQUIRE(r1.dir(-1, 1, 1) == 0);
+    REQUIRE(r0.scaled(1) == r0);
+  }
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "catch2/catch.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "stencil/staging_arena.hpp"
+
+TEST_CASE("staging arena") {
+
+  StagingArena arena(StagingArena::Kind::Host);
+  REQUIRE(0 == arena.footprint());
+  REQUIRE(nullptr == arena.allocate(0));
+  arena.deallocate(nullptr);
+
+  SECTION("aligned and disjoint") {
+    std::vector<char *> bufs;
+    for (size_t n : {1, 300, 4096, 17}) {
+      char *p = static_cast<char *>(arena.allocate(n));
+      REQUIRE(p);
+      REQUIRE(0 == uintptr_t(p) % StagingArena::kAlign);
+      std::memset(p, int(bufs.size()), n);
+      bufs.push_back(p);
+    }
+    REQUIRE(bufs[0][0] == 0);
+    REQUIRE(bufs[1][299] == 1);
+    REQUIRE(bufs[2][4095] == 2);
+    REQUIRE(arena.in_use() == 256 + 512 + 4096 + 256);
+    REQUIRE(arena.footprint() == StagingArena::kMinBlock);
+    for (char *p : bufs) {
+      arena.deallocate(p);
+    }
+    REQUIRE(0 == arena.in_use());
+    REQUIRE(arena.high_water() == 256 + 512 + 4096 + 256);
+  }
+
+  SECTION("freed buffers are reused") {
+    const size_t n = StagingArena::kMinBlock / 4;
+    void *a = arena.allocate(n);
+    void *b = arena.allocate(n);
+    void *c = arena.allocate(n);
+    arena.deallocate(a);
+    arena.deallocate(b);
+    INFO("the neighboring free ranges are merged");
+    void *d = arena.allocate(2 * n);
+    REQUIRE(d == a);
+    REQUIRE(arena.footprint() == StagingArena::kMinBlock);
+    arena.deallocate(c);
+    arena.deallocate(d);
+    REQUIRE(arena.high_water() == 3 * n);
+  }
+
+  SECTION("grows and trims") {
+    void *a = arena.allocate(StagingArena::kMinBlock);
+    REQUIRE(arena.footprint() == StagingArena::kMinBlock);
+    INFO("a new block at least doubles the footprint");
+    void *b = arena.allocate(1);
+    REQUIRE(arena.footprint() == 2 * StagingArena::kMinBlock);
+    arena.deallocate(b);
+    arena.trim();
+    REQUIRE(arena.footprint() == StagingArena::kMinBlock);
+    arena.deallocate(a);
+    arena.trim();
+    REQUIRE(0 == arena.footprint());
+    REQUIRE(arena.high_water() == StagingArena::kMinBlock + StagingArena::kAlign);
+  }
+
+  SECTION("reserve") {
+    arena.reserve(3 * StagingArena::kMinBlock);
+    const size_t footprint = arena.footprint();
+    REQUIRE(footprint >= 3 * StagingArena::kMinBlock);
+    void *a = arena.allocate(3 * StagingArena::kMinBlock);
+    REQUIRE(arena.footprint() == footprint);
+    arena.deallocate(a);
+  }
+}
@@ -65,6 +65,106 @@ static __global__ void init_kernel(Accessor<T> dst, //<! [out] pointer to beginn
   }
 }
 
+/* the packed coordinate, like pack_xyz(), for domains in host memory
+ */
+static int pack_host(const Dim3 &p) { return int(p.x | (p.y << 10) | (p.z << 20)); }
+
+/*! Call f(di, p, interior) for every point `p` of the full region of each domain `di`, where `interior` is whether
+    `p` is in the compute region
+ */
+template <typename F> static void for_each_point(DistributedDomain &dd, F f) {
+  for (size_t di = 0; di < dd.domains().size(); ++di) {
+    const Rect3 full = dd.domains()[di].get_full_region();
+    const Rect3 cr = dd.domains()[di].get_compute_region();
+    for (int64_t z = full.lo.z; z < full.hi.z; ++z) {
+      for (int64_t y = full.lo.y; y < full.hi.y; ++y) {
+        for (int64_t x = full.lo.x; x < full.hi.x; ++x) {
+          const bool interior =
+              x >= cr.lo.x && y >= cr.lo.y && z >= cr.lo.z && x < cr.hi.x && y < cr.hi.y && z < cr.hi.z;
+          f(di, Dim3(x, y, z), interior);
+        }
+      }
+    }
+  }
+}
+
+/*! Set the compute region of each host domain to the packed coordinate, and the halo to -1, like init_kernel
+ */
+template <typename T> static void fill_packed(DistributedDomain &dd, const DataHandle<T> &dh) {
+  for_each_point(dd, [&](size_t di, const Dim3 &p, bool interior) {
+    REQUIRE(dd.domains()[di].is_host());
+    Accessor<T> acc = dd.domains()[di].get_curr_accessor(dh);
+    acc[p] = interior ? T(pack_host(p)) : T(-1);
+  });
+}
+
+/*! Every point of each host domain, halo included, holds the packed coordinate it wraps to in a domain of `size`
+ */
+template <typename T> static void check_wrapped(DistributedDomain &dd, const DataHandle<T> &dh, const Dim3 &size) {
+  for_each_point(dd, [&](size_t di, const Dim3 &p, bool) {
+    Accessor<T> acc = dd.domains()[di].get_curr_accessor(dh);
+    Dim3 src = p;
+    src = src.wrap(size);
+    REQUIRE(acc[p] == T(pack_host(src)));
+  });
+}
+
+/*! The interior of every quantity of each device domain holds its packed coordinate, as init_kernel left it
+ */
+template <typename Q> static void check_device_interior(DistributedDomain &dd) {
+  for (auto &d : dd.domains()) {
+    const Dim3 origin = d.origin();
+    const Dim3 ext = d.halo_extent(Dim3(0, 0, 0));
+    for (size_t qi = 0; qi < d.num_data(); ++qi) {
+      auto vec = d.interior_to_host(qi);
+      std::vector<Q> interior(ext.flatten());
+      REQUIRE(vec.size() == interior.size() * sizeof(Q));
+      std::memcpy(interior.data(), vec.data(), vec.size());
+      for (int64_t z = 0; z < ext.z; ++z) {
+        for (int64_t y = 0; y < ext.y; ++y) {
+          for (int64_t x = 0; x < ext.x; ++x) {
+            Q val = interior[z * (ext.y * ext.x) + y * (ext.x) + x];
+            REQUIRE(unpack_x(val) == x + origin.x);
+            REQUIRE(unpack_y(val) == y + origin.y);
+            REQUIRE(unpack_z(val) == z + origin.z);
+          }
+        }
+      }
+    }
+  }
+}
+
+/*! Every point of every quantity of each device domain, including a halo `radius` deep on each side, holds the packed
+    coordinate it wraps to in a domain of `size`
+ */
+template <typename Q> static void check_device_wrapped(DistributedDomain &dd, size_t radius, const Dim3 &size) {
+  for (auto &d : dd.domains()) {
+    const Dim3 origin = d.origin();
+    Dim3 ext = d.size();
+    ext.x += 2 * radius;
+    ext.y += 2 * radius;
+    ext.z += 2 * radius;
+    for (size_t qi = 0; qi < d.num_data(); ++qi) {
+      auto vec = d.quantity_to_host(qi);
+      std::vector<Q> quantity(ext.flatten());
+      REQUIRE(vec.size() == quantity.size() * sizeof(Q));
+      std::memcpy(quantity.data(), vec.data(), vec.size());
+      for (int64_t z = 0; z < ext.z; ++z) {
+        for (int64_t y = 0; y < ext.y; ++y) {
+          for (int64_t x = 0; x < ext.x; ++x) {
+            Dim3 coord = Dim3(x, y, z) - Dim3(radius, radius, radius) + origin;
+            coord = coord.wrap(size);
+            Q val = quantity[z * (ext.y * ext.x) + y * (ext.x) + x];
+            REQUIRE(unpack_x(val) == coord.x);
+            REQUIRE(unpack_y(val) == coord.y);
+            REQUIRE(unpack_z(val) == coord.z);
+          }
+        }
+      }
+    }
+  }
+}
+
 TEST_CASE("exchange1") {
 
   int rank;
@@ -82,6 +182,13 @@ TEST_CASE("exchange1") {
   dd.set_radius(radius);
   auto dh1 = dd.add_data<Q1>("d0");
   dd.set_methods(Method::CudaMpi);
+  SECTION("raw") {}
+  SECTION("compressed") { dd.set_compression(true, 1 /*bytes/s, so compressing always pays off*/); }
+  // each message uses whichever method was fastest, so the exchange mixes them
+  SECTION("autotuned") {
+    dd.set_methods(Method::Default);
+    dd.set_autotune(true, 1, 2);
+  }
 
   INFO("realize");
   dd.realize();
@@ -115,99 +222,241 @@ TEST_CASE("exchange1") {
 
   // test initialization
   INFO("test compute region");
-  for (size_t di = 0; di < dd.domains().size(); ++di) {
-    auto &d = dd.domains()[di];
-    const Dim3 origin = d.origin();
-    const Dim3 ext = d.halo_extent(Dim3(0, 0, 0));
+  check_device_interior<Q1>(dd);
 
-    for (size_t qi = 0; qi < d.num_data(); ++qi) {
-      auto vec = d.interior_to_host(qi);
+  MPI_Barrier(MPI_COMM_WORLD);
 
-      // make sure we can access data as a Q1
-      std::vector<Q1> interior(ext.flatten());
-      REQUIRE(vec.size() == interior.size() * sizeof(Q1));
-      std::memcpy(interior.data(), vec.data(), vec.size());
+  INFO("exchange");
 
-      for (int64_t z = 0; z < ext.z; ++z) {
-        for (int64_t y = 0; y < ext.y; ++y) {
-          for (int64_t x = 0; x < ext.x; ++x) {
-            Q1 val = interior[z * (ext.y * ext.x) + y * (ext.x) + x];
-            REQUIRE(unpack_x(val) == x + origin.x);
-            REQUIRE(unpack_y(val) == y + origin.y);
-            REQUIRE(unpack_z(val) == z + origin.z);
-          }
+  dd.exchange();
+  CUDA_RUNTIME(cudaDeviceSynchronize());
+
+  INFO("interior should be unchanged");
+  check_device_interior<Q1>(dd);
+
+  INFO("check halo regions");
+  check_device_wrapped<Q1>(dd, radius, Dim3(10, 10, 10));
+}
+
+TEST_CASE("exchange split-phase host") {
+
+  const size_t radius = 1;
+  const Dim3 size(10, 10, 10);
+
+  DistributedDomain dd(size.x, size.y, size.z);
+  dd.set_radius(radius);
+  auto dh = dd.add_data<int>("d0");
+  dd.set_methods(Method::HostMpi);
+  SECTION("polled") {}
+  SECTION("progress thread") { dd.set_progress_thread(true); }
+  SECTION("aggregated") { dd.set_aggregate(true); }
+  // edges and corners arrive through the faces of later rounds
+  SECTION("phased") { dd.set_exchange_rounds(ExchangeRounds::Phased); }
+  SECTION("phased progress thread") {
+    dd.set_exchange_rounds(ExchangeRounds::Phased);
+    dd.set_progress_thread(true);
+  }
+  SECTION("phased aggregated") {
+    dd.set_exchange_rounds(ExchangeRounds::Phased);
+    dd.set_aggregate(true);
+  }
+  dd.realize();
+
+  fill_packed(dd, dh);
+
+  ExchangeHandle h = dd.exchange_begin();
+  while (!dd.exchange_test(h)) {
+  }
+  dd.exchange_end(h);
+
+  check_wrapped(dd, dh, size);
+}
+
+TEST_CASE("exchange arrival callback host") {
+
+  const size_t radius = 1;
+  const Dim3 size(10, 10, 10);
+
+  DistributedDomain dd(size.x, size.y, size.z);
+  dd.set_radius(radius);
+  auto dh = dd.add_data<int>("d0");
+  dd.set_methods(Method::HostMpi);
+  SECTION("polled") {}
+  SECTION("progress thread") { dd.set_progress_thread(true); }
+  SECTION("aggregated") { dd.set_aggregate(true); }
+  SECTION("phased") { dd.set_exchange_rounds(ExchangeRounds::Phased); }
+
+  // when a region is reported, every point it reads holds the neighbor's value
+  std::vector<std::vector<Rect3>> exterior;
+  std::vector<std::vector<int>> reported;
+  dd.set_arrival_callback([&](size_t di, size_t ri) {
+    REQUIRE(di < exterior.size());
+    REQUIRE(ri < exterior[di].size());
+    ++reported[di][ri];
+    Accessor<int> acc = dd.domains()[di].get_curr_accessor(dh);
+    const Rect3 reg = exterior[di][ri];
+    for (int64_t z = reg.lo.z - 1; z < reg.hi.z + 1; ++z) {
+      for (int64_t y = reg.lo.y - 1; y < reg.hi.y + 1; ++y) {
+        for (int64_t x = reg.lo.x - 1; x < reg.hi.x + 1; ++x) {
+          Dim3 src(x, y, z);
+          src = src.wrap(size);
+          REQUIRE(acc[Dim3(x, y, z)] == pack_host(src));
         }
       }
     }
+  });
+  dd.realize();
+
+  exterior = dd.get_exterior();
+  fill_packed(dd, dh);
+
+  // two exchanges, to see the reports are reset in between
+  for (int iter = 0; iter < 2; ++iter) {
+    reported.clear();
+    for (auto &regs : exterior) {
+      reported.push_back(std::vector<int>(regs.size(), 0));
+    }
+    ExchangeHandle h = dd.exchange_begin();
+    while (!dd.exchange_test(h)) {
+    }
+    dd.exchange_end(h);
+
+    INFO("every region is reported exactly once");
+    for (size_t di = 0; di < exterior.size(); ++di) {
+      for (size_t ri = 0; ri < exterior[di].size(); ++ri) {
+        REQUIRE(1 == reported[di][ri]);
+        REQUIRE(dd.exterior_ready(di, ri));
+      }
+    }
   }
+}
 
-  MPI_Barrier(MPI_COMM_WORLD);
+TEST_CASE("exchange quantity set host") {
 
-  INFO("exchange");
+  const size_t radius = 1;
+  const Dim3 size(10, 10, 10);
+
+  DistributedDomain dd(size.x, size.y, size.z);
+  dd.set_radius(radius);
+  auto dh0 = dd.add_data<int>("d0");
+  auto dh1 = dd.add_data<int>("d1");
+  QuantitySet only1 = dd.add_quantity_set(dh1);
+  dd.set_methods(Method::HostMpi);
+  SECTION("per pair") {}
+  SECTION("aggregated") { dd.set_aggregate(true); }
+  dd.realize();
 
+  fill_packed(dd, dh0);
+  fill_packed(dd, dh1);
+
+  INFO("exchange d1 only");
+  dd.exchange(only1);
+  check_wrapped(dd, dh1, size);
+  // d0's halo is untouched
+  for_each_point(dd, [&](size_t di, const Dim3 &p, bool interior) {
+    Accessor<int> acc0 = dd.domains()[di].get_curr_accessor(dh0);
+    REQUIRE(acc0[p] == (interior ? pack_host(p) : -1));
+  });
+
+  INFO("exchange everything");
   dd.exchange();
-  CUDA_RUNTIME(cudaDeviceSynchronize());
+  check_wrapped(dd, dh0, size);
+}
 
-  INFO("interior should be unchanged");
-  for (size_t di = 0; di < dd.domains().size(); ++di) {
-    auto &d = dd.domains()[di];
-    const Dim3 origin = d.origin();
-    const Dim3 ext = d.halo_extent(Dim3(0, 0, 0));
+TEST_CASE("exchange wire format host") {
 
-    for (size_t qi = 0; qi < d.num_data(); ++qi) {
-      auto vec = d.interior_to_host(qi);
+  int worldSize;
+  MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
 
-      // make sure we can access data as a Q1
-      std::vector<Q1> interior(ext.flatten());
-      REQUIRE(vec.size() == interior.size() * sizeof(Q1));
-      std::memcpy(interior.data(), vec.data(), vec.size());
+  const size_t radius = 1;
+  const Dim3 size(10, 10, 10);
 
-      for (int64_t z = 0; z < ext.z; ++z) {
-        for (int64_t y = 0; y < ext.y; ++y) {
-          for (int64_t x = 0; x < ext.x; ++x) {
-            Q1 val = interior[z * (ext.y * ext.x) + y * (ext.x) + x];
-            REQUIRE(unpack_x(val) == x + origin.x);
-            REQUIRE(unpack_y(val) == y + origin.y);
-            REQUIRE(unpack_z(val) == z + origin.z);
-          }
-        }
-      }
+  DistributedDomain dd(size.x, size.y, size.z);
+  dd.set_radius(radius);
+  auto dh = dd.add_data<double>("d0", WireFormat::float32());
+  dd.set_methods(Method::HostMpi);
+  dd.realize();
+
+  // not representable as a float, so a value that crossed ranks differs from the exact one
+  auto val = [](const Dim3 &p) { return double(p.x + 10 * p.y + 100 * p.z) + 1.0 / 3; };
+  for_each_point(dd, [&](size_t di, const Dim3 &p, bool interior) {
+    Accessor<double> acc = dd.domains()[di].get_curr_accessor(dh);
+    acc[p] = interior ? val(p) : -1;
+  });
+
+  dd.exchange();
+
+  uint64_t lossy = 0;
+  for_each_point(dd, [&](size_t di, const Dim3 &p, bool interior) {
+    Accessor<double> acc = dd.domains()[di].get_curr_accessor(dh);
+    Dim3 src = p;
+    src = src.wrap(size);
+    const double exact = val(src);
+    if (interior) {
+      REQUIRE(acc[p] == exact);
+    } else {
+      REQUIRE((acc[p] == exact || acc[p] == double(float(exact))));
+      lossy += acc[p] != exact;
     }
+  });
+
+  uint64_t allLossy = 0;
+  MPI_Allreduce(&lossy, &allLossy, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  if (worldSize > 1) {
+    REQUIRE(allLossy > 0);
+  } else {
+    REQUIRE(allLossy == 0);
   }
+}
 
-  INFO("check halo regions");
+TEST_CASE("exchange deep halo host") {
 
-  for (size_t di = 0; di < dd.domains().size(); ++di) {
-    auto &d = dd.domains()[di];
-    const Dim3 origin = d.origin();
+  const size_t radius = 1;
+  const size_t depth = 2;
+  const Dim3 size(10, 10, 10);
 
-    Dim3 ext = d.size();
-    ext.x += 2 * radius;
-    ext.y += 2 * radius;
-    ext.z += 2 * radius;
+  DistributedDomain dd(size.x, size.y, size.z);
+  dd.set_radius(radius);
+  dd.set_halo_depth(depth);
+  auto dh = dd.add_data<int>("d0");
+  dd.set_methods(Method::HostMpi);
+  dd.realize();
+  REQUIRE(dd.exchange_due());
 
-    for (size_t qi = 0; qi < d.num_data(); ++qi) {
-      auto vec = d.quantity_to_host(qi);
-      // access quantity data as a Q1
-      std::vector<Q1> quantity(ext.flatten());
-      REQUIRE(vec.size() == quantity.size() * sizeof(Q1));
-      std::memcpy(quantity.data(), vec.data(), vec.size());
+  for (auto &d : dd.domains()) {
+    REQUIRE(d.get_compute_region().lo.x - d.get_full_region().lo.x == int64_t(radius * depth));
+  }
+  fill_packed(dd, dh);
 
-      for (int64_t z = 0; z < ext.z; ++z) {
-        for (int64_t y = 0; y < ext.y; ++y) {
-          for (int64_t x = 0; x < ext.x; ++x) {
-            Dim3 xyz = Dim3(x, y, z);
-            Dim3 coord = xyz - Dim3(radius, radius, radius) + origin;
-            coord = coord.wrap(Dim3(10, 10, 10));
+  dd.exchange();
+  REQUIRE(!dd.exchange_due());
+  check_wrapped(dd, dh, size);
 
-            Q1 val = quantity[z * (ext.y * ext.x) + y * (ext.x) + x];
-            REQUIRE(unpack_x(val) == coord.x);
-            REQUIRE(unpack_y(val) == coord.y);
-            REQUIRE(unpack_z(val) == coord.z);
-          }
-        }
-      }
+  std::vector<Rect3> valid = dd.get_valid_regions();
+  for (size_t di = 0; di < dd.domains().size(); ++di) {
+    const Rect3 full = dd.domains()[di].get_full_region();
+    REQUIRE(valid[di].lo == full.lo);
+    REQUIRE(valid[di].hi == full.hi);
+  }
+
+  // each step's region shrinks by the radius, down to the compute region
+  for (size_t step = 0; step < depth; ++step) {
+    REQUIRE(!dd.exchange_due());
+    std::vector<Rect3> regions = dd.get_step_regions();
+    for (size_t di = 0; di < dd.domains().size(); ++di) {
+      const Rect3 cr = dd.domains()[di].get_compute_region();
+      const int64_t grow = radius * (depth - step - 1);
+      REQUIRE(regions[di].lo == cr.lo - Dim3(grow, grow, grow));
+      REQUIRE(regions[di].hi == cr.hi + Dim3(grow, grow, grow));
     }
+    dd.swap();
+  }
+  REQUIRE(dd.exchange_due());
+  valid = dd.get_valid_regions();
+  for (size_t di = 0; di < dd.domains().size(); ++di) {
+    const Rect3 cr = dd.domains()[di].get_compute_region();
+    REQUIRE(valid[di].lo == cr.lo);
+    REQUIRE(valid[di].hi == cr.hi);
   }
 }
 
@@ -242,4 +491,66 @@ TEST_CASE("swap") {
 
   INFO("swap");
   dd.swap();
-}
\ No newline at end of file
+}
+
+TEST_CASE("rebalance") {
+  int rank;
+  int size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t radius = 1;
+  typedef float Q1;
+
+  INFO("ctor");
+  DistributedDomain dd(10, 10, 10);
+  dd.set_radius(radius);
+  auto dh1 = dd.add_data<Q1>("d0");
+  dd.set_methods(Method::CudaMpi);
+
+  INFO("realize");
+  dd.realize();
+
+  INFO("init");
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+  for (auto &d : dd.domains()) {
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    init_kernel<<<dimGrid, dimBlock>>>(d.get_curr_accessor(dh1), d.get_compute_region());
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+  }
+
+  INFO("rebalance");
+  // rank 0's first domain is three times slower than the rest
+  std::vector<double> times(dd.domains().size(), 1);
+  if (0 == rank && !times.empty()) {
+    times[0] = 3;
+  }
+  const Dim3 oldSize = dd.domains().empty() ? Dim3(0, 0, 0) : dd.domains()[0].size();
+  dd.rebalance(times);
+
+  INFO("volume is conserved");
+  uint64_t volume = 0;
+  for (auto &d : dd.domains()) {
+    volume += d.size().flatten();
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &volume, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  REQUIRE(volume == 1000);
+
+  INFO("the slow subdomain shrinks if another subdomain can take its work");
+  uint64_t numSubdomains = dd.domains().size();
+  MPI_Allreduce(MPI_IN_PLACE, &numSubdomains, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+  if (0 == rank && numSubdomains > 1 && !dd.domains().empty()) {
+    REQUIRE(dd.domains()[0].size().flatten() < oldSize.flatten());
+  }
+
+  INFO("interior moved with the boundaries");
+  check_device_interior<Q1>(dd);
+
+  INFO("exchange");
+  dd.exchange();
+  CUDA_RUNTIME(cudaDeviceSynchronize());
+
+  INFO("check halo regions");
+  check_device_wrapped<Q1>(dd, radius, Dim3(10, 10, 10));
+}